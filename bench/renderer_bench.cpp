@@ -0,0 +1,807 @@
+// Vulkan Renderer - Benchmark Suite
+//
+// renderer_bench [--frames N] [--warmup N] [--scene name]... [--out results.json]
+//                [--baseline baseline.json] [--tolerance 0.10]
+//
+// Every scene runs headless with validation off, so results are comparable across
+// machines with the same driver (e.g. lavapipe in CI). Exits 1 when a metric is
+// worse than the baseline by more than the tolerance, 2 on a usage or setup error.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <regex>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "Renderer.h"
+
+
+#define BENCH_FRAMES 500
+#define BENCH_WARMUP_FRAMES 50
+#define BENCH_TOLERANCE 0.10										// Allowed slowdown over the baseline, as a fraction
+#define BENCH_NOISE_FLOOR_MS 0.05									// Smaller absolute changes never count as regressions
+
+#define BENCH_TRIANGLES 200000
+#define BENCH_DRAWS 20000
+#define BENCH_PIPELINES 64
+#define BENCH_UPLOAD_VERTICES (256 * 1024)							// ~5 MiB of vertices & indices re-uploaded every frame
+#define BENCH_OBJECTS 100000
+#define BENCH_INSTANCES 20000										// Same objects two ways - one instanced draw vs one draw each
+#define BENCH_MODEL_SEGMENTS 512									// Sphere of 2 * 512 * 512 triangles, loaded from OBJ text & from .rmesh
+#define BENCH_MODEL_OBJ "bench_model.obj"
+#define BENCH_MODEL_RMESH "bench_model.rmesh"
+#define BENCH_MODEL_RAW_RMESH "bench_model_raw.rmesh"						// Packed in source order with 32 bit float attributes & one level
+#define BENCH_FIELD_SIDE 16											// Spheres per side of the small field - the large one has 16x as many
+#define BENCH_FIELD_SPACING 3.0f
+#define BENCH_FIELD_TRIANGLE_BUDGET (256 * 1024)							// Model triangles per frame for the budgeted field
+#define BENCH_SCENE_ROOTS 512										// Scene graph of 512 roots with 16 children of 16 children each
+#define BENCH_SCENE_FANOUT 16
+#define BENCH_SCENE_SPARSE_NODES 1400								// Nodes moved per frame by the sparse variant - about 1%
+
+
+struct SceneResult
+{
+	std::string name;
+	uint32_t frames = 0;
+	double setupMs = 0.0;											// Renderer init plus scene specific setup
+	double loadMs = 0.0;											// The scene's load step alone - 0 without one
+	double p50Ms = 0.0;
+	double p99Ms = 0.0;
+	double averageMs = 0.0;
+	double cpuP50Ms = 0.0;											// CPU recording & submit, waits excluded
+	double cpuP99Ms = 0.0;
+	uint64_t peakGpuBytes = 0;
+	uint64_t peakRssKb = 0;											// Process high water mark - grows across scenes
+	uint64_t vertexBytes = 0;										// Vertex buffer of the model the load step loaded
+	double vsInvocations = 0.0;										// Per frame, 0 unless the scene profiles the GPU
+	double triangles = 0.0;											// Input assembly primitives per frame, same condition
+	double sceneUpdateMs = 0.0;										// Average scene graph update - 0 for scenes without nodes
+};
+
+
+struct Scene
+{
+	const char* name;
+	std::function<void(Renderer&)> setup;							// Runs once after init
+	std::function<void(Renderer&, uint32_t)> frame;					// Runs before each frame - may be empty
+	bool gpuDriven;
+	std::function<void(Renderer&)> load = nullptr;					// Runs after setup, timed on its own - may be empty
+	bool profileGpu = false;										// Pipeline statistics for vs_invocations & triangles
+	float lodErrorPixels = 1.0f;									// 0 draws models at full detail
+	uint32_t lodTriangleBudget = 0;
+};
+
+
+// Nearest rank percentile
+static double percentile(std::vector<double> samples, double fraction)
+{
+	if (samples.empty())
+	{
+		return 0.0;
+	}
+	size_t rank = (size_t)std::min<double>(samples.size() - 1, fraction * samples.size());
+	std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+	return samples[rank];
+}
+
+
+static uint64_t peakRssKb()
+{
+#ifdef __linux__
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return (uint64_t)usage.ru_maxrss;
+#else
+	return 0;
+#endif
+}
+
+
+// Deterministic position in [-1, 1] for object i
+static void objectPosition(uint32_t i, float& x, float& y)
+{
+	uint32_t seed = i * 2654435761u + 1;
+	seed = seed * 1664525u + 1013904223u;
+	x = (seed >> 8) / 16777216.0f * 2.0f - 1.0f;
+	seed = seed * 1664525u + 1013904223u;
+	y = (seed >> 8) / 16777216.0f * 2.0f - 1.0f;
+}
+
+
+// A grid of small triangles - vertex & raster heavy, one draw
+static void buildTriangleGrid(uint32_t triangleCount, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	uint32_t side = 1;
+	while (side * side < triangleCount)
+	{
+		side++;
+	}
+	float cell = 2.0f / side;
+
+	vertices.clear();
+	indices.clear();
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		float x = -1.0f + (i % side) * cell;
+		float y = -1.0f + (i / side) * cell;
+		uint32_t base = (uint32_t)vertices.size();
+		vertices.push_back({ { x, y }, { 1.0f, 0.0f, 0.0f } });
+		vertices.push_back({ { x + cell, y }, { 0.0f, 1.0f, 0.0f } });
+		vertices.push_back({ { x, y + cell }, { 0.0f, 0.0f, 1.0f } });
+		indices.push_back(base);
+		indices.push_back(base + 1);
+		indices.push_back(base + 2);
+	}
+}
+
+
+// UV sphere written as OBJ text, then packed optimized & raw - the files are reused by later runs
+static void writeBenchModel()
+{
+	MeshContainer existing;
+	MeshContainer existing_raw;
+	if (existing.open(BENCH_MODEL_RMESH) && existing_raw.open(BENCH_MODEL_RAW_RMESH))
+	{
+		return;
+	}
+
+	std::ofstream obj(BENCH_MODEL_OBJ, std::ios::trunc);
+	const uint32_t segments = BENCH_MODEL_SEGMENTS;
+	char line[128];
+	for (uint32_t y = 0; y <= segments; y++)
+	{
+		for (uint32_t x = 0; x <= segments; x++)
+		{
+			float theta = 3.14159265f * y / segments;
+			float phi = 6.28318531f * x / segments;
+			float px = std::sin(theta) * std::cos(phi), py = std::cos(theta), pz = std::sin(theta) * std::sin(phi);
+			std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\nvt %.6f %.6f\n",
+				px, py, pz, px, py, pz, (float)x / segments, 1.0f - (float)y / segments);
+			obj << line;
+		}
+	}
+	for (uint32_t y = 0; y < segments; y++)
+	{
+		for (uint32_t x = 0; x < segments; x++)
+		{
+			uint32_t a = y * (segments + 1) + x + 1;
+			uint32_t b = a + segments + 1;
+			std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+			obj << line;
+		}
+	}
+	obj.close();
+
+	MeshData mesh;
+	std::vector<uint8_t> container;
+	std::vector<uint8_t> raw_container;
+	MeshBuildOptions raw_options;
+	raw_options.optimizeIndices = false;
+	raw_options.quantize = false;
+	raw_options.generateLods = false;
+	if (!MeshContainer::importObj(BENCH_MODEL_OBJ, mesh)
+		|| !MeshContainer::build(mesh, container) || !MeshContainer::write(BENCH_MODEL_RMESH, container)
+		|| !MeshContainer::build(mesh, raw_container, raw_options) || !MeshContainer::write(BENCH_MODEL_RAW_RMESH, raw_container))
+	{
+		throw std::runtime_error("[!] Failed to write the benchmark model");
+	}
+}
+
+
+static void drawBenchModel(Renderer& vulkan, uint32_t frame)
+{
+	DrawConstants constants;
+	float angle = frame * 0.01f;
+	constants.model[0] = 0.8f * std::cos(angle);
+	constants.model[2] = -0.8f * std::sin(angle);
+	constants.model[5] = 0.8f;
+	constants.model[8] = 0.8f * std::sin(angle);
+	constants.model[10] = 0.8f * std::cos(angle);
+	vulkan.drawModel(0, constants);
+}
+
+
+// Rotation about y & a translation - the transform every animated scene graph node gets
+static void benchNodeTransform(float matrix[16], float angle, float x, float y, float z)
+{
+	std::memset(matrix, 0, 16 * sizeof(float));
+	matrix[0] = std::cos(angle);
+	matrix[2] = -std::sin(angle);
+	matrix[5] = 1.0f;
+	matrix[8] = std::sin(angle);
+	matrix[10] = std::cos(angle);
+	matrix[12] = x;
+	matrix[13] = y;
+	matrix[14] = z;
+	matrix[15] = 1.0f;
+}
+
+
+// Transform only nodes - drawing them would measure the model path instead of propagation
+static void buildBenchScene(Renderer& vulkan, std::vector<SceneNode>& nodes)
+{
+	SceneGraph& scene = vulkan.getScene();
+	float matrix[16];
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t r = 0; r < BENCH_SCENE_ROOTS; r++)
+	{
+		SceneNode root = scene.createNode();
+		benchNodeTransform(matrix, 0.0f, (float)(r % 32) * 8.0f, 0.0f, (float)(r / 32) * 8.0f);
+		scene.setLocalTransform(root, matrix);
+		nodes.push_back(root);
+		for (uint32_t c = 0; c < BENCH_SCENE_FANOUT; c++)
+		{
+			SceneNode child = scene.createNode(root);
+			benchNodeTransform(matrix, c * 0.39f, 2.0f, 0.0f, 0.0f);
+			scene.setLocalTransform(child, matrix);
+			nodes.push_back(child);
+			for (uint32_t g = 0; g < BENCH_SCENE_FANOUT; g++)
+			{
+				SceneNode leaf = scene.createNode(child);
+				benchNodeTransform(matrix, g * 0.39f, 0.5f, 0.0f, 0.0f);
+				scene.setLocalTransform(leaf, matrix);
+				scene.setLocalBounds(leaf, center, 0.25f);
+				nodes.push_back(leaf);
+			}
+		}
+	}
+	scene.update();
+}
+
+
+// Square field of spheres in front of a perspective camera that creeps forward - each sphere keeps its level between frames
+static void drawBenchField(Renderer& vulkan, uint32_t frame, uint32_t side, std::vector<uint32_t>& lods)
+{
+	// Vulkan clip space: y down, depth 0 - 1. Looking down +z from above the field's near edge, tilted down.
+	const float fov = 1.0471976f, aspect = 16.0f / 9.0f, near_plane = 0.1f, far_plane = 1000.0f;
+	const float pitch = 0.35f;
+	float f = 1.0f / std::tan(fov * 0.5f);
+	float eye[3] = { 0.0f, 6.0f, -4.0f + frame * 0.02f };
+	float c = std::cos(pitch), s = std::sin(pitch);
+	float right[3] = { 1.0f, 0.0f, 0.0f };
+	float up[3] = { 0.0f, c, s };
+	float forward[3] = { 0.0f, -s, c };
+
+	float view_projection[16] = {};
+	for (int column = 0; column < 3; column++)
+	{
+		view_projection[column * 4 + 0] = f / aspect * right[column];
+		view_projection[column * 4 + 1] = -f * up[column];
+		view_projection[column * 4 + 2] = far_plane / (far_plane - near_plane) * forward[column];
+		view_projection[column * 4 + 3] = forward[column];
+	}
+	for (int row = 0; row < 4; row++)
+	{
+		float translation = 0.0f;
+		for (int column = 0; column < 3; column++)
+		{
+			translation -= view_projection[column * 4 + row] * eye[column];
+		}
+		view_projection[12 + row] = translation;
+	}
+	view_projection[14] -= far_plane * near_plane / (far_plane - near_plane);
+	vulkan.setViewProjection(view_projection);
+
+	lods.resize(side * side, UINT32_MAX);
+	DrawConstants constants;
+	for (uint32_t z = 0; z < side; z++)
+	{
+		for (uint32_t x = 0; x < side; x++)
+		{
+			constants.model[12] = ((float)x - (side - 1) * 0.5f) * BENCH_FIELD_SPACING;
+			constants.model[14] = (float)z * BENCH_FIELD_SPACING;
+			vulkan.drawModel(0, constants, &lods[z * side + x]);
+		}
+	}
+}
+
+
+static std::vector<Scene> buildScenes()
+{
+	std::vector<Scene> scenes;
+
+	scenes.push_back({ "triangles", [](Renderer& vulkan) {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		buildTriangleGrid(BENCH_TRIANGLES, vertices, indices);
+		vulkan.uploadMesh(vertices, indices);
+	}, nullptr, false });
+
+	scenes.push_back({ "draws", [](Renderer& vulkan) {
+		vulkan.setDrawList(std::vector<VkDrawIndexedIndirectCommand>(BENCH_DRAWS, vulkan.getDrawList()[0]));
+	}, nullptr, false });
+
+	// Every instance is rewritten in place each frame, like a particle system would
+	scenes.push_back({ "instanced", [](Renderer& vulkan) {
+		// First append requests the instanced pipeline - keep its compile out of the measured frames
+		InstanceBatchWriter first = vulkan.appendInstances(vulkan.getDrawList()[0], 1);
+		first.transforms[0] = first.transforms[1] = first.transforms[3] = 0.0f;
+		first.transforms[2] = 1.0f;
+		first.colors[0] = 0xFFFFFFFFu;
+		first.ids[0] = 0;
+		vulkan.waitForPipelines();
+	}, [](Renderer& vulkan, uint32_t frame) {
+		InstanceBatchWriter batch = vulkan.appendInstances(vulkan.getDrawList()[0], BENCH_INSTANCES);
+		for (uint32_t i = 0; i < batch.count; i++)
+		{
+			float x, y;
+			objectPosition(i, x, y);
+			float* transform = batch.transforms + i * 4;
+			transform[0] = x;
+			transform[1] = y;
+			transform[2] = 0.02f;
+			transform[3] = frame * 0.01f;
+			batch.colors[i] = 0xFFFFFFFFu;
+			batch.ids[i] = i;
+		}
+	}, false });
+
+	// The same objects as one draw each, transforms in push constants
+	scenes.push_back({ "object-draws", [](Renderer& vulkan) {
+		std::vector<DrawConstants> constants(BENCH_INSTANCES);
+		for (uint32_t i = 0; i < BENCH_INSTANCES; i++)
+		{
+			float x, y;
+			objectPosition(i, x, y);
+			float* model = constants[i].model;
+			model[0] = 0.02f;
+			model[5] = 0.02f;
+			model[12] = x;
+			model[13] = y;
+		}
+		vulkan.setDrawList(std::vector<VkDrawIndexedIndirectCommand>(BENCH_INSTANCES, vulkan.getDrawList()[0]));
+		vulkan.setDrawConstants(constants);
+	}, nullptr, false });
+
+	// Compile every variant up front, then bind a different one each frame
+	auto variants = std::make_shared<std::vector<PipelineHandle>>();
+	scenes.push_back({ "pipelines", [variants](Renderer& vulkan) {
+		const VkCullModeFlags cull_modes[] = { VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT };
+		variants->clear();
+		for (uint32_t i = 0; i < BENCH_PIPELINES; i++)
+		{
+			PipelineDesc desc = vulkan.basePipelineDesc();
+			desc.cullMode = cull_modes[i % 3];
+			desc.blendEnable = (i / 3) % 2 == 1;
+			desc.specialization = { i };
+			variants->push_back(vulkan.requestPipelineVariant(desc));
+		}
+		vulkan.waitForPipelines();
+	}, [variants](Renderer& vulkan, uint32_t frame) {
+		vulkan.setActivePipeline((*variants)[frame % variants->size()]);
+	}, false });
+
+	// Fresh geometry every frame through the staging ring
+	auto upload_vertices = std::make_shared<std::vector<Vertex>>();
+	auto upload_indices = std::make_shared<std::vector<uint32_t>>();
+	scenes.push_back({ "uploads", [upload_vertices, upload_indices](Renderer& vulkan) {
+		buildTriangleGrid(BENCH_UPLOAD_VERTICES / 3, *upload_vertices, *upload_indices);
+	}, [upload_vertices, upload_indices](Renderer& vulkan, uint32_t frame) {
+		// Replaced buffers are retired behind the frames in flight - only the staging copies are waited on
+		(*upload_vertices)[0].color[0] = (frame % 256) / 255.0f;
+		vulkan.uploadMesh(*upload_vertices, *upload_indices);
+	}, false });
+
+	scenes.push_back({ "gpu-driven", [](Renderer& vulkan) {
+		const VkDrawIndexedIndirectCommand& mesh = vulkan.getDrawList()[0];
+		std::vector<GpuObject> objects(BENCH_OBJECTS);
+		uint32_t seed = 1;
+		for (GpuObject& object : objects)
+		{
+			for (int axis = 0; axis < 2; axis++)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				object.center[axis] = ((seed >> 8) / 16777216.0f * 2.0f - 1.0f) * 4.0f;
+			}
+			object.center[2] = 0.0f;
+			object.radius = 0.75f;
+			object.indexCount = mesh.indexCount;
+			object.firstIndex = mesh.firstIndex;
+			object.vertexOffset = mesh.vertexOffset;
+			object.firstInstance = 0;
+		}
+		vulkan.setSceneObjects(objects);
+	}, nullptr, true });
+
+	// Same sphere two ways - parse the OBJ text & build the container, or map the packed file & copy
+	scenes.push_back({ "model-obj", [](Renderer& vulkan) {
+		writeBenchModel();
+	}, drawBenchModel, false, [](Renderer& vulkan) {
+		MeshData mesh;
+		std::vector<uint8_t> bytes;
+		MeshContainer container;
+		if (!MeshContainer::importObj(BENCH_MODEL_OBJ, mesh) || !MeshContainer::build(mesh, bytes) || !container.load(std::move(bytes)))
+		{
+			throw std::runtime_error("[!] Failed to import " BENCH_MODEL_OBJ);
+		}
+		vulkan.loadModel(container);
+	}, true });
+
+	scenes.push_back({ "model-rmesh", [](Renderer& vulkan) {
+		writeBenchModel();
+	}, drawBenchModel, false, [](Renderer& vulkan) {
+		vulkan.loadModel(BENCH_MODEL_RMESH);
+	}, true });
+
+	// Without cache reordering & quantization - against model-rmesh for vertex_bytes & vs_invocations
+	scenes.push_back({ "model-raw", [](Renderer& vulkan) {
+		writeBenchModel();
+	}, drawBenchModel, false, [](Renderer& vulkan) {
+		vulkan.loadModel(BENCH_MODEL_RAW_RMESH);
+	}, true });
+
+	// Levels of detail - triangles against the same field at full detail, then a field 16x larger with & without a budget
+	struct Field
+	{
+		const char* name;
+		uint32_t side;
+		float errorPixels;
+		uint32_t triangleBudget;
+	};
+	const Field fields[] = {
+		{ "lod-field-full", BENCH_FIELD_SIDE, 0.0f, 0 },
+		{ "lod-field", BENCH_FIELD_SIDE, 1.0f, 0 },
+		{ "lod-field-16x", BENCH_FIELD_SIDE * 4, 1.0f, 0 },
+		{ "lod-field-16x-budget", BENCH_FIELD_SIDE * 4, 1.0f, BENCH_FIELD_TRIANGLE_BUDGET } };
+	for (const Field& field : fields)
+	{
+		uint32_t side = field.side;
+		auto lods = std::make_shared<std::vector<uint32_t>>();
+		scenes.push_back({ field.name, [](Renderer& vulkan) {
+			writeBenchModel();
+		}, [side, lods](Renderer& vulkan, uint32_t frame) {
+			drawBenchField(vulkan, frame, side, *lods);
+		}, false, [](Renderer& vulkan) {
+			vulkan.loadModel(BENCH_MODEL_RMESH);
+		}, true, field.errorPixels, field.triangleBudget });
+	}
+
+	// Scene graph propagation - every root moving, so every world transform, then a sparse 1% of nodes
+	auto scene_nodes = std::make_shared<std::vector<SceneNode>>();
+	scenes.push_back({ "scene-graph", [scene_nodes](Renderer& vulkan) {
+		buildBenchScene(vulkan, *scene_nodes);
+	}, [scene_nodes](Renderer& vulkan, uint32_t frame) {
+		SceneGraph& scene = vulkan.getScene();
+		float matrix[16];
+		for (size_t i = 0; i < scene_nodes->size(); i += 1 + BENCH_SCENE_FANOUT + BENCH_SCENE_FANOUT * BENCH_SCENE_FANOUT)
+		{
+			SceneNode root = (*scene_nodes)[i];
+			std::memcpy(matrix, scene.getLocalTransform(root), sizeof(matrix));
+			benchNodeTransform(matrix, frame * 0.01f, matrix[12], matrix[13], matrix[14]);
+			scene.setLocalTransform(root, matrix);
+		}
+	}, false });
+
+	auto sparse_nodes = std::make_shared<std::vector<SceneNode>>();
+	scenes.push_back({ "scene-graph-sparse", [sparse_nodes](Renderer& vulkan) {
+		buildBenchScene(vulkan, *sparse_nodes);
+	}, [sparse_nodes](Renderer& vulkan, uint32_t frame) {
+		SceneGraph& scene = vulkan.getScene();
+		float matrix[16];
+		for (uint32_t i = 0; i < BENCH_SCENE_SPARSE_NODES; i++)
+		{
+			SceneNode node = (*sparse_nodes)[((frame * BENCH_SCENE_SPARSE_NODES + i) * 2654435761u) % sparse_nodes->size()];
+			std::memcpy(matrix, scene.getLocalTransform(node), sizeof(matrix));
+			benchNodeTransform(matrix, frame * 0.01f + i, matrix[12], matrix[13], matrix[14]);
+			scene.setLocalTransform(node, matrix);
+		}
+	}, false });
+
+	return scenes;
+}
+
+
+static SceneResult runScene(const Scene& scene, const RendererConfig& baseConfig, uint32_t frameCount, uint32_t warmupFrames)
+{
+	RendererConfig config = baseConfig;
+	config.gpuDriven = scene.gpuDriven;
+	config.profileGpu = baseConfig.profileGpu || scene.profileGpu;
+	config.lodErrorPixels = scene.lodErrorPixels;
+	config.lodTriangleBudget = scene.lodTriangleBudget;
+
+	auto setup_start = std::chrono::steady_clock::now();
+	Renderer vulkan(config);
+	scene.setup(vulkan);
+	double setup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setup_start).count();
+
+	double load_ms = 0.0;
+	uint64_t vertex_bytes = 0;
+	if (scene.load)
+	{
+		auto load_start = std::chrono::steady_clock::now();
+		scene.load(vulkan);
+		load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+		vulkan.waitForPipelines();
+		vertex_bytes = vulkan.getModelVertexBytes(0);
+	}
+
+	for (uint32_t i = 0; i < warmupFrames; i++)
+	{
+		if (scene.frame)
+		{
+			scene.frame(vulkan, i);
+		}
+		vulkan.drawFrame();
+	}
+	vulkan.waitIdle();
+
+	vulkan.resetFrameStats();
+	vulkan.keepFrameSamples(true);
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		if (scene.frame)
+		{
+			scene.frame(vulkan, warmupFrames + i);
+		}
+		vulkan.drawFrame();
+	}
+	vulkan.waitIdle();
+
+	const FrameStats& stats = vulkan.getFrameStats();
+	SceneResult result;
+	result.name = scene.name;
+	result.frames = frameCount;
+	result.setupMs = setup_ms;
+	result.loadMs = load_ms;
+	result.p50Ms = percentile(stats.frameTimesMs, 0.50);
+	result.p99Ms = percentile(stats.frameTimesMs, 0.99);
+	result.averageMs = stats.averageFrameMs();
+	result.cpuP50Ms = percentile(stats.cpuTimesMs, 0.50);
+	result.cpuP99Ms = percentile(stats.cpuTimesMs, 0.99);
+	result.peakGpuBytes = vulkan.getMemoryStats().peakBytesReserved;
+	result.peakRssKb = peakRssKb();
+	result.vertexBytes = vertex_bytes;
+
+	const SceneUpdateStats& scene_stats = vulkan.getScene().getStats();
+	result.sceneUpdateMs = scene_stats.nodes > 0 && scene_stats.updates > 0 ? scene_stats.totalUpdateMs / scene_stats.updates : 0.0;
+
+	uint32_t statistics_frames = 0;
+	for (const ProfiledFrame& frame : vulkan.getGpuProfiler().getFrames())
+	{
+		if (frame.hasStatistics)
+		{
+			result.vsInvocations += (double)frame.statistics.vertexShaderInvocations;
+			result.triangles += (double)frame.statistics.inputAssemblyPrimitives;
+			statistics_frames++;
+		}
+	}
+	result.vsInvocations = statistics_frames ? result.vsInvocations / statistics_frames : 0.0;
+	result.triangles = statistics_frames ? result.triangles / statistics_frames : 0.0;
+	return result;
+}
+
+
+static void writeResults(std::ostream& out, const std::vector<SceneResult>& results, uint32_t frameCount, uint32_t warmupFrames)
+{
+	out << std::fixed << std::setprecision(4);
+	out << "{\n  \"frames\": " << frameCount << ",\n  \"warmup\": " << warmupFrames << ",\n  \"scenes\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const SceneResult& result = results[i];
+		out << (i ? ",\n" : "\n")
+			<< "    { \"name\": \"" << result.name << "\""
+			<< ", \"frames\": " << result.frames
+			<< ", \"setup_ms\": " << result.setupMs
+			<< ", \"load_ms\": " << result.loadMs
+			<< ", \"p50_ms\": " << result.p50Ms
+			<< ", \"p99_ms\": " << result.p99Ms
+			<< ", \"avg_ms\": " << result.averageMs
+			<< ", \"cpu_p50_ms\": " << result.cpuP50Ms
+			<< ", \"cpu_p99_ms\": " << result.cpuP99Ms
+			<< ", \"peak_gpu_bytes\": " << result.peakGpuBytes
+			<< ", \"peak_rss_kb\": " << result.peakRssKb
+			<< ", \"vertex_bytes\": " << result.vertexBytes
+			<< ", \"vs_invocations\": " << result.vsInvocations
+			<< ", \"triangles\": " << result.triangles
+			<< ", \"scene_update_ms\": " << result.sceneUpdateMs << " }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+
+// Reads back the flat scene objects written by writeResults - not a general JSON parser
+static bool readBaseline(const std::string& path, std::map<std::string, std::map<std::string, double>>& baseline)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	std::string json = text.str();
+
+	size_t scenes = json.find("\"scenes\"");
+	if (scenes == std::string::npos)
+	{
+		return false;
+	}
+
+	const std::regex name_pattern("\"name\"\\s*:\\s*\"([^\"]*)\"");
+	const std::regex number_pattern("\"(\\w+)\"\\s*:\\s*(-?[0-9.eE+-]+)");
+	for (size_t open = json.find('{', scenes); open != std::string::npos; open = json.find('{', open + 1))
+	{
+		size_t close = json.find('}', open);
+		if (close == std::string::npos)
+		{
+			break;
+		}
+		std::string object = json.substr(open, close - open);
+
+		std::smatch name;
+		if (!std::regex_search(object, name, name_pattern))
+		{
+			continue;
+		}
+		auto& metrics = baseline[name[1].str()];
+		for (std::sregex_iterator it(object.begin(), object.end(), number_pattern), end; it != end; ++it)
+		{
+			metrics[(*it)[1].str()] = std::strtod((*it)[2].str().c_str(), nullptr);
+		}
+	}
+	return !baseline.empty();
+}
+
+
+// Lower is better for every compared metric
+static bool compareWithBaseline(const std::vector<SceneResult>& results, const std::map<std::string, std::map<std::string, double>>& baseline, double tolerance)
+{
+	bool passed = true;
+	for (const SceneResult& result : results)
+	{
+		auto scene = baseline.find(result.name);
+		if (scene == baseline.end())
+		{
+			std::cout << "[*] " << result.name << ": no baseline, skipped" << std::endl;
+			continue;
+		}
+
+		const std::pair<const char*, double> metrics[] = {
+			{ "p50_ms", result.p50Ms },
+			{ "p99_ms", result.p99Ms },
+			{ "cpu_p50_ms", result.cpuP50Ms },
+			{ "load_ms", result.loadMs },
+			{ "peak_gpu_bytes", (double)result.peakGpuBytes },
+			{ "vertex_bytes", (double)result.vertexBytes },
+			{ "vs_invocations", result.vsInvocations },
+			{ "triangles", result.triangles },
+			{ "scene_update_ms", result.sceneUpdateMs },
+		};
+		for (const auto& metric : metrics)
+		{
+			auto reference = scene->second.find(metric.first);
+			if (reference == scene->second.end())
+			{
+				continue;
+			}
+
+			double limit = reference->second * (1.0 + tolerance);
+			bool is_time = std::strstr(metric.first, "_ms") != nullptr;
+			bool regressed = metric.second > limit && (!is_time || metric.second - reference->second > BENCH_NOISE_FLOOR_MS);
+			if (regressed)
+			{
+				passed = false;
+			}
+
+			std::cout << (regressed ? "[!] " : "[*] ") << result.name << " " << metric.first << ": "
+				<< std::fixed << std::setprecision(3) << metric.second << " vs baseline " << reference->second
+				<< (regressed ? "  REGRESSION" : "") << std::endl;
+		}
+	}
+	return passed;
+}
+
+
+int main(int argc, char** argv)
+{
+	uint32_t frame_count = BENCH_FRAMES;
+	uint32_t warmup_frames = BENCH_WARMUP_FRAMES;
+	double tolerance = BENCH_TOLERANCE;
+	std::string out_path;
+	std::string baseline_path;
+	std::vector<std::string> selected;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			frame_count = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+		{
+			warmup_frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+		{
+			selected.push_back(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			out_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+		{
+			baseline_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+		{
+			tolerance = std::strtod(argv[++i], nullptr);
+		}
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--frames N] [--warmup N] [--scene name]... [--out results.json] [--baseline baseline.json] [--tolerance 0.10]" << std::endl;
+			return 2;
+		}
+	}
+
+	// Pipeline cache off so every run compiles from scratch - the variants scene would otherwise measure the disk
+	RendererConfig config;
+	config.headless = true;
+	config.enableValidation = false;
+	config.pipelineCachePath.clear();
+
+	std::vector<SceneResult> results;
+	for (const Scene& scene : buildScenes())
+	{
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), scene.name) == selected.end())
+		{
+			continue;
+		}
+
+		std::cout << "[*] Scene " << scene.name << std::endl;
+		try
+		{
+			results.push_back(runScene(scene, config, frame_count, warmup_frames));
+		}
+		catch (const std::exception& error)
+		{
+			std::cerr << error.what() << std::endl;
+			return 2;
+		}
+	}
+
+	if (results.empty())
+	{
+		std::cerr << "[!] No scenes selected" << std::endl;
+		return 2;
+	}
+
+	writeResults(std::cout, results, frame_count, warmup_frames);
+	if (!out_path.empty())
+	{
+		std::ofstream out(out_path, std::ios::trunc);
+		writeResults(out, results, frame_count, warmup_frames);
+	}
+
+	if (!baseline_path.empty())
+	{
+		std::map<std::string, std::map<std::string, double>> baseline;
+		if (!readBaseline(baseline_path, baseline))
+		{
+			std::cerr << "[!] Failed to read baseline " << baseline_path << std::endl;
+			return 2;
+		}
+		if (!compareWithBaseline(results, baseline, tolerance))
+		{
+			std::cout << "[!] Benchmark regressed against " << baseline_path << std::endl;
+			return 1;
+		}
+		std::cout << "[*] Benchmark within " << tolerance * 100.0 << "% of " << baseline_path << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,86 @@
+// Vulkan Renderer - Descriptor Manager
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+
+#define BINDLESS_SET 0												// Bound once per command buffer at set = 0
+#define BINDLESS_TEXTURE_BINDING 0									// sampler2D textures[] in bindless.glsl
+#define BINDLESS_BUFFER_BINDING 1									// buffer storageBuffers[] in bindless.glsl
+#define BINDLESS_MAX_TEXTURES 16384									// Clamped to the device's update after bind limits
+#define BINDLESS_MAX_BUFFERS 4096
+#define BINDLESS_INDEX_NONE UINT32_MAX
+
+#define TRANSIENT_POOL_SETS 256										// Sets per transient pool - another pool is chained when one runs dry
+#define TRANSIENT_POOL_DESCRIPTORS 1024								// Descriptors of each type per transient pool
+
+
+// Bindless table & per frame transient sets
+//
+// The bindless set holds every texture & storage buffer the renderer knows about, written once when the
+// resource is added & indexed from shaders by the integer handle returned here. Removed slots are reused
+// only once every frame that may still read them has retired.
+//
+// Transient sets are allocated linearly from the ring slot's pools and released in bulk by beginFrame.
+class DescriptorManager
+{
+public:
+	bool init(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, bool bindless);
+	void destroy();
+	bool isBindless() const { return bindlessSet != VK_NULL_HANDLE; }
+	VkDescriptorSetLayout getBindlessLayout() const { return bindlessLayout; }	// Empty placeholder without bindless
+
+	uint32_t addTexture(VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	uint32_t addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	void updateTexture(uint32_t index, VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);	// Only for slots no frame in flight reads
+	void removeTexture(uint32_t index, uint64_t frameNumber);		// frameNumber - last frame submitted that may use it
+	void removeStorageBuffer(uint32_t index, uint64_t frameNumber);
+
+	void beginFrame(uint32_t slot, uint64_t frameNumber);			// Slot's fence must have signaled - resets its transient pools
+	VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout);	// Valid until the ring slot comes around again
+	void bindBindless(VkCommandBuffer command_buffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) const;
+
+	uint32_t textureCapacity() const { return textures.capacity; }
+	uint32_t bufferCapacity() const { return buffers.capacity; }
+	uint32_t transientPoolCount() const;
+
+private:
+	// Slot allocator for one bindless binding
+	struct SlotTable
+	{
+		uint32_t capacity = 0;
+		uint32_t next = 0;											// Slots below next have been handed out at least once
+		std::vector <uint32_t> freeSlots;
+		std::vector <std::pair<uint32_t, uint64_t>> retiredSlots;	// Slot & the frame that last used it
+	};
+
+	struct TransientPools
+	{
+		std::vector <VkDescriptorPool> pools;
+		uint32_t current = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t frames_in_flight = 0;
+
+	VkDescriptorSetLayout bindlessLayout = VK_NULL_HANDLE;
+	VkDescriptorPool bindlessPool = VK_NULL_HANDLE;
+	VkDescriptorSet bindlessSet = VK_NULL_HANDLE;
+	SlotTable textures;
+	SlotTable buffers;
+	std::mutex bindless_mutex;										// Resources may be added from loader threads
+
+	std::vector <TransientPools> transientPools;					// One set of pools per frame in flight
+	uint32_t current_slot = 0;
+
+	uint32_t acquireSlot(SlotTable& table);
+	void retireSlot(SlotTable& table, uint32_t index, uint64_t frameNumber);
+	void releaseSlots(SlotTable& table, uint64_t frameNumber);
+	void createPlaceholderLayout();
+	VkDescriptorPool createTransientPool();
+};
@@ -0,0 +1,220 @@
+// Vulkan Renderer - Frame Graph
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "MemoryAllocator.h"
+#include "GpuProfiler.h"
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+
+#define FRAME_GRAPH_NONE UINT32_MAX
+#define FRAME_GRAPH_QUEUE_COUNT 2
+
+
+typedef uint32_t FrameGraphResource;
+typedef std::function<void(VkCommandBuffer command_buffer)> FrameGraphExecute;
+
+
+enum class FrameGraphQueue : uint32_t
+{
+	Graphics = 0,
+	Compute = 1,												// Folded into Graphics when the graph has no async compute queue
+};
+
+
+// How a pass touches a resource - each maps to the stages, access mask & image layout barriers are built from
+enum class FrameGraphAccess : uint32_t
+{
+	None = 0,
+	ColorAttachment,											// Writes
+	DepthAttachment,											// Writes
+	DepthRead,
+	Sampled,
+	StorageRead,
+	StorageWrite,												// Writes
+	Uniform,
+	IndirectRead,
+	VertexRead,
+	TransferRead,
+	TransferWrite,												// Writes
+	Present,													// Final state only
+	HostRead,													// Final state only
+};
+
+
+// Transient image - usage flags are gathered from the passes that use it
+struct FrameGraphImageDesc
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+
+struct FrameGraphStats
+{
+	uint32_t passCount = 0;
+	uint32_t culledPasses = 0;
+	uint32_t barrierCount = 0;									// Image & buffer barriers recorded last compile
+	uint32_t transientImages = 0;
+	uint32_t memoryBlocks = 0;									// Aliased device memory backing the transient images
+	VkDeviceSize transientBytes = 0;							// What the transient images would take unaliased
+	VkDeviceSize memoryBytes = 0;
+};
+
+
+// Per frame render graph
+//
+// Passes declare every resource they touch and are recorded in declaration order. Compiling culls passes
+// that contribute nothing to an output, places the smallest set of barriers & layout transitions between
+// them, and packs transient images whose lifetimes don't overlap into the same memory.
+//
+// Cross queue edges become a timeline semaphore wait on the consuming queue at the stages that consume,
+// instead of a barrier. Compute work is submitted before the graphics work of its frame, so compute passes
+// may not consume graphics output, and images stay on one queue.
+class FrameGraph
+{
+public:
+	void init(VkDevice logicalDevice, MemoryAllocator* memoryAllocator, uint32_t framesInFlight, bool asyncCompute);
+	void destroy();
+
+	// Building - clears the passes & resources, transient images & their memory are kept between frames
+	void reset(uint64_t frameNumber);							// frameNumber - frames submitted so far
+	FrameGraphResource importImage(const char* name, VkImage image, VkImageAspectFlags aspect, VkPipelineStageFlags readyStages, FrameGraphAccess finalAccess = FrameGraphAccess::None);	// Contents discarded
+	FrameGraphResource importBuffer(const char* name, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE, FrameGraphAccess finalAccess = FrameGraphAccess::None);
+	FrameGraphResource createImage(const char* name, const FrameGraphImageDesc& desc);
+	uint32_t addPass(const char* name, FrameGraphQueue queue, FrameGraphExecute execute);	// name must outlive the graph - profiler scopes keep it
+	void use(uint32_t pass, FrameGraphResource resource, FrameGraphAccess access);
+	void setSideEffects(uint32_t pass);							// Never culled - for passes whose outputs the graph can't see
+	void markOutput(FrameGraphResource resource);
+
+	void compile();
+	bool hasWork(FrameGraphQueue queue) const;
+	VkPipelineStageFlags waitStages(FrameGraphQueue queue) const;	// 0 - the queue needs no semaphore wait this frame
+	void execute(FrameGraphQueue queue, VkCommandBuffer command_buffer, GpuProfiler* profiler = nullptr);
+
+	VkImage getImage(FrameGraphResource resource) const;
+	VkImageView getImageView(FrameGraphResource resource) const;	// Transient images only
+	const FrameGraphStats& getStats() const { return stats; }
+
+private:
+	// Where the last accesses of a resource left it
+	struct ResourceState
+	{
+		VkPipelineStageFlags writeStages = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;					// Reads since the last write
+		VkAccessFlags readAccess = 0;							// Made visible since the last write
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t queue = FRAME_GRAPH_NONE;
+	};
+
+	struct Resource
+	{
+		const char* name;
+		bool isImage;
+		bool transient;
+		bool output;
+		FrameGraphAccess finalAccess;
+
+		VkImage image;
+		VkImageAspectFlags aspect;
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+
+		FrameGraphImageDesc desc;
+		VkImageUsageFlags usage;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		uint32_t physical;
+		ResourceState state;
+	};
+
+	// One vkCmdPipelineBarrier
+	struct BarrierBatch
+	{
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector <VkImageMemoryBarrier> imageBarriers;
+		std::vector <VkBufferMemoryBarrier> bufferBarriers;
+	};
+
+	struct ResourceUse
+	{
+		FrameGraphResource resource;
+		FrameGraphAccess access;
+	};
+
+	struct Pass
+	{
+		const char* name;
+		uint32_t queue;
+		FrameGraphExecute execute;
+		std::vector <ResourceUse> uses;
+		bool compute;											// Shader accesses happen in the compute stage
+		bool sideEffects;
+		bool live;
+		BarrierBatch barriers;									// Recorded before the pass
+	};
+
+	struct PhysicalImage
+	{
+		FrameGraphImageDesc desc;
+		VkImageUsageFlags usage;
+		VkImage image;
+		VkImageView view;
+		VkMemoryRequirements requirements;
+		uint32_t block;
+	};
+
+	// Memory shared by transient images - the state is whichever occupant was used last
+	struct MemoryBlock
+	{
+		MemoryAllocation allocation;
+		VkDeviceSize size;
+		VkDeviceSize alignment;
+		uint32_t memoryTypeBits;
+		std::vector <std::pair<uint32_t, uint32_t>> lifetimes;	// First & last pass of each occupant this compile
+		ResourceState state;
+	};
+
+	struct RetiredTransients
+	{
+		std::vector <PhysicalImage> images;
+		std::vector <MemoryBlock> blocks;
+		uint64_t frameNumber;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryAllocator* allocator = nullptr;
+	uint32_t frames_in_flight = 0;
+	bool async_compute = false;
+	uint64_t frame_number = 0;
+
+	std::vector <Resource> resources;
+	std::vector <Pass> passes;
+	BarrierBatch tails[FRAME_GRAPH_QUEUE_COUNT];				// After a queue's last pass - hands imported resources over in their final state
+	VkPipelineStageFlags wait_stages[FRAME_GRAPH_QUEUE_COUNT] = {};
+	bool queue_work[FRAME_GRAPH_QUEUE_COUNT] = {};
+
+	std::vector <PhysicalImage> physicalImages;
+	std::vector <MemoryBlock> memoryBlocks;
+	std::vector <RetiredTransients> retired;
+	uint64_t transient_signature = 0;
+	FrameGraphStats stats;
+
+	void cullPasses();
+	void allocateTransients();
+	void retireTransients();
+	void buildBarriers();
+	void useResource(Pass& pass, uint32_t pass_index, Resource& resource, FrameGraphAccess access);
+	void addBarrier(BarrierBatch& batch, const Resource& resource, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkImageLayout oldLayout,
+		VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, VkImageLayout newLayout);
+	void recordBarriers(VkCommandBuffer command_buffer, const BarrierBatch& batch) const;
+};
@@ -0,0 +1,41 @@
+// Vulkan Renderer - Frame Pacing
+
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+
+
+#define FRAME_PACER_SPIN_MS 1.0										// Final stretch before a deadline is spun - sleep overshoots
+#define FRAME_PACER_LATENCY_MARGIN_MS 0.5							// Blocking left in place so a slow frame does not miss its slot
+#define FRAME_PACER_LATENCY_GAIN 0.25								// Fraction of the measured slack removed per frame
+
+
+// Delays the start of each frame - before input is polled - to hold a frame rate or to cut queueing latency
+class FramePacer
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	void setTargetFps(double fps);									// 0 disables the frame rate cap
+	void setLowLatency(bool enabled);								// Sleep away the time the CPU would block in fence wait & acquire
+	double getTargetFps() const { return target_fps; }
+	bool isLowLatency() const { return low_latency; }
+	bool isActive() const { return target_fps > 0.0 || low_latency; }
+
+	double waitForFrameStart();										// Returns the milliseconds slept
+	void recordBlockedTime(double ms);								// Fence wait + acquire of the frame just started
+	void reset();
+
+	double getLatencyDelayMs() const { return latency_delay_ms; }
+
+private:
+	double target_fps = 0.0;
+	bool low_latency = false;
+
+	Clock::time_point next_deadline;
+	bool has_deadline = false;
+	double latency_delay_ms = 0.0;									// Converges on the blocking time minus the margin
+
+	static void sleepUntil(Clock::time_point deadline);
+};
@@ -0,0 +1,124 @@
+// Vulkan Renderer - GPU Profiler
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <chrono>
+
+
+#define PROFILER_MAX_SCOPES 32										// Timestamp pairs per frame
+#define PROFILER_MAX_HISTORY 4096									// Resolved frames kept for the summary & trace export
+
+
+// Fixed function & shader counters over one frame
+struct PipelineStatistics
+{
+	uint64_t inputAssemblyVertices = 0;
+	uint64_t inputAssemblyPrimitives = 0;
+	uint64_t vertexShaderInvocations = 0;
+	uint64_t clippingPrimitives = 0;
+	uint64_t fragmentShaderInvocations = 0;
+	uint64_t computeShaderInvocations = 0;
+};
+
+
+struct ProfiledScope
+{
+	const char* name;
+	uint32_t depth;
+	double beginMs;												// Relative to the start of the GPU frame
+	double endMs;
+};
+
+
+// One frame with its CPU & GPU timings side by side
+struct ProfiledFrame
+{
+	uint64_t frameNumber = 0;
+	uint64_t cpuStartNs = 0;									// steady_clock
+	double cpuMs = 0.0;
+	uint64_t gpuStartNs = 0;									// Device timestamp domain - not comparable to cpuStartNs
+	double gpuMs = 0.0;
+	std::vector <ProfiledScope> scopes;
+	bool hasStatistics = false;
+	PipelineStatistics statistics;
+};
+
+
+// Timestamp & pipeline statistics queries, one query ring slot per frame in flight
+class GpuProfiler
+{
+public:
+	bool init(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight, bool pipelineStatistics);
+	void destroy();
+	bool isEnabled() const { return timestampPool != VK_NULL_HANDLE; }
+
+	void beginFrame(VkCommandBuffer command_buffer, uint32_t slot, uint64_t frameNumber);	// Slot's fence must have signaled - resolves its last frame
+	uint32_t beginScope(VkCommandBuffer command_buffer, const char* name);
+	void endScope(VkCommandBuffer command_buffer, uint32_t scope);
+	void beginStatistics(VkCommandBuffer command_buffer);			// Outside any render pass recorded into secondaries
+	void endStatistics(VkCommandBuffer command_buffer);
+	void recordCpuFrame(uint64_t frameNumber, std::chrono::steady_clock::time_point start, double cpuMs);
+	void collectAll();												// Device idle - resolve every outstanding slot
+
+	const std::deque<ProfiledFrame>& getFrames() const { return frames; }
+	void reset();
+	void printSummary() const;
+	bool exportChromeTrace(const std::string& path) const;
+
+private:
+	struct FrameSlot
+	{
+		uint64_t frameNumber = 0;
+		uint32_t scopeCount = 0;
+		uint32_t depth = 0;
+		std::vector <const char*> names;
+		std::vector <uint32_t> depths;
+		bool pending = false;
+		bool statistics = false;
+	};
+
+	struct CpuFrame
+	{
+		uint64_t startNs;
+		double ms;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueryPool timestampPool = VK_NULL_HANDLE;
+	VkQueryPool statisticsPool = VK_NULL_HANDLE;
+	double timestamp_period = 1.0;									// Nanoseconds per tick
+	uint64_t timestamp_mask = ~0ull;
+	std::vector <FrameSlot> slots;
+	uint32_t current_slot = 0;
+
+	std::map <uint64_t, CpuFrame> cpuFrames;						// Waiting for their GPU half
+	std::deque <ProfiledFrame> frames;
+	uint64_t dropped_frames = 0;
+
+	void resolve(uint32_t slot);
+};
+
+
+// Times the commands recorded during its lifetime
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler& profiler, VkCommandBuffer command_buffer, const char* name)
+		: profiler(profiler), command_buffer(command_buffer), scope(profiler.beginScope(command_buffer, name)) {}
+	~GpuProfileScope() { profiler.endScope(command_buffer, scope); }
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler& profiler;
+	VkCommandBuffer command_buffer;
+	uint32_t scope;
+};
@@ -0,0 +1,37 @@
+// Vulkan Renderer - Read-only Memory Mapped Files
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+
+// Maps a whole file read-only - the view is page aligned and lives until close or destruction
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return view != nullptr; }
+	const uint8_t* data() const { return static_cast<const uint8_t*>(view); }
+	size_t size() const { return view_size; }
+
+private:
+	void* view = nullptr;
+	size_t view_size = 0;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,211 @@
+// Vulkan Renderer - GPU Memory Allocator
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <iostream>
+
+
+#define MEMORY_BLOCK_SIZE (64ull * 1024 * 1024)					// Default VkDeviceMemory block carved into sub-allocations
+#define MEMORY_DEDICATED_THRESHOLD (MEMORY_BLOCK_SIZE / 2)		// Requests above this get their own VkDeviceMemory
+#define MEMORY_MIN_ALIGNMENT 16									// Smallest offset granularity handed out by the TLSF heaps
+
+#define TLSF_SL_LOG2 4											// Second level subdivisions per power of two (16)
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT 64
+#define TLSF_NONE UINT32_MAX
+
+
+// How an allocation should be placed
+struct MemoryAllocationCreateInfo
+{
+	VkMemoryPropertyFlags requiredFlags = 0;
+	VkMemoryPropertyFlags preferredFlags = 0;					// Used when a type with these flags is also allowed
+	bool optimalImage = false;									// Optimal tiling images get separate blocks, so bufferImageGranularity never applies
+	bool dedicated = false;										// Give the resource its own VkDeviceMemory
+};
+
+
+// A sub-allocated range of device memory
+struct MemoryAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	VkDeviceSize alignment = 0;
+	void* mapped = nullptr;										// Host pointer to offset when the block is host visible
+	uint32_t memoryType = 0;
+
+	// Allocator bookkeeping
+	uint32_t pool = TLSF_NONE;
+	uint32_t block = TLSF_NONE;
+	uint32_t node = TLSF_NONE;
+};
+
+
+// Allocator Statistics
+struct MemoryStats
+{
+	uint32_t deviceMemoryCount = 0;								// Live vkAllocateMemory objects
+	uint32_t allocationCount = 0;								// Live sub-allocations
+	VkDeviceSize bytesReserved = 0;								// Sum of VkDeviceMemory sizes
+	VkDeviceSize peakBytesReserved = 0;							// High water mark of bytesReserved since init
+	VkDeviceSize bytesInUse = 0;								// Sum of live sub-allocation sizes
+	VkDeviceSize bytesFree = 0;									// Free bytes inside general purpose blocks
+	VkDeviceSize largestFreeRange = 0;
+	float fragmentation = 0.0f;									// 1 - largest free range / free bytes (0 = one contiguous hole)
+};
+
+
+// Two level segregated fit heap over a single block - O(1) allocate & free
+class TlsfHeap
+{
+public:
+	void init(VkDeviceSize size);
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& node);
+	void free(uint32_t node);
+
+	VkDeviceSize capacity() const { return heap_size; }
+	VkDeviceSize usedBytes() const { return used_bytes; }
+	uint32_t allocationCount() const { return allocation_count; }
+	VkDeviceSize largestFreeRange() const;
+	VkDeviceSize nodeSize(uint32_t node) const { return nodes[node].size; }
+	bool empty() const { return allocation_count == 0; }
+
+private:
+	struct Node
+	{
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint32_t prevPhys = TLSF_NONE;							// Neighbours in address order
+		uint32_t nextPhys = TLSF_NONE;
+		uint32_t prevFree = TLSF_NONE;							// Neighbours in the segregated free list
+		uint32_t nextFree = TLSF_NONE;
+		bool free = false;
+	};
+
+	VkDeviceSize heap_size = 0;
+	VkDeviceSize used_bytes = 0;
+	uint32_t allocation_count = 0;
+
+	std::vector <Node> nodes;
+	std::vector <uint32_t> unusedNodes;							// Recycled slots in nodes
+	uint64_t fl_bitmap = 0;
+	uint32_t sl_bitmap[TLSF_FL_COUNT] = {};
+	uint32_t freeHeads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+	uint32_t newNode();
+	void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl) const;
+	void insertFree(uint32_t node);
+	void removeFree(uint32_t node);
+	uint32_t findFree(VkDeviceSize size);
+};
+
+
+// Ring of per-frame transient memory - bump allocate, retire whole frames in FIFO order
+class MemoryRing
+{
+public:
+	MemoryRing(VkDeviceMemory memory, void* mapped, VkDeviceSize size, uint32_t memoryType);
+
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation);
+	void endFrame();											// Close the frame currently being recorded
+	void releaseFrame();										// Retire the oldest closed frame - call once its fence has signaled
+	void discardFrame();										// Drop the open frame's allocations - nothing recorded against them was submitted
+	void reset();												// Linear mode - drop everything at once
+	void setStartLimit(VkDeviceSize limit) { start_limit = limit; }	// No allocation starts past limit - dynamic descriptors read a fixed range beyond their offset
+
+	VkDeviceMemory memory() const { return ring_memory; }
+	VkDeviceSize capacity() const { return ring_size; }
+	VkDeviceSize usedBytes() const { return used_bytes; }
+	uint32_t pendingFrames() const { return (uint32_t)frameEnds.size(); }	// Closed frames not yet released
+
+private:
+	VkDeviceMemory ring_memory;
+	uint8_t* ring_mapped;
+	VkDeviceSize ring_size;
+	VkDeviceSize start_limit;
+	uint32_t memory_type;
+
+	VkDeviceSize head = 0;
+	VkDeviceSize tail = 0;
+	VkDeviceSize used_bytes = 0;
+	VkDeviceSize frame_bytes = 0;								// Bytes consumed by the open frame, including wrap padding
+	std::vector <std::pair<VkDeviceSize, VkDeviceSize>> frameEnds;	// (head at endFrame, bytes) per closed frame
+};
+
+
+// One planned relocation produced by planDefragmentation
+struct DefragmentationMove
+{
+	uint32_t index;												// Index into the movable list passed in
+	MemoryAllocation destination;								// Already reserved - copy, rebind, then free the source
+};
+
+
+class MemoryAllocator
+{
+public:
+	void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkDeviceSize blockSize = MEMORY_BLOCK_SIZE);
+	void destroy();
+
+	MemoryAllocation allocate(const VkMemoryRequirements& requirements, const MemoryAllocationCreateInfo& createInfo);
+	void free(MemoryAllocation& allocation);
+
+	MemoryRing* createRing(VkDeviceSize size, uint32_t memoryTypeBits, const MemoryAllocationCreateInfo& createInfo);
+
+	void flush(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void invalidate(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	bool isCoherent(uint32_t memoryType) const;
+
+	std::vector<DefragmentationMove> planDefragmentation(const std::vector<MemoryAllocation*>& movable);
+	void releaseEmptyBlocks();
+
+	MemoryStats getStats();
+	void printStats();
+
+private:
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint8_t* mapped = nullptr;
+		bool dedicated = false;
+		TlsfHeap heap;
+	};
+
+	// Blocks share a pool when they share a memory type and resource kind
+	struct MemoryPool
+	{
+		uint32_t memoryType = 0;
+		bool optimalImage = false;
+		std::vector <std::unique_ptr<MemoryBlock>> blocks;		// Null entries are released slots
+	};
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memory_properties{};
+	VkDeviceSize block_size = MEMORY_BLOCK_SIZE;
+	VkDeviceSize non_coherent_atom = 1;
+	uint32_t max_allocation_count = UINT32_MAX;
+	uint32_t device_memory_count = 0;
+	VkDeviceSize device_memory_bytes = 0;
+	VkDeviceSize peak_device_memory_bytes = 0;
+
+	std::vector <MemoryPool> pools;
+	std::vector <std::unique_ptr<MemoryRing>> rings;
+	std::mutex allocator_mutex;
+
+	uint32_t findMemoryType(uint32_t typeBits, const MemoryAllocationCreateInfo& createInfo) const;
+	uint32_t findPool(uint32_t memoryType, bool optimalImage);
+	bool allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, VkDeviceMemory& memory, uint8_t*& mapped);
+	void freeDeviceMemory(VkDeviceMemory memory, uint8_t* mapped, VkDeviceSize size);
+	bool allocateFromBlock(uint32_t poolIndex, uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation);
+	void mappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range) const;
+};
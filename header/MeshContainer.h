@@ -0,0 +1,160 @@
+// Vulkan Renderer - GPU Ready Mesh Container
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+
+#define MESH_CONTAINER_MAGIC 0x48534D52								// "RMSH"
+#define MESH_CONTAINER_VERSION 2
+#define MESH_CONTAINER_ALIGNMENT 16									// Vertex & index blobs start on this boundary
+#define MESH_CONTAINER_EXTENSION ".rmesh"
+#define MESH_MAX_ATTRIBUTES 8
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESH_MAX_LODS 12												// Levels per submesh, the full submesh included
+#define MESH_LOD_REDUCTION 0.25f										// Triangle count of each level relative to the one before
+#define MESH_LOD_MIN_TRIANGLES 32										// No further levels below this
+
+
+enum MeshAttributeSemantic : uint32_t
+{
+	MESH_ATTRIBUTE_POSITION = 0,
+	MESH_ATTRIBUTE_NORMAL = 1,
+	MESH_ATTRIBUTE_UV = 2,
+};
+
+
+// File layout: header | attributes | submeshes | meshlets | lods | padding | vertices | padding | indices
+struct MeshContainerHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexType;												// VkIndexType - 16 bit whenever every vertex is addressable
+	uint32_t indexCount;
+	uint32_t attributeCount;
+	uint32_t submeshCount;
+	uint32_t meshletCount;
+	uint32_t lodCount;												// Levels per submesh - level 0 is the submesh itself
+	float boundsMin[3];												// Object space
+	float boundsMax[3];
+	float positionScale[3];											// Object position = stored position * scale + offset
+	float positionOffset[3];
+	uint64_t vertexOffset;											// From the start of the file
+	uint64_t vertexSize;
+	uint64_t indexOffset;
+	uint64_t indexSize;
+};
+
+// Binding 0 vertex input - maps straight onto VkVertexInputAttributeDescription
+struct MeshContainerAttribute
+{
+	uint32_t semantic;												// MeshAttributeSemantic - also the shader location
+	uint32_t format;												// VkFormat
+	uint32_t offset;
+	uint32_t reserved;
+};
+
+// One draw - an OBJ group or material range
+struct MeshContainerSubmesh
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	float center[3];												// Bounding sphere
+	float radius;
+};
+
+// Cluster of at most MESHLET_MAX_TRIANGLES triangles over MESHLET_MAX_VERTICES vertices - indices are stored meshlet by meshlet
+struct MeshContainerMeshlet
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t vertexCount;											// Distinct vertices referenced
+	uint32_t submesh;
+	float center[3];												// Bounding sphere
+	float radius;
+};
+
+// One level of detail of a submesh - indices into the shared vertex blob, stored after every submesh's full detail indices
+struct MeshContainerLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;													// Object space distance any vertex moved from the source - 0 at level 0
+	uint32_t reserved;
+};
+
+
+// Import time optimization - all on by default, all off reproduces the source order & 32 bit float layout at one level
+struct MeshBuildOptions
+{
+	bool optimizeIndices = true;									// Reorder triangles for the post transform vertex cache
+	bool quantize = true;											// 16 bit positions, octahedral normals & half float uvs
+	bool generateLods = true;										// Vertex clustered levels down to MESH_LOD_MIN_TRIANGLES
+};
+
+
+// Interchange geometry before it is laid out for the GPU - normals & uvs may be empty
+struct MeshData
+{
+	std::vector <float> positions;									// xyz
+	std::vector <float> normals;									// xyz, one per position
+	std::vector <float> uvs;										// uv, one per position
+	std::vector <uint32_t> indices;									// Triangle list
+	std::vector <std::pair<uint32_t, uint32_t>> submeshes;			// First index & index count - one covering everything when empty
+};
+
+
+// Vertex & index blobs ready for a staging copy - mapped from an .rmesh file or built in memory from interchange geometry
+class MeshContainer
+{
+public:
+	bool open(const std::string& path);
+	bool load(std::vector<uint8_t>&& bytes);						// Takes a container built by build
+	void close();
+
+	bool isOpen() const { return bytes != nullptr; }
+	const MeshContainerHeader& getHeader() const { return header; }
+	uint32_t vertexCount() const { return header.vertexCount; }
+	uint32_t indexCount() const { return header.indexCount; }
+	VkIndexType indexType() const { return (VkIndexType)header.indexType; }
+	const uint8_t* vertexData() const { return bytes + header.vertexOffset; }
+	const uint8_t* indexData() const { return bytes + header.indexOffset; }
+	const MeshContainerAttribute* attributes() const { return attribute_table; }
+	const MeshContainerSubmesh* submeshes() const { return submesh_table; }
+	const MeshContainerMeshlet* meshlets() const { return meshlet_table; }
+	uint32_t lodCount() const { return header.lodCount; }
+	const MeshContainerLod* lods() const { return lod_table; }		// Submesh s at level l is lods()[s * lodCount() + l]
+
+	// Interchange formats - Wavefront OBJ, polygons are fan triangulated
+	static bool importObj(const std::string& path, MeshData& mesh);
+	static bool build(const MeshData& mesh, std::vector<uint8_t>& container, const MeshBuildOptions& options = MeshBuildOptions());	// Optimizes, builds meshlets & lays out the blobs
+	static bool write(const std::string& path, const std::vector<uint8_t>& container);
+	static bool isContainer(const std::string& path);
+	static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);	// Triangle list, reordered in place
+	static float cacheMissRatio(const uint32_t* indices, size_t count, uint32_t cacheSize = 16);	// Vertices transformed per triangle
+
+private:
+	MappedFile file;
+	std::vector <uint8_t> memory;
+	const uint8_t* bytes = nullptr;
+	size_t byte_count = 0;
+	MeshContainerHeader header{};
+	const MeshContainerAttribute* attribute_table = nullptr;
+	const MeshContainerSubmesh* submesh_table = nullptr;
+	const MeshContainerMeshlet* meshlet_table = nullptr;
+	const MeshContainerLod* lod_table = nullptr;
+
+	bool parse(const std::string& name);
+};
@@ -0,0 +1,100 @@
+// Vulkan Renderer - Pipeline Library
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <stdexcept>
+#include <iostream>
+
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "ShaderArchive.h"
+
+
+typedef uint32_t PipelineHandle;
+#define PIPELINE_HANDLE_NONE UINT32_MAX
+
+
+// Everything that distinguishes one graphics pipeline variant from another
+struct PipelineDesc
+{
+	std::string vertexShader;
+	std::string fragmentShader;
+	std::vector <VkVertexInputBindingDescription> bindings;
+	std::vector <VkVertexInputAttributeDescription> attributes;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+	bool blendEnable = false;
+	std::vector <uint32_t> specialization;						// constant_id i = specialization[i], applied to both stages
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+};
+
+
+// Compiles pipeline variants on worker threads through one shared VkPipelineCache
+class PipelineLibrary
+{
+public:
+	void init(VkDevice logicalDevice, VkPipelineCache cache, uint32_t threadCount = 0);
+	void destroy();												// Waits for outstanding compiles, then destroys every pipeline
+	bool loadArchive(const std::string& path);					// Shader paths found in the archive are served from it
+
+	VkPipeline compile(const PipelineDesc& desc);				// Synchronous - caller owns the result
+	VkPipeline compileCompute(const std::string& shader, VkPipelineLayout layout);	// Synchronous - caller owns the result
+	PipelineHandle request(const PipelineDesc& desc);			// Queue an asynchronous compile
+	PipelineHandle adopt(const PipelineDesc& desc, VkPipeline pipeline);	// Track a compiled pipeline so it can be hot reloaded
+	VkPipeline get(PipelineHandle handle, VkPipeline fallback);	// Never blocks - fallback until the variant is ready
+	bool isReady(PipelineHandle handle);
+	void waitAll();
+
+	void reloadShader(const std::string& path, std::vector<uint32_t>&& code);	// Replace a module & rebuild every pipeline using it
+	uint32_t collectReloads(uint64_t frameNumber, uint32_t framesInFlight);		// Frame boundary - swap in rebuilt pipelines, free retired ones
+
+	uint32_t workerCount() const { return workers ? workers->threadCount() : 0; }
+
+private:
+	struct PipelineEntry
+	{
+		PipelineDesc desc;
+		std::shared_future<VkPipeline> future;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		bool resolved = false;
+		std::shared_future<VkPipeline> rebuild;					// Pending hot reload of this entry
+		bool rebuilding = false;
+	};
+
+	// Replaced pipelines stay alive until every frame that may have recorded them has retired
+	struct RetiredPipeline
+	{
+		VkPipeline pipeline;
+		uint64_t frameNumber;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;			// Internally synchronized by the driver - safe to share across threads
+	std::unique_ptr<ThreadPool> workers;
+
+	std::vector <std::unique_ptr<PipelineEntry>> entries;
+	std::vector <RetiredPipeline> retiredPipelines;
+	std::vector <std::shared_future<VkPipeline>> supersededBuilds;	// Rebuilds overtaken by a newer save - never swapped in
+	std::mutex entries_mutex;
+
+	std::map <std::string, VkShaderModule> shaderModules;		// Loaded once per path, shared by every variant
+	ShaderArchive shaderArchive;
+	std::vector <VkShaderModule> retiredModules;				// A compile in flight may still hold one - freed in destroy
+	std::mutex shader_mutex;
+
+	VkShaderModule getShaderModule(const std::string& path);
+	std::shared_future<VkPipeline> compileAsync(const PipelineDesc& desc);
+};
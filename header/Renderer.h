@@ -5,9 +5,21 @@
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 #include <GLFW/glfw3native.h>
+#include "MemoryAllocator.h"
+#include "PipelineLibrary.h"
+#include "ShaderWatcher.h"
+#include "FramePacer.h"
+#include "GpuProfiler.h"
+#include "DescriptorManager.h"
+#include "FrameGraph.h"
+#include "TextureStreamer.h"
+#include "MeshContainer.h"
+#include "SceneGraph.h"
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
 #define GLFW_INCLUDE_VULKAN
 #define GLFW_EXPOSE_NATIVE_WIN32
+#endif
 
 #include <assert.h>
 #include <cstdlib>
@@ -16,26 +28,256 @@
 #include <sstream>
 #include <optional>
 #include <set>
+#include <map>
 #include <algorithm>
 #include <cstdint>
+#include <cstddef>
 #include <iomanip>
 #include <fstream>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <functional>
+#include <array>
+#include <string>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
 
 
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+#define MAX_FRAMES_IN_FLIGHT 3
+
 #define CLAMP(x, lo, hi)    ((x) < (lo) ? (lo) : (x) > (hi) ? (hi) : (x))
 
-#define SHADER_VERT_FILE_DIR "/src/shaders/vert.spv"
-#define SHADER_FRAG_FILE_DIR "/src/shaders/frag.spv"
+#define SHADER_VERT_FILE_DIR "src/shaders/vert.spv"
+#define SHADER_FRAG_FILE_DIR "src/shaders/frag.spv"
+#define SHADER_SOURCE_DIR "src/shaders/"
+#define SHADER_VERT_SOURCE_FILE "src/shaders/shader_base.vert"
+#define SHADER_FRAG_SOURCE_FILE "src/shaders/shader_base.frag"
+#define INSTANCE_VERT_FILE "src/shaders/instanced.spv"
+#define INSTANCE_VERT_SOURCE_FILE "src/shaders/instanced.vert"
+#define MESH_VERT_FILE "src/shaders/mesh.spv"
+#define MESH_VERT_SOURCE_FILE "src/shaders/mesh.vert"
+#define SHADER_ARCHIVE_FILE "src/shaders/shaders.spva"				// Built by tools/pack_shaders - optional
+
+#define OFFSCREEN_IMAGE_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+#define PARALLEL_RECORD_MIN_DRAWS 256							// Smallest draw slice worth handing to a recording worker
+
+#define CULL_SHADER_FILE "src/shaders/cull.spv"
+#define CULL_WORKGROUP_SIZE 64										// local_size_x in cull.comp
+
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+#define PIPELINE_CACHE_MAGIC 0x43504B56								// "VKPC"
+#define PIPELINE_CACHE_VERSION 1
+
+#define PRESENT_TIMING_HISTORY 64									// Frame start times kept for matching VK_GOOGLE_display_timing results
+
+#define UNIFORM_RING_SIZE (8 * 1024 * 1024)						// Bytes of per frame uniforms shared by every frame in flight
+#define UNIFORM_RING_RANGE 65536									// Largest block one dynamic offset addresses - clamped to maxUniformBufferRange
+#define FRAME_UNIFORM_SET 1											// After the bindless table at set 0
+
+#define INSTANCE_RING_SIZE (64 * 1024 * 1024)						// Bytes of instance streams - holds frames in flight + 1 frames of batches
+
+#define MODEL_LOD_HYSTERESIS 0.25f									// A model only coarsens once the next level is this far under the error threshold
+#define MODEL_LOD_MAX_ERROR_SCALE 64.0f								// Furthest the triangle budget may loosen the error threshold
+
+#define STAGING_CHUNK_SIZE (16 * 1024 * 1024)						// Bytes per staging chunk
+#define STAGING_CHUNK_COUNT 2										// Chunks in the staging ring - CPU fills one while the GPU copies another
+
+
+// Renderer Creation Settings
+struct RendererConfig
+{
+	uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;		// Frames the CPU may record ahead of the GPU (1 - MAX_FRAMES_IN_FLIGHT)
+	bool headless = false;									// Render into offscreen images - no window, surface or swap chain
+	uint32_t width = WINDOW_WIDTH;
+	uint32_t height = WINDOW_HEIGHT;
+	bool enableValidation = true;							// Request VK_LAYER_KHRONOS_validation
+	std::string pipelineCachePath = PIPELINE_CACHE_FILE;	// Empty disables the on-disk pipeline cache
+	uint32_t pipelineThreads = 0;							// Pipeline compile workers - 0 for one per hardware thread
+	std::string shaderArchivePath = SHADER_ARCHIVE_FILE;	// Packed shaders, falls back to the loose .spv files when missing
+	bool hotReload = false;									// Recompile & swap pipelines when GLSL in SHADER_SOURCE_DIR changes
+	uint32_t recordThreads = 0;								// Secondary command buffer workers - 0 records inline on the calling thread
+	bool gpuDriven = false;									// Cull scene objects in a compute pass & draw them indirectly
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;	// Falls back to FIFO when the surface does not offer it
+	double targetFps = 0.0;									// Frame rate cap - 0 leaves pacing to the present mode
+	bool lowLatency = false;								// Delay input & recording to just before the GPU can take the frame
+	bool profileGpu = false;								// Timestamp & pipeline statistics queries around each pass
+	bool bindlessDescriptors = true;						// One descriptor indexed table for every texture & storage buffer, when supported
+	bool asyncCompute = true;								// Culling & compute passes on a compute only queue, when the device has one
+	VkDeviceSize textureStagingBudget = TEXTURE_STAGING_BUDGET;	// Texture upload bytes recorded per frame
+	VkDeviceSize textureMemoryBudget = TEXTURE_MEMORY_BUDGET;	// Device memory streamed texture mips may hold
+	uint32_t textureDecodeThreads = 2;						// Texture decode & encode workers
+	float lodErrorPixels = 1.0f;							// Screen space error a model level of detail may show - 0 always draws full detail
+	uint32_t lodTriangleBudget = 0;							// Model triangles per frame before the error threshold loosens - 0 for no limit
+	uint32_t sceneThreads = 2;								// Scene graph update workers - few, since pipelineThreads already covers every core; 0 for one per hardware thread
+};
+
+// Vertex Layout consumed by shader_base.vert
+struct Vertex
+{
+	float pos[2];
+	float color[3];
+
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription binding{};
+		binding.binding = 0;
+		binding.stride = sizeof(Vertex);
+		binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return binding;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 2> attributes{};
+		attributes[0].binding = 0;
+		attributes[0].location = 0;
+		attributes[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributes[0].offset = offsetof(Vertex, pos);
+		attributes[1].binding = 0;
+		attributes[1].location = 1;
+		attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributes[1].offset = offsetof(Vertex, color);
+		return attributes;
+	}
+};
+
+// Object culled & drawn by the GPU driven path - layout matches GpuObject in cull.comp
+struct GpuObject
+{
+	float center[3];
+	float radius;												// Bounding sphere
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+// Push constants for cull.comp
+struct CullConstants
+{
+	float frustumPlanes[6][4];									// xyz inward normal, w distance
+	uint32_t objectCount;
+	uint32_t compact;											// Append visible draws & count them, for vkCmdDrawIndexedIndirectCount
+};
+
+// Per frame uniforms at set = FRAME_UNIFORM_SET, binding 0 - std140 layout matches FrameUniforms in shader_base.vert
+struct FrameUniforms
+{
+	float viewProjection[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };	// Column major
+	float extent[2] = { 0.0f, 0.0f };
+	float time = 0.0f;											// Seconds since the renderer started
+	uint32_t frameNumber = 0;
+};
+
+// Per draw push constants - layout matches DrawConstants in shader_base.vert, within the 128 bytes every device offers
+struct DrawConstants
+{
+	float model[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };	// Column major
+};
+
+// Per instance attributes as structure of arrays - each stream is bound as its own per instance vertex binding
+struct InstanceStreams
+{
+	std::vector <float> transforms;								// x, y, scale, rotation in radians - 4 floats per instance
+	std::vector <uint32_t> colors;								// RGBA8, multiplies the vertex color
+	std::vector <uint32_t> ids;									// Passed to the fragment stage flat, for picking
+
+	void push(float x, float y, float scale, float rotation, uint32_t color, uint32_t id)
+	{
+		transforms.insert(transforms.end(), { x, y, scale, rotation });
+		colors.push_back(color);
+		ids.push_back(id);
+	}
+	void reserve(size_t count) { transforms.reserve(count * 4); colors.reserve(count); ids.reserve(count); }
+	void clear() { transforms.clear(); colors.clear(); ids.clear(); }
+	uint32_t size() const { return (uint32_t)ids.size(); }
+};
+
+// Streams of one batch in the instance ring - write count instances in place before the next drawFrame
+struct InstanceBatchWriter
+{
+	float* transforms = nullptr;
+	uint32_t* colors = nullptr;
+	uint32_t* ids = nullptr;
+	uint32_t count = 0;
+};
+
+// Block bump allocated from the uniform ring - written through data, read by shaders at the dynamic offset
+struct UniformAllocation
+{
+	void* data = nullptr;
+	uint32_t offset = 0;
+};
+
+// Buffer bound to a sub-allocation from the Renderer's MemoryAllocator
+struct GpuBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation allocation;
+	VkDeviceSize size = 0;
+	VkBufferUsageFlags usage = 0;
+	MemoryAllocationCreateInfo memoryInfo;
+};
+
+// Index into the Renderer's loaded models
+typedef uint32_t ModelHandle;
+
+// Called with the pixels of each finished headless frame (tightly packed OFFSCREEN_IMAGE_FORMAT)
+typedef std::function<void(const void* pixels, VkExtent2D extent, uint64_t frameNumber)> FrameReadbackCallback;
+
+// Records one compute pass into the frame's compute command buffer - async compute queue or inline before the render pass
+typedef std::function<void(VkCommandBuffer command_buffer, uint32_t frameSlot)> ComputePassCallback;
+
+// Declares what a compute pass reads & writes - passes without one are never culled & graphics waits on them conservatively
+typedef std::function<void(FrameGraph& graph, uint32_t pass)> ComputePassSetup;
+
+// Frame Timing Statistics collected by drawFrame
+struct FrameStats
+{
+	uint64_t frameCount = 0;
+	double totalFrameMs = 0.0;									// Sum of intervals between consecutive frames
+	double minFrameMs = 0.0;
+	double maxFrameMs = 0.0;
+	double totalCpuMs = 0.0;									// Sum of CPU time spent inside drawFrame
+	double totalFenceWaitMs = 0.0;								// Sum of CPU time blocked on in-flight fences
+	uint32_t swapChainRecreations = 0;
+	double totalRecreateMs = 0.0;								// Sum of CPU time spent recreating the swap chain
+	double totalAcquireMs = 0.0;								// Sum of CPU time blocked in vkAcquireNextImageKHR
+	double totalPacingMs = 0.0;									// Sum of time the frame pacer slept before frames
+	uint64_t presentLatencySamples = 0;
+	double totalPresentLatencyMs = 0.0;							// Frame start to on-screen, measured through VK_GOOGLE_display_timing
+	double maxPresentLatencyMs = 0.0;
+	uint64_t totalModelTriangles = 0;							// Sum of model triangles drawn at their selected level of detail
+	std::vector <double> frameTimesMs;							// Per frame intervals - only with keepFrameSamples(true)
+	std::vector <double> cpuTimesMs;							// Per frame CPU recording & submit time, waits excluded
+
+	double averageFrameMs() const { return frameCount > 1 ? totalFrameMs / (frameCount - 1) : 0.0; }
+	double framesPerSecond() const { return totalFrameMs > 0.0 ? (frameCount - 1) * 1000.0 / totalFrameMs : 0.0; }
+};
+
+
+// Startup Timing
+struct StartupStats
+{
+	double initMs = 0.0;										// Whole of initVulkan
+	double pipelineMs = 0.0;									// Pipeline creation only
+	bool pipelineCacheLoaded = false;							// A valid cache file was found for this device & driver
+	size_t pipelineCacheBytes = 0;								// Size of the cache data loaded from disk
+};
 
 
 class Renderer
 {
 public:
-	Renderer();
+	Renderer(RendererConfig config = RendererConfig());
 	~Renderer();
 
 private:
@@ -54,9 +296,17 @@ private:
 	VkDevice device = VK_NULL_HANDLE;							// Logical Device connected to GPU
 	VkQueue graphics_queue;										// Queue for Device (GPU)
 	VkQueue present_queue;										// Queue for Presenting
+	VkQueue transfer_queue;										// Queue for Uploads - dedicated family when the device has one
+	VkQueue compute_queue = VK_NULL_HANDLE;						// Async compute - only with a compute family apart from graphics
 	uint32_t queue_family_index = 0;							// Graphics Family indice
 	uint32_t present_family_index = 0;
+	uint32_t transfer_family_index = 0;
+	uint32_t compute_family_index = 0;
 	VkDebugReportCallbackEXT debug_report = VK_NULL_HANDLE;		// Debugger callback report
+	MemoryAllocator allocator;									// Sub-allocates every buffer & image
+	DescriptorManager descriptorManager;						// Bindless table & per frame transient sets
+	bool bindless_descriptors = true;
+	bool descriptor_indexing = false;							// Descriptor indexing features enabled on the device
 
 
 	// Vulkan Presentation Components
@@ -65,24 +315,226 @@ private:
 	VkFormat swap_chain_image_format;							// Format of swapchain
 	VkExtent2D swap_chain_extent;								// Extent / resolution
 	VkPipelineLayout pipelineLayout;							// Pipeline for rendering
-	VkPipeline graphicsPipeline;
+	VkPipeline graphicsPipeline;								// Base pipeline & fallback for pending variants
+	PipelineLibrary pipelineLibrary;
+	PipelineHandle active_pipeline = PIPELINE_HANDLE_NONE;
+	PipelineHandle base_pipeline = PIPELINE_HANDLE_NONE;		// graphicsPipeline as tracked by the library for hot reload
+	ShaderWatcher shaderWatcher;
+	bool hot_reload = false;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;				// Seeded from & written back to pipeline_cache_path
+	std::string pipeline_cache_path;
+	uint32_t pipeline_threads = 0;
+	std::string shader_archive_path;
 	VkRenderPass render_pass;									// Renderer Pass
 	VkCommandPool commandPool;									// Command pool
-	VkCommandBuffer commandBuffer;								// Command Buffer
+	std::vector <VkCommandBuffer> commandBuffers;				// Command Buffer per frame in flight
+
+	// Parallel Recording - [frame][worker] pools, each holding the one secondary buffer that worker records
+	uint32_t record_threads = 0;
+	std::unique_ptr<ThreadPool> recordWorkers;
+	std::vector <std::vector<VkCommandPool>> recordPools;
+	std::vector <std::vector<VkCommandBuffer>> recordSecondaries;
 
 	// Vulkan Buffers
 	std::vector <VkImage> swapChainImages;						// Images in swap chain
 	std::vector <VkImageView> swapChainImageViews;				// Image views
 	std::vector <VkFramebuffer> swapChainFrameBuffers;			// Frame Buffesr
 
-	// Synchronization objects
-	VkSemaphore imageAvailableSemaphore;
-	VkSemaphore renderFinishedSemaphore;
-	VkFence inFlightFence;
+	// Swap Chain Recreation - replaced chains live on until every frame that used them has retired
+	struct RetiredSwapChain
+	{
+		VkSwapchainKHR swapChain;
+		std::vector <VkImageView> imageViews;
+		std::vector <VkFramebuffer> frameBuffers;
+		std::vector <VkSemaphore> renderFinishedSemaphores;		// Presents of the old images may still wait on these
+		uint64_t frameNumber;
+	};
+	std::vector <RetiredSwapChain> retiredSwapChains;
+	bool framebuffer_resized = false;							// Set by the GLFW resize callback
+	bool swap_chain_stale = false;								// Window is minimized - retry recreation each frame
+
+	// Presentation & Pacing
+	VkPresentModeKHR requested_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;	// Mode of the current swap chain
+	std::vector <VkPresentModeKHR> supportedPresentModes;
+	bool present_mode_changed = false;							// Recreate the swap chain at the next frame
+	FramePacer framePacer;
+	bool display_timing = false;								// VK_GOOGLE_display_timing enabled
+	PFN_vkGetPastPresentationTimingGOOGLE getPastPresentationTiming = nullptr;
+	PFN_vkGetRefreshCycleDurationGOOGLE getRefreshCycleDuration = nullptr;
+	uint64_t refresh_duration_ns = 0;
+	std::array <uint64_t, PRESENT_TIMING_HISTORY> presentStartTimes{};	// steady_clock ns of each frame's start, by present ID
+
+	// Headless Offscreen Targets - stand in for swap chain images, one per frame in flight. The extent also sizes the window.
+	bool headless = false;
+	uint32_t target_width = WINDOW_WIDTH;
+	uint32_t target_height = WINDOW_HEIGHT;
+	std::vector <MemoryAllocation> offscreenImageAllocations;
+	GpuBuffer readbackBuffer;									// Persistently mapped staging ring, one slot per frame in flight
+	VkDeviceSize readback_slot_size = 0;
+	std::vector <bool> readbackPending;							// Slot holds a frame not yet handed to the callback
+	std::vector <uint64_t> readbackFrameNumbers;
+	uint64_t submitted_frames = 0;							// Frames submitted so far - also paces pipeline retirement
+	FrameReadbackCallback frame_readback_callback;
+
+	// Geometry Buffers - device local, filled through the staging ring
+	GpuBuffer vertexBuffer;
+	GpuBuffer indexBuffer;
+	uint32_t index_count = 0;
+
+	// Replaced geometry lives on until every frame that drew it has retired
+	struct RetiredBuffer
+	{
+		GpuBuffer buffer;
+		uint64_t frameNumber;
+	};
+	std::vector <RetiredBuffer> retiredBuffers;
+	std::vector <VkDrawIndexedIndirectCommand> drawList;			// Draws recorded each frame against the current mesh
+
+	// GPU Driven Rendering - objects culled by cull.comp into per frame indirect buffers
+	bool gpu_driven = false;
+	bool draw_indirect_count = false;							// VK_KHR_draw_indirect_count enabled
+	bool multi_draw_indirect = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+	uint32_t object_count = 0;
+	uint32_t object_capacity = 0;
+	GpuBuffer objectBuffer;
+	std::vector <GpuBuffer> indirectBuffers;
+	std::vector <GpuBuffer> drawCountBuffers;
+	VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool cullDescriptorPool = VK_NULL_HANDLE;
+	std::vector <VkDescriptorSet> cullSets;
+	VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	float frustum_planes[6][4] = {								// Clip space box until a camera supplies its own
+		{ 1.0f, 0.0f, 0.0f, 1.0f }, { -1.0f, 0.0f, 0.0f, 1.0f },
+		{ 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, -1.0f, 0.0f, 1.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f, 1.0f } };
+	VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+
+	// Per Frame Uniforms - bump allocated from one persistently mapped ring & bound through dynamic offsets
+	VkBuffer uniformBuffer = VK_NULL_HANDLE;
+	MemoryRing* uniformRing = nullptr;							// Memory is owned by the allocator
+	VkDeviceSize uniform_alignment = 256;						// minUniformBufferOffsetAlignment
+	VkDeviceSize uniform_range = UNIFORM_RING_RANGE;
+	VkDescriptorSetLayout uniformSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool uniformDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet uniformSet = VK_NULL_HANDLE;				// One set for the whole ring - the dynamic offset picks the block
+	FrameUniforms frame_uniforms;								// Copied into the ring as each frame starts recording
+	uint32_t frame_uniform_offset = 0;
+	std::chrono::steady_clock::time_point uniform_epoch;
+	std::vector <DrawConstants> drawConstants;					// Parallel to drawList - identity transforms when empty
+
+	// Instanced Batches - streams appended into a ring each frame, one draw per batch
+	struct InstanceBatch
+	{
+		VkDrawIndexedIndirectCommand mesh;
+		VkDeviceSize streamOffsets[3];							// Transforms, colors & ids in instanceBuffer
+	};
+	VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	MemoryRing* instanceRing = nullptr;
+	std::vector <InstanceBatch> instanceBatches;				// Drawn by the next frame, then cleared
+	PipelineHandle instanced_pipeline = PIPELINE_HANDLE_NONE;	// Requested on first use
+
+	// Async Compute - culling & compute passes run beside graphics, ordered by a timeline semaphore
+	bool async_compute_requested = true;
+	bool async_compute = false;
+	bool timeline_semaphore = false;							// timelineSemaphore feature enabled
+	VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+	std::vector <VkCommandBuffer> computeCommandBuffers;		// One per frame in flight
+	std::vector <VkFence> computeFences;						// Graphics may not wait on every compute submit - guards command buffer reuse
+	VkSemaphore computeTimeline = VK_NULL_HANDLE;
+	uint64_t compute_timeline_value = 0;
+	uint64_t compute_wait_value = 0;							// Timeline value this frame's graphics submit waits on - 0 for none
+	struct ComputePass
+	{
+		const char* name;
+		ComputePassCallback record;
+		ComputePassSetup setup;
+	};
+	std::vector <ComputePass> computePasses;
+
+	// Frame Graph - rebuilt & compiled every frame, owns the barriers between its passes
+	FrameGraph frameGraph;
+
+	// Models - blobs from a MeshContainer copied into device local buffers, one pipeline per vertex layout
+	struct Model
+	{
+		GpuBuffer vertexBuffer;
+		GpuBuffer indexBuffer;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+		std::vector <MeshContainerSubmesh> submeshes;
+		std::vector <MeshContainerMeshlet> meshlets;				// Kept on the CPU for cluster culling
+		float boundsMin[3];
+		float boundsMax[3];
+		float positionScale[3];									// Folded into the model matrix by drawModel
+		float positionOffset[3];
+		uint32_t lodCount = 1;
+		std::vector <MeshContainerLod> lods;					// Submesh s at level l is lods[s * lodCount + l]
+		std::vector <float> lodErrors;							// Per level, the largest of any submesh
+		std::vector <uint32_t> lodTriangles;					// Per level, every submesh
+		PipelineHandle pipeline = PIPELINE_HANDLE_NONE;
+	};
+	struct ModelDraw
+	{
+		ModelHandle model;
+		uint32_t lod;
+		DrawConstants constants;
+	};
+	std::vector <Model> models;
+	std::vector <ModelDraw> modelDraws;							// Drawn by the next frame, then cleared
+	std::map <std::vector<uint32_t>, PipelineHandle> modelPipelines;	// Keyed by stride & attribute table
+	float lod_error_pixels = 1.0f;
+	uint32_t lod_triangle_budget = 0;
+	float lod_error_scale = 1.0f;								// Raised while model triangles run over the budget
+	uint64_t model_triangles = 0;								// Drawn by the frame being built
+
+	// Scene Graph - nodes with a render handle draw that model every frame
+	SceneGraph scene;
+	uint32_t scene_threads = 2;
+
+	// Texture Streaming - uploads recorded by a graph pass out of their own ring
+	TextureStreamer textureStreamer;
+	VkBuffer textureStagingBuffer = VK_NULL_HANDLE;
+	MemoryRing* textureStagingRing = nullptr;
+	bool texture_compression_bc = false;						// textureCompressionBC feature enabled
+	VkDeviceSize texture_staging_budget = TEXTURE_STAGING_BUDGET;
+	VkDeviceSize texture_memory_budget = TEXTURE_MEMORY_BUDGET;
+	uint32_t texture_decode_threads = 2;
+
+	// Staging Upload Ring
+	struct StagingChunk
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		VkDeviceSize used = 0;
+		std::vector <std::pair<VkBuffer, VkBufferCopy>> copies;	// Pending copies out of this chunk
+	};
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+	GpuBuffer stagingBuffer;
+	std::vector <StagingChunk> stagingChunks;
+	uint32_t staging_chunk_index = 0;
+
+	// Synchronization objects - one ring slot per frame in flight
+	uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+	uint32_t currentFrame = 0;
+	std::vector <VkSemaphore> imageAvailableSemaphores;
+	std::vector <VkSemaphore> renderFinishedSemaphores;			// One per swap chain image - a present holds it until the image is reacquired
+	std::vector <VkFence> inFlightFences;
+	std::vector <VkFence> imagesInFlight;						// Fence of the frame currently using each swap chain image
+
+	// Frame timing
+	bool profile_gpu = false;
+	bool pipeline_statistics_query = false;						// pipelineStatisticsQuery feature enabled
+	GpuProfiler gpuProfiler;
+	StartupStats startup_stats;
+	FrameStats frame_stats;
+	std::chrono::steady_clock::time_point last_frame_time;
+	bool keep_frame_samples = false;
 
 
 	// Validation Layers for Vulkan Elementsdf
-	const bool enableValidationLayers = true;
+	bool enableValidationLayers = true;
 	const std::vector <const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};		// Validation layers for instance & device
 	//std::vector <const char*> SDL_extensions{};													// SDL extensions
 	std::vector <const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};			// Device extensions
@@ -90,10 +542,12 @@ private:
 	// Queue Family Indices for Physical Device
 	struct QueueFamilyIndices 
 	{
-		uint32_t graphicsFamily = -1;
-		uint32_t presentFamily = -1;
+		uint32_t graphicsFamily = UINT32_MAX;
+		uint32_t presentFamily = UINT32_MAX;
+		uint32_t transferFamily = UINT32_MAX;				// Dedicated transfer family, or graphics when none exists
+		uint32_t computeFamily = UINT32_MAX;				// Compute family without graphics, or graphics when none exists
 
-		bool hasEntry() { return (graphicsFamily != -1 && presentFamily != -1); }
+		bool hasEntry() { return (graphicsFamily != UINT32_MAX && presentFamily != UINT32_MAX); }
 	};
 
 	// Swap Chain Properties for Surface
@@ -133,21 +587,128 @@ public: // Delete 'public' later *
 	bool checkDeviceExtensions(VkPhysicalDevice device);								// Check for needed Device Extensions
 	void createLogicalDevice();															// Create Logical Device from Physical GPU 
 	void createSurface();																// Create Surface for graphics
-	void createSwapChain();																// Create Swap Chain for
+	void createSwapChain(VkSwapchainKHR old_swap_chain = VK_NULL_HANDLE);				// Create Swap Chain for
+	bool recreateSwapChain();															// Replace the swap chain, image views & framebuffers in place
+	void releaseRetiredSwapChains(bool all = false);
+	static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+	void setViewportState(VkCommandBuffer command_buffer);								// Dynamic viewport & scissor covering the swap chain
+	void setPresentMode(VkPresentModeKHR mode);											// Applied at the next frame by recreating the swap chain
+	VkPresentModeKHR getPresentMode() const { return present_mode; }
+	const std::vector<VkPresentModeKHR>& getSupportedPresentModes() const { return supportedPresentModes; }
+	static const char* presentModeName(VkPresentModeKHR mode);
+	void setTargetFps(double fps) { framePacer.setTargetFps(fps); }
+	void setLowLatency(bool enabled) { framePacer.setLowLatency(enabled); }
+	void paceFrame();																	// Frame pacer sleep - call before polling input
+	void collectPresentTimings();														// Read back VK_GOOGLE_display_timing results
 	SwapChainProperties querySwapChainProp(VkPhysicalDevice device);					// Query the Properties in Swap Chain
 	void setSwapChainProp(SwapChainProperties& swapChainProperties);					// Fill SwapChain Properties
 	void createImageViews();
+	void createOffscreenTargets();														// Create headless render targets & readback ring
+	void destroyOffscreenTargets();
+	void deliverReadback(uint32_t slot);												// Hand a finished headless frame to the callback
 
 
-	std::vector<char> readFile(const std::string &fileName);						// Reads in Files
-	VkShaderModule createShaderModule(std::vector<char> &buffer);						// Create Module from Shader Files
+	void createPipelineCache();															// Load & validate the on-disk pipeline cache
+	void savePipelineCache();															// Atomically write the pipeline cache back to disk
 	void createGraphicsPipeline();														// Graphics Pipeline for Rendering
+	PipelineDesc basePipelineDesc();													// Default pipeline state for variants to start from
+	PipelineHandle requestPipelineVariant(const PipelineDesc& desc);					// Compile a variant on the pipeline worker threads
+	void setActivePipeline(PipelineHandle handle) { active_pipeline = handle; }		// Drawn once compiled, base pipeline until then
+	void waitForPipelines();
+	void startShaderHotReload();														// Watch SHADER_SOURCE_DIR & rebuild affected pipelines
+	void swapReloadedPipelines();														// Frame boundary - after the ring slot's fence wait
 	void createRenderPass();															// Create the Renderpass for Frame bufers
 	void createFrameBuffers();															// Create Frame Buffers for Rendering
 	void createCommandPool();
-	void createCommandBuffer();															// Create Command Buffer
+	void createCommandBuffers();														// Create Command Buffer per frame in flight
+	void createRecordWorkers();															// Per frame, per worker pools for secondary buffers
+	void destroyRecordWorkers();
+	void recordDraws(VkCommandBuffer command_buffer, VkPipeline pipeline, size_t first, size_t count);		// Bind state & record a slice of the draw list
+	void setDrawList(const std::vector<VkDrawIndexedIndirectCommand>& draws) { drawList = draws; }
+	const std::vector<VkDrawIndexedIndirectCommand>& getDrawList() const { return drawList; }
+	void createCullingPipeline();														// Compute pipeline & descriptors for GPU driven drawing
+	void destroyCullingResources();
+	void writeCullSets();																// Rebind the culling descriptors to the current buffers
+	void setSceneObjects(const std::vector<GpuObject>& objects);						// Upload the objects the GPU culls & draws
+	void setFrustumPlanes(const float planes[6][4]) { std::memcpy(frustum_planes, planes, sizeof(frustum_planes)); }
+	void recordCulling(VkCommandBuffer command_buffer);									// Compute pass writing this frame's indirect draws
+	void recordIndirectDraws(VkCommandBuffer command_buffer, VkPipeline pipeline);
+	bool isGpuDriven() const { return gpu_driven; }
+	void createAsyncCompute();															// Compute pool, per frame command buffers & timeline
+	void destroyAsyncCompute();
+	void addComputePass(const char* name, ComputePassCallback record, ComputePassSetup setup = nullptr) { computePasses.push_back({ name, record, setup }); }	// name must outlive the renderer - profiler scopes keep it
+	bool isAsyncCompute() const { return async_compute; }
+	void submitAsyncCompute();															// Records the graph's compute passes - sets compute_wait_value
+	void buildFrameGraph(uint32_t image_index, FrameGraphExecute renderPass);			// Culling, compute passes, the render pass & readback
+	const FrameGraphStats& getFrameGraphStats() const { return frameGraph.getStats(); }
+	void createTextureStreamer();														// Upload ring & decode workers for streamed textures
+	void destroyTextureStreamer();
+	TextureStreamer& getTextureStreamer() { return textureStreamer; }
+	void submitGraphics(VkCommandBuffer command_buffer, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore);	// Either semaphore may be VK_NULL_HANDLE
+	VkBuffer createBufferHandle(VkDeviceSize size, VkBufferUsageFlags usage);			// Unbound, shared across every queue family that touches buffers
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const MemoryAllocationCreateInfo& memoryInfo, GpuBuffer& buffer);	// Create & bind a sub-allocated buffer
+	void destroyBuffer(GpuBuffer& buffer);
+	void createUniformRing();															// Persistently mapped ring & dynamic uniform descriptor
+	void destroyUniformRing();
+	void releaseUniformFrames();														// Frame boundary - after the ring slot's fence wait
+	UniformAllocation allocateUniforms(VkDeviceSize size);								// Valid for the frame being recorded - recording thread only
+	template <typename T> uint32_t pushUniforms(const T& value)						// Copy into the ring, returns the dynamic offset
+	{
+		UniformAllocation block = allocateUniforms(sizeof(T));
+		std::memcpy(block.data, &value, sizeof(T));
+		return block.offset;
+	}
+	void bindFrameState(VkCommandBuffer command_buffer);								// Bindless table, frame uniforms & default push constants
+	void setViewProjection(const float matrix[16]) { std::memcpy(frame_uniforms.viewProjection, matrix, sizeof(frame_uniforms.viewProjection)); }
+	void setDrawConstants(const std::vector<DrawConstants>& constants) { drawConstants = constants; }	// One per draw list entry
+	MemoryRing* createRingBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer);	// Host coherent buffer over a dedicated ring
+	void createInstanceRing();															// Mapped ring the instance streams are written into
+	void destroyInstanceRing();
+	void releaseInstanceFrames();														// Frame boundary - after the ring slot's fence wait
+	InstanceBatchWriter appendInstances(const VkDrawIndexedIndirectCommand& mesh, uint32_t count);	// Batch drawn by the next frame, streams written in place
+	void drawInstanced(const VkDrawIndexedIndirectCommand& mesh, const InstanceStreams& instances);	// Copy streams into a new batch
+	void recordInstancedDraws(VkCommandBuffer command_buffer);
+	ModelHandle loadModel(const std::string& path);										// Map an .rmesh file & copy its blobs through the staging ring
+	ModelHandle loadModel(const MeshContainer& mesh);
+	void drawModel(ModelHandle model, const DrawConstants& constants, uint32_t* lod = nullptr);	// Every submesh, drawn by the next frame - lod keeps the level between frames
+	uint32_t selectModelLod(ModelHandle model, const float matrix[16], uint32_t current) const;	// Coarsest level under the error threshold, UINT32_MAX current for none
+	void updateLodBudget();
+	SceneGraph& getScene() { return scene; }
+	void drawScene();																	// Every scene node with a model, at its world transform
+	VkDeviceSize getModelVertexBytes(ModelHandle model) const;
+	void recordModelDraws(VkCommandBuffer command_buffer);
+	void destroyModels();
+	void createStagingRing();															// Create the persistently mapped upload ring
+	void destroyStagingRing();
+	void uploadToBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);	// Queue a copy into a device local buffer
+	void submitStagingChunk();															// Submit the current chunk and move to the next
+	void flushUploads();																// Submit pending copies and wait for them all
+	void uploadMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);	// Replace the geometry drawn each frame
+	void destroyMeshBuffers();
+	void retireBuffer(GpuBuffer& buffer);												// Destroyed once frames submitted so far have retired
+	void releaseRetiredBuffers(bool all = false);
+	void defragmentMemory();															// Relocate long lived buffers & release emptied blocks
 	void writeCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index);		// Writes to Command buffers
 
 	void createSyncObjects();
+	void createPresentSemaphores();														// Render finished semaphores for the current swap chain images
 	void drawFrame();																	// Draws each Frame
+	void discardFrame();																// Drop the draws & ring space queued for a frame that is skipped
+	void runFrames(uint32_t frameCount);												// Draw a fixed number of frames then wait for idle
+	void waitIdle();																	// Drain the GPU & resolve outstanding profiler queries
+	void drawOffscreenFrame();															// Headless drawFrame - no acquire or present
+	void recordFrameTiming(std::chrono::steady_clock::time_point frame_start, double wait_ms);
+	void setFrameReadbackCallback(FrameReadbackCallback callback) { frame_readback_callback = callback; }
+	bool isHeadless() const { return headless; }
+
+	const StartupStats& getStartupStats() const { return startup_stats; }
+	const FrameStats& getFrameStats() const { return frame_stats; }
+	GpuProfiler& getGpuProfiler() { return gpuProfiler; }
+	DescriptorManager& getDescriptorManager() { return descriptorManager; }
+	uint64_t getSubmittedFrames() const { return submitted_frames; }					// Pass to DescriptorManager::remove* when dropping a resource
+	void resetFrameStats();
+	void keepFrameSamples(bool keep) { keep_frame_samples = keep; }					// Store every frame time for percentiles
+	MemoryStats getMemoryStats() { return allocator.getStats(); }
+	void printFrameStats();
+	void printMemoryStats();
 };
\ No newline at end of file
@@ -0,0 +1,133 @@
+// Vulkan Renderer - Scene Graph
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+#define SCENE_NODE_NONE UINT32_MAX
+#define SCENE_NODE_INDEX_BITS 24										// Slot in the low bits, generation above
+#define SCENE_NODE_MAX_SLOTS ((1u << SCENE_NODE_INDEX_BITS) - 1)
+#define SCENE_RENDER_NONE UINT32_MAX
+#define SCENE_UPDATE_CHUNK 4096											// Nodes per job when a level is split across workers
+
+
+typedef uint32_t SceneNode;
+
+
+// Column major - aligned for the SIMD paths
+struct alignas(16) SceneMatrix
+{
+	float m[16];
+};
+
+// Bounding sphere
+struct alignas(16) SceneBounds
+{
+	float center[3];
+	float radius;
+};
+
+
+struct SceneUpdateStats
+{
+	uint32_t nodes = 0;
+	uint32_t levels = 0;
+	uint32_t updatedNodes = 0;										// World transforms recomputed by the last update
+	double updateMs = 0.0;											// Last update
+	uint64_t updates = 0;											// Since resetStats
+	uint64_t totalUpdatedNodes = 0;
+	double totalUpdateMs = 0.0;
+	uint32_t rebuilds = 0;											// Updates that re-sorted the pools after structural changes
+};
+
+
+// Transform hierarchy in structure of arrays pools
+//
+// Every per node attribute lives in its own contiguous array, indexed by a dense index that update keeps in
+// breadth first order: each depth is one contiguous level and each node's children are one contiguous range
+// of the next. Handles stay stable across that ordering through a slot table with generations.
+//
+// A local transform change marks the node dirty. update walks the levels top down, recomputing only dirty
+// nodes & the child ranges of whatever changed above them, so untouched subtrees are never read. Levels
+// large enough are split across worker threads - a level only depends on the one before it.
+class SceneGraph
+{
+public:
+	void init(uint32_t threadCount);								// Update workers - optional, update runs on the caller without them
+	void clear();
+
+	SceneNode createNode(SceneNode parent = SCENE_NODE_NONE);		// Identity transform - SCENE_NODE_NONE when parent is invalid
+	void destroyNode(SceneNode node);								// Its subtree goes with it at the next update
+	bool setParent(SceneNode node, SceneNode parent);				// Fails on invalid handles or a cycle
+	bool isValid(SceneNode node) const;
+	SceneNode getParent(SceneNode node) const;
+
+	void setLocalTransform(SceneNode node, const float matrix[16]);
+	void setLocalBounds(SceneNode node, const float center[3], float radius);
+	void setRenderHandle(SceneNode node, uint32_t handle);			// SCENE_RENDER_NONE for transform only nodes
+	const float* getLocalTransform(SceneNode node) const;
+	const float* getWorldTransform(SceneNode node) const;			// As of the last update
+	const SceneBounds* getWorldBounds(SceneNode node) const;
+	uint32_t getRenderHandle(SceneNode node) const;
+
+	void update();													// Apply structural changes, then propagate dirty transforms
+
+	// Pools in dense order as of the last update - nodes created since are appended unsorted
+	uint32_t size() const { return (uint32_t)world.size(); }
+	const SceneMatrix* worldTransforms() const { return world.data(); }
+	const SceneBounds* worldBounds() const { return world_bounds.data(); }
+	const uint32_t* renderHandles() const { return render_handles.data(); }
+	uint32_t* renderStates() { return render_states.data(); }		// Opaque to the graph, UINT32_MAX on create - the renderer's level of detail
+
+	const SceneUpdateStats& getStats() const { return stats; }
+	void resetStats();
+
+private:
+	enum NodeFlags : uint8_t
+	{
+		NODE_DIRTY = 1,												// Local transform or bounds changed
+		NODE_REMOVED = 2,
+	};
+
+	// Dense pools
+	std::vector <SceneMatrix> local;
+	std::vector <SceneMatrix> world;
+	std::vector <SceneBounds> local_bounds;
+	std::vector <SceneBounds> world_bounds;
+	std::vector <uint32_t> render_handles;
+	std::vector <uint32_t> render_states;
+	std::vector <uint32_t> parents;									// Dense index, SCENE_NODE_NONE for roots
+	std::vector <uint32_t> child_begin;								// Children are [child_begin, child_end) - begins never decrease
+	std::vector <uint32_t> child_end;
+	std::vector <uint32_t> dense_slots;
+	std::vector <uint8_t> flags;
+	std::vector <uint32_t> level_begin{ 0 };						// Level d is [level_begin[d], level_begin[d + 1])
+	std::vector <uint32_t> dirty;									// Dense indices marked NODE_DIRTY, each once
+
+	// Handles
+	std::vector <uint32_t> slot_dense;
+	std::vector <uint8_t> slot_generation;
+	std::vector <uint32_t> free_slots;
+
+	// Update scratch, kept between updates
+	std::vector <std::vector<uint32_t>> level_dirty;
+	std::vector <std::pair<uint32_t, uint32_t>> spans;
+	std::vector <std::pair<uint32_t, uint32_t>> own_spans;
+	std::vector <std::pair<uint32_t, uint32_t>> next_spans;
+	std::vector <std::pair<uint32_t, uint32_t>> chunks;
+
+	bool structure_changed = false;
+	std::unique_ptr <ThreadPool> workers;
+	SceneUpdateStats stats;
+
+	uint32_t resolve(SceneNode node) const;							// Dense index, SCENE_NODE_NONE when stale
+	void markDirty(uint32_t index);
+	void rebuild();
+	void updateSpans(const std::vector<std::pair<uint32_t, uint32_t>>& ranges, uint32_t count);
+	void updateRange(uint32_t begin, uint32_t end);
+};
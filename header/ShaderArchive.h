@@ -0,0 +1,55 @@
+// Vulkan Renderer - Packed Shader Archive
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "MappedFile.h"
+
+
+#define SHADER_ARCHIVE_MAGIC 0x41565053								// "SPVA"
+#define SHADER_ARCHIVE_VERSION 1
+#define SHADER_ARCHIVE_ALIGNMENT 16									// Every module starts on this boundary
+#define SPIRV_MAGIC 0x07230203
+
+
+// File layout: header | entries[entryCount] | name table | padding | modules
+struct ShaderArchiveHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t nameTableSize;
+};
+
+struct ShaderArchiveEntry
+{
+	uint32_t nameOffset;											// Into the name table
+	uint32_t nameLength;
+	uint64_t offset;												// From the start of the file
+	uint64_t size;													// Bytes of SPIR-V
+};
+
+
+// Many SPIR-V modules behind one open & one map - lookups return pointers into the mapping
+class ShaderArchive
+{
+public:
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return file.isOpen(); }
+	bool find(const std::string& name, const uint32_t*& code, size_t& size) const;
+	uint32_t moduleCount() const { return (uint32_t)index.size(); }
+
+	static bool write(const std::string& path, const std::vector<std::string>& names, const std::vector<std::vector<uint8_t>>& modules);
+	static bool isSpirv(const uint8_t* data, size_t size);
+
+private:
+	MappedFile file;
+	std::unordered_map <std::string, ShaderArchiveEntry> index;
+};
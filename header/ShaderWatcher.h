@@ -0,0 +1,55 @@
+// Vulkan Renderer - Shader Hot Reload
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <filesystem>
+
+
+#define SHADER_WATCH_POLL_MS 100									// Wake interval to notice stop() & poll timestamps
+
+
+// Watches GLSL sources, recompiles them to SPIR-V on its own thread and hands the result to a callback
+class ShaderWatcher
+{
+public:
+	typedef std::function<void(const std::string& spvPath, std::vector<uint32_t>&& code)> ReloadCallback;
+
+	~ShaderWatcher() { stop(); }
+
+	void addSource(const std::string& sourcePath, const std::string& spvPath);
+	void start(const std::string& directory, ReloadCallback callback);
+	void stop();
+
+	bool isRunning() const { return running; }
+	static bool compile(const std::string& sourcePath, std::vector<uint32_t>& code, std::string& log);
+
+private:
+	struct ShaderSource
+	{
+		std::string source;
+		std::string spv;
+		std::filesystem::file_time_type lastWrite;
+	};
+
+	std::vector <ShaderSource> sources;
+	std::mutex sources_mutex;
+	std::string watch_directory;
+	ReloadCallback on_reload;
+
+	std::thread watcher;
+	std::atomic<bool> running{ false };
+#ifdef __linux__
+	int inotify_fd = -1;
+#endif
+
+	void watchLoop();
+	void sourceChanged(const std::string& fileName);
+	void rebuild(ShaderSource& shader);
+};
@@ -0,0 +1,74 @@
+// Vulkan Renderer - Block Compressed Texture Container
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+
+#define TEXTURE_CONTAINER_MAGIC 0x58455452							// "RTEX"
+#define TEXTURE_CONTAINER_VERSION 1
+#define TEXTURE_CONTAINER_ALIGNMENT 16								// Every mip starts on this boundary
+#define TEXTURE_CONTAINER_EXTENSION ".rtex"
+#define TEXTURE_MAX_SOURCE_SIZE 16384								// Decoded source images larger than this are rejected
+
+
+// File layout: header | mips[mipCount] | padding | mip data, finest first
+struct TextureContainerHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;												// VkFormat - BC1 for opaque images, BC3 with alpha
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipCount;
+};
+
+struct TextureContainerMip
+{
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;												// From the start of the file
+	uint64_t size;
+};
+
+
+// Mip chain ready for vkCmdCopyBufferToImage - mapped from an .rtex file or built in memory from a source image
+class TextureContainer
+{
+public:
+	bool open(const std::string& path);
+	bool load(std::vector<uint8_t>&& bytes);						// Takes a container built by encode
+	void close();
+
+	bool isOpen() const { return bytes != nullptr; }
+	VkFormat format() const { return (VkFormat)header.format; }
+	uint32_t width() const { return header.width; }
+	uint32_t height() const { return header.height; }
+	uint32_t mipCount() const { return header.mipCount; }
+	const TextureContainerMip& mip(uint32_t level) const { return mips[level]; }
+	const uint8_t* mipData(uint32_t level) const { return bytes + mips[level].offset; }
+
+	// Source images - uncompressed or RLE TGA & binary PPM, decoded to tightly packed RGBA8
+	static bool decodeImage(const std::string& path, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height);
+	static bool encode(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, std::vector<uint8_t>& container);	// Full mip chain
+	static bool write(const std::string& path, const std::vector<uint8_t>& container);
+	static uint32_t blockBytes(VkFormat format);					// 0 - not a format the container holds
+	static bool isContainer(const std::string& path);
+
+private:
+	MappedFile file;
+	std::vector <uint8_t> memory;
+	const uint8_t* bytes = nullptr;
+	size_t byte_count = 0;
+	TextureContainerHeader header{};
+	std::vector <TextureContainerMip> mips;
+
+	bool parse(const std::string& name);
+};
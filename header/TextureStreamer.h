@@ -0,0 +1,147 @@
+// Vulkan Renderer - Texture Streamer
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "MemoryAllocator.h"
+#include "DescriptorManager.h"
+#include "TextureContainer.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+#define TEXTURE_STAGING_BUDGET (8ull * 1024 * 1024)					// Upload bytes recorded per frame
+#define TEXTURE_MEMORY_BUDGET (512ull * 1024 * 1024)				// Device memory for resident mips
+#define TEXTURE_TAIL_SIZE 64										// Mips this size & smaller become resident as soon as the texture loads
+#define TEXTURE_DEMAND_FRAMES 120									// Unrequested this long - fine mips are first to go under memory pressure
+#define TEXTURE_STAGING_ALIGNMENT 16
+#define TEXTURE_HANDLE_NONE UINT32_MAX
+
+
+typedef uint32_t TextureHandle;
+
+
+struct TextureStreamStats
+{
+	uint32_t loading = 0;										// Queued or decoding on a worker
+	uint32_t resident = 0;										// Textures with at least their tail resident
+	uint32_t failed = 0;
+	VkDeviceSize residentBytes = 0;								// Including images still being uploaded
+	VkDeviceSize uploadedBytes = 0;								// Since resetStats
+	uint64_t promotions = 0;									// Finer mip made resident
+	uint64_t evictions = 0;										// Fine mips dropped for the memory budget
+};
+
+
+// Streams block compressed textures into bindless slots
+//
+// Files decode on worker threads - .rtex containers are only mapped & validated, TGA & PPM sources are
+// mip mapped & BC encoded first. The render thread never waits on a worker: finished loads are picked up
+// by beginFrame, and uploads are cut to the per frame staging budget, splitting large mips across frames.
+//
+// A texture starts with its mip tail resident and gains one finer mip at a time while something requests
+// it. Each change builds a new image holding the new mip range and swaps its bindless slot in once fully
+// uploaded, so the index from getIndex changes - fetch it every frame. When the memory budget is hit, the
+// least recently requested textures drop their finest mips.
+class TextureStreamer
+{
+public:
+	void init(VkDevice logicalDevice, MemoryAllocator* memoryAllocator, DescriptorManager* descriptors, MemoryRing* stagingRing,
+		VkBuffer stagingBuffer, uint32_t framesInFlight, VkDeviceSize stagingBudget, VkDeviceSize memoryBudget, uint32_t decodeThreads, bool blockCompression);
+	void destroy();													// Device idle
+
+	TextureHandle load(const std::string& path, bool srgb = true);	// Returns at once - srgb only applies to decoded sources
+	void requestMip(TextureHandle handle, uint32_t mip);			// Finest mip needed this frame - call every frame it is visible
+	void requestScreenSize(TextureHandle handle, float screenPixels);	// Projected size of the texture's larger side in pixels
+	uint32_t getIndex(TextureHandle handle) const;				// Bindless index for the frame being recorded - BINDLESS_INDEX_NONE until loaded
+	uint32_t getResidentMip(TextureHandle handle) const;
+	bool isLoaded(TextureHandle handle) const;
+
+	void beginFrame(uint64_t frameNumber);							// After the ring slot's fence wait
+	void recordUploads(VkCommandBuffer command_buffer);				// Graphics queue, outside any render pass
+	void endFrame();												// After the frame is submitted
+
+	const TextureStreamStats& getStats() const { return stats; }
+	void resetStats() { stats.uploadedBytes = 0; stats.promotions = 0; stats.evictions = 0; }
+	VkSampler getSampler() const { return sampler; }
+
+private:
+	enum TextureState { TEXTURE_LOADING, TEXTURE_READY, TEXTURE_FAILED };
+
+	// Image for a mip range - levels [firstMip, container mip count)
+	struct MipImage
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		MemoryAllocation allocation;
+		uint32_t firstMip = 0;
+		uint32_t index = BINDLESS_INDEX_NONE;
+	};
+
+	struct Texture
+	{
+		std::string path;
+		bool srgb = true;
+		TextureState state = TEXTURE_LOADING;
+		std::unique_ptr <TextureContainer> container;
+		uint32_t tailMip = 0;
+
+		MipImage current;											// What shaders sample - firstMip == mip count before the tail lands
+		MipImage incoming;											// Being uploaded - swapped in once complete
+		bool uploading = false;
+		uint32_t uploadLevel = 0;									// Next container level to copy into incoming
+		uint32_t uploadRow = 0;										// Next block row of that level
+
+		uint32_t requestedMip = UINT32_MAX;
+		uint64_t requestFrame = 0;
+	};
+
+	struct RetiredImage
+	{
+		MipImage image;
+		uint64_t frameNumber;
+	};
+
+	struct DecodedTexture
+	{
+		TextureHandle handle;
+		std::unique_ptr <TextureContainer> container;				// Null when the load failed
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	MemoryAllocator* allocator = nullptr;
+	DescriptorManager* descriptorManager = nullptr;
+	MemoryRing* staging_ring = nullptr;
+	VkBuffer staging_buffer = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	uint32_t frames_in_flight = 0;
+	VkDeviceSize staging_budget = TEXTURE_STAGING_BUDGET;
+	VkDeviceSize memory_budget = TEXTURE_MEMORY_BUDGET;
+	uint64_t frame_number = 0;
+	bool block_compression = false;								// textureCompressionBC enabled
+
+	std::vector <std::unique_ptr<Texture>> textures;
+	std::vector <RetiredImage> retired;
+	std::unique_ptr <ThreadPool> decodePool;
+	std::atomic <bool> stopping{ false };
+	std::mutex decoded_mutex;
+	std::vector <DecodedTexture> decoded;							// Finished on workers, picked up by beginFrame
+	TextureStreamStats stats;
+
+	uint32_t desiredMip(const Texture& texture) const;
+	VkDeviceSize imageBytes(const Texture& texture, uint32_t firstMip) const;
+	void createMipImage(Texture& texture, uint32_t firstMip, MipImage& image);
+	void retireImage(MipImage& image);
+	void destroyImage(MipImage& image);
+	bool makeRoom(VkDeviceSize bytes, const Texture* keep, VkCommandBuffer command_buffer);	// Start evictions until bytes fit the memory budget
+	void startUpload(Texture& texture, uint32_t firstMip, VkCommandBuffer command_buffer);
+	VkDeviceSize continueUpload(Texture& texture, VkCommandBuffer command_buffer, VkDeviceSize budget,
+		std::vector<VkImageMemoryBarrier>& finished);				// Returns the staging bytes used
+};
@@ -0,0 +1,94 @@
+// Vulkan Renderer - Worker Thread Pool
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <algorithm>
+
+
+// Fixed set of worker threads draining a FIFO job queue
+class ThreadPool
+{
+public:
+	// 0 threads - one per hardware thread, leaving the calling thread free
+	explicit ThreadPool(uint32_t threadCount = 0)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+		}
+
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			stopping = true;
+		}
+		queue_condition.notify_all();
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Queue a job - the future carries its result or exception
+	template <typename Function>
+	auto submit(Function job) -> std::future<decltype(job())>
+	{
+		typedef decltype(job()) Result;
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+		std::future<Result> result = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);
+			jobs.push([task]() { (*task)(); });
+		}
+		queue_condition.notify_one();
+		return result;
+	}
+
+	uint32_t threadCount() const { return (uint32_t)workers.size(); }
+
+private:
+	std::vector <std::thread> workers;
+	std::queue <std::function<void()>> jobs;
+	std::mutex queue_mutex;
+	std::condition_variable queue_condition;
+	bool stopping = false;
+
+	void workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(queue_mutex);
+				queue_condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping && jobs.empty())
+				{
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop();
+			}
+			job();
+		}
+	}
+};
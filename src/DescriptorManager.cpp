@@ -0,0 +1,391 @@
+// Vulkan Renderer - Descriptor Manager
+
+#include "DescriptorManager.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <iostream>
+
+
+bool DescriptorManager::init(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, bool bindless)
+{
+	device = logicalDevice;
+	frames_in_flight = framesInFlight;
+	transientPools.assign(framesInFlight, TransientPools{});
+	current_slot = 0;
+
+	if (!bindless)
+	{
+		createPlaceholderLayout();
+		return false;
+	}
+
+	// Update after bind descriptors have their own, usually far larger, limits
+	VkPhysicalDeviceDescriptorIndexingProperties indexing_properties{};
+	indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexing_properties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	textures = SlotTable{};
+	buffers = SlotTable{};
+	textures.capacity = std::min<uint32_t>({ BINDLESS_MAX_TEXTURES, indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages });
+	buffers.capacity = std::min<uint32_t>({ BINDLESS_MAX_BUFFERS, indexing_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+		indexing_properties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+	if (textures.capacity == 0 || buffers.capacity == 0)
+	{
+		std::cout << "[!] Descriptor manager - no update after bind descriptors available, bindless disabled" << std::endl;
+		createPlaceholderLayout();
+		return false;
+	}
+
+	// Partially bound - only slots that have been written are ever indexed
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	bindings[0].binding = BINDLESS_TEXTURE_BINDING;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = textures.capacity;
+	bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[1].binding = BINDLESS_BUFFER_BINDING;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = buffers.capacity;
+	bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+	VkDescriptorBindingFlags binding_flags[2] = {};
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		binding_flags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{};
+	binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	binding_flags_info.bindingCount = 2;
+	binding_flags_info.pBindingFlags = binding_flags;
+
+	VkDescriptorSetLayoutCreateInfo set_layout_create_info{};
+	set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_create_info.pNext = &binding_flags_info;
+	set_layout_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	set_layout_create_info.bindingCount = 2;
+	set_layout_create_info.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &set_layout_create_info, nullptr, &bindlessLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create bindless descriptor set layout!");
+		std::exit(-1);
+	}
+
+	VkDescriptorPoolSize pool_sizes[2] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textures.capacity },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers.capacity } };
+
+	VkDescriptorPoolCreateInfo pool_create_info{};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	pool_create_info.maxSets = 1;
+	pool_create_info.poolSizeCount = 2;
+	pool_create_info.pPoolSizes = pool_sizes;
+
+	if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &bindlessPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create bindless descriptor pool!");
+		std::exit(-1);
+	}
+
+	VkDescriptorSetAllocateInfo set_alloc_info{};
+	set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_alloc_info.descriptorPool = bindlessPool;
+	set_alloc_info.descriptorSetCount = 1;
+	set_alloc_info.pSetLayouts = &bindlessLayout;
+
+	if (vkAllocateDescriptorSets(device, &set_alloc_info, &bindlessSet) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to allocate bindless descriptor set!");
+		std::exit(-1);
+	}
+
+	return true;
+}
+
+
+void DescriptorManager::destroy()
+{
+	for (TransientPools& frame : transientPools)
+	{
+		for (VkDescriptorPool pool : frame.pools)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+	}
+	transientPools.clear();
+
+	// Sets are freed with their pool
+	vkDestroyDescriptorPool(device, bindlessPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, bindlessLayout, nullptr);
+	bindlessPool = VK_NULL_HANDLE;
+	bindlessLayout = VK_NULL_HANDLE;
+	bindlessSet = VK_NULL_HANDLE;
+	textures = SlotTable{};
+	buffers = SlotTable{};
+}
+
+
+uint32_t DescriptorManager::addTexture(VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+	std::lock_guard<std::mutex> lock(bindless_mutex);
+	uint32_t index = acquireSlot(textures);
+	if (index == BINDLESS_INDEX_NONE)
+	{
+		return BINDLESS_INDEX_NONE;
+	}
+
+	VkDescriptorImageInfo image_info{};
+	image_info.sampler = sampler;
+	image_info.imageView = view;
+	image_info.imageLayout = layout;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = bindlessSet;
+	write.dstBinding = BINDLESS_TEXTURE_BINDING;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image_info;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+	return index;
+}
+
+
+uint32_t DescriptorManager::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	std::lock_guard<std::mutex> lock(bindless_mutex);
+	uint32_t index = acquireSlot(buffers);
+	if (index == BINDLESS_INDEX_NONE)
+	{
+		return BINDLESS_INDEX_NONE;
+	}
+
+	VkDescriptorBufferInfo buffer_info{};
+	buffer_info.buffer = buffer;
+	buffer_info.offset = offset;
+	buffer_info.range = range;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = bindlessSet;
+	write.dstBinding = BINDLESS_BUFFER_BINDING;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &buffer_info;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+	return index;
+}
+
+
+// Rewriting a slot a pending frame reads is not allowed - callers swap to a new slot & remove the old one instead
+void DescriptorManager::updateTexture(uint32_t index, VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+	std::lock_guard<std::mutex> lock(bindless_mutex);
+	if (index >= textures.next)
+	{
+		return;
+	}
+
+	VkDescriptorImageInfo image_info{};
+	image_info.sampler = sampler;
+	image_info.imageView = view;
+	image_info.imageLayout = layout;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = bindlessSet;
+	write.dstBinding = BINDLESS_TEXTURE_BINDING;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image_info;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+
+void DescriptorManager::removeTexture(uint32_t index, uint64_t frameNumber)
+{
+	std::lock_guard<std::mutex> lock(bindless_mutex);
+	retireSlot(textures, index, frameNumber);
+}
+
+
+void DescriptorManager::removeStorageBuffer(uint32_t index, uint64_t frameNumber)
+{
+	std::lock_guard<std::mutex> lock(bindless_mutex);
+	retireSlot(buffers, index, frameNumber);
+}
+
+
+void DescriptorManager::beginFrame(uint32_t slot, uint64_t frameNumber)
+{
+	// Every set handed out from this slot belonged to the frame whose fence just signaled
+	current_slot = slot;
+	TransientPools& frame = transientPools[slot];
+	for (uint32_t i = 0; i < frame.pools.size() && i <= frame.current; i++)
+	{
+		vkResetDescriptorPool(device, frame.pools[i], 0);
+	}
+	frame.current = 0;
+
+	if (bindlessSet != VK_NULL_HANDLE)
+	{
+		std::lock_guard<std::mutex> lock(bindless_mutex);
+		releaseSlots(textures, frameNumber);
+		releaseSlots(buffers, frameNumber);
+	}
+}
+
+
+// Linear - never freed individually, a full pool moves on to the next one in the chain
+VkDescriptorSet DescriptorManager::allocateTransient(VkDescriptorSetLayout layout)
+{
+	TransientPools& frame = transientPools[current_slot];
+
+	VkDescriptorSetAllocateInfo set_alloc_info{};
+	set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_alloc_info.descriptorSetCount = 1;
+	set_alloc_info.pSetLayouts = &layout;
+
+	while (true)
+	{
+		bool fresh_pool = frame.current == frame.pools.size();
+		if (fresh_pool)
+		{
+			frame.pools.push_back(createTransientPool());
+		}
+
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		set_alloc_info.descriptorPool = frame.pools[frame.current];
+		VkResult result = vkAllocateDescriptorSets(device, &set_alloc_info, &set);
+		if (result == VK_SUCCESS)
+		{
+			return set;
+		}
+
+		// A set an empty pool cannot hold never fits - the layout asks for more than TRANSIENT_POOL_DESCRIPTORS
+		if (fresh_pool || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL))
+		{
+			throw std::runtime_error("[!] Failed to allocate transient descriptor set!");
+			std::exit(-1);
+		}
+		frame.current++;
+	}
+}
+
+
+void DescriptorManager::bindBindless(VkCommandBuffer command_buffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout) const
+{
+	if (bindlessSet != VK_NULL_HANDLE)
+	{
+		vkCmdBindDescriptorSets(command_buffer, bindPoint, layout, BINDLESS_SET, 1, &bindlessSet, 0, nullptr);
+	}
+}
+
+
+uint32_t DescriptorManager::transientPoolCount() const
+{
+	uint32_t count = 0;
+	for (const TransientPools& frame : transientPools)
+	{
+		count += (uint32_t)frame.pools.size();
+	}
+	return count;
+}
+
+
+uint32_t DescriptorManager::acquireSlot(SlotTable& table)
+{
+	if (!table.freeSlots.empty())
+	{
+		uint32_t index = table.freeSlots.back();
+		table.freeSlots.pop_back();
+		return index;
+	}
+	if (table.next < table.capacity)
+	{
+		return table.next++;
+	}
+
+	std::cout << "[!] Descriptor manager - bindless table full (" << table.capacity << " slots)" << std::endl;
+	return BINDLESS_INDEX_NONE;
+}
+
+
+void DescriptorManager::retireSlot(SlotTable& table, uint32_t index, uint64_t frameNumber)
+{
+	if (index < table.next)
+	{
+		table.retiredSlots.push_back({ index, frameNumber });
+	}
+}
+
+
+// Same rule as retired swap chains - frameNumber + framesInFlight frames submitted means its fence has signaled
+void DescriptorManager::releaseSlots(SlotTable& table, uint64_t frameNumber)
+{
+	for (size_t i = 0; i < table.retiredSlots.size(); )
+	{
+		if (frameNumber < table.retiredSlots[i].second + frames_in_flight)
+		{
+			i++;
+			continue;
+		}
+		table.freeSlots.push_back(table.retiredSlots[i].first);
+		table.retiredSlots[i] = table.retiredSlots.back();
+		table.retiredSlots.pop_back();
+	}
+}
+
+
+// Set 0 stays in every pipeline layout so the sets after it keep their numbers with or without bindless
+void DescriptorManager::createPlaceholderLayout()
+{
+	VkDescriptorSetLayoutCreateInfo set_layout_create_info{};
+	set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_create_info.bindingCount = 0;
+
+	if (vkCreateDescriptorSetLayout(device, &set_layout_create_info, nullptr, &bindlessLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create placeholder descriptor set layout!");
+		std::exit(-1);
+	}
+}
+
+
+VkDescriptorPool DescriptorManager::createTransientPool()
+{
+	VkDescriptorPoolSize pool_sizes[] = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, TRANSIENT_POOL_DESCRIPTORS },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, TRANSIENT_POOL_DESCRIPTORS },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, TRANSIENT_POOL_DESCRIPTORS },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, TRANSIENT_POOL_DESCRIPTORS },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, TRANSIENT_POOL_DESCRIPTORS } };
+
+	// No FREE_DESCRIPTOR_SET_BIT - the pool is only ever reset as a whole, which lets the driver allocate linearly
+	VkDescriptorPoolCreateInfo pool_create_info{};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.maxSets = TRANSIENT_POOL_SETS;
+	pool_create_info.poolSizeCount = (uint32_t)(sizeof(pool_sizes) / sizeof(pool_sizes[0]));
+	pool_create_info.pPoolSizes = pool_sizes;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create transient descriptor pool!");
+		std::exit(-1);
+	}
+	return pool;
+}
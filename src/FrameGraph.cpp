@@ -0,0 +1,673 @@
+// Vulkan Renderer - Frame Graph
+
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <iostream>
+
+
+// Barrier inputs for one kind of access
+struct FrameGraphAccessInfo
+{
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkImageLayout layout;
+	VkImageUsageFlags usage;									// What a transient image needs for it
+	bool write;
+};
+
+
+static FrameGraphAccessInfo accessInfo(FrameGraphAccess access, bool compute)
+{
+	VkPipelineStageFlags shader_stages = compute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+		: VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+	switch (access)
+	{
+	case FrameGraphAccess::ColorAttachment:
+		return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true };
+	case FrameGraphAccess::DepthAttachment:
+		return { depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true };
+	case FrameGraphAccess::DepthRead:
+		return { depth_stages | shader_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, false };
+	case FrameGraphAccess::Sampled:
+		return { shader_stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+	case FrameGraphAccess::StorageRead:
+		return { shader_stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false };
+	case FrameGraphAccess::StorageWrite:
+		return { shader_stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true };
+	case FrameGraphAccess::Uniform:
+		return { shader_stages, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, false };
+	case FrameGraphAccess::IndirectRead:
+		return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, false };
+	case FrameGraphAccess::VertexRead:
+		return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, false };
+	case FrameGraphAccess::TransferRead:
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false };
+	case FrameGraphAccess::TransferWrite:
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true };
+	case FrameGraphAccess::Present:
+		return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, false };
+	case FrameGraphAccess::HostRead:
+		return { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, 0, false };
+	default:
+		return { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, false };
+	}
+}
+
+
+void FrameGraph::init(VkDevice logicalDevice, MemoryAllocator* memoryAllocator, uint32_t framesInFlight, bool asyncCompute)
+{
+	device = logicalDevice;
+	allocator = memoryAllocator;
+	frames_in_flight = framesInFlight;
+	async_compute = asyncCompute;
+	frame_number = 0;
+	transient_signature = 0;
+}
+
+
+// Device idle - nothing in flight may still use the transient images
+void FrameGraph::destroy()
+{
+	retireTransients();
+	for (RetiredTransients& entry : retired)
+	{
+		for (PhysicalImage& image : entry.images)
+		{
+			vkDestroyImageView(device, image.view, nullptr);
+			vkDestroyImage(device, image.image, nullptr);
+		}
+		for (MemoryBlock& block : entry.blocks)
+		{
+			allocator->free(block.allocation);
+		}
+	}
+	retired.clear();
+	resources.clear();
+	passes.clear();
+}
+
+
+void FrameGraph::reset(uint64_t frameNumber)
+{
+	frame_number = frameNumber;
+	resources.clear();
+	passes.clear();
+
+	// Transients replaced by a recompile are freed once the last frame that used them has retired
+	for (size_t i = 0; i < retired.size(); )
+	{
+		if (frameNumber < retired[i].frameNumber + frames_in_flight)
+		{
+			i++;
+			continue;
+		}
+		for (PhysicalImage& image : retired[i].images)
+		{
+			vkDestroyImageView(device, image.view, nullptr);
+			vkDestroyImage(device, image.image, nullptr);
+		}
+		for (MemoryBlock& block : retired[i].blocks)
+		{
+			allocator->free(block.allocation);
+		}
+		retired.erase(retired.begin() + i);
+	}
+}
+
+
+FrameGraphResource FrameGraph::importImage(const char* name, VkImage image, VkImageAspectFlags aspect, VkPipelineStageFlags readyStages, FrameGraphAccess finalAccess)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.finalAccess = finalAccess;
+	resource.image = image;
+	resource.aspect = aspect;
+	resource.physical = FRAME_GRAPH_NONE;
+
+	// The first barrier waits on readyStages - chains onto e.g. the acquire semaphore's wait stage
+	resource.state.writeStages = readyStages;
+	resource.state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	resources.push_back(resource);
+	return (FrameGraphResource)(resources.size() - 1);
+}
+
+
+FrameGraphResource FrameGraph::importBuffer(const char* name, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, FrameGraphAccess finalAccess)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = false;
+	resource.finalAccess = finalAccess;
+	resource.buffer = buffer;
+	resource.offset = offset;
+	resource.size = size;
+	resource.physical = FRAME_GRAPH_NONE;
+
+	resources.push_back(resource);
+	return (FrameGraphResource)(resources.size() - 1);
+}
+
+
+FrameGraphResource FrameGraph::createImage(const char* name, const FrameGraphImageDesc& desc)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.transient = true;
+	resource.finalAccess = FrameGraphAccess::None;
+	resource.aspect = desc.aspect;
+	resource.desc = desc;
+	resource.physical = FRAME_GRAPH_NONE;
+
+	resources.push_back(resource);
+	return (FrameGraphResource)(resources.size() - 1);
+}
+
+
+uint32_t FrameGraph::addPass(const char* name, FrameGraphQueue queue, FrameGraphExecute execute)
+{
+	Pass pass{};
+	pass.name = name;
+	pass.compute = queue == FrameGraphQueue::Compute;
+	pass.queue = async_compute ? (uint32_t)queue : (uint32_t)FrameGraphQueue::Graphics;
+	pass.execute = execute;
+
+	passes.push_back(std::move(pass));
+	return (uint32_t)(passes.size() - 1);
+}
+
+
+void FrameGraph::use(uint32_t pass, FrameGraphResource resource, FrameGraphAccess access)
+{
+	passes[pass].uses.push_back({ resource, access });
+}
+
+
+void FrameGraph::setSideEffects(uint32_t pass)
+{
+	passes[pass].sideEffects = true;
+}
+
+
+void FrameGraph::markOutput(FrameGraphResource resource)
+{
+	resources[resource].output = true;
+}
+
+
+void FrameGraph::compile()
+{
+	stats.passCount = (uint32_t)passes.size();
+	stats.culledPasses = 0;
+	stats.barrierCount = 0;
+	for (uint32_t queue = 0; queue < FRAME_GRAPH_QUEUE_COUNT; queue++)
+	{
+		tails[queue] = BarrierBatch{};
+		wait_stages[queue] = 0;
+		queue_work[queue] = false;
+	}
+
+	cullPasses();
+	allocateTransients();
+	buildBarriers();
+}
+
+
+// Walks back from the outputs - a pass lives if a live pass or an output needs something it writes
+void FrameGraph::cullPasses()
+{
+	std::vector <bool> needed(resources.size(), false);
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		needed[i] = resources[i].output || resources[i].finalAccess != FrameGraphAccess::None;
+	}
+
+	for (size_t p = passes.size(); p-- > 0; )
+	{
+		Pass& pass = passes[p];
+		pass.live = pass.sideEffects;
+		for (const ResourceUse& use : pass.uses)
+		{
+			if (needed[use.resource] && accessInfo(use.access, pass.compute).write)
+			{
+				pass.live = true;
+			}
+		}
+
+		if (!pass.live)
+		{
+			stats.culledPasses++;
+			continue;
+		}
+
+		// Writes count too - an earlier writer may have produced what this pass only partly overwrites
+		for (const ResourceUse& use : pass.uses)
+		{
+			needed[use.resource] = true;
+		}
+	}
+}
+
+
+// Greedy interval packing - largest images first, each into the first block none of whose occupants overlap it
+void FrameGraph::allocateTransients()
+{
+	std::vector <uint32_t> transients;
+	for (uint32_t r = 0; r < resources.size(); r++)
+	{
+		Resource& resource = resources[r];
+		resource.firstPass = FRAME_GRAPH_NONE;
+		resource.lastPass = 0;
+		resource.usage = 0;
+	}
+
+	for (uint32_t p = 0; p < passes.size(); p++)
+	{
+		if (!passes[p].live)
+		{
+			continue;
+		}
+		for (const ResourceUse& use : passes[p].uses)
+		{
+			Resource& resource = resources[use.resource];
+			if (!resource.transient)
+			{
+				continue;
+			}
+			if (passes[p].queue != (uint32_t)FrameGraphQueue::Graphics)
+			{
+				throw std::runtime_error("[!] Frame graph - transient images must stay on the graphics queue.");
+				std::exit(-1);
+			}
+			if (resource.firstPass == FRAME_GRAPH_NONE)
+			{
+				resource.firstPass = p;
+				transients.push_back(use.resource);
+			}
+			resource.lastPass = p;
+			resource.usage |= accessInfo(use.access, passes[p].compute).usage;
+		}
+	}
+
+	// Same images & lifetimes as last compile - keep the physical images, their memory & barrier state
+	uint64_t signature = 0xcbf29ce484222325ull;
+	auto mix = [&signature](uint64_t value) { signature = (signature ^ value) * 0x100000001b3ull; };
+	for (uint32_t r : transients)
+	{
+		const Resource& resource = resources[r];
+		mix(resource.desc.format);
+		mix(((uint64_t)resource.desc.extent.width << 32) | resource.desc.extent.height);
+		mix(resource.desc.aspect);
+		mix(resource.usage);
+		mix(((uint64_t)resource.firstPass << 32) | resource.lastPass);
+	}
+	mix(transients.size());
+
+	if (signature != transient_signature)
+	{
+		retireTransients();
+		transient_signature = signature;
+
+		for (uint32_t r : transients)
+		{
+			const Resource& resource = resources[r];
+
+			VkImageCreateInfo image_create_info{};
+			image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			image_create_info.imageType = VK_IMAGE_TYPE_2D;
+			image_create_info.format = resource.desc.format;
+			image_create_info.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+			image_create_info.mipLevels = 1;
+			image_create_info.arrayLayers = 1;
+			image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+			image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+			image_create_info.usage = resource.usage;
+			image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			PhysicalImage physical{};
+			physical.desc = resource.desc;
+			physical.usage = resource.usage;
+			physical.block = FRAME_GRAPH_NONE;
+			if (vkCreateImage(device, &image_create_info, nullptr, &physical.image) != VK_SUCCESS)
+			{
+				throw std::runtime_error("[!] Frame graph - failed to create transient image.");
+				std::exit(-1);
+			}
+			vkGetImageMemoryRequirements(device, physical.image, &physical.requirements);
+			physicalImages.push_back(physical);
+		}
+
+		std::vector <uint32_t> order(transients.size());
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+			return physicalImages[a].requirements.size > physicalImages[b].requirements.size;
+		});
+
+		for (uint32_t i : order)
+		{
+			PhysicalImage& physical = physicalImages[i];
+			const Resource& resource = resources[transients[i]];
+
+			for (uint32_t b = 0; b < memoryBlocks.size() && physical.block == FRAME_GRAPH_NONE; b++)
+			{
+				MemoryBlock& block = memoryBlocks[b];
+				if (!(block.memoryTypeBits & physical.requirements.memoryTypeBits))
+				{
+					continue;
+				}
+
+				bool overlaps = false;
+				for (const std::pair<uint32_t, uint32_t>& lifetime : block.lifetimes)
+				{
+					overlaps = overlaps || (resource.firstPass <= lifetime.second && lifetime.first <= resource.lastPass);
+				}
+				if (!overlaps)
+				{
+					physical.block = b;
+				}
+			}
+
+			if (physical.block == FRAME_GRAPH_NONE)
+			{
+				MemoryBlock block{};
+				block.memoryTypeBits = physical.requirements.memoryTypeBits;
+				physical.block = (uint32_t)memoryBlocks.size();
+				memoryBlocks.push_back(block);
+			}
+
+			MemoryBlock& block = memoryBlocks[physical.block];
+			block.size = std::max(block.size, physical.requirements.size);
+			block.alignment = std::max(block.alignment, physical.requirements.alignment);
+			block.memoryTypeBits &= physical.requirements.memoryTypeBits;
+			block.lifetimes.push_back({ resource.firstPass, resource.lastPass });
+		}
+
+		MemoryAllocationCreateInfo memory_info{};
+		memory_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		memory_info.optimalImage = true;
+		for (MemoryBlock& block : memoryBlocks)
+		{
+			VkMemoryRequirements requirements{ block.size, block.alignment, block.memoryTypeBits };
+			block.allocation = allocator->allocate(requirements, memory_info);
+		}
+
+		stats = FrameGraphStats{ stats.passCount, stats.culledPasses, 0, (uint32_t)physicalImages.size(), (uint32_t)memoryBlocks.size(), 0, 0 };
+		for (PhysicalImage& physical : physicalImages)
+		{
+			const MemoryAllocation& allocation = memoryBlocks[physical.block].allocation;
+			vkBindImageMemory(device, physical.image, allocation.memory, allocation.offset);
+			stats.transientBytes += physical.requirements.size;
+
+			VkImageViewCreateInfo view_create_info{};
+			view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_create_info.image = physical.image;
+			view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			view_create_info.format = physical.desc.format;
+			view_create_info.subresourceRange = { physical.desc.aspect, 0, 1, 0, 1 };
+			if (vkCreateImageView(device, &view_create_info, nullptr, &physical.view) != VK_SUCCESS)
+			{
+				throw std::runtime_error("[!] Frame graph - failed to create transient image view.");
+				std::exit(-1);
+			}
+		}
+		for (const MemoryBlock& block : memoryBlocks)
+		{
+			stats.memoryBytes += block.size;
+		}
+
+		if (!physicalImages.empty())
+		{
+			std::cout << "[*] Frame graph - " << stats.transientImages << " transient images in " << stats.memoryBlocks << " memory blocks ("
+				<< stats.memoryBytes / 1024 << " KB, " << stats.transientBytes / 1024 << " KB unaliased)" << std::endl;
+		}
+	}
+
+	for (uint32_t i = 0; i < transients.size(); i++)
+	{
+		resources[transients[i]].physical = i;
+	}
+}
+
+
+// Frames still in flight may use them - freed by reset once those frames have retired
+void FrameGraph::retireTransients()
+{
+	if (!physicalImages.empty() || !memoryBlocks.empty())
+	{
+		retired.push_back({ std::move(physicalImages), std::move(memoryBlocks), frame_number });
+	}
+	physicalImages.clear();
+	memoryBlocks.clear();
+	transient_signature = 0;
+}
+
+
+void FrameGraph::buildBarriers()
+{
+	for (uint32_t p = 0; p < passes.size(); p++)
+	{
+		Pass& pass = passes[p];
+		pass.barriers = BarrierBatch{};
+		if (!pass.live)
+		{
+			continue;
+		}
+		queue_work[pass.queue] = true;
+
+		for (const ResourceUse& use : pass.uses)
+		{
+			useResource(pass, p, resources[use.resource], use.access);
+		}
+
+		// Undeclared outputs may feed any draw - wait for them before anything reads memory
+		if (pass.sideEffects && pass.queue == (uint32_t)FrameGraphQueue::Compute)
+		{
+			wait_stages[(uint32_t)FrameGraphQueue::Graphics] |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		}
+		stats.barrierCount += (uint32_t)(pass.barriers.imageBarriers.size() + pass.barriers.bufferBarriers.size());
+	}
+
+	// Imported resources leave in the state their owner expects
+	for (Resource& resource : resources)
+	{
+		if (resource.finalAccess == FrameGraphAccess::None || resource.state.queue == FRAME_GRAPH_NONE)
+		{
+			continue;
+		}
+
+		FrameGraphAccessInfo info = accessInfo(resource.finalAccess, false);
+		const ResourceState& state = resource.state;
+		addBarrier(tails[state.queue], resource, state.writeStages | state.readStages, state.writeAccess, state.layout,
+			info.stages, info.access, resource.isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+	for (uint32_t queue = 0; queue < FRAME_GRAPH_QUEUE_COUNT; queue++)
+	{
+		stats.barrierCount += (uint32_t)(tails[queue].imageBarriers.size() + tails[queue].bufferBarriers.size());
+	}
+}
+
+
+void FrameGraph::useResource(Pass& pass, uint32_t pass_index, Resource& resource, FrameGraphAccess access)
+{
+	FrameGraphAccessInfo info = accessInfo(access, pass.compute);
+	VkImageLayout layout = resource.isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+	ResourceState& state = resource.state;
+
+	// First use of a transient - the memory's last occupant is what must finish first, its contents are discarded
+	MemoryBlock* block = resource.transient ? &memoryBlocks[physicalImages[resource.physical].block] : nullptr;
+	if (block && pass_index == resource.firstPass)
+	{
+		state = block->state;
+		state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	// Produced on the other queue - the timeline wait orders it & makes it visible, no barrier needed here
+	if (state.queue != FRAME_GRAPH_NONE && state.queue != pass.queue)
+	{
+		if (pass.queue != (uint32_t)FrameGraphQueue::Graphics || resource.isImage)
+		{
+			throw std::runtime_error("[!] Frame graph - unsupported cross queue dependency.");
+			std::exit(-1);
+		}
+		wait_stages[pass.queue] |= info.stages;
+
+		state.writeStages = info.stages;
+		state.writeAccess = info.write ? info.access : 0;
+		state.readStages = info.write ? 0 : info.stages;
+		state.readAccess = info.write ? 0 : info.access;
+		state.queue = pass.queue;
+		return;
+	}
+
+	bool layout_change = resource.isImage && layout != state.layout;
+	if (info.write || layout_change)
+	{
+		// Write after write needs the memory dependency, write after read only the execution one
+		VkPipelineStageFlags src_stages = state.writeStages | state.readStages;
+		if (src_stages != 0 || layout_change)
+		{
+			addBarrier(pass.barriers, resource, src_stages, state.writeAccess, state.layout, info.stages, info.access, layout);
+		}
+
+		state.writeStages = info.stages;
+		state.writeAccess = info.write ? info.access : 0;
+		state.readStages = info.write ? 0 : info.stages;
+		state.readAccess = info.write ? 0 : info.access;
+		state.layout = layout;
+	}
+	else
+	{
+		// Read after read - only stages the last write hasn't been made visible to need a barrier
+		bool visible = (state.readStages & info.stages) == info.stages && (state.readAccess & info.access) == info.access;
+		if (state.writeStages != 0 && !visible)
+		{
+			addBarrier(pass.barriers, resource, state.writeStages, state.writeAccess, state.layout, info.stages, info.access, layout);
+		}
+		state.readStages |= info.stages;
+		state.readAccess |= info.access;
+	}
+	state.queue = pass.queue;
+
+	if (block)
+	{
+		block->state = state;
+	}
+}
+
+
+// Execution only dependencies just widen the stage masks
+void FrameGraph::addBarrier(BarrierBatch& batch, const Resource& resource, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkImageLayout oldLayout,
+	VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, VkImageLayout newLayout)
+{
+	batch.srcStages |= srcStages != 0 ? srcStages : (VkPipelineStageFlags)VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	batch.dstStages |= dstStages;
+
+	if (resource.isImage && (oldLayout != newLayout || srcAccess != 0))
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = getImage((FrameGraphResource)(&resource - resources.data()));
+		barrier.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+		batch.imageBarriers.push_back(barrier);
+	}
+	else if (!resource.isImage && srcAccess != 0)
+	{
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = resource.buffer;
+		barrier.offset = resource.offset;
+		barrier.size = resource.size;
+		batch.bufferBarriers.push_back(barrier);
+	}
+}
+
+
+void FrameGraph::recordBarriers(VkCommandBuffer command_buffer, const BarrierBatch& batch) const
+{
+	if (batch.srcStages == 0)
+	{
+		return;
+	}
+
+	vkCmdPipelineBarrier(command_buffer, batch.srcStages, batch.dstStages != 0 ? batch.dstStages : (VkPipelineStageFlags)VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, (uint32_t)batch.bufferBarriers.size(), batch.bufferBarriers.data(), (uint32_t)batch.imageBarriers.size(), batch.imageBarriers.data());
+}
+
+
+bool FrameGraph::hasWork(FrameGraphQueue queue) const
+{
+	return queue_work[(uint32_t)queue];
+}
+
+
+VkPipelineStageFlags FrameGraph::waitStages(FrameGraphQueue queue) const
+{
+	return wait_stages[(uint32_t)queue];
+}
+
+
+void FrameGraph::execute(FrameGraphQueue queue, VkCommandBuffer command_buffer, GpuProfiler* profiler)
+{
+	for (const Pass& pass : passes)
+	{
+		if (!pass.live || pass.queue != (uint32_t)queue)
+		{
+			continue;
+		}
+
+		recordBarriers(command_buffer, pass.barriers);
+		if (profiler)
+		{
+			GpuProfileScope scope(*profiler, command_buffer, pass.name);
+			pass.execute(command_buffer);
+		}
+		else
+		{
+			pass.execute(command_buffer);
+		}
+	}
+	recordBarriers(command_buffer, tails[(uint32_t)queue]);
+}
+
+
+VkImage FrameGraph::getImage(FrameGraphResource resource) const
+{
+	const Resource& entry = resources[resource];
+	if (entry.transient)
+	{
+		return entry.physical != FRAME_GRAPH_NONE ? physicalImages[entry.physical].image : VK_NULL_HANDLE;
+	}
+	return entry.image;
+}
+
+
+VkImageView FrameGraph::getImageView(FrameGraphResource resource) const
+{
+	const Resource& entry = resources[resource];
+	return entry.transient && entry.physical != FRAME_GRAPH_NONE ? physicalImages[entry.physical].view : VK_NULL_HANDLE;
+}
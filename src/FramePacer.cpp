@@ -0,0 +1,89 @@
+// Vulkan Renderer - Frame Pacing
+
+#include "FramePacer.h"
+
+#include <thread>
+#include <algorithm>
+
+
+void FramePacer::setTargetFps(double fps)
+{
+	target_fps = std::max(fps, 0.0);
+	has_deadline = false;
+}
+
+
+void FramePacer::setLowLatency(bool enabled)
+{
+	low_latency = enabled;
+	latency_delay_ms = 0.0;
+}
+
+
+void FramePacer::reset()
+{
+	has_deadline = false;
+	latency_delay_ms = 0.0;
+}
+
+
+double FramePacer::waitForFrameStart()
+{
+	if (!isActive())
+	{
+		return 0.0;
+	}
+
+	Clock::time_point start = Clock::now();
+	Clock::time_point deadline = start;
+
+	// Frame rate cap - deadlines advance by a fixed interval so sleep overshoot does not accumulate
+	if (target_fps > 0.0)
+	{
+		auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(1000.0 / target_fps));
+		if (!has_deadline || start - next_deadline > interval)
+		{
+			// First frame or fell more than a frame behind - restart the schedule instead of bursting to catch up
+			next_deadline = start;
+			has_deadline = true;
+		}
+		deadline = std::max(deadline, next_deadline);
+		next_deadline += interval;
+	}
+
+	// Low latency - the time the frame would spend blocked is spent here instead, before input is read
+	if (low_latency)
+	{
+		deadline = std::max(deadline, start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(latency_delay_ms)));
+	}
+
+	sleepUntil(deadline);
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+// Blocking still seen after the delay is slack - grow the delay towards it, shrink quickly once frames start to stall
+void FramePacer::recordBlockedTime(double ms)
+{
+	if (!low_latency)
+	{
+		return;
+	}
+
+	double slack = ms - FRAME_PACER_LATENCY_MARGIN_MS;
+	latency_delay_ms = std::max(0.0, latency_delay_ms + (slack > 0.0 ? slack * FRAME_PACER_LATENCY_GAIN : slack));
+}
+
+
+void FramePacer::sleepUntil(Clock::time_point deadline)
+{
+	auto spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(FRAME_PACER_SPIN_MS));
+	if (deadline - Clock::now() > spin)
+	{
+		std::this_thread::sleep_until(deadline - spin);
+	}
+	while (Clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+}
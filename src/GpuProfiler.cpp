@@ -0,0 +1,405 @@
+// Vulkan Renderer - GPU Profiler
+
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+#define PROFILER_STATISTICS (VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | \
+	VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT)
+#define PROFILER_STATISTIC_COUNT 6									// Bits set in PROFILER_STATISTICS - results come back in bit order
+
+
+bool GpuProfiler::init(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight, bool pipelineStatistics)
+{
+	device = logicalDevice;
+
+	// Timestamps are optional per queue family - zero valid bits means none are written
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &family_count, families.data());
+	uint32_t valid_bits = queueFamily < family_count ? families[queueFamily].timestampValidBits : 0;
+	if (valid_bits == 0)
+	{
+		std::cout << "[!] GPU profiler - queue family " << queueFamily << " has no timestamp support, profiling disabled" << std::endl;
+		return false;
+	}
+	timestamp_mask = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	timestamp_period = properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo timestamp_pool_info{};
+	timestamp_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	timestamp_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	timestamp_pool_info.queryCount = framesInFlight * PROFILER_MAX_SCOPES * 2;
+	if (vkCreateQueryPool(device, &timestamp_pool_info, nullptr, &timestampPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create timestamp query pool!");
+		std::exit(-1);
+	}
+
+	if (pipelineStatistics)
+	{
+		VkQueryPoolCreateInfo statistics_pool_info{};
+		statistics_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		statistics_pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		statistics_pool_info.queryCount = framesInFlight;
+		statistics_pool_info.pipelineStatistics = PROFILER_STATISTICS;
+		if (vkCreateQueryPool(device, &statistics_pool_info, nullptr, &statisticsPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("[!] Failed to create pipeline statistics query pool!");
+			std::exit(-1);
+		}
+	}
+
+	slots.assign(framesInFlight, FrameSlot());
+	for (FrameSlot& slot : slots)
+	{
+		slot.names.resize(PROFILER_MAX_SCOPES);
+		slot.depths.resize(PROFILER_MAX_SCOPES);
+	}
+	return true;
+}
+
+
+void GpuProfiler::destroy()
+{
+	if (statisticsPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, statisticsPool, nullptr);
+		statisticsPool = VK_NULL_HANDLE;
+	}
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, timestampPool, nullptr);
+		timestampPool = VK_NULL_HANDLE;
+	}
+	slots.clear();
+}
+
+
+void GpuProfiler::beginFrame(VkCommandBuffer command_buffer, uint32_t slot, uint64_t frameNumber)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	// The fence for this slot has signaled, so its queries are complete - read them before the reset below
+	resolve(slot);
+
+	current_slot = slot;
+	FrameSlot& frame = slots[slot];
+	frame.frameNumber = frameNumber;
+	frame.scopeCount = 0;
+	frame.depth = 0;
+	frame.statistics = false;
+	frame.pending = true;
+
+	vkCmdResetQueryPool(command_buffer, timestampPool, slot * PROFILER_MAX_SCOPES * 2, PROFILER_MAX_SCOPES * 2);
+	if (statisticsPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(command_buffer, statisticsPool, slot, 1);
+	}
+}
+
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer command_buffer, const char* name)
+{
+	if (!isEnabled() || slots[current_slot].scopeCount == PROFILER_MAX_SCOPES)
+	{
+		return UINT32_MAX;
+	}
+
+	FrameSlot& frame = slots[current_slot];
+	uint32_t scope = frame.scopeCount++;
+	frame.names[scope] = name;
+	frame.depths[scope] = frame.depth++;
+
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, (current_slot * PROFILER_MAX_SCOPES + scope) * 2);
+	return scope;
+}
+
+
+// Bottom of pipe - the timestamp lands once every earlier command has finished
+void GpuProfiler::endScope(VkCommandBuffer command_buffer, uint32_t scope)
+{
+	if (scope == UINT32_MAX)
+	{
+		return;
+	}
+
+	slots[current_slot].depth--;
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, (current_slot * PROFILER_MAX_SCOPES + scope) * 2 + 1);
+}
+
+
+void GpuProfiler::beginStatistics(VkCommandBuffer command_buffer)
+{
+	if (statisticsPool == VK_NULL_HANDLE || !isEnabled())
+	{
+		return;
+	}
+	vkCmdBeginQuery(command_buffer, statisticsPool, current_slot, 0);
+	slots[current_slot].statistics = true;
+}
+
+
+void GpuProfiler::endStatistics(VkCommandBuffer command_buffer)
+{
+	if (statisticsPool == VK_NULL_HANDLE || !isEnabled() || !slots[current_slot].statistics)
+	{
+		return;
+	}
+	vkCmdEndQuery(command_buffer, statisticsPool, current_slot);
+}
+
+
+void GpuProfiler::recordCpuFrame(uint64_t frameNumber, std::chrono::steady_clock::time_point start, double cpuMs)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	CpuFrame cpu_frame;
+	cpu_frame.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+	cpu_frame.ms = cpuMs;
+	cpuFrames[frameNumber] = cpu_frame;
+
+	// Frames whose GPU half was dropped never claim their entry
+	while (cpuFrames.size() > slots.size() * 4)
+	{
+		cpuFrames.erase(cpuFrames.begin());
+	}
+}
+
+
+void GpuProfiler::collectAll()
+{
+	for (uint32_t slot = 0; slot < slots.size(); slot++)
+	{
+		resolve(slot);
+	}
+}
+
+
+void GpuProfiler::reset()
+{
+	frames.clear();
+	cpuFrames.clear();
+	dropped_frames = 0;
+}
+
+
+// Never waits - results that are not available yet are dropped rather than stalling the frame
+void GpuProfiler::resolve(uint32_t slot)
+{
+	FrameSlot& frame = slots[slot];
+	if (!frame.pending)
+	{
+		return;
+	}
+	frame.pending = false;
+
+	if (frame.scopeCount == 0)
+	{
+		return;
+	}
+
+	std::vector<uint64_t> timestamps(frame.scopeCount * 2);
+	VkResult result = vkGetQueryPoolResults(device, timestampPool, slot * PROFILER_MAX_SCOPES * 2, frame.scopeCount * 2,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		dropped_frames++;
+		return;
+	}
+
+	ProfiledFrame profiled;
+	profiled.frameNumber = frame.frameNumber;
+
+	// Scope 0 opens first & closes last, so it bounds the frame
+	uint64_t gpu_start = timestamps[0] & timestamp_mask;
+	for (uint32_t i = 0; i < frame.scopeCount; i++)
+	{
+		uint64_t begin = (timestamps[i * 2] & timestamp_mask) - gpu_start;
+		uint64_t end = (timestamps[i * 2 + 1] & timestamp_mask) - gpu_start;
+
+		ProfiledScope scope;
+		scope.name = frame.names[i];
+		scope.depth = frame.depths[i];
+		scope.beginMs = begin * timestamp_period / 1000000.0;
+		scope.endMs = end * timestamp_period / 1000000.0;
+		profiled.scopes.push_back(scope);
+		profiled.gpuMs = std::max(profiled.gpuMs, scope.endMs);
+	}
+	profiled.gpuStartNs = (uint64_t)(gpu_start * timestamp_period);
+
+	if (frame.statistics)
+	{
+		uint64_t values[PROFILER_STATISTIC_COUNT] = {};
+		if (vkGetQueryPoolResults(device, statisticsPool, slot, 1, sizeof(values), values, sizeof(values), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			profiled.hasStatistics = true;
+			profiled.statistics.inputAssemblyVertices = values[0];
+			profiled.statistics.inputAssemblyPrimitives = values[1];
+			profiled.statistics.vertexShaderInvocations = values[2];
+			profiled.statistics.clippingPrimitives = values[3];
+			profiled.statistics.fragmentShaderInvocations = values[4];
+			profiled.statistics.computeShaderInvocations = values[5];
+		}
+	}
+
+	auto cpu_frame = cpuFrames.find(frame.frameNumber);
+	if (cpu_frame != cpuFrames.end())
+	{
+		profiled.cpuStartNs = cpu_frame->second.startNs;
+		profiled.cpuMs = cpu_frame->second.ms;
+		cpuFrames.erase(cpu_frame);
+	}
+
+	frames.push_back(profiled);
+	if (frames.size() > PROFILER_MAX_HISTORY)
+	{
+		frames.pop_front();
+	}
+}
+
+
+void GpuProfiler::printSummary() const
+{
+	if (frames.empty())
+	{
+		std::cout << "[GPU Profiler] no frames resolved" << std::endl;
+		return;
+	}
+
+	double cpu_total = 0.0, gpu_total = 0.0, gpu_max = 0.0;
+	std::vector<std::string> scope_order;
+	std::map<std::string, std::pair<double, uint64_t>> scope_totals;
+	PipelineStatistics statistics_total;
+	uint64_t statistics_frames = 0;
+
+	for (const ProfiledFrame& frame : frames)
+	{
+		cpu_total += frame.cpuMs;
+		gpu_total += frame.gpuMs;
+		gpu_max = std::max(gpu_max, frame.gpuMs);
+		for (const ProfiledScope& scope : frame.scopes)
+		{
+			auto& total = scope_totals[scope.name];
+			if (total.second == 0)
+			{
+				scope_order.push_back(std::string(scope.depth * 2, ' ') + scope.name);
+			}
+			total.first += scope.endMs - scope.beginMs;
+			total.second++;
+		}
+		if (frame.hasStatistics)
+		{
+			statistics_total.inputAssemblyVertices += frame.statistics.inputAssemblyVertices;
+			statistics_total.inputAssemblyPrimitives += frame.statistics.inputAssemblyPrimitives;
+			statistics_total.vertexShaderInvocations += frame.statistics.vertexShaderInvocations;
+			statistics_total.clippingPrimitives += frame.statistics.clippingPrimitives;
+			statistics_total.fragmentShaderInvocations += frame.statistics.fragmentShaderInvocations;
+			statistics_total.computeShaderInvocations += frame.statistics.computeShaderInvocations;
+			statistics_frames++;
+		}
+	}
+
+	double count = (double)frames.size();
+	std::cout << "[GPU Profiler] frames: " << frames.size() << " | dropped: " << dropped_frames
+		<< std::fixed << std::setprecision(3)
+		<< " | cpu: " << cpu_total / count << " ms"
+		<< " | gpu: " << gpu_total / count << " ms (max " << gpu_max << " ms)" << std::endl;
+
+	for (const std::string& label : scope_order)
+	{
+		std::string name = label.substr(label.find_first_not_of(' '));
+		const auto& total = scope_totals.at(name);
+		std::cout << "[GPU Profiler]   " << std::left << std::setw(24) << label << std::right
+			<< total.first / total.second << " ms" << std::endl;
+	}
+
+	if (statistics_frames > 0)
+	{
+		double n = (double)statistics_frames;
+		std::cout << std::setprecision(0)
+			<< "[GPU Profiler] per frame - vertices: " << statistics_total.inputAssemblyVertices / n
+			<< " | primitives: " << statistics_total.inputAssemblyPrimitives / n
+			<< " | vs: " << statistics_total.vertexShaderInvocations / n
+			<< " | clipped prims: " << statistics_total.clippingPrimitives / n
+			<< " | fs: " << statistics_total.fragmentShaderInvocations / n
+			<< " | cs: " << statistics_total.computeShaderInvocations / n << std::endl;
+	}
+}
+
+
+// chrome://tracing & Perfetto - CPU frames on one track, GPU scopes on another
+bool GpuProfiler::exportChromeTrace(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "[!] GPU profiler - failed to write " << path << std::endl;
+		return false;
+	}
+
+	// The GPU clock has no fixed relation to the CPU clock - start the first GPU frame where its CPU frame was submitted
+	uint64_t base_ns = 0;
+	int64_t gpu_offset_ns = 0;
+	if (!frames.empty())
+	{
+		const ProfiledFrame& first = frames.front();
+		base_ns = first.cpuStartNs;
+		gpu_offset_ns = (int64_t)(first.cpuStartNs + (uint64_t)(first.cpuMs * 1000000.0)) - (int64_t)first.gpuStartNs;
+	}
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+	for (const ProfiledFrame& frame : frames)
+	{
+		if (frame.cpuStartNs != 0)
+		{
+			file << ",\n{\"name\":\"Frame " << frame.frameNumber << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+				<< ",\"ts\":" << (double)(int64_t)(frame.cpuStartNs - base_ns) / 1000.0
+				<< ",\"dur\":" << frame.cpuMs * 1000.0 << "}";
+		}
+
+		double gpu_ts = (double)((int64_t)frame.gpuStartNs + gpu_offset_ns - (int64_t)base_ns) / 1000.0;
+		for (const ProfiledScope& scope : frame.scopes)
+		{
+			file << ",\n{\"name\":\"" << scope.name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2"
+				<< ",\"ts\":" << gpu_ts + scope.beginMs * 1000.0
+				<< ",\"dur\":" << (scope.endMs - scope.beginMs) * 1000.0
+				<< ",\"args\":{\"frame\":" << frame.frameNumber;
+			if (scope.depth == 0 && frame.hasStatistics)
+			{
+				file << ",\"vertices\":" << frame.statistics.inputAssemblyVertices
+					<< ",\"primitives\":" << frame.statistics.inputAssemblyPrimitives
+					<< ",\"vs_invocations\":" << frame.statistics.vertexShaderInvocations
+					<< ",\"clipping_primitives\":" << frame.statistics.clippingPrimitives
+					<< ",\"fs_invocations\":" << frame.statistics.fragmentShaderInvocations
+					<< ",\"cs_invocations\":" << frame.statistics.computeShaderInvocations;
+			}
+			file << "}}";
+		}
+	}
+	file << "\n]}\n";
+
+	std::cout << "[*] GPU profiler - wrote " << frames.size() << " frames to " << path << std::endl;
+	return true;
+}
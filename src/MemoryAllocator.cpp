@@ -0,0 +1,830 @@
+// Vulkan Renderer - GPU Memory Allocator
+
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <iomanip>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+// Bit Scan Helpers
+static uint32_t highestBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+static uint32_t lowestBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+
+// ----- TLSF Heap -----
+
+void TlsfHeap::init(VkDeviceSize size)
+{
+	heap_size = size / MEMORY_MIN_ALIGNMENT * MEMORY_MIN_ALIGNMENT;
+	used_bytes = 0;
+	allocation_count = 0;
+	nodes.clear();
+	unusedNodes.clear();
+	fl_bitmap = 0;
+	for (uint32_t fl = 0; fl < TLSF_FL_COUNT; fl++)
+	{
+		sl_bitmap[fl] = 0;
+		for (uint32_t sl = 0; sl < TLSF_SL_COUNT; sl++)
+		{
+			freeHeads[fl][sl] = TLSF_NONE;
+		}
+	}
+
+	// One free node spanning the whole block
+	uint32_t root = newNode();
+	nodes[root].offset = 0;
+	nodes[root].size = heap_size;
+	nodes[root].free = true;
+	insertFree(root);
+}
+
+
+uint32_t TlsfHeap::newNode()
+{
+	if (!unusedNodes.empty())
+	{
+		uint32_t node = unusedNodes.back();
+		unusedNodes.pop_back();
+		nodes[node] = Node();
+		return node;
+	}
+	nodes.push_back(Node());
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+
+// First level = power of two, second level = linear subdivision of that power
+void TlsfHeap::mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl) const
+{
+	fl = highestBit(size);
+	sl = static_cast<uint32_t>(size >> (fl - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+}
+
+
+void TlsfHeap::insertFree(uint32_t node)
+{
+	uint32_t fl, sl;
+	mapping(nodes[node].size, fl, sl);
+
+	uint32_t head = freeHeads[fl][sl];
+	nodes[node].prevFree = TLSF_NONE;
+	nodes[node].nextFree = head;
+	if (head != TLSF_NONE)
+	{
+		nodes[head].prevFree = node;
+	}
+	freeHeads[fl][sl] = node;
+
+	fl_bitmap |= (1ull << fl);
+	sl_bitmap[fl] |= (1u << sl);
+}
+
+
+void TlsfHeap::removeFree(uint32_t node)
+{
+	uint32_t fl, sl;
+	mapping(nodes[node].size, fl, sl);
+
+	uint32_t prev = nodes[node].prevFree;
+	uint32_t next = nodes[node].nextFree;
+	if (prev != TLSF_NONE)
+	{
+		nodes[prev].nextFree = next;
+	}
+	if (next != TLSF_NONE)
+	{
+		nodes[next].prevFree = prev;
+	}
+
+	if (freeHeads[fl][sl] == node)
+	{
+		freeHeads[fl][sl] = next;
+		if (next == TLSF_NONE)
+		{
+			sl_bitmap[fl] &= ~(1u << sl);
+			if (sl_bitmap[fl] == 0)
+			{
+				fl_bitmap &= ~(1ull << fl);
+			}
+		}
+	}
+	nodes[node].prevFree = TLSF_NONE;
+	nodes[node].nextFree = TLSF_NONE;
+}
+
+
+// Find a free node guaranteed to hold size bytes
+uint32_t TlsfHeap::findFree(VkDeviceSize size)
+{
+	// Round up to the next list so every node in it is large enough
+	size += (1ull << (highestBit(size) - TLSF_SL_LOG2)) - 1;
+
+	uint32_t fl, sl;
+	mapping(size, fl, sl);
+
+	uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+	if (sl_map == 0)
+	{
+		uint64_t fl_map = (fl + 1 < TLSF_FL_COUNT) ? fl_bitmap & (~0ull << (fl + 1)) : 0;
+		if (fl_map == 0)
+		{
+			return TLSF_NONE;
+		}
+		fl = lowestBit(fl_map);
+		sl_map = sl_bitmap[fl];
+	}
+	sl = lowestBit(sl_map);
+
+	return freeHeads[fl][sl];
+}
+
+
+bool TlsfHeap::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& node)
+{
+	size = alignUp(std::max<VkDeviceSize>(size, MEMORY_MIN_ALIGNMENT), MEMORY_MIN_ALIGNMENT);
+	alignment = std::max<VkDeviceSize>(alignment, MEMORY_MIN_ALIGNMENT);
+
+	// Worst case front padding is alignment - MEMORY_MIN_ALIGNMENT since every offset is a multiple of it
+	uint32_t found = findFree(size + alignment - MEMORY_MIN_ALIGNMENT);
+	if (found == TLSF_NONE)
+	{
+		return false;
+	}
+	removeFree(found);
+
+	// Split off front padding as its own free node - its physical predecessor is never free
+	VkDeviceSize aligned = alignUp(nodes[found].offset, alignment);
+	VkDeviceSize padding = aligned - nodes[found].offset;
+	if (padding > 0)
+	{
+		uint32_t front = newNode();
+		nodes[front].offset = nodes[found].offset;
+		nodes[front].size = padding;
+		nodes[front].prevPhys = nodes[found].prevPhys;
+		nodes[front].nextPhys = found;
+		nodes[front].free = true;
+		if (nodes[front].prevPhys != TLSF_NONE)
+		{
+			nodes[nodes[front].prevPhys].nextPhys = front;
+		}
+		nodes[found].prevPhys = front;
+		nodes[found].offset = aligned;
+		nodes[found].size -= padding;
+		insertFree(front);
+	}
+
+	// Return the tail to the free lists
+	if (nodes[found].size > size)
+	{
+		uint32_t back = newNode();
+		nodes[back].offset = aligned + size;
+		nodes[back].size = nodes[found].size - size;
+		nodes[back].prevPhys = found;
+		nodes[back].nextPhys = nodes[found].nextPhys;
+		nodes[back].free = true;
+		if (nodes[back].nextPhys != TLSF_NONE)
+		{
+			nodes[nodes[back].nextPhys].prevPhys = back;
+		}
+		nodes[found].nextPhys = back;
+		nodes[found].size = size;
+		insertFree(back);
+	}
+
+	nodes[found].free = false;
+	used_bytes += nodes[found].size;
+	allocation_count++;
+
+	offset = aligned;
+	node = found;
+	return true;
+}
+
+
+void TlsfHeap::free(uint32_t node)
+{
+	used_bytes -= nodes[node].size;
+	allocation_count--;
+	nodes[node].free = true;
+
+	// Merge with the physical predecessor
+	uint32_t prev = nodes[node].prevPhys;
+	if (prev != TLSF_NONE && nodes[prev].free)
+	{
+		removeFree(prev);
+		nodes[prev].size += nodes[node].size;
+		nodes[prev].nextPhys = nodes[node].nextPhys;
+		if (nodes[node].nextPhys != TLSF_NONE)
+		{
+			nodes[nodes[node].nextPhys].prevPhys = prev;
+		}
+		unusedNodes.push_back(node);
+		node = prev;
+	}
+
+	// Merge with the physical successor
+	uint32_t next = nodes[node].nextPhys;
+	if (next != TLSF_NONE && nodes[next].free)
+	{
+		removeFree(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].nextPhys = nodes[next].nextPhys;
+		if (nodes[next].nextPhys != TLSF_NONE)
+		{
+			nodes[nodes[next].nextPhys].prevPhys = node;
+		}
+		unusedNodes.push_back(next);
+	}
+
+	insertFree(node);
+}
+
+
+VkDeviceSize TlsfHeap::largestFreeRange() const
+{
+	if (fl_bitmap == 0)
+	{
+		return 0;
+	}
+
+	// The largest node lives in the highest non-empty list
+	uint32_t fl = highestBit(fl_bitmap);
+	uint32_t sl = highestBit(sl_bitmap[fl]);
+
+	VkDeviceSize largest = 0;
+	for (uint32_t node = freeHeads[fl][sl]; node != TLSF_NONE; node = nodes[node].nextFree)
+	{
+		largest = std::max(largest, nodes[node].size);
+	}
+	return largest;
+}
+
+
+// ----- Memory Ring -----
+
+MemoryRing::MemoryRing(VkDeviceMemory memory, void* mapped, VkDeviceSize size, uint32_t memoryType)
+	: ring_memory(memory), ring_mapped(static_cast<uint8_t*>(mapped)), ring_size(size), start_limit(size), memory_type(memoryType)
+{
+}
+
+
+bool MemoryRing::allocate(VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation)
+{
+	alignment = std::max<VkDeviceSize>(alignment, 1);
+	if (used_bytes == 0)
+	{
+		head = tail = 0;
+	}
+
+	VkDeviceSize start = alignUp(head, alignment);
+	VkDeviceSize consumed;
+
+	if (head >= tail)
+	{
+		// Free space is [head, end) followed by [0, tail)
+		if (used_bytes > 0 && head == tail)
+		{
+			return false;
+		}
+		if (start + size <= ring_size && start <= start_limit)
+		{
+			consumed = start + size - head;
+		}
+		else
+		{
+			// Wrap - the skipped end of the ring is charged to this frame
+			if (size > tail)
+			{
+				return false;
+			}
+			start = 0;
+			consumed = (ring_size - head) + size;
+		}
+	}
+	else
+	{
+		if (start + size > tail || start > start_limit)
+		{
+			return false;
+		}
+		consumed = start + size - head;
+	}
+
+	head = start + size;
+	used_bytes += consumed;
+	frame_bytes += consumed;
+
+	allocation.memory = ring_memory;
+	allocation.offset = start;
+	allocation.size = size;
+	allocation.alignment = alignment;
+	allocation.mapped = ring_mapped ? ring_mapped + start : nullptr;
+	allocation.memoryType = memory_type;
+	return true;
+}
+
+
+void MemoryRing::endFrame()
+{
+	frameEnds.push_back({ head, frame_bytes });
+	frame_bytes = 0;
+}
+
+
+void MemoryRing::releaseFrame()
+{
+	if (frameEnds.empty())
+	{
+		return;
+	}
+	tail = frameEnds.front().first;
+	used_bytes -= frameEnds.front().second;
+	frameEnds.erase(frameEnds.begin());
+}
+
+
+// The open frame starts where the last closed one ended, or at the tail once every closed frame is released
+void MemoryRing::discardFrame()
+{
+	head = frameEnds.empty() ? tail : frameEnds.back().first;
+	used_bytes -= frame_bytes;
+	frame_bytes = 0;
+}
+
+
+void MemoryRing::reset()
+{
+	head = tail = 0;
+	used_bytes = 0;
+	frame_bytes = 0;
+	frameEnds.clear();
+}
+
+
+// ----- Memory Allocator -----
+
+void MemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkDeviceSize blockSize)
+{
+	physical_device = physicalDevice;
+	device = logicalDevice;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+	non_coherent_atom = std::max<VkDeviceSize>(device_properties.limits.nonCoherentAtomSize, 1);
+	max_allocation_count = device_properties.limits.maxMemoryAllocationCount;
+
+	// Block sizes are atom multiples so flush ranges never run past the end of a block
+	block_size = alignUp(blockSize, non_coherent_atom);
+}
+
+
+void MemoryAllocator::destroy()
+{
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	for (auto& pool : pools)
+	{
+		for (auto& block : pool.blocks)
+		{
+			if (block)
+			{
+				freeDeviceMemory(block->memory, block->mapped, block->size);
+			}
+		}
+	}
+	pools.clear();
+
+	for (auto& ring : rings)
+	{
+		freeDeviceMemory(ring->memory(), nullptr, ring->capacity());
+	}
+	rings.clear();
+}
+
+
+// Prefer a type with both required & preferred flags, then any type with the required flags
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeBits, const MemoryAllocationCreateInfo& createInfo) const
+{
+	VkMemoryPropertyFlags wanted[] = { createInfo.requiredFlags | createInfo.preferredFlags, createInfo.requiredFlags };
+
+	for (VkMemoryPropertyFlags flags : wanted)
+	{
+		for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+		{
+			if ((typeBits & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & flags) == flags)
+			{
+				return i;
+			}
+		}
+	}
+	return TLSF_NONE;
+}
+
+
+uint32_t MemoryAllocator::findPool(uint32_t memoryType, bool optimalImage)
+{
+	for (uint32_t i = 0; i < pools.size(); i++)
+	{
+		if (pools[i].memoryType == memoryType && pools[i].optimalImage == optimalImage)
+		{
+			return i;
+		}
+	}
+
+	MemoryPool pool;
+	pool.memoryType = memoryType;
+	pool.optimalImage = optimalImage;
+	pools.push_back(std::move(pool));
+	return static_cast<uint32_t>(pools.size() - 1);
+}
+
+
+bool MemoryAllocator::isCoherent(uint32_t memoryType) const
+{
+	return (memory_properties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+
+// Allocate & persistently map (when host visible) one VkDeviceMemory object
+bool MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, VkDeviceMemory& memory, uint8_t*& mapped)
+{
+	if (device_memory_count >= max_allocation_count)
+	{
+		throw std::runtime_error("[!] Memory Error - maxMemoryAllocationCount reached.");
+	}
+
+	VkMemoryAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = memoryType;
+
+	if (vkAllocateMemory(device, &alloc_info, nullptr, &memory) != VK_SUCCESS)
+	{
+		return false;
+	}
+	device_memory_count++;
+	device_memory_bytes += size;
+	peak_device_memory_bytes = std::max(peak_device_memory_bytes, device_memory_bytes);
+
+	mapped = nullptr;
+	if (memory_properties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		void* pointer = nullptr;
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &pointer) != VK_SUCCESS)
+		{
+			freeDeviceMemory(memory, nullptr, size);
+			throw std::runtime_error("[!] Memory Error - Failed to map host visible block.");
+		}
+		mapped = static_cast<uint8_t*>(pointer);
+	}
+	return true;
+}
+
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, uint8_t* mapped, VkDeviceSize size)
+{
+	if (mapped)
+	{
+		vkUnmapMemory(device, memory);
+	}
+	vkFreeMemory(device, memory, nullptr);
+	device_memory_count--;
+	device_memory_bytes -= size;
+}
+
+
+bool MemoryAllocator::allocateFromBlock(uint32_t poolIndex, uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation)
+{
+	MemoryBlock& block = *pools[poolIndex].blocks[blockIndex];
+
+	VkDeviceSize offset;
+	uint32_t node;
+	if (!block.heap.allocate(size, alignment, offset, node))
+	{
+		return false;
+	}
+
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.alignment = alignment;
+	allocation.mapped = block.mapped ? block.mapped + offset : nullptr;
+	allocation.memoryType = pools[poolIndex].memoryType;
+	allocation.pool = poolIndex;
+	allocation.block = blockIndex;
+	allocation.node = node;
+	return true;
+}
+
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, const MemoryAllocationCreateInfo& createInfo)
+{
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	uint32_t memory_type = findMemoryType(requirements.memoryTypeBits, createInfo);
+	if (memory_type == TLSF_NONE)
+	{
+		throw std::runtime_error("[!] Memory Error - No memory type satisfies the allocation.");
+	}
+
+	uint32_t pool_index = findPool(memory_type, createInfo.optimalImage);
+	MemoryPool& pool = pools[pool_index];
+	VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, MEMORY_MIN_ALIGNMENT);
+	bool dedicated = createInfo.dedicated || requirements.size > MEMORY_DEDICATED_THRESHOLD;
+
+	// Sub-allocate from an existing block first
+	if (!dedicated)
+	{
+		for (uint32_t i = 0; i < pool.blocks.size(); i++)
+		{
+			MemoryAllocation allocation;
+			if (pool.blocks[i] && !pool.blocks[i]->dedicated && allocateFromBlock(pool_index, i, requirements.size, alignment, allocation))
+			{
+				return allocation;
+			}
+		}
+	}
+
+	// New block - reuse a released slot so block indices stay stable
+	auto block = std::make_unique<MemoryBlock>();
+	block->dedicated = dedicated;
+	block->size = dedicated ? alignUp(alignUp(requirements.size, MEMORY_MIN_ALIGNMENT), non_coherent_atom) : block_size;
+	if (!allocateDeviceMemory(block->size, memory_type, block->memory, block->mapped))
+	{
+		throw std::runtime_error("[!] Memory Error - vkAllocateMemory failed for a new block.");
+	}
+	block->heap.init(block->size);
+
+	uint32_t block_index = 0;
+	while (block_index < pool.blocks.size() && pool.blocks[block_index])
+	{
+		block_index++;
+	}
+	if (block_index == pool.blocks.size())
+	{
+		pool.blocks.push_back(nullptr);
+	}
+	pool.blocks[block_index] = std::move(block);
+
+	MemoryAllocation allocation;
+	if (!allocateFromBlock(pool_index, block_index, requirements.size, alignment, allocation))
+	{
+		throw std::runtime_error("[!] Memory Error - Allocation does not fit in a fresh block.");
+	}
+	return allocation;
+}
+
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	// Ring allocations & empty handles are not owned by a pool
+	if (allocation.pool == TLSF_NONE)
+	{
+		allocation = MemoryAllocation();
+		return;
+	}
+
+	MemoryPool& pool = pools[allocation.pool];
+	MemoryBlock& block = *pool.blocks[allocation.block];
+	block.heap.free(allocation.node);
+
+	// Release empty blocks, but keep one general block per pool around to avoid allocation churn
+	if (block.heap.empty())
+	{
+		bool release = block.dedicated;
+		for (uint32_t i = 0; !release && i < pool.blocks.size(); i++)
+		{
+			release = (i != allocation.block && pool.blocks[i] && !pool.blocks[i]->dedicated && pool.blocks[i]->heap.empty());
+		}
+		if (release)
+		{
+			freeDeviceMemory(block.memory, block.mapped, block.size);
+			pool.blocks[allocation.block].reset();
+		}
+	}
+
+	allocation = MemoryAllocation();
+}
+
+
+// Dedicated block for per-frame transient data
+MemoryRing* MemoryAllocator::createRing(VkDeviceSize size, uint32_t memoryTypeBits, const MemoryAllocationCreateInfo& createInfo)
+{
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	uint32_t memory_type = findMemoryType(memoryTypeBits, createInfo);
+	if (memory_type == TLSF_NONE)
+	{
+		throw std::runtime_error("[!] Memory Error - No memory type satisfies the ring.");
+	}
+
+	size = alignUp(size, non_coherent_atom);
+	VkDeviceMemory memory;
+	uint8_t* mapped;
+	if (!allocateDeviceMemory(size, memory_type, memory, mapped))
+	{
+		throw std::runtime_error("[!] Memory Error - vkAllocateMemory failed for a ring.");
+	}
+
+	rings.push_back(std::make_unique<MemoryRing>(memory, mapped, size, memory_type));
+	return rings.back().get();
+}
+
+
+// Expand a range within an allocation to non coherent atom boundaries
+void MemoryAllocator::mappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range) const
+{
+	if (size == VK_WHOLE_SIZE)
+	{
+		size = allocation.size - offset;
+	}
+	VkDeviceSize begin = allocation.offset + offset;
+	VkDeviceSize end = begin + size;
+
+	range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = begin / non_coherent_atom * non_coherent_atom;
+	range.size = alignUp(end, non_coherent_atom) - range.offset;
+}
+
+
+void MemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (isCoherent(allocation.memoryType))
+	{
+		return;
+	}
+	VkMappedMemoryRange range;
+	mappedRange(allocation, offset, size, range);
+	vkFlushMappedMemoryRanges(device, 1, &range);
+}
+
+
+void MemoryAllocator::invalidate(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (isCoherent(allocation.memoryType))
+	{
+		return;
+	}
+	VkMappedMemoryRange range;
+	mappedRange(allocation, offset, size, range);
+	vkInvalidateMappedMemoryRanges(device, 1, &range);
+}
+
+
+// Plan moves that drain the emptiest blocks of each pool into fuller ones.
+// Destinations are reserved here; the caller copies the data, rebinds, then frees each source.
+std::vector<DefragmentationMove> MemoryAllocator::planDefragmentation(const std::vector<MemoryAllocation*>& movable)
+{
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+	std::vector<DefragmentationMove> moves;
+
+	for (uint32_t p = 0; p < pools.size(); p++)
+	{
+		MemoryPool& pool = pools[p];
+
+		// General blocks, fullest first
+		std::vector<uint32_t> order;
+		for (uint32_t i = 0; i < pool.blocks.size(); i++)
+		{
+			if (pool.blocks[i] && !pool.blocks[i]->dedicated)
+			{
+				order.push_back(i);
+			}
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return pool.blocks[a]->heap.usedBytes() > pool.blocks[b]->heap.usedBytes();
+		});
+
+		// Evacuate from the emptiest block towards the fullest
+		for (size_t source = order.size(); source-- > 1;)
+		{
+			for (uint32_t i = 0; i < movable.size(); i++)
+			{
+				MemoryAllocation* allocation = movable[i];
+				if (allocation->pool != p || allocation->block != order[source])
+				{
+					continue;
+				}
+
+				for (size_t destination = 0; destination < source; destination++)
+				{
+					DefragmentationMove move;
+					move.index = i;
+					if (allocateFromBlock(p, order[destination], allocation->size, allocation->alignment, move.destination))
+					{
+						moves.push_back(move);
+						break;
+					}
+				}
+			}
+		}
+	}
+	return moves;
+}
+
+
+void MemoryAllocator::releaseEmptyBlocks()
+{
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+
+	for (auto& pool : pools)
+	{
+		for (auto& block : pool.blocks)
+		{
+			if (block && block->heap.empty())
+			{
+				freeDeviceMemory(block->memory, block->mapped, block->size);
+				block.reset();
+			}
+		}
+	}
+}
+
+
+MemoryStats MemoryAllocator::getStats()
+{
+	std::lock_guard<std::mutex> lock(allocator_mutex);
+	MemoryStats stats;
+	stats.deviceMemoryCount = device_memory_count;
+	stats.peakBytesReserved = peak_device_memory_bytes;
+
+	for (auto& pool : pools)
+	{
+		for (auto& block : pool.blocks)
+		{
+			if (!block)
+			{
+				continue;
+			}
+			stats.allocationCount += block->heap.allocationCount();
+			stats.bytesReserved += block->size;
+			stats.bytesInUse += block->heap.usedBytes();
+			if (!block->dedicated)
+			{
+				stats.bytesFree += block->heap.capacity() - block->heap.usedBytes();
+				stats.largestFreeRange = std::max(stats.largestFreeRange, block->heap.largestFreeRange());
+			}
+		}
+	}
+
+	for (auto& ring : rings)
+	{
+		stats.bytesReserved += ring->capacity();
+		stats.bytesInUse += ring->usedBytes();
+	}
+
+	if (stats.bytesFree > 0)
+	{
+		stats.fragmentation = 1.0f - (float)stats.largestFreeRange / (float)stats.bytesFree;
+	}
+	return stats;
+}
+
+
+void MemoryAllocator::printStats()
+{
+	MemoryStats stats = getStats();
+	const double mib = 1024.0 * 1024.0;
+
+	std::cout << "[Memory Stats] device memory objects: " << stats.deviceMemoryCount << " / " << max_allocation_count
+		<< " | allocations: " << stats.allocationCount
+		<< std::fixed << std::setprecision(2)
+		<< " | reserved: " << stats.bytesReserved / mib << " MiB"
+		<< " | in use: " << stats.bytesInUse / mib << " MiB"
+		<< " | peak: " << stats.peakBytesReserved / mib << " MiB"
+		<< " | largest free: " << stats.largestFreeRange / mib << " MiB"
+		<< " | fragmentation: " << stats.fragmentation * 100.0f << "%" << std::endl;
+}
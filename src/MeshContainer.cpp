@@ -0,0 +1,1146 @@
+// Vulkan Renderer - GPU Ready Mesh Container
+
+#include "MeshContainer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+
+bool MeshContainer::isContainer(const std::string& path)
+{
+	size_t length = std::strlen(MESH_CONTAINER_EXTENSION);
+	return path.size() >= length && path.compare(path.size() - length, length, MESH_CONTAINER_EXTENSION) == 0;
+}
+
+
+bool MeshContainer::open(const std::string& path)
+{
+	close();
+	if (!file.open(path))
+	{
+		return false;
+	}
+
+	bytes = file.data();
+	byte_count = file.size();
+	return parse(path);
+}
+
+
+bool MeshContainer::load(std::vector<uint8_t>&& containerBytes)
+{
+	close();
+	memory = std::move(containerBytes);
+	bytes = memory.data();
+	byte_count = memory.size();
+	return parse("<memory>");
+}
+
+
+void MeshContainer::close()
+{
+	file.close();
+	memory.clear();
+	bytes = nullptr;
+	byte_count = 0;
+	header = MeshContainerHeader{};
+	attribute_table = nullptr;
+	submesh_table = nullptr;
+	meshlet_table = nullptr;
+	lod_table = nullptr;
+}
+
+
+// Validate the header & tables once - the blobs are handed to the GPU untouched
+bool MeshContainer::parse(const std::string& name)
+{
+	if (byte_count < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	std::memcpy(&header, bytes, sizeof(header));
+
+	uint32_t index_bytes = header.indexType == VK_INDEX_TYPE_UINT16 ? 2 : header.indexType == VK_INDEX_TYPE_UINT32 ? 4 : 0;
+	uint64_t tables = sizeof(header) + (uint64_t)header.attributeCount * sizeof(MeshContainerAttribute)
+		+ (uint64_t)header.submeshCount * sizeof(MeshContainerSubmesh) + (uint64_t)header.meshletCount * sizeof(MeshContainerMeshlet)
+		+ (uint64_t)header.submeshCount * header.lodCount * sizeof(MeshContainerLod);
+	if (header.magic != MESH_CONTAINER_MAGIC || header.version != MESH_CONTAINER_VERSION || index_bytes == 0
+		|| header.lodCount == 0 || header.lodCount > MESH_MAX_LODS
+		|| header.vertexStride == 0 || header.vertexCount == 0 || header.indexCount == 0 || header.indexCount % 3 != 0
+		|| header.attributeCount == 0 || header.attributeCount > MESH_MAX_ATTRIBUTES || header.submeshCount == 0
+		|| tables > byte_count
+		|| header.vertexOffset % MESH_CONTAINER_ALIGNMENT != 0 || header.vertexSize != (uint64_t)header.vertexStride * header.vertexCount
+		|| header.vertexOffset + header.vertexSize > byte_count
+		|| header.indexOffset % MESH_CONTAINER_ALIGNMENT != 0 || header.indexSize != (uint64_t)header.indexCount * index_bytes
+		|| header.indexOffset + header.indexSize > byte_count)
+	{
+		std::cout << "[!] Mesh container " << name << " has an invalid header" << std::endl;
+		close();
+		return false;
+	}
+
+	// Tables are read in place - the header keeps them 8 byte aligned
+	attribute_table = reinterpret_cast<const MeshContainerAttribute*>(bytes + sizeof(header));
+	submesh_table = reinterpret_cast<const MeshContainerSubmesh*>(attribute_table + header.attributeCount);
+	meshlet_table = reinterpret_cast<const MeshContainerMeshlet*>(submesh_table + header.submeshCount);
+	lod_table = reinterpret_cast<const MeshContainerLod*>(meshlet_table + header.meshletCount);
+
+	for (uint32_t i = 0; i < header.attributeCount; i++)
+	{
+		if (attribute_table[i].offset >= header.vertexStride)
+		{
+			std::cout << "[!] Mesh container " << name << " has an invalid attribute " << i << std::endl;
+			close();
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header.submeshCount; i++)
+	{
+		const MeshContainerSubmesh& submesh = submesh_table[i];
+		if ((uint64_t)submesh.firstIndex + submesh.indexCount > header.indexCount
+			|| (uint64_t)submesh.firstMeshlet + submesh.meshletCount > header.meshletCount)
+		{
+			std::cout << "[!] Mesh container " << name << " has an invalid submesh " << i << std::endl;
+			close();
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header.meshletCount; i++)
+	{
+		const MeshContainerMeshlet& meshlet = meshlet_table[i];
+		if ((uint64_t)meshlet.firstIndex + meshlet.indexCount > header.indexCount || meshlet.submesh >= header.submeshCount)
+		{
+			std::cout << "[!] Mesh container " << name << " has an invalid meshlet " << i << std::endl;
+			close();
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header.submeshCount * header.lodCount; i++)
+	{
+		const MeshContainerLod& lod = lod_table[i];
+		if ((uint64_t)lod.firstIndex + lod.indexCount > header.indexCount || lod.indexCount % 3 != 0 || !(lod.error >= 0.0f))
+		{
+			std::cout << "[!] Mesh container " << name << " has an invalid level of detail " << i << std::endl;
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// OBJ Tokens - the mapped file is not null terminated, so nothing here may read past end
+static void skipSpaces(const char*& p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+	{
+		p++;
+	}
+}
+
+
+static float parseFloat(const char*& p, const char* end)
+{
+	skipSpaces(p, end);
+	bool negative = p < end && *p == '-';
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		p++;
+	}
+
+	double value = 0.0;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		value = value * 10.0 + (*p++ - '0');
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		double scale = 0.1;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			value += (*p++ - '0') * scale;
+			scale *= 0.1;
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negative_exponent = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			p++;
+		}
+		int exponent = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			exponent = exponent * 10 + (*p++ - '0');
+		}
+		value *= std::pow(10.0, negative_exponent ? -exponent : exponent);
+	}
+	return (float)(negative ? -value : value);
+}
+
+
+static int32_t parseInt(const char*& p, const char* end)
+{
+	bool negative = p < end && *p == '-';
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		p++;
+	}
+	int32_t value = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		value = value * 10 + (*p++ - '0');
+	}
+	return negative ? -value : value;
+}
+
+
+// One face corner - position, uv & normal indices, -1 when absent
+struct ObjCorner
+{
+	int32_t position;
+	int32_t uv;
+	int32_t normal;
+
+	bool operator==(const ObjCorner& other) const { return position == other.position && uv == other.uv && normal == other.normal; }
+};
+
+
+struct ObjCornerHash
+{
+	size_t operator()(const ObjCorner& corner) const
+	{
+		uint64_t key = (uint64_t)(uint32_t)corner.position * 0x9E3779B97F4A7C15ull;
+		key ^= ((uint64_t)(uint32_t)corner.uv + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+		key ^= ((uint64_t)(uint32_t)corner.normal + 0x165667B19E3779F9ull) * 0x85EBCA77C2B2AE63ull;
+		return (size_t)(key ^ (key >> 29));
+	}
+};
+
+
+bool MeshContainer::importObj(const std::string& path, MeshData& mesh)
+{
+	MappedFile source;
+	if (!source.open(path))
+	{
+		return false;
+	}
+
+	const char* p = reinterpret_cast<const char*>(source.data());
+	const char* end = p + source.size();
+
+	std::vector <float> positions;
+	std::vector <float> uvs;
+	std::vector <float> normals;
+	std::vector <ObjCorner> corners;
+	std::unordered_map <ObjCorner, uint32_t, ObjCornerHash> vertices;
+	mesh = MeshData{};
+	bool all_uvs = true;
+	bool all_normals = true;
+	uint32_t submesh_start = 0;
+
+	// OBJ indices are 1 based, negative ones count back from the latest element
+	auto resolve = [](int32_t index, size_t count) -> int32_t {
+		return index > 0 ? index - 1 : index < 0 ? (int32_t)count + index : -1;
+	};
+
+	while (p < end)
+	{
+		skipSpaces(p, end);
+		const char* line_end = (const char*)std::memchr(p, '\n', end - p);
+		if (!line_end)
+		{
+			line_end = end;
+		}
+
+		if (line_end - p >= 2 && p[0] == 'v' && p[1] == ' ')
+		{
+			p += 2;
+			for (int i = 0; i < 3; i++)
+			{
+				positions.push_back(parseFloat(p, line_end));
+			}
+		}
+		else if (line_end - p >= 3 && p[0] == 'v' && p[1] == 't' && p[2] == ' ')
+		{
+			p += 3;
+			uvs.push_back(parseFloat(p, line_end));
+			uvs.push_back(1.0f - parseFloat(p, line_end));			// OBJ puts v = 0 at the bottom
+		}
+		else if (line_end - p >= 3 && p[0] == 'v' && p[1] == 'n' && p[2] == ' ')
+		{
+			p += 3;
+			for (int i = 0; i < 3; i++)
+			{
+				normals.push_back(parseFloat(p, line_end));
+			}
+		}
+		else if (line_end - p >= 2 && p[0] == 'f' && p[1] == ' ')
+		{
+			p += 2;
+			corners.clear();
+			for (;;)
+			{
+				skipSpaces(p, line_end);
+				if (p >= line_end || !(*p == '-' || (*p >= '0' && *p <= '9')))
+				{
+					break;
+				}
+
+				ObjCorner corner{ resolve(parseInt(p, line_end), positions.size() / 3), -1, -1 };
+				if (p < line_end && *p == '/')
+				{
+					p++;
+					if (p < line_end && *p != '/')
+					{
+						corner.uv = resolve(parseInt(p, line_end), uvs.size() / 2);
+					}
+					if (p < line_end && *p == '/')
+					{
+						p++;
+						corner.normal = resolve(parseInt(p, line_end), normals.size() / 3);
+					}
+				}
+				if (corner.position < 0 || (size_t)corner.position >= positions.size() / 3
+					|| corner.uv >= (int32_t)(uvs.size() / 2) || corner.normal >= (int32_t)(normals.size() / 3))
+				{
+					std::cout << "[!] OBJ " << path << " references a missing vertex" << std::endl;
+					return false;
+				}
+				corners.push_back(corner);
+			}
+
+			// Fan triangulation - convex polygons only, like every OBJ exporter writes them
+			std::vector <uint32_t> face;
+			for (const ObjCorner& corner : corners)
+			{
+				auto found = vertices.find(corner);
+				if (found == vertices.end())
+				{
+					uint32_t index = (uint32_t)(mesh.positions.size() / 3);
+					found = vertices.emplace(corner, index).first;
+					mesh.positions.insert(mesh.positions.end(), &positions[corner.position * 3], &positions[corner.position * 3] + 3);
+					if (corner.uv >= 0)
+					{
+						mesh.uvs.insert(mesh.uvs.end(), &uvs[corner.uv * 2], &uvs[corner.uv * 2] + 2);
+					}
+					else
+					{
+						mesh.uvs.insert(mesh.uvs.end(), 2, 0.0f);
+						all_uvs = false;
+					}
+					if (corner.normal >= 0)
+					{
+						mesh.normals.insert(mesh.normals.end(), &normals[corner.normal * 3], &normals[corner.normal * 3] + 3);
+					}
+					else
+					{
+						mesh.normals.insert(mesh.normals.end(), 3, 0.0f);
+						all_normals = false;
+					}
+				}
+				face.push_back(found->second);
+			}
+			for (size_t i = 2; i < face.size(); i++)
+			{
+				mesh.indices.push_back(face[0]);
+				mesh.indices.push_back(face[i - 1]);
+				mesh.indices.push_back(face[i]);
+			}
+		}
+		else if ((line_end - p >= 2 && (p[0] == 'o' || p[0] == 'g') && p[1] == ' ') || (line_end - p >= 7 && std::strncmp(p, "usemtl ", 7) == 0))
+		{
+			// Each group or material change starts a new draw
+			if (mesh.indices.size() > submesh_start)
+			{
+				mesh.submeshes.push_back({ submesh_start, (uint32_t)mesh.indices.size() - submesh_start });
+				submesh_start = (uint32_t)mesh.indices.size();
+			}
+		}
+
+		p = line_end + (line_end < end ? 1 : 0);
+	}
+
+	if (mesh.indices.empty())
+	{
+		std::cout << "[!] OBJ " << path << " has no faces" << std::endl;
+		return false;
+	}
+	if (!mesh.submeshes.empty() && mesh.indices.size() > submesh_start)
+	{
+		mesh.submeshes.push_back({ submesh_start, (uint32_t)mesh.indices.size() - submesh_start });
+	}
+
+	// Normals must cover every corner or build generates them all, missing uvs stay zero
+	if (!all_normals)
+	{
+		mesh.normals.clear();
+	}
+	if (!all_uvs && uvs.empty())
+	{
+		mesh.uvs.clear();
+	}
+	return true;
+}
+
+
+// Vertex Quantization
+static int16_t packSnorm16(float value)
+{
+	return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+
+// Round to nearest even, overflow to infinity - subnormal results are flushed to zero
+static uint16_t packHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude >= 0x7F800000)
+	{
+		return sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00);
+	}
+	if (magnitude < 0x38800000)
+	{
+		return sign;
+	}
+
+	uint32_t rounded = magnitude - 0x38000000;
+	rounded += 0x0FFF + ((rounded >> 13) & 1);
+	if (rounded >= 0x0F800000)
+	{
+		return sign | 0x7C00;
+	}
+	return sign | (uint16_t)(rounded >> 13);
+}
+
+
+// Unit vector onto the octahedron, lower half folded over - decoded in mesh.vert
+static void encodeOctahedral(const float normal[3], float octahedral[2])
+{
+	float sum = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	float x = sum > 0.0f ? normal[0] / sum : 0.0f;
+	float y = sum > 0.0f ? normal[1] / sum : 0.0f;
+	if (normal[2] < 0.0f)
+	{
+		float folded_x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float folded_y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = folded_x;
+		y = folded_y;
+	}
+	octahedral[0] = x;
+	octahedral[1] = y;
+}
+
+
+// Post Transform Cache Order - Forsyth's linear speed optimizer over an LRU cache model
+#define VERTEX_CACHE_MODEL_SIZE 32
+
+static float vertexCacheScore(int32_t cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The triangle just drawn gets a fixed score so the next pick does not simply reuse its vertices
+		score = cachePosition < 3 ? 0.75f
+			: std::pow(1.0f - (float)(cachePosition - 3) / (VERTEX_CACHE_MODEL_SIZE - 3), 1.5f);
+	}
+
+	// Vertices with few triangles left are finished first, so they leave the working set
+	return score + 2.0f / std::sqrt((float)remainingTriangles);
+}
+
+
+void MeshContainer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	size_t triangle_count = indices.size() / 3;
+	if (triangle_count < 2)
+	{
+		return;
+	}
+
+	// Triangles adjacent to each vertex, as offsets into one flat list
+	std::vector <uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		remaining[index]++;
+	}
+	std::vector <uint32_t> first_adjacent(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		first_adjacent[v + 1] = first_adjacent[v] + remaining[v];
+	}
+	std::vector <uint32_t> adjacent(indices.size());
+	std::vector <uint32_t> fill(first_adjacent.begin(), first_adjacent.end() - 1);
+	for (size_t t = 0; t < triangle_count; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			adjacent[fill[indices[t * 3 + corner]]++] = (uint32_t)t;
+		}
+	}
+
+	std::vector <int32_t> cache_position(vertexCount, -1);
+	std::vector <float> vertex_score(vertexCount, 0.0f);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertex_score[v] = vertexCacheScore(-1, remaining[v]);
+	}
+	std::vector <float> triangle_score(triangle_count, 0.0f);
+	std::vector <uint8_t> emitted(triangle_count, 0);
+	uint32_t best_triangle = 0;
+	for (size_t t = 0; t < triangle_count; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			triangle_score[t] += vertex_score[indices[t * 3 + corner]];
+		}
+		if (triangle_score[t] > triangle_score[best_triangle])
+		{
+			best_triangle = (uint32_t)t;
+		}
+	}
+
+	std::vector <uint32_t> output;
+	output.reserve(indices.size());
+	uint32_t cache[VERTEX_CACHE_MODEL_SIZE + 3];
+	uint32_t cache_size = 0;
+	size_t scan = 0;
+
+	while (output.size() < indices.size())
+	{
+		emitted[best_triangle] = 1;
+		const uint32_t* triangle = &indices[best_triangle * 3];
+		output.insert(output.end(), triangle, triangle + 3);
+
+		// Drop the triangle from its vertices' adjacency
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t v = triangle[corner];
+			uint32_t* list = &adjacent[first_adjacent[v]];
+			for (uint32_t i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == best_triangle)
+				{
+					list[i] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// Its vertices move to the front of the LRU, the rest shift back & may fall out
+		uint32_t next_cache[VERTEX_CACHE_MODEL_SIZE + 3];
+		uint32_t next_size = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			next_cache[next_size++] = triangle[corner];
+		}
+		for (uint32_t i = 0; i < cache_size; i++)
+		{
+			uint32_t v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+			{
+				next_cache[next_size++] = v;
+			}
+		}
+		for (uint32_t i = VERTEX_CACHE_MODEL_SIZE; i < next_size; i++)
+		{
+			cache_position[next_cache[i]] = -1;
+			vertex_score[next_cache[i]] = vertexCacheScore(-1, remaining[next_cache[i]]);
+		}
+		cache_size = std::min<uint32_t>(next_size, VERTEX_CACHE_MODEL_SIZE);
+		std::memcpy(cache, next_cache, next_size * sizeof(uint32_t));
+
+		// Rescore what the cache touches - the best of those is the next triangle
+		for (uint32_t i = 0; i < cache_size; i++)
+		{
+			cache_position[cache[i]] = (int32_t)i;
+			vertex_score[cache[i]] = vertexCacheScore((int32_t)i, remaining[cache[i]]);
+		}
+		float best_score = -1.0f;
+		for (uint32_t i = 0; i < next_size; i++)
+		{
+			uint32_t v = next_cache[i];
+			const uint32_t* list = &adjacent[first_adjacent[v]];
+			for (uint32_t j = 0; j < remaining[v]; j++)
+			{
+				uint32_t t = list[j];
+				const uint32_t* corners = &indices[t * 3];
+				triangle_score[t] = vertex_score[corners[0]] + vertex_score[corners[1]] + vertex_score[corners[2]];
+				if (triangle_score[t] > best_score)
+				{
+					best_score = triangle_score[t];
+					best_triangle = t;
+				}
+			}
+		}
+
+		// Nothing in the cache has work left - carry on from the first triangle not yet drawn
+		if (best_score < 0.0f)
+		{
+			while (scan < triangle_count && emitted[scan])
+			{
+				scan++;
+			}
+			if (scan == triangle_count)
+			{
+				break;
+			}
+			best_triangle = (uint32_t)scan;
+		}
+	}
+
+	indices.swap(output);
+}
+
+
+// Average vertex shader invocations per triangle through a FIFO cache - 0.5 is ideal for large grids, 3 the worst
+float MeshContainer::cacheMissRatio(const uint32_t* indices, size_t count, uint32_t cacheSize)
+{
+	if (count < 3)
+	{
+		return 0.0f;
+	}
+
+	std::vector <uint32_t> fifo(cacheSize, UINT32_MAX);
+	uint32_t head = 0;
+	size_t misses = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (std::find(fifo.begin(), fifo.end(), indices[i]) == fifo.end())
+		{
+			fifo[head] = indices[i];
+			head = (head + 1) % cacheSize;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(count / 3);
+}
+
+
+// Bounding sphere around the AABB center of a set of vertices
+static void boundingSphere(const std::vector<float>& positions, const uint32_t* vertices, size_t count, float center[3], float& radius)
+{
+	float lo[3] = { INFINITY, INFINITY, INFINITY };
+	float hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			lo[axis] = std::min(lo[axis], positions[vertices[i] * 3 + axis]);
+			hi[axis] = std::max(hi[axis], positions[vertices[i] * 3 + axis]);
+		}
+	}
+
+	float radius_squared = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis] = count ? (lo[axis] + hi[axis]) * 0.5f : 0.0f;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		float dx = positions[vertices[i] * 3 + 0] - center[0];
+		float dy = positions[vertices[i] * 3 + 1] - center[1];
+		float dz = positions[vertices[i] * 3 + 2] - center[2];
+		radius_squared = std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+	}
+	radius = std::sqrt(radius_squared);
+}
+
+
+// Level of detail by vertex clustering - every vertex in a grid cell collapses onto the cell's vertex nearest the
+// cell mean, so a level needs no vertices of its own. Returns the furthest a representative sits off the plane of
+// any source triangle touching its cell - the surface deviation, not how far vertices slid along it.
+static float clusterTriangles(const std::vector<float>& positions, const std::vector<uint32_t>& vertices,
+	const std::vector<uint32_t>& triangles, float cellSize, std::vector<uint32_t>& remap, std::vector<uint32_t>& simplified)
+{
+	float lo[3] = { INFINITY, INFINITY, INFINITY };
+	for (uint32_t v : vertices)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			lo[axis] = std::min(lo[axis], positions[v * 3 + axis]);
+		}
+	}
+
+	// Cell key - 21 bits per axis
+	std::unordered_map <uint64_t, uint32_t> cell_index;
+	std::vector <uint32_t> vertex_cell(vertices.size());
+	std::vector <float> cell_sum;
+	std::vector <uint32_t> cell_count;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		uint64_t key = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			uint64_t cell = (uint64_t)std::min((positions[vertices[i] * 3 + axis] - lo[axis]) / cellSize, 2097151.0f);
+			key |= cell << (axis * 21);
+		}
+		auto found = cell_index.emplace(key, (uint32_t)cell_count.size());
+		if (found.second)
+		{
+			cell_sum.insert(cell_sum.end(), { 0.0f, 0.0f, 0.0f });
+			cell_count.push_back(0);
+		}
+		uint32_t cell = found.first->second;
+		vertex_cell[i] = cell;
+		cell_count[cell]++;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			cell_sum[cell * 3 + axis] += positions[vertices[i] * 3 + axis];
+		}
+	}
+
+	std::vector <uint32_t> representative(cell_count.size(), UINT32_MAX);
+	std::vector <float> nearest(cell_count.size(), INFINITY);
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		uint32_t cell = vertex_cell[i];
+		float distance = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float d = positions[vertices[i] * 3 + axis] - cell_sum[cell * 3 + axis] / cell_count[cell];
+			distance += d * d;
+		}
+		if (distance < nearest[cell])
+		{
+			nearest[cell] = distance;
+			representative[cell] = vertices[i];
+		}
+	}
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		remap[vertices[i]] = representative[vertex_cell[i]];
+	}
+
+	// Triangles collapsed inside one cell vanish
+	float error = 0.0f;
+	simplified.clear();
+	for (size_t i = 0; i < triangles.size(); i += 3)
+	{
+		const float* a = &positions[triangles[i] * 3];
+		const float* b = &positions[triangles[i + 1] * 3];
+		const float* c = &positions[triangles[i + 2] * 3];
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		for (int corner = 0; corner < 3 && length > 0.0f; corner++)
+		{
+			const float* r = &positions[remap[triangles[i + corner]] * 3];
+			float distance = std::fabs(n[0] * (r[0] - a[0]) + n[1] * (r[1] - a[1]) + n[2] * (r[2] - a[2])) / length;
+			error = std::max(error, distance);
+		}
+
+		uint32_t ra = remap[triangles[i]], rb = remap[triangles[i + 1]], rc = remap[triangles[i + 2]];
+		if (ra != rb && rb != rc && ra != rc)
+		{
+			simplified.insert(simplified.end(), { ra, rb, rc });
+		}
+	}
+	return error;
+}
+
+
+bool MeshContainer::build(const MeshData& mesh, std::vector<uint8_t>& container, const MeshBuildOptions& options)
+{
+	size_t source_vertices = mesh.positions.size() / 3;
+	if (source_vertices == 0 || mesh.positions.size() % 3 != 0 || mesh.indices.empty() || mesh.indices.size() % 3 != 0
+		|| (!mesh.normals.empty() && mesh.normals.size() != mesh.positions.size())
+		|| (!mesh.uvs.empty() && mesh.uvs.size() != source_vertices * 2))
+	{
+		return false;
+	}
+	for (uint32_t index : mesh.indices)
+	{
+		if (index >= source_vertices)
+		{
+			return false;
+		}
+	}
+
+	// Area weighted face normals when the source has none
+	std::vector <float> normals = mesh.normals;
+	if (normals.empty())
+	{
+		normals.assign(mesh.positions.size(), 0.0f);
+		for (size_t i = 0; i < mesh.indices.size(); i += 3)
+		{
+			const float* a = &mesh.positions[mesh.indices[i] * 3];
+			const float* b = &mesh.positions[mesh.indices[i + 1] * 3];
+			const float* c = &mesh.positions[mesh.indices[i + 2] * 3];
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					normals[mesh.indices[i + corner] * 3 + axis] += n[axis];
+				}
+			}
+		}
+	}
+	for (size_t v = 0; v < source_vertices; v++)
+	{
+		float* n = &normals[v * 3];
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length > 0.0f)
+		{
+			n[0] /= length;
+			n[1] /= length;
+			n[2] /= length;
+		}
+		else
+		{
+			n[0] = 0.0f;
+			n[1] = 0.0f;
+			n[2] = 1.0f;
+		}
+	}
+
+	std::vector <std::pair<uint32_t, uint32_t>> ranges = mesh.submeshes;
+	if (ranges.empty())
+	{
+		ranges.push_back({ 0, (uint32_t)mesh.indices.size() });
+	}
+
+	// Meshlets - greedy over each submesh's triangles in cache order, closing a cluster when either limit is reached.
+	// Degenerate triangles are dropped first.
+	std::vector <uint32_t> ordered;
+	std::vector <uint32_t> triangles;
+	std::vector <MeshContainerSubmesh> submeshes;
+	std::vector <MeshContainerMeshlet> meshlets;
+	std::vector <uint32_t> stamp(source_vertices, UINT32_MAX);
+	std::vector <uint32_t> cluster;
+	std::vector <std::vector<MeshContainerLod>> submesh_lods;
+	std::vector <uint32_t> lod_indices;
+	std::vector <uint32_t> lod_remap(source_vertices, UINT32_MAX);
+	std::vector <uint32_t> vertices;
+	std::vector <uint32_t> simplified;
+	for (uint32_t s = 0; s < ranges.size(); s++)
+	{
+		uint32_t first = ranges[s].first;
+		uint32_t last = std::min<uint32_t>(first + ranges[s].second, (uint32_t)mesh.indices.size());
+
+		MeshContainerSubmesh submesh{};
+		submesh.firstIndex = (uint32_t)ordered.size();
+		submesh.firstMeshlet = (uint32_t)meshlets.size();
+
+		MeshContainerMeshlet meshlet{};
+		meshlet.firstIndex = (uint32_t)ordered.size();
+		meshlet.submesh = (uint32_t)submeshes.size();			// Where the submesh lands unless it ends up empty
+		cluster.clear();
+
+		auto closeMeshlet = [&]() {
+			meshlet.indexCount = (uint32_t)ordered.size() - meshlet.firstIndex;
+			meshlet.vertexCount = (uint32_t)cluster.size();
+			if (meshlet.indexCount > 0)
+			{
+				boundingSphere(mesh.positions, cluster.data(), cluster.size(), meshlet.center, meshlet.radius);
+				meshlets.push_back(meshlet);
+			}
+			meshlet.firstIndex = (uint32_t)ordered.size();
+			cluster.clear();
+		};
+
+		triangles.clear();
+		for (uint32_t i = first; i + 3 <= last; i += 3)
+		{
+			const uint32_t* triangle = &mesh.indices[i];
+			if (triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[0] != triangle[2])
+			{
+				triangles.insert(triangles.end(), triangle, triangle + 3);
+			}
+		}
+		if (options.optimizeIndices)
+		{
+			optimizeVertexCache(triangles, source_vertices);
+		}
+
+		for (size_t i = 0; i < triangles.size(); i += 3)
+		{
+			const uint32_t* triangle = &triangles[i];
+			uint32_t id = (uint32_t)meshlets.size();
+			uint32_t fresh = 0;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				fresh += stamp[triangle[corner]] != id ? 1 : 0;
+			}
+			if (cluster.size() + fresh > MESHLET_MAX_VERTICES || (ordered.size() - meshlet.firstIndex) / 3 + 1 > MESHLET_MAX_TRIANGLES)
+			{
+				closeMeshlet();
+				id = (uint32_t)meshlets.size();
+			}
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				if (stamp[triangle[corner]] != id)
+				{
+					stamp[triangle[corner]] = id;
+					cluster.push_back(triangle[corner]);
+				}
+				ordered.push_back(triangle[corner]);
+			}
+		}
+		closeMeshlet();
+
+		submesh.indexCount = (uint32_t)ordered.size() - submesh.firstIndex;
+		submesh.meshletCount = (uint32_t)meshlets.size() - submesh.firstMeshlet;
+		if (submesh.indexCount == 0)
+		{
+			continue;
+		}
+		boundingSphere(mesh.positions, &ordered[submesh.firstIndex], submesh.indexCount, submesh.center, submesh.radius);
+		submeshes.push_back(submesh);
+
+		// Coarser levels - the cell size starts from the surface area & is corrected until a level lands near its target.
+		// Level firstIndex is relative to lod_indices until the full detail indices are laid out.
+		submesh_lods.push_back({ { submesh.firstIndex, submesh.indexCount, 0.0f, 0 } });
+		if (!options.generateLods)
+		{
+			continue;
+		}
+		vertices.clear();
+		for (uint32_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount; i++)
+		{
+			if (lod_remap[ordered[i]] == UINT32_MAX)
+			{
+				lod_remap[ordered[i]] = ordered[i];
+				vertices.push_back(ordered[i]);
+			}
+		}
+		float area = 0.0f;
+		for (size_t i = 0; i < triangles.size(); i += 3)
+		{
+			const float* a = &mesh.positions[triangles[i] * 3];
+			const float* b = &mesh.positions[triangles[i + 1] * 3];
+			const float* c = &mesh.positions[triangles[i + 2] * 3];
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			area += 0.5f * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		}
+
+		float level_error = 0.0f;
+		size_t level_triangles = triangles.size() / 3;
+		while (submesh_lods.back().size() < MESH_MAX_LODS && level_triangles > MESH_LOD_MIN_TRIANGLES && area > 0.0f)
+		{
+			// A surface cut by cells of size c keeps about 2 * area / c^2 triangles
+			float target = std::max(level_triangles * MESH_LOD_REDUCTION, (float)MESH_LOD_MIN_TRIANGLES * 0.5f);
+			float cell_size = std::sqrt(2.0f * area / target);
+			float error = 0.0f;
+			for (int attempt = 0; attempt < 4; attempt++)
+			{
+				error = clusterTriangles(mesh.positions, vertices, triangles, cell_size, lod_remap, simplified);
+				float ratio = (float)(simplified.size() / 3) / target;
+				if (ratio > 0.67f && ratio < 1.5f)
+				{
+					break;
+				}
+				cell_size *= std::sqrt(std::max(ratio, 0.01f));
+			}
+			if (simplified.empty() || simplified.size() / 3 > level_triangles * 0.75f)
+			{
+				break;
+			}
+
+			if (options.optimizeIndices)
+			{
+				optimizeVertexCache(simplified, source_vertices);
+			}
+			level_error = std::max(level_error, error);
+			level_triangles = simplified.size() / 3;
+			submesh_lods.back().push_back({ (uint32_t)lod_indices.size(), (uint32_t)simplified.size(), level_error, 0 });
+			lod_indices.insert(lod_indices.end(), simplified.begin(), simplified.end());
+		}
+		for (uint32_t v : vertices)
+		{
+			lod_remap[v] = UINT32_MAX;
+		}
+	}
+	if (ordered.empty())
+	{
+		return false;
+	}
+
+	// Vertices in order of first use by the meshlet ordered index stream, unreferenced ones dropped
+	std::vector <uint32_t> remap(source_vertices, UINT32_MAX);
+	std::vector <uint32_t> order;
+	for (uint32_t& index : ordered)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = (uint32_t)order.size();
+			order.push_back(index);
+		}
+		index = remap[index];
+	}
+
+	// Levels share the vertex blob - they only use vertices of their full detail submesh. Submeshes with fewer
+	// levels repeat their coarsest.
+	uint32_t lod_count = 1;
+	for (const std::vector<MeshContainerLod>& levels : submesh_lods)
+	{
+		lod_count = std::max(lod_count, (uint32_t)levels.size());
+	}
+	std::vector <MeshContainerLod> lods;
+	for (const std::vector<MeshContainerLod>& levels : submesh_lods)
+	{
+		for (uint32_t level = 0; level < lod_count; level++)
+		{
+			MeshContainerLod lod = levels[std::min<size_t>(level, levels.size() - 1)];
+			if (level > 0 && levels.size() > 1)
+			{
+				lod.firstIndex += (uint32_t)ordered.size();
+			}
+			lods.push_back(lod);
+		}
+	}
+	for (uint32_t index : lod_indices)
+	{
+		ordered.push_back(remap[index]);
+	}
+
+	MeshContainerHeader header{};
+	header.magic = MESH_CONTAINER_MAGIC;
+	header.version = MESH_CONTAINER_VERSION;
+	header.vertexCount = (uint32_t)order.size();
+	header.indexCount = (uint32_t)ordered.size();
+	header.indexType = header.vertexCount <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	header.submeshCount = (uint32_t)submeshes.size();
+	header.meshletCount = (uint32_t)meshlets.size();
+	header.lodCount = lod_count;
+
+	// Binding 0, locations follow MeshAttributeSemantic. Quantized: 16 bit positions over the bounds, octahedral
+	// normals & half float uvs in 16 bytes. Otherwise 32 bit floats in 32 bytes.
+	MeshContainerAttribute attributes[3] = {
+		{ MESH_ATTRIBUTE_POSITION, VK_FORMAT_R32G32B32_SFLOAT, 0, 0 },
+		{ MESH_ATTRIBUTE_NORMAL, VK_FORMAT_R32G32B32_SFLOAT, 12, 0 },
+		{ MESH_ATTRIBUTE_UV, VK_FORMAT_R32G32_SFLOAT, 24, 0 } };
+	header.attributeCount = 3;
+	header.vertexStride = 32;
+	if (options.quantize)
+	{
+		attributes[0] = { MESH_ATTRIBUTE_POSITION, VK_FORMAT_R16G16B16A16_SNORM, 0, 0 };
+		attributes[1] = { MESH_ATTRIBUTE_NORMAL, VK_FORMAT_R16G16_SNORM, 8, 0 };
+		attributes[2] = { MESH_ATTRIBUTE_UV, VK_FORMAT_R16G16_SFLOAT, 12, 0 };
+		header.vertexStride = 16;
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.boundsMin[axis] = INFINITY;
+		header.boundsMax[axis] = -INFINITY;
+	}
+	for (uint32_t v : order)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			header.boundsMin[axis] = std::min(header.boundsMin[axis], mesh.positions[v * 3 + axis]);
+			header.boundsMax[axis] = std::max(header.boundsMax[axis], mesh.positions[v * 3 + axis]);
+		}
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float half_extent = (header.boundsMax[axis] - header.boundsMin[axis]) * 0.5f;
+		header.positionScale[axis] = options.quantize ? std::max(half_extent, 1e-20f) : 1.0f;
+		header.positionOffset[axis] = options.quantize ? (header.boundsMin[axis] + header.boundsMax[axis]) * 0.5f : 0.0f;
+	}
+
+	auto align = [](uint64_t offset) { return (offset + MESH_CONTAINER_ALIGNMENT - 1) & ~(uint64_t)(MESH_CONTAINER_ALIGNMENT - 1); };
+	uint64_t tables = sizeof(header) + header.attributeCount * sizeof(MeshContainerAttribute)
+		+ submeshes.size() * sizeof(MeshContainerSubmesh) + meshlets.size() * sizeof(MeshContainerMeshlet)
+		+ lods.size() * sizeof(MeshContainerLod);
+	header.vertexOffset = align(tables);
+	header.vertexSize = (uint64_t)header.vertexStride * header.vertexCount;
+	header.indexOffset = align(header.vertexOffset + header.vertexSize);
+	header.indexSize = (uint64_t)header.indexCount * (header.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+
+	container.assign((size_t)(header.indexOffset + header.indexSize), 0);
+	uint8_t* out = container.data();
+	std::memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	std::memcpy(out, attributes, header.attributeCount * sizeof(MeshContainerAttribute));
+	out += header.attributeCount * sizeof(MeshContainerAttribute);
+	std::memcpy(out, submeshes.data(), submeshes.size() * sizeof(MeshContainerSubmesh));
+	out += submeshes.size() * sizeof(MeshContainerSubmesh);
+	std::memcpy(out, meshlets.data(), meshlets.size() * sizeof(MeshContainerMeshlet));
+	out += meshlets.size() * sizeof(MeshContainerMeshlet);
+	std::memcpy(out, lods.data(), lods.size() * sizeof(MeshContainerLod));
+
+	uint8_t* vertex = container.data() + header.vertexOffset;
+	for (uint32_t v : order)
+	{
+		float u = mesh.uvs.empty() ? 0.0f : mesh.uvs[v * 2 + 0];
+		float w = mesh.uvs.empty() ? 0.0f : mesh.uvs[v * 2 + 1];
+		if (options.quantize)
+		{
+			int16_t packed[8];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				packed[axis] = packSnorm16((mesh.positions[v * 3 + axis] - header.positionOffset[axis]) / header.positionScale[axis]);
+			}
+			packed[3] = 0;
+
+			float octahedral[2];
+			encodeOctahedral(&normals[v * 3], octahedral);
+			packed[4] = packSnorm16(octahedral[0]);
+			packed[5] = packSnorm16(octahedral[1]);
+
+			uint16_t halves[2] = { packHalf(u), packHalf(w) };
+			std::memcpy(&packed[6], halves, sizeof(halves));
+			std::memcpy(vertex, packed, sizeof(packed));
+		}
+		else
+		{
+			float packed[8] = {
+				mesh.positions[v * 3 + 0], mesh.positions[v * 3 + 1], mesh.positions[v * 3 + 2],
+				normals[v * 3 + 0], normals[v * 3 + 1], normals[v * 3 + 2], u, w };
+			std::memcpy(vertex, packed, sizeof(packed));
+		}
+		vertex += header.vertexStride;
+	}
+
+	uint8_t* index = container.data() + header.indexOffset;
+	if (header.indexType == VK_INDEX_TYPE_UINT16)
+	{
+		for (size_t i = 0; i < ordered.size(); i++)
+		{
+			uint16_t value = (uint16_t)ordered[i];
+			std::memcpy(index + i * 2, &value, 2);
+		}
+	}
+	else
+	{
+		std::memcpy(index, ordered.data(), ordered.size() * 4);
+	}
+	return true;
+}
+
+
+bool MeshContainer::write(const std::string& path, const std::vector<uint8_t>& container)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(container.data()), (std::streamsize)container.size());
+	return (bool)out;
+}
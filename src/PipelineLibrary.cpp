@@ -0,0 +1,469 @@
+// Vulkan Renderer - Pipeline Library
+
+#include "PipelineLibrary.h"
+
+
+void PipelineLibrary::init(VkDevice logicalDevice, VkPipelineCache cache, uint32_t threadCount)
+{
+	device = logicalDevice;
+	pipelineCache = cache;
+	workers.reset(new ThreadPool(threadCount));
+}
+
+
+void PipelineLibrary::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// Joining the workers lets every queued compile finish first
+	waitAll();
+	workers.reset();
+
+	std::vector<VkPipeline> pipelines;
+	for (auto& entry : entries)
+	{
+		pipelines.push_back(entry->resolved ? entry->pipeline : entry->future.get());
+		if (entry->rebuilding)
+		{
+			pipelines.push_back(entry->rebuild.get());
+		}
+	}
+	for (auto& retired : retiredPipelines)
+	{
+		pipelines.push_back(retired.pipeline);
+	}
+	for (auto& superseded : supersededBuilds)
+	{
+		pipelines.push_back(superseded.get());
+	}
+
+	for (VkPipeline pipeline : pipelines)
+	{
+		if (pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+	}
+	entries.clear();
+	retiredPipelines.clear();
+	supersededBuilds.clear();
+
+	for (auto& module : shaderModules)
+	{
+		vkDestroyShaderModule(device, module.second, nullptr);
+	}
+	for (VkShaderModule module : retiredModules)
+	{
+		vkDestroyShaderModule(device, module, nullptr);
+	}
+	shaderModules.clear();
+	retiredModules.clear();
+	shaderArchive.close();
+
+	device = VK_NULL_HANDLE;
+}
+
+
+bool PipelineLibrary::loadArchive(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(shader_mutex);
+	return shaderArchive.open(path);
+}
+
+
+// Map the SPIR-V & create its module, or reuse the one created by an earlier variant
+VkShaderModule PipelineLibrary::getShaderModule(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(shader_mutex);
+
+	auto found = shaderModules.find(path);
+	if (found != shaderModules.end())
+	{
+		return found->second;
+	}
+
+	// The archive, or else the lone file, is handed to the driver straight from the mapping
+	MappedFile file;
+	const uint32_t* code = nullptr;
+	size_t code_size = 0;
+	if (!shaderArchive.find(path, code, code_size))
+	{
+		if (!file.open(path))
+		{
+			throw std::runtime_error("[!] File Error - failed to open and map file " + path);
+		}
+		if (!ShaderArchive::isSpirv(file.data(), file.size()))
+		{
+			throw std::runtime_error("[!] Shader Module Error - " + path + " is not SPIR-V");
+		}
+		code = reinterpret_cast<const uint32_t*>(file.data());
+		code_size = file.size();
+	}
+
+	VkShaderModuleCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = code_size;
+	create_info.pCode = code;
+
+	VkShaderModule shader_module;
+	if (vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Shader Module Error - Unable to create Shader module " + path);
+	}
+
+	shaderModules[path] = shader_module;
+	return shader_module;
+}
+
+
+VkPipeline PipelineLibrary::compile(const PipelineDesc& desc)
+{
+	// Specialization constants - constant_id i takes specialization[i]
+	std::vector<VkSpecializationMapEntry> map_entries(desc.specialization.size());
+	for (uint32_t i = 0; i < map_entries.size(); i++)
+	{
+		map_entries[i].constantID = i;
+		map_entries[i].offset = i * sizeof(uint32_t);
+		map_entries[i].size = sizeof(uint32_t);
+	}
+
+	VkSpecializationInfo specialization_info{};
+	specialization_info.mapEntryCount = (uint32_t)map_entries.size();
+	specialization_info.pMapEntries = map_entries.data();
+	specialization_info.dataSize = desc.specialization.size() * sizeof(uint32_t);
+	specialization_info.pData = desc.specialization.data();
+
+	// Create Shader Stages
+	VkPipelineShaderStageCreateInfo stages[2] = {};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = getShaderModule(desc.vertexShader);
+	stages[0].pName = "main";
+	stages[0].pSpecializationInfo = desc.specialization.empty() ? nullptr : &specialization_info;
+
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = getShaderModule(desc.fragmentShader);
+	stages[1].pName = "main";
+	stages[1].pSpecializationInfo = stages[0].pSpecializationInfo;
+
+	// Create Vertices
+	VkPipelineVertexInputStateCreateInfo vertex_input_create_info{};
+	vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_create_info.vertexBindingDescriptionCount = (uint32_t)desc.bindings.size();
+	vertex_input_create_info.pVertexBindingDescriptions = desc.bindings.data();
+	vertex_input_create_info.vertexAttributeDescriptionCount = (uint32_t)desc.attributes.size();
+	vertex_input_create_info.pVertexAttributeDescriptions = desc.attributes.data();
+
+	VkPipelineInputAssemblyStateCreateInfo assembly_create_info{};
+	assembly_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	assembly_create_info.topology = desc.topology;
+	assembly_create_info.primitiveRestartEnable = VK_FALSE;
+
+	// Viewport & scissor are dynamic so pipelines survive swap chain resizes
+	VkPipelineViewportStateCreateInfo viewport_create_info{};
+	viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_create_info.viewportCount = 1;
+	viewport_create_info.scissorCount = 1;
+
+	VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamic_state_create_info{};
+	dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic_state_create_info.dynamicStateCount = 2;
+	dynamic_state_create_info.pDynamicStates = dynamic_states;
+
+	// Create Rasterizor
+	VkPipelineRasterizationStateCreateInfo rasterizer_create_info{};
+	rasterizer_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_create_info.depthClampEnable = VK_FALSE;
+	rasterizer_create_info.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer_create_info.polygonMode = desc.polygonMode;
+	rasterizer_create_info.lineWidth = 1.0f;
+	rasterizer_create_info.cullMode = desc.cullMode;
+	rasterizer_create_info.frontFace = desc.frontFace;
+	rasterizer_create_info.depthBiasEnable = VK_FALSE;
+
+	// Create Multisampling
+	VkPipelineMultisampleStateCreateInfo multisample_create_info{};
+	multisample_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisample_create_info.sampleShadingEnable = VK_FALSE;
+	multisample_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Create Color Blend Attachments - standard alpha blending when enabled
+	VkPipelineColorBlendAttachmentState color_blend_attachment{};
+	color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	color_blend_attachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+	color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+	color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	// Create Color Blending Pipeline
+	VkPipelineColorBlendStateCreateInfo color_blend_create_info{};
+	color_blend_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	color_blend_create_info.logicOpEnable = VK_FALSE;
+	color_blend_create_info.logicOp = VK_LOGIC_OP_COPY;
+	color_blend_create_info.attachmentCount = 1;
+	color_blend_create_info.pAttachments = &color_blend_attachment;
+
+	// Create Pipeline
+	VkGraphicsPipelineCreateInfo pipeline_create_info{};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeline_create_info.stageCount = 2;
+	pipeline_create_info.pStages = stages;
+	pipeline_create_info.pVertexInputState = &vertex_input_create_info;
+	pipeline_create_info.pInputAssemblyState = &assembly_create_info;
+	pipeline_create_info.pViewportState = &viewport_create_info;
+	pipeline_create_info.pRasterizationState = &rasterizer_create_info;
+	pipeline_create_info.pMultisampleState = &multisample_create_info;
+	pipeline_create_info.pColorBlendState = &color_blend_create_info;
+	pipeline_create_info.pDynamicState = &dynamic_state_create_info;
+	pipeline_create_info.layout = desc.layout;
+	pipeline_create_info.renderPass = desc.renderPass;
+	pipeline_create_info.subpass = desc.subpass;
+	pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create graphics pipeline!");
+	}
+	return pipeline;
+}
+
+
+VkPipeline PipelineLibrary::compileCompute(const std::string& shader, VkPipelineLayout layout)
+{
+	VkComputePipelineCreateInfo pipeline_create_info{};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_create_info.stage.module = getShaderModule(shader);
+	pipeline_create_info.stage.pName = "main";
+	pipeline_create_info.layout = layout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create compute pipeline " + shader);
+	}
+	return pipeline;
+}
+
+
+// A failed compile resolves to VK_NULL_HANDLE so frames keep using what they had
+std::shared_future<VkPipeline> PipelineLibrary::compileAsync(const PipelineDesc& desc)
+{
+	return workers->submit([this, desc]() -> VkPipeline {
+		try
+		{
+			return compile(desc);
+		}
+		catch (const std::exception& error)
+		{
+			std::cerr << error.what() << " (" << desc.vertexShader << ", " << desc.fragmentShader << ")" << std::endl;
+			return VK_NULL_HANDLE;
+		}
+	}).share();
+}
+
+
+PipelineHandle PipelineLibrary::request(const PipelineDesc& desc)
+{
+	std::unique_ptr<PipelineEntry> entry(new PipelineEntry());
+	entry->desc = desc;
+	entry->future = compileAsync(desc);
+
+	std::lock_guard<std::mutex> lock(entries_mutex);
+	entries.push_back(std::move(entry));
+	return (PipelineHandle)(entries.size() - 1);
+}
+
+
+PipelineHandle PipelineLibrary::adopt(const PipelineDesc& desc, VkPipeline pipeline)
+{
+	std::promise<VkPipeline> compiled;
+	compiled.set_value(pipeline);
+
+	std::unique_ptr<PipelineEntry> entry(new PipelineEntry());
+	entry->desc = desc;
+	entry->future = compiled.get_future().share();
+	entry->pipeline = pipeline;
+	entry->resolved = true;
+
+	std::lock_guard<std::mutex> lock(entries_mutex);
+	entries.push_back(std::move(entry));
+	return (PipelineHandle)(entries.size() - 1);
+}
+
+
+VkPipeline PipelineLibrary::get(PipelineHandle handle, VkPipeline fallback)
+{
+	if (handle == PIPELINE_HANDLE_NONE || !isReady(handle))
+	{
+		return fallback;
+	}
+
+	PipelineEntry* entry;
+	{
+		std::lock_guard<std::mutex> lock(entries_mutex);
+		entry = entries[handle].get();
+	}
+	return entry->pipeline != VK_NULL_HANDLE ? entry->pipeline : fallback;
+}
+
+
+bool PipelineLibrary::isReady(PipelineHandle handle)
+{
+	PipelineEntry* entry;
+	{
+		std::lock_guard<std::mutex> lock(entries_mutex);
+		if (handle >= entries.size())
+		{
+			return false;
+		}
+		entry = entries[handle].get();
+	}
+
+	if (!entry->resolved && entry->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		entry->pipeline = entry->future.get();
+		entry->resolved = true;
+	}
+	return entry->resolved;
+}
+
+
+void PipelineLibrary::waitAll()
+{
+	std::vector<std::shared_future<VkPipeline>> pending;
+	{
+		std::lock_guard<std::mutex> lock(entries_mutex);
+		for (auto& entry : entries)
+		{
+			pending.push_back(entry->future);
+		}
+	}
+
+	for (auto& future : pending)
+	{
+		future.wait();
+	}
+}
+
+
+// Called from the watcher thread - swaps are deferred to collectReloads on the render thread
+void PipelineLibrary::reloadShader(const std::string& path, std::vector<uint32_t>&& code)
+{
+	VkShaderModuleCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = code.size() * sizeof(uint32_t);
+	create_info.pCode = code.data();
+
+	VkShaderModule shader_module;
+	if (vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS)
+	{
+		std::cerr << "[!] Shader Module Error - Unable to reload Shader module " << path << std::endl;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(shader_mutex);
+		auto found = shaderModules.find(path);
+		if (found != shaderModules.end())
+		{
+			retiredModules.push_back(found->second);
+		}
+		shaderModules[path] = shader_module;
+	}
+
+	std::lock_guard<std::mutex> lock(entries_mutex);
+	for (auto& entry : entries)
+	{
+		if (entry->desc.vertexShader != path && entry->desc.fragmentShader != path)
+		{
+			continue;
+		}
+
+		if (entry->rebuilding)
+		{
+			supersededBuilds.push_back(entry->rebuild);
+		}
+		entry->rebuild = compileAsync(entry->desc);
+		entry->rebuilding = true;
+	}
+}
+
+
+uint32_t PipelineLibrary::collectReloads(uint64_t frameNumber, uint32_t framesInFlight)
+{
+	// Every frame before frameNumber + 1 - framesInFlight has signaled its fence
+	for (size_t i = 0; i < retiredPipelines.size(); )
+	{
+		if (frameNumber + 1 >= retiredPipelines[i].frameNumber + framesInFlight)
+		{
+			vkDestroyPipeline(device, retiredPipelines[i].pipeline, nullptr);
+			retiredPipelines[i] = retiredPipelines.back();
+			retiredPipelines.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(entries_mutex);
+
+	for (size_t i = 0; i < supersededBuilds.size(); )
+	{
+		if (supersededBuilds[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			VkPipeline pipeline = supersededBuilds[i].get();
+			if (pipeline != VK_NULL_HANDLE)
+			{
+				vkDestroyPipeline(device, pipeline, nullptr);
+			}
+			supersededBuilds[i] = supersededBuilds.back();
+			supersededBuilds.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	uint32_t swapped = 0;
+	for (auto& entry : entries)
+	{
+		if (!entry->rebuilding || entry->rebuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready
+			|| entry->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			continue;
+		}
+
+		VkPipeline rebuilt = entry->rebuild.get();
+		entry->rebuilding = false;
+		if (rebuilt == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		if (!entry->resolved)
+		{
+			entry->pipeline = entry->future.get();
+			entry->resolved = true;
+		}
+		if (entry->pipeline != VK_NULL_HANDLE)
+		{
+			retiredPipelines.push_back({ entry->pipeline, frameNumber });
+		}
+		entry->pipeline = rebuilt;
+		swapped++;
+	}
+	return swapped;
+}
@@ -4,8 +4,38 @@
 
 
 // Constructor & Deconstructors
-Renderer::Renderer()
+Renderer::Renderer(RendererConfig config)
 {
+	frames_in_flight = CLAMP(config.framesInFlight, 1u, (uint32_t)MAX_FRAMES_IN_FLIGHT);
+	headless = config.headless;
+	target_width = config.width;
+	target_height = config.height;
+	enableValidationLayers = config.enableValidation;
+	pipeline_cache_path = config.pipelineCachePath;
+	pipeline_threads = config.pipelineThreads;
+	shader_archive_path = config.shaderArchivePath;
+	hot_reload = config.hotReload;
+	record_threads = config.recordThreads;
+	gpu_driven = config.gpuDriven;
+	requested_present_mode = config.presentMode;
+	framePacer.setTargetFps(config.targetFps);
+	framePacer.setLowLatency(config.lowLatency);
+	profile_gpu = config.profileGpu;
+	bindless_descriptors = config.bindlessDescriptors;
+	async_compute_requested = config.asyncCompute;
+	texture_staging_budget = config.textureStagingBudget;
+	texture_memory_budget = config.textureMemoryBudget;
+	texture_decode_threads = config.textureDecodeThreads;
+	lod_error_pixels = config.lodErrorPixels;
+	lod_triangle_budget = config.lodTriangleBudget;
+	scene_threads = config.sceneThreads;
+
+	// Offscreen rendering never presents, so the swap chain extension is not required
+	if (headless)
+	{
+		deviceExtensions.clear();
+	}
+
 	initVulkan();
 }
 
@@ -15,47 +45,129 @@ Renderer::~Renderer()
 }
 
 
+// Default geometry - the triangle previously hard-coded in shader_base.vert
+static const std::vector<Vertex> defaultTriangleVertices = {
+	{ {  0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+	{ {  0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f } },
+	{ { -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f } }
+};
+static const std::vector<uint32_t> defaultTriangleIndices = { 0, 1, 2 };
+
+
 // Initializers & Deinitializers
 void Renderer::initVulkan()
 {
-	createWindow();
+	auto init_start = std::chrono::steady_clock::now();
+
+	if (!headless)
+	{
+		createWindow();
+	}
 	createInstance();
 	createDebugMessenger();
-	createSurface();
+	if (!headless)
+	{
+		createSurface();
+	}
 	createPhysicalDevice();
 	createLogicalDevice();
-	createSwapChain();
+	allocator.init(physical_device, device);
+	descriptorManager.init(device, physical_device, frames_in_flight, descriptor_indexing);
+	frameGraph.init(device, &allocator, frames_in_flight, async_compute);
+	createUniformRing();
+	createInstanceRing();
+	createTextureStreamer();
+	scene.init(scene_threads);
+	createPipelineCache();
+	if (headless)
+	{
+		createOffscreenTargets();
+	}
+	else
+	{
+		createSwapChain();
+	}
 	createImageViews();
 	createRenderPass();
+
+	auto pipeline_start = std::chrono::steady_clock::now();
 	createGraphicsPipeline();
+	startup_stats.pipelineMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipeline_start).count();
+
 	createFrameBuffers();
 	createCommandPool();
-	createCommandBuffer();
+	createCommandBuffers();
+	createRecordWorkers();
+	createAsyncCompute();
+	if (profile_gpu)
+	{
+		gpuProfiler.init(device, physical_device, queue_family_index, frames_in_flight, pipeline_statistics_query);
+	}
+	createStagingRing();
+	uploadMesh(defaultTriangleVertices, defaultTriangleIndices);
+	if (gpu_driven)
+	{
+		createCullingPipeline();
+	}
 	createSyncObjects();
+
+	startup_stats.initMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - init_start).count();
 }
 
 
 void Renderer::deInitVulkan()
 {
 	// Destroy Sync objects
-	vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-	vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-	vkDestroyFence(device, inFlightFence, nullptr);
+	for (VkSemaphore semaphore : renderFinishedSemaphores)
+	{
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	for (uint32_t i = 0; i < frames_in_flight; i++)
+	{
+		vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+		vkDestroyFence(device, inFlightFences[i], nullptr);
+	}
 
-	// Destroy Command Pool
+	// Destroy Geometry & Staging Buffers
+	destroyCullingResources();
+	destroyModels();
+	destroyMeshBuffers();
+	destroyStagingRing();
+
+	// Destroy Query Pools & Command Pools
+	gpuProfiler.destroy();
+	destroyRecordWorkers();
+	destroyAsyncCompute();
 	vkDestroyCommandPool(device, commandPool, nullptr);
 
-	// Destroy Frame Buffers
+	// Destroy Frame Buffers & any swap chains replaced by a resize
 	for (auto framebuffer : swapChainFrameBuffers) {
 		vkDestroyFramebuffer(device, framebuffer, nullptr);
 	}
+	releaseRetiredSwapChains(true);
 
-	// Destroy Graphics pipeline
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
+	// Destroy Graphics pipeline & every compiled variant - the library owns them all
+	shaderWatcher.stop();
+	pipelineLibrary.destroy();
 
 	// Destroy Pipeline layout
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr); 
 
+	// Destroy the Frame Graph's transient images
+	frameGraph.destroy();
+
+	// Destroy Streamed Textures & their upload ring - their bindless slots go with the table
+	destroyTextureStreamer();
+
+	// Destroy Bindless, Transient & Uniform Descriptors & the Instance Ring
+	descriptorManager.destroy();
+	destroyUniformRing();
+	destroyInstanceRing();
+
+	// Write back & Destroy Pipeline Cache
+	savePipelineCache();
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
 	// Destroy the Render Pass
 	vkDestroyRenderPass(device, render_pass, nullptr);
 
@@ -65,8 +177,18 @@ void Renderer::deInitVulkan()
 		vkDestroyImageView(device, imageView, nullptr);
 	}
 
-	// Destroy Swap Chain
-	vkDestroySwapchainKHR(device, swap_chain, nullptr);
+	// Destroy Swap Chain or Offscreen Targets
+	if (headless)
+	{
+		destroyOffscreenTargets();
+	}
+	else
+	{
+		vkDestroySwapchainKHR(device, swap_chain, nullptr);
+	}
+
+	// Release every remaining memory block
+	allocator.destroy();
 
 	// Destroy device
 	vkDestroyDevice(device, nullptr);
@@ -80,27 +202,49 @@ void Renderer::deInitVulkan()
 	}
 
 	// Destroy Surface
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	if (!headless)
+	{
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
 
 	// Destroy Instance
 	vkDestroyInstance(instance, nullptr);
 	instance = nullptr;
 
 	// Destroy SDL Window and Quit SDL
-	glfwDestroyWindow(window);
+	if (!headless)
+	{
+		glfwDestroyWindow(window);
 
-	glfwTerminate();
+		glfwTerminate();
+	}
 }
 
 
 void Renderer::eventHandler()
 {
+	if (headless)
+	{
+		throw std::runtime_error("[!] Headless Error: No window to handle events for - use runFrames().");
+		std::exit(-1);
+	}
+
 	while (!glfwWindowShouldClose(window)) 
 	{
-		glfwPollEvents();
+		// Nothing to draw while minimized - sleep until the window changes
+		if (swap_chain_stale)
+		{
+			glfwWaitEvents();
+		}
+		else
+		{
+			paceFrame();
+			glfwPollEvents();
+		}
 		drawFrame();
 	}
 	vkDeviceWaitIdle(device);
+	gpuProfiler.collectAll();
 }
 
 
@@ -111,15 +255,25 @@ void Renderer::createWindow()
 	glfwInit();
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-	window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan", nullptr, nullptr);
+	window = glfwCreateWindow((int)target_width, (int)target_height, "Vulkan", nullptr, nullptr);
 
 	if (window == nullptr)
 	{
 		throw std::runtime_error("\n[!] SDL Error: Unable to initilaize SDL window.\n");
 		std::exit(-1);
 	}
+
+	glfwSetWindowUserPointer(window, this);
+	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+}
+
+
+void Renderer::framebufferResizeCallback(GLFWwindow* window, int width, int height)
+{
+	Renderer* renderer = static_cast<Renderer*>(glfwGetWindowUserPointer(window));
+	renderer->framebuffer_resized = true;
 }
 
 
@@ -144,7 +298,7 @@ void Renderer::createInstance()
 	VkApplicationInfo application {};
 	application.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	application.pApplicationName = "Vulkan Renderer Prototype";
-	application.apiVersion = VK_API_VERSION_1_0;
+	application.apiVersion = VK_API_VERSION_1_2;					// Older loaders & devices still work - features are checked per device
 	application.applicationVersion = VK_MAKE_VERSION(0, 1, 0);
 	application.pEngineName = "No Engine";
 
@@ -218,11 +372,17 @@ bool Renderer::checkValidationLayers()
 // Connect SDL Extensions to Vulkan Application
 std::vector<const char*> Renderer::checkSDLExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
+
+	// Headless instances need no surface extensions
+	if (!headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayers) {
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -345,6 +505,28 @@ Renderer::QueueFamilyIndices Renderer::queryQueueFamilies(VkPhysicalDevice devic
 	queue_families.resize(family_count);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, queue_families.data());
 
+	// Prefer a transfer-only family for uploads so copies run beside graphics work
+	for (uint32_t i = 0; i < family_count; i++)
+	{
+		VkQueueFlags flags = queue_families[i].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT))
+		{
+			indices.transferFamily = i;
+			break;
+		}
+	}
+
+	// A compute family without graphics runs async compute beside the graphics queue
+	for (uint32_t i = 0; i < family_count; i++)
+	{
+		VkQueueFlags flags = queue_families[i].queueFlags;
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			indices.computeFamily = i;
+			break;
+		}
+	}
+
 	// Find a Supporting Queue Family
 	bool found = false;
 	for (uint32_t i = 0; i < family_count; i++)
@@ -354,8 +536,16 @@ Renderer::QueueFamilyIndices Renderer::queryQueueFamilies(VkPhysicalDevice devic
 			queue_family_index = i;
 			indices.graphicsFamily = i;
 		}
+		// Headless frames are never presented - the graphics family stands in for present
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		if (headless)
+		{
+			presentSupport = (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		}
 
 		if (presentSupport)
 		{
@@ -377,6 +567,20 @@ Renderer::QueueFamilyIndices Renderer::queryQueueFamilies(VkPhysicalDevice devic
 		std::exit(-1);
 	}
 
+	// Graphics queues always support transfer
+	if (indices.transferFamily == (uint32_t)-1)
+	{
+		indices.transferFamily = indices.graphicsFamily;
+	}
+	transfer_family_index = indices.transferFamily;
+
+	// Graphics queues always support compute
+	if (indices.computeFamily == (uint32_t)-1)
+	{
+		indices.computeFamily = indices.graphicsFamily;
+	}
+	compute_family_index = indices.computeFamily;
+
 	return indices;
 }
 
@@ -408,8 +612,8 @@ void Renderer::validatePhysicalDevice(bool& suitable, VkPhysicalDevice device)
 
 	bool extensionsSupported = checkDeviceExtensions(device);
 
-	bool supported_swap_chain = false;
-	if (extensionsSupported) {
+	bool supported_swap_chain = headless;
+	if (extensionsSupported && !headless) {
 		SwapChainProperties swapChainSupport = querySwapChainProp(device);
 		supported_swap_chain = !swapChainSupport.surfaceFormats.empty() && !swapChainSupport.presentModes.empty();
 	}
@@ -421,8 +625,152 @@ void Renderer::validatePhysicalDevice(bool& suitable, VkPhysicalDevice device)
 void Renderer::createLogicalDevice()
 {
 	QueueFamilyIndices indices = queryQueueFamilies(physical_device);
+
+	// Specify device's features used with physical device - [!] Fill feature support in later when renderer advances 
+	VkPhysicalDeviceFeatures device_features{};
+	std::vector<const char*> enabled_extensions = deviceExtensions;
+
+	uint32_t extension_count;
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extensions(extension_count);
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, extensions.data());
+	std::set<std::string> available_extensions;
+	for (const auto& extension : extensions)
+	{
+		available_extensions.insert(extension.extensionName);
+	}
+
+	// Measured present timing - optional, pacing falls back to CPU side timing without it
+	if (!headless && available_extensions.count(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME))
+	{
+		enabled_extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+		display_timing = true;
+	}
+
+	// Profiling - pipeline statistics are an optional feature, timestamps alone still work without it
+	if (profile_gpu)
+	{
+		VkPhysicalDeviceFeatures supported_features;
+		vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+		pipeline_statistics_query = supported_features.pipelineStatisticsQuery == VK_TRUE;
+		device_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+	}
+
+	// Streamed textures are stored BC1 / BC3 - without the feature the streamer rejects every load
+	{
+		VkPhysicalDeviceFeatures supported_features;
+		vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+		texture_compression_bc = supported_features.textureCompressionBC == VK_TRUE;
+		device_features.textureCompressionBC = supported_features.textureCompressionBC;
+	}
+
+	// GPU driven drawing - use the count & multi draw paths when the device has them, plain indirect draws otherwise
+	if (gpu_driven)
+	{
+		VkPhysicalDeviceFeatures supported_features;
+		vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+		multi_draw_indirect = supported_features.multiDrawIndirect == VK_TRUE;
+		device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+		device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+
+		if (available_extensions.count(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+		{
+			enabled_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			draw_indirect_count = true;
+		}
+	}
+
+	// Bindless descriptors - core in 1.2, VK_EXT_descriptor_indexing on 1.1 devices, classic sets only otherwise
+	VkPhysicalDeviceDescriptorIndexingFeatures indexing_features{};
+	indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	if (bindless_descriptors)
+	{
+		VkPhysicalDeviceProperties device_properties;
+		vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+		bool core_indexing = device_properties.apiVersion >= VK_API_VERSION_1_2;
+		bool extension_indexing = device_properties.apiVersion >= VK_API_VERSION_1_1 && available_extensions.count(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+		VkPhysicalDeviceDescriptorIndexingFeatures supported_indexing{};
+		supported_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		if (core_indexing || extension_indexing)
+		{
+			VkPhysicalDeviceFeatures2 supported_features{};
+			supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			supported_features.pNext = &supported_indexing;
+			vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+
+			descriptor_indexing = supported_indexing.runtimeDescriptorArray && supported_indexing.descriptorBindingPartiallyBound &&
+				supported_indexing.descriptorBindingSampledImageUpdateAfterBind && supported_indexing.descriptorBindingStorageBufferUpdateAfterBind &&
+				supported_indexing.descriptorBindingUpdateUnusedWhilePending;
+		}
+
+		if (descriptor_indexing)
+		{
+			indexing_features.runtimeDescriptorArray = VK_TRUE;
+			indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+			indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			indexing_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+			indexing_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			indexing_features.shaderSampledImageArrayNonUniformIndexing = supported_indexing.shaderSampledImageArrayNonUniformIndexing;
+			if (!core_indexing)
+			{
+				enabled_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			}
+		}
+		else
+		{
+			std::cout << "[!] Descriptor indexing not supported - bindless descriptors disabled" << std::endl;
+		}
+	}
+
+
+	// Async compute - needs its own family & timeline semaphores (core in 1.2, VK_KHR_timeline_semaphore before)
+	VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features{};
+	timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	if (async_compute_requested && compute_family_index != queue_family_index)
+	{
+		VkPhysicalDeviceProperties device_properties;
+		vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+		bool core_timeline = device_properties.apiVersion >= VK_API_VERSION_1_2;
+		bool extension_timeline = device_properties.apiVersion >= VK_API_VERSION_1_1 && available_extensions.count(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+		if (core_timeline || extension_timeline)
+		{
+			VkPhysicalDeviceTimelineSemaphoreFeatures supported_timeline{};
+			supported_timeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+			VkPhysicalDeviceFeatures2 supported_features{};
+			supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			supported_features.pNext = &supported_timeline;
+			vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+			timeline_semaphore = supported_timeline.timelineSemaphore == VK_TRUE;
+		}
+
+		if (timeline_semaphore)
+		{
+			timeline_features.timelineSemaphore = VK_TRUE;
+			if (!core_timeline)
+			{
+				enabled_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			}
+			async_compute = true;
+		}
+		else
+		{
+			std::cout << "[!] Timeline semaphores not supported - compute stays on the graphics queue" << std::endl;
+		}
+	}
+	if (!async_compute)
+	{
+		compute_family_index = queue_family_index;
+	}
+
+	// Queues are created once async compute is settled - the compute family only joins when it is used
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.transferFamily };
+	if (async_compute)
+	{
+		uniqueQueueFamilies.insert(compute_family_index);
+	}
 	float queue_priority[]{ 1.0f };
 
 	// Iterate through all Queue Families for GPU
@@ -435,9 +783,18 @@ void Renderer::createLogicalDevice()
 		queueCreateInfos.push_back(create_info);
 	}
 
-	// Specify device's features used with physical device - [!] Fill feature support in later when renderer advances 
-	VkPhysicalDeviceFeatures device_features{};
-
+	// Optional feature structs chain off the device create info
+	void* feature_chain = nullptr;
+	if (descriptor_indexing)
+	{
+		indexing_features.pNext = feature_chain;
+		feature_chain = &indexing_features;
+	}
+	if (timeline_semaphore)
+	{
+		timeline_features.pNext = feature_chain;
+		feature_chain = &timeline_features;
+	}
 
 	// Create Device Info - Logical Device
 	VkDeviceCreateInfo device_create_info{};
@@ -445,8 +802,9 @@ void Renderer::createLogicalDevice()
 	device_create_info.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	device_create_info.pQueueCreateInfos = queueCreateInfos.data();
 	device_create_info.pEnabledFeatures = &device_features;
-	device_create_info.enabledExtensionCount = static_cast<uint32_t> (deviceExtensions.size());		// [!] Fill in logical extensions later
-	device_create_info.ppEnabledExtensionNames = deviceExtensions.data();		// [!] Fill in logical extensions later
+	device_create_info.pNext = feature_chain;
+	device_create_info.enabledExtensionCount = static_cast<uint32_t> (enabled_extensions.size());
+	device_create_info.ppEnabledExtensionNames = enabled_extensions.data();
 	
 	// Validation Layer Support for Logical Device
 	if (enableValidationLayers)
@@ -469,6 +827,24 @@ void Renderer::createLogicalDevice()
 	// Get Logical Device Queue Handles
 	vkGetDeviceQueue(device, queue_family_index, 0, &graphics_queue);
 	vkGetDeviceQueue(device, present_family_index, 0, &present_queue);
+	vkGetDeviceQueue(device, transfer_family_index, 0, &transfer_queue);
+	if (async_compute)
+	{
+		vkGetDeviceQueue(device, compute_family_index, 0, &compute_queue);
+	}
+
+	if (draw_indirect_count)
+	{
+		cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+		draw_indirect_count = cmdDrawIndexedIndirectCount != nullptr;
+	}
+
+	if (display_timing)
+	{
+		getPastPresentationTiming = (PFN_vkGetPastPresentationTimingGOOGLE)vkGetDeviceProcAddr(device, "vkGetPastPresentationTimingGOOGLE");
+		getRefreshCycleDuration = (PFN_vkGetRefreshCycleDurationGOOGLE)vkGetDeviceProcAddr(device, "vkGetRefreshCycleDurationGOOGLE");
+		display_timing = getPastPresentationTiming != nullptr && getRefreshCycleDuration != nullptr;
+	}
 
 }
 
@@ -510,28 +886,25 @@ Renderer::SwapChainProperties Renderer::querySwapChainProp(VkPhysicalDevice devi
 
 void Renderer::setSwapChainProp(SwapChainProperties& availableProperties)
 {
-	// Set Surface Format
+	// Set Surface Format - sRGB BGRA when offered, otherwise the surface's first format
+	availableProperties.format = availableProperties.surfaceFormats[0];
 	for (const auto& availableFormat : availableProperties.surfaceFormats) {
 		if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
 			availableProperties.format = availableFormat;
 			break;
 		}
-		else
-		{
-			availableProperties.format = availableProperties.surfaceFormats[0];
-		}
 	}
 
-	// Set Presentation Mode
-	for (const auto& availablePresentMode : availableProperties.presentModes) {
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-			availableProperties.mode = availablePresentMode;
-			break;
-		}
-		else
-		{
-			availableProperties.mode = VK_PRESENT_MODE_FIFO_KHR;
-		}
+	// Set Presentation Mode - the requested mode when offered, otherwise FIFO which every surface supports
+	const std::vector<VkPresentModeKHR>& modes = availableProperties.presentModes;
+	availableProperties.mode = VK_PRESENT_MODE_FIFO_KHR;
+	if (std::find(modes.begin(), modes.end(), requested_present_mode) != modes.end())
+	{
+		availableProperties.mode = requested_present_mode;
+	}
+	else if (requested_present_mode != VK_PRESENT_MODE_FIFO_KHR)
+	{
+		std::cout << "[!] Present mode " << presentModeName(requested_present_mode) << " is not supported - using FIFO" << std::endl;
 	}
 
 	// Set Resolution Extent Capabilities
@@ -541,25 +914,18 @@ void Renderer::setSwapChainProp(SwapChainProperties& availableProperties)
 	}
 	else 
 	{
+		// The surface lets us pick - use the framebuffer size within the supported range
 		int width, height;
 		glfwGetFramebufferSize(window, &width, &height);
 
-
-		VkExtent2D actualExtent = {
-			static_cast<uint32_t>(width),
-			static_cast<uint32_t>(height)
-		};
-
-		availableProperties.extent.height = actualExtent.height;
-		availableProperties.extent.width = actualExtent.width;
-
-		throw std::runtime_error("[!] Resolution Error: Swap Chain Extent is set past the maximum!");
-		std::exit(-1);
+		const VkSurfaceCapabilitiesKHR& capabilities = availableProperties.extentCapabilities;
+		availableProperties.extent.width = CLAMP(static_cast<uint32_t>(width), capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+		availableProperties.extent.height = CLAMP(static_cast<uint32_t>(height), capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
 	}
 }
 
 
-void Renderer::createSwapChain()
+void Renderer::createSwapChain(VkSwapchainKHR old_swap_chain)
 {
 	// Query Physical Device's Swap Chain Properties
 	SwapChainProperties swapChainProperties = querySwapChainProp(physical_device);
@@ -608,7 +974,7 @@ void Renderer::createSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = swapChainProperties.mode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = old_swap_chain;								// Lets the driver hand over resources from the chain being replaced
 
 	// Swap Chain Creation Error Handling
 	if (errorHandler(vkCreateSwapchainKHR(device, &createInfo, nullptr, &swap_chain)) != VK_SUCCESS)
@@ -624,6 +990,39 @@ void Renderer::createSwapChain()
 
 	swap_chain_image_format = swapChainProperties.format.format;
 	swap_chain_extent = swapChainProperties.extent;
+	present_mode = swapChainProperties.mode;
+	supportedPresentModes = swapChainProperties.presentModes;
+
+	if (display_timing)
+	{
+		VkRefreshCycleDurationGOOGLE refresh_cycle{};
+		getRefreshCycleDuration(device, swap_chain, &refresh_cycle);
+		refresh_duration_ns = refresh_cycle.refreshDuration;
+	}
+}
+
+
+void Renderer::setPresentMode(VkPresentModeKHR mode)
+{
+	if (headless || mode == requested_present_mode)
+	{
+		return;
+	}
+	requested_present_mode = mode;
+	present_mode_changed = true;
+}
+
+
+const char* Renderer::presentModeName(VkPresentModeKHR mode)
+{
+	switch (mode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:		return "IMMEDIATE";
+	case VK_PRESENT_MODE_MAILBOX_KHR:		return "MAILBOX";
+	case VK_PRESENT_MODE_FIFO_KHR:			return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:	return "FIFO_RELAXED";
+	default:								return "UNKNOWN";
+	}
 }
 
 
@@ -658,186 +1057,411 @@ void Renderer::createImageViews()
 }
 
 
-VkShaderModule Renderer::createShaderModule(std::vector<char> &buffer)
+// Resize or Out of Date - rebuild only what depends on the swap chain images, no device wait
+bool Renderer::recreateSwapChain()
 {
-	VkShaderModule shaderModule;
-	VkShaderModuleCreateInfo create_info{};
-	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	create_info.codeSize = buffer.size();
-	create_info.pCode = reinterpret_cast<const uint32_t*> (buffer.data());
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	if (width == 0 || height == 0)
+	{
+		// Minimized - a zero sized swap chain is invalid, try again once the window is restored
+		swap_chain_stale = true;
+		return false;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Frames already submitted may still render into or present from the old chain
+	RetiredSwapChain retired;
+	retired.swapChain = swap_chain;
+	retired.imageViews = std::move(swapChainImageViews);
+	retired.frameBuffers = std::move(swapChainFrameBuffers);
+	retired.renderFinishedSemaphores = std::move(renderFinishedSemaphores);
+	retired.frameNumber = submitted_frames;
+	retiredSwapChains.push_back(std::move(retired));
+
+	// Render pass & pipelines are kept - the surface format does not change and viewport/scissor are dynamic
+	createSwapChain(retiredSwapChains.back().swapChain);
+	createImageViews();
+	createFrameBuffers();
+	createPresentSemaphores();
+	imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
+
+	framebuffer_resized = false;
+	swap_chain_stale = false;
+	present_mode_changed = false;
 
-	if (errorHandler(vkCreateShaderModule(device, &create_info, nullptr, &shaderModule)) != VK_SUCCESS)
+	frame_stats.swapChainRecreations++;
+	frame_stats.totalRecreateMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+
+// Frame boundary - one frame later than the pipeline rule since presentation trails the fence
+void Renderer::releaseRetiredSwapChains(bool all)
+{
+	for (size_t i = 0; i < retiredSwapChains.size(); )
 	{
-		throw std::runtime_error("[!] Shader Module Error - Unable to create Shader module.");
-		std::exit(-1);
+		RetiredSwapChain& retired = retiredSwapChains[i];
+		if (!all && submitted_frames < retired.frameNumber + frames_in_flight)
+		{
+			i++;
+			continue;
+		}
+
+		for (VkFramebuffer framebuffer : retired.frameBuffers)
+		{
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		}
+		for (VkImageView imageView : retired.imageViews)
+		{
+			vkDestroyImageView(device, imageView, nullptr);
+		}
+		for (VkSemaphore semaphore : retired.renderFinishedSemaphores)
+		{
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
+		vkDestroySwapchainKHR(device, retired.swapChain, nullptr);
+
+		retiredSwapChains.erase(retiredSwapChains.begin() + i);
 	}
-	return shaderModule;
 }
 
 
-void Renderer::createGraphicsPipeline()
+// Headless Render Targets - device local images in place of swap chain images
+void Renderer::createOffscreenTargets()
 {
-	// Get Shader Vertices & Fragment from Buffer
-	auto shaderVert = readFile(SHADER_VERT_FILE_DIR);
-	auto shaderFrag = readFile(SHADER_FRAG_FILE_DIR);
-
-	// Create Shader Module
-	VkShaderModule shaderVertModule = createShaderModule(shaderVert);
-	VkShaderModule shaderFragModule = createShaderModule(shaderFrag);
-
-	// Create Shader Vertices Stage
-	VkPipelineShaderStageCreateInfo vert_create_info {};
-	vert_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vert_create_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vert_create_info.module = shaderVertModule;
-	vert_create_info.pName = "main";
-
-	// Create Shader Fragment Stage
-	VkPipelineShaderStageCreateInfo frag_create_info{};
-	frag_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	frag_create_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	frag_create_info.module = shaderFragModule;
-	frag_create_info.pName = "main";
-
-	// Create Shader Stages from Fragments & Verticies
-	VkPipelineShaderStageCreateInfo stages[] = { vert_create_info, frag_create_info };
-
-	// Create Vertices
-	VkPipelineVertexInputStateCreateInfo vertex_input_create_info{};
-	vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_create_info.vertexBindingDescriptionCount = 0;
-	vertex_input_create_info.pVertexAttributeDescriptions = 0;
-
-	VkPipelineInputAssemblyStateCreateInfo assembly_create_info{};
-	assembly_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	assembly_create_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	assembly_create_info.primitiveRestartEnable = VK_FALSE;
-
-	// Create Viewport
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)swap_chain_extent.width;
-	viewport.height = (float)swap_chain_extent.height;
+	swap_chain_image_format = OFFSCREEN_IMAGE_FORMAT;
+	swap_chain_extent = { target_width, target_height };
 
-	// Create Scissor for viewport
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = swap_chain_extent;
+	swapChainImages.resize(frames_in_flight);
+	offscreenImageAllocations.resize(frames_in_flight);
 
-	// Create Viewport Pipeline
-	VkPipelineViewportStateCreateInfo viewport_create_info{};
-	viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewport_create_info.viewportCount = 1;
-	viewport_create_info.pViewports = &viewport;
-	viewport_create_info.scissorCount = 1;  // Currently only 1 scissor implemented
-	viewport_create_info.pScissors = &scissor;
-
-	// Create Rasterizor
-	VkPipelineRasterizationStateCreateInfo rasterizer_create_info{};
-	rasterizer_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer_create_info.depthClampEnable = VK_FALSE;
-	rasterizer_create_info.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer_create_info.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer_create_info.lineWidth = 1.0f;
-	rasterizer_create_info.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer_create_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	rasterizer_create_info.depthBiasEnable = VK_FALSE;
-
-	// Create Multisampling
-	VkPipelineMultisampleStateCreateInfo multisample_create_info{};
-	multisample_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisample_create_info.sampleShadingEnable = VK_FALSE;
-	multisample_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;						// Come back and play around with this value
-
-	// Create Color Blend Attachments
-	VkPipelineColorBlendAttachmentState color_blend_attachment{};
-	color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	color_blend_attachment.blendEnable = VK_FALSE;
-
-	// Create Color Blending Pipeline
-	VkPipelineColorBlendStateCreateInfo color_blend_create_info{};
-	color_blend_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	color_blend_create_info.logicOpEnable = VK_FALSE;
-	color_blend_create_info.logicOp = VK_LOGIC_OP_COPY;
-	color_blend_create_info.attachmentCount = 1;
-	color_blend_create_info.pAttachments = &color_blend_attachment;
-	color_blend_create_info.blendConstants[0] = 0.0f;
-	color_blend_create_info.blendConstants[1] = 0.0f;
-	color_blend_create_info.blendConstants[2] = 0.0f;
-	color_blend_create_info.blendConstants[3] = 0.0f;
-
-	// Create Pipeline Layout
-	VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
-	pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipeline_layout_create_info.setLayoutCount = 0;
-	pipeline_layout_create_info.pushConstantRangeCount = 0;
+	MemoryAllocationCreateInfo image_memory_info{};
+	image_memory_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	image_memory_info.optimalImage = true;
 
-	// Pipeline layout error handling
-	if (errorHandler(vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipelineLayout)) != VK_SUCCESS)
+	for (uint32_t i = 0; i < frames_in_flight; i++)
 	{
-		throw std::runtime_error("[!] Failed to create pipeline layout!");
-		std::exit(-1);
-	}
+		VkImageCreateInfo image_create_info{};
+		image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_create_info.imageType = VK_IMAGE_TYPE_2D;
+		image_create_info.format = swap_chain_image_format;
+		image_create_info.extent = { swap_chain_extent.width, swap_chain_extent.height, 1 };
+		image_create_info.mipLevels = 1;
+		image_create_info.arrayLayers = 1;
+		image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (errorHandler(vkCreateImage(device, &image_create_info, nullptr, &swapChainImages[i])) != VK_SUCCESS)
+		{
+			throw std::runtime_error("[!] Failed to create offscreen image!");
+			std::exit(-1);
+		}
 
-	// Create Pipeline
-	VkGraphicsPipelineCreateInfo pipeline_create_info{};
-	pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipeline_create_info.stageCount = 2;
-	pipeline_create_info.pStages = stages;
-	pipeline_create_info.pVertexInputState = &vertex_input_create_info;
-	pipeline_create_info.pInputAssemblyState = &assembly_create_info;
-	pipeline_create_info.pViewportState = &viewport_create_info;
-	pipeline_create_info.pRasterizationState = &rasterizer_create_info;
-	pipeline_create_info.pMultisampleState = &multisample_create_info;
-	pipeline_create_info.pColorBlendState = &color_blend_create_info;
-	pipeline_create_info.layout = pipelineLayout;
-	pipeline_create_info.renderPass = render_pass;
-	pipeline_create_info.subpass = 0;
-	pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
-
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &graphicsPipeline) != VK_SUCCESS) 
-	{
-		throw std::runtime_error("[!] Failed to create graphics pipeline!");
-		std::exit(-1);
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(device, swapChainImages[i], &requirements);
+
+		offscreenImageAllocations[i] = allocator.allocate(requirements, image_memory_info);
+		vkBindImageMemory(device, swapChainImages[i], offscreenImageAllocations[i].memory, offscreenImageAllocations[i].offset);
 	}
 
-	// Destroy Shader Module 
-	vkDestroyShaderModule(device, shaderFragModule, nullptr);
-	vkDestroyShaderModule(device, shaderVertModule, nullptr);
+	// Readback Ring - slots are padded to the non-coherent atom so each can be invalidated alone
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+	VkDeviceSize atom = std::max<VkDeviceSize>(device_properties.limits.nonCoherentAtomSize, 1);
+	VkDeviceSize frame_size = (VkDeviceSize)swap_chain_extent.width * swap_chain_extent.height * 4;
+	readback_slot_size = ((frame_size + atom - 1) / atom) * atom;
+
+	// Prefer cached memory for fast CPU reads - mapped once for the lifetime of the renderer
+	MemoryAllocationCreateInfo readback_memory_info{};
+	readback_memory_info.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	readback_memory_info.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	readback_memory_info.dedicated = true;
+	createBuffer(readback_slot_size * frames_in_flight, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readback_memory_info, readbackBuffer);
+
+	readbackPending.assign(frames_in_flight, false);
+	readbackFrameNumbers.assign(frames_in_flight, 0);
 }
 
 
-void Renderer::createRenderPass()
+void Renderer::destroyOffscreenTargets()
 {
-	// Color Attachment for Render Pass
-	VkAttachmentDescription color_attachment{};
-	color_attachment.format = swap_chain_image_format;
-	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	destroyBuffer(readbackBuffer);
 
-	// Color Attachment Reference
-	VkAttachmentReference color_attachment_ref{};
-	color_attachment_ref.attachment = 0;
-	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	for (size_t i = 0; i < swapChainImages.size(); i++)
+	{
+		vkDestroyImage(device, swapChainImages[i], nullptr);
+		allocator.free(offscreenImageAllocations[i]);
+	}
+	swapChainImages.clear();
+	offscreenImageAllocations.clear();
+}
 
-	// Subpass Description
-	VkSubpassDescription subpass_description{};
-	subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass_description.colorAttachmentCount = 1;
-	subpass_description.pColorAttachments = &color_attachment_ref;
 
-	// Render Pass Info
-	VkRenderPassCreateInfo render_pass_create_info{};
-	render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	render_pass_create_info.attachmentCount = 1;
-	render_pass_create_info.pAttachments = &color_attachment;
-	render_pass_create_info.subpassCount = 1;
+// On-disk pipeline cache header - the driver's own header lacks the driver version
+struct PipelineCacheFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint64_t checksum;											// FNV-1a of the cache data
+};
+
+
+static uint64_t pipelineCacheChecksum(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ data[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+
+void Renderer::createPipelineCache()
+{
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+	// Read the cache file - any mismatch with this device or driver starts an empty cache
+	std::vector<uint8_t> cache_data;
+	std::ifstream file(pipeline_cache_path, std::ios::binary | std::ios::ate);
+	if (!pipeline_cache_path.empty() && file.is_open())
+	{
+		size_t file_size = (size_t)file.tellg();
+		file.seekg(0);
+
+		PipelineCacheFileHeader header{};
+		bool valid = file_size >= sizeof(header) && file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		valid = valid && header.magic == PIPELINE_CACHE_MAGIC
+			&& header.version == PIPELINE_CACHE_VERSION
+			&& header.vendorID == device_properties.vendorID
+			&& header.deviceID == device_properties.deviceID
+			&& header.driverVersion == device_properties.driverVersion
+			&& std::memcmp(header.pipelineCacheUUID, device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0
+			&& header.dataSize == file_size - sizeof(header);
+
+		if (valid)
+		{
+			cache_data.resize((size_t)header.dataSize);
+			valid = file.read(reinterpret_cast<char*>(cache_data.data()), cache_data.size())
+				&& pipelineCacheChecksum(cache_data.data(), cache_data.size()) == header.checksum;
+		}
+
+		if (!valid)
+		{
+			std::cout << "[*] Pipeline cache " << pipeline_cache_path << " is stale or corrupt - rebuilding" << std::endl;
+			cache_data.clear();
+		}
+	}
+
+	VkPipelineCacheCreateInfo cache_create_info{};
+	cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cache_create_info.initialDataSize = cache_data.size();
+	cache_create_info.pInitialData = cache_data.empty() ? nullptr : cache_data.data();
+
+	if (errorHandler(vkCreatePipelineCache(device, &cache_create_info, nullptr, &pipelineCache)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create pipeline cache!");
+		std::exit(-1);
+	}
+
+	startup_stats.pipelineCacheLoaded = !cache_data.empty();
+	startup_stats.pipelineCacheBytes = cache_data.size();
+}
+
+
+void Renderer::savePipelineCache()
+{
+	if (pipeline_cache_path.empty() || pipelineCache == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	size_t data_size = 0;
+	vkGetPipelineCacheData(device, pipelineCache, &data_size, nullptr);
+	std::vector<uint8_t> cache_data(data_size);
+	if (data_size == 0 || vkGetPipelineCacheData(device, pipelineCache, &data_size, cache_data.data()) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+	PipelineCacheFileHeader header{};
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = device_properties.vendorID;
+	header.deviceID = device_properties.deviceID;
+	header.driverVersion = device_properties.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, device_properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data_size;
+	header.checksum = pipelineCacheChecksum(cache_data.data(), data_size);
+
+	// Write beside the target then rename over it, so a crash never leaves a torn cache
+	std::string temp_path = pipeline_cache_path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(cache_data.data()), data_size);
+		file.flush();
+		if (!file)
+		{
+			std::cout << "[!] Failed to write pipeline cache " << temp_path << std::endl;
+			file.close();
+			std::remove(temp_path.c_str());
+			return;
+		}
+	}
+
+	// filesystem::rename replaces an existing target on every platform, unlike std::rename on Windows
+	std::error_code error;
+	std::filesystem::rename(temp_path, pipeline_cache_path, error);
+	if (error)
+	{
+		std::cout << "[!] Failed to replace pipeline cache " << pipeline_cache_path << std::endl;
+		std::remove(temp_path.c_str());
+	}
+}
+
+
+void Renderer::createGraphicsPipeline()
+{
+	// Create Pipeline Layout - set 0 is the bindless table (empty without support), set 1 the frame uniforms
+	VkDescriptorSetLayout set_layouts[] = { descriptorManager.getBindlessLayout(), uniformSetLayout };
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(DrawConstants);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+	pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_create_info.setLayoutCount = 2;
+	pipeline_layout_create_info.pSetLayouts = set_layouts;
+	pipeline_layout_create_info.pushConstantRangeCount = 1;
+	pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+	// Pipeline layout error handling
+	if (errorHandler(vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipelineLayout)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create pipeline layout!");
+		std::exit(-1);
+	}
+
+	// The base pipeline is compiled up front - it is the fallback while variants compile
+	pipelineLibrary.init(device, pipelineCache, pipeline_threads);
+	if (!shader_archive_path.empty() && pipelineLibrary.loadArchive(shader_archive_path) && hot_reload)
+	{
+		// Reloads only rewrite the loose .spv files, which the archive shadows
+		std::cout << "[*] Shader hot reload - " << shader_archive_path << " is not updated, rebuild or rerun pack_shaders to keep the edits" << std::endl;
+	}
+	PipelineDesc base_desc = basePipelineDesc();
+	graphicsPipeline = pipelineLibrary.compile(base_desc);
+	base_pipeline = pipelineLibrary.adopt(base_desc, graphicsPipeline);
+
+	if (hot_reload)
+	{
+		startShaderHotReload();
+	}
+}
+
+
+// Description of the default pipeline - copy & modify it to request variants
+PipelineDesc Renderer::basePipelineDesc()
+{
+	auto binding_description = Vertex::getBindingDescription();
+	auto attribute_descriptions = Vertex::getAttributeDescriptions();
+
+	PipelineDesc desc;
+	desc.vertexShader = SHADER_VERT_FILE_DIR;
+	desc.fragmentShader = SHADER_FRAG_FILE_DIR;
+	desc.bindings.assign(1, binding_description);
+	desc.attributes.assign(attribute_descriptions.begin(), attribute_descriptions.end());
+	desc.layout = pipelineLayout;
+	desc.renderPass = render_pass;
+	desc.subpass = 0;
+	return desc;
+}
+
+
+PipelineHandle Renderer::requestPipelineVariant(const PipelineDesc& desc)
+{
+	return pipelineLibrary.request(desc);
+}
+
+
+void Renderer::waitForPipelines()
+{
+	pipelineLibrary.waitAll();
+}
+
+
+void Renderer::startShaderHotReload()
+{
+	shaderWatcher.addSource(SHADER_VERT_SOURCE_FILE, SHADER_VERT_FILE_DIR);
+	shaderWatcher.addSource(SHADER_FRAG_SOURCE_FILE, SHADER_FRAG_FILE_DIR);
+	shaderWatcher.addSource(INSTANCE_VERT_SOURCE_FILE, INSTANCE_VERT_FILE);
+	shaderWatcher.addSource(MESH_VERT_SOURCE_FILE, MESH_VERT_FILE);
+
+	// Runs on the watcher thread - the library queues rebuilds, swapReloadedPipelines installs them
+	shaderWatcher.start(SHADER_SOURCE_DIR, [this](const std::string& spvPath, std::vector<uint32_t>&& code) {
+		pipelineLibrary.reloadShader(spvPath, std::move(code));
+	});
+}
+
+
+// Old pipelines are retired rather than destroyed, so no vkDeviceWaitIdle is needed
+void Renderer::swapReloadedPipelines()
+{
+	if (pipelineLibrary.collectReloads(submitted_frames, frames_in_flight) > 0)
+	{
+		graphicsPipeline = pipelineLibrary.get(base_pipeline, graphicsPipeline);
+	}
+}
+
+
+void Renderer::createRenderPass()
+{
+	// Color Attachment for Render Pass
+	VkAttachmentDescription color_attachment{};
+	color_attachment.format = swap_chain_image_format;
+	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	// The frame graph's barriers transition the target in & out - no layout changes or external dependencies in here
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	// Color Attachment Reference
+	VkAttachmentReference color_attachment_ref{};
+	color_attachment_ref.attachment = 0;
+	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	// Subpass Description
+	VkSubpassDescription subpass_description{};
+	subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass_description.colorAttachmentCount = 1;
+	subpass_description.pColorAttachments = &color_attachment_ref;
+
+	// Render Pass Info
+	VkRenderPassCreateInfo render_pass_create_info{};
+	render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_create_info.attachmentCount = 1;
+	render_pass_create_info.pAttachments = &color_attachment;
+	render_pass_create_info.subpassCount = 1;
 	render_pass_create_info.pSubpasses = &subpass_description;
 
 	// Error Handling
@@ -900,16 +1524,18 @@ void Renderer::createCommandPool()
 }
 
 
-void Renderer::createCommandBuffer()
+void Renderer::createCommandBuffers()
 {
-	// Allocate Command Buffer
+	commandBuffers.resize(frames_in_flight);
+
+	// Allocate one Command Buffer per frame in flight
 	VkCommandBufferAllocateInfo command_buffer_alloc_info{};
 	command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	command_buffer_alloc_info.commandPool = commandPool;
 	command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	command_buffer_alloc_info.commandBufferCount = 1;
+	command_buffer_alloc_info.commandBufferCount = frames_in_flight;
 
-	if (errorHandler(vkAllocateCommandBuffers(device, &command_buffer_alloc_info, &commandBuffer)) != VK_SUCCESS)
+	if (errorHandler(vkAllocateCommandBuffers(device, &command_buffer_alloc_info, commandBuffers.data())) != VK_SUCCESS)
 	{
 		throw std::runtime_error("[!] Failed to allocate Command buffers!");
 		std::exit(-1);
@@ -917,138 +1543,2199 @@ void Renderer::createCommandBuffer()
 }
 
 
-void Renderer::writeCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index)
+void Renderer::createRecordWorkers()
 {
-	// Begin recording to command buffer
-	VkCommandBufferBeginInfo command_buffer_begin_info{};
-	command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	command_buffer_begin_info.flags = 0; // Optional
-	command_buffer_begin_info.pInheritanceInfo = nullptr; // Optional
+	if (record_threads == 0)
+	{
+		return;
+	}
+
+	recordWorkers.reset(new ThreadPool(record_threads));
+	recordPools.assign(frames_in_flight, std::vector<VkCommandPool>(record_threads));
+	recordSecondaries.assign(frames_in_flight, std::vector<VkCommandBuffer>(record_threads));
+
+	// Transient pools are reset whole each frame, which is cheaper than resetting buffers one at a time
+	VkCommandPoolCreateInfo pool_create_info{};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_create_info.queueFamilyIndex = queue_family_index;
 
-	if (errorHandler(vkBeginCommandBuffer(commandBuffer, &command_buffer_begin_info))!= VK_SUCCESS)
+	for (uint32_t frame = 0; frame < frames_in_flight; frame++)
 	{
-		throw std::runtime_error("[!] Failed to begin writing to Command Buffer!");
-		std::exit(-1);
+		for (uint32_t worker = 0; worker < record_threads; worker++)
+		{
+			if (vkCreateCommandPool(device, &pool_create_info, nullptr, &recordPools[frame][worker]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("[!] Failed to Create recording Command pool.");
+				std::exit(-1);
+			}
+
+			VkCommandBufferAllocateInfo command_buffer_alloc_info{};
+			command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			command_buffer_alloc_info.commandPool = recordPools[frame][worker];
+			command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			command_buffer_alloc_info.commandBufferCount = 1;
+
+			if (errorHandler(vkAllocateCommandBuffers(device, &command_buffer_alloc_info, &recordSecondaries[frame][worker])) != VK_SUCCESS)
+			{
+				throw std::runtime_error("[!] Failed to allocate secondary Command buffer!");
+				std::exit(-1);
+			}
+		}
 	}
+}
 
-	// Start the Render passing process
-	VkRenderPassBeginInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = render_pass;
-	renderPassInfo.framebuffer = swapChainFrameBuffers[image_index];
 
-	// Bind the framebuffer for the swapchain image we want to draw
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = swap_chain_extent;
+void Renderer::destroyRecordWorkers()
+{
+	recordWorkers.reset();
+	for (auto& frame_pools : recordPools)
+	{
+		for (VkCommandPool pool : frame_pools)
+		{
+			vkDestroyCommandPool(device, pool, nullptr);
+		}
+	}
+	recordPools.clear();
+	recordSecondaries.clear();
+}
 
-	// Define the size of the render area
-	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-	renderPassInfo.clearValueCount = 1;
-	renderPassInfo.pClearValues = &clearColor;
 
-	// Start render passing
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-	vkCmdEndRenderPass(commandBuffer);
+// Unbound buffer with the sharing every sub-allocated buffer uses - createBuffer & defragmentMemory both go through here
+VkBuffer Renderer::createBufferHandle(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	// Buffers touched by graphics, a dedicated transfer family & the async compute family are shared concurrently
+	std::set<uint32_t> unique_families = { queue_family_index, transfer_family_index, compute_family_index };
+	std::vector<uint32_t> families(unique_families.begin(), unique_families.end());
+
+	VkBufferCreateInfo buffer_create_info{};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = usage;
+	if (families.size() > 1)
+	{
+		buffer_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		buffer_create_info.queueFamilyIndexCount = (uint32_t)families.size();
+		buffer_create_info.pQueueFamilyIndices = families.data();
+	}
+	else
+	{
+		buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) 
+	VkBuffer buffer;
+	if (errorHandler(vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer)) != VK_SUCCESS)
 	{
-		throw std::runtime_error("failed to record command buffer!");
+		throw std::runtime_error("[!] Buffer Error - Failed to create buffer.");
 		std::exit(-1);
 	}
+	return buffer;
 }
 
 
-void Renderer::createSyncObjects()
+// Create a Buffer bound to a sub-allocation from the renderer's allocator
+void Renderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const MemoryAllocationCreateInfo& memoryInfo, GpuBuffer& buffer)
 {
-	// Create info from semaphore object
-	VkSemaphoreCreateInfo semaphoreInfo{};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	buffer.buffer = createBufferHandle(size, usage);
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer.buffer, &requirements);
+
+	buffer.allocation = allocator.allocate(requirements, memoryInfo);
+	buffer.size = size;
+	buffer.usage = usage;
+	buffer.memoryInfo = memoryInfo;
+	vkBindBufferMemory(device, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset);
+}
 
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS ||
-		vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence) != VK_SUCCESS) 
+void Renderer::destroyBuffer(GpuBuffer& buffer)
+{
+	if (buffer.buffer == VK_NULL_HANDLE)
 	{
-		throw std::runtime_error("failed to create synchronization objects for a frame!");
-		std::exit(-1);
+		return;
 	}
+	vkDestroyBuffer(device, buffer.buffer, nullptr);
+	allocator.free(buffer.allocation);
+	buffer = GpuBuffer();
 }
 
 
-void Renderer::drawFrame()
+// Uniform Ring - per frame & per draw constants in one mapped buffer behind a single dynamic descriptor
+void Renderer::createUniformRing()
 {
-	vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-	vkResetFences(device, 1, &inFlightFence);
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+	uniform_alignment = std::max<VkDeviceSize>(device_properties.limits.minUniformBufferOffsetAlignment, 16);
+	uniform_range = std::min<VkDeviceSize>(UNIFORM_RING_RANGE, device_properties.limits.maxUniformBufferRange);
+
+	uniformRing = createRingBuffer(UNIFORM_RING_SIZE + uniform_range, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, uniformBuffer);
+	uniformRing->setStartLimit(UNIFORM_RING_SIZE);
+
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo set_layout_create_info{};
+	set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_create_info.bindingCount = 1;
+	set_layout_create_info.pBindings = &binding;
+
+	if (errorHandler(vkCreateDescriptorSetLayout(device, &set_layout_create_info, nullptr, &uniformSetLayout)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create uniform descriptor set layout!");
+		std::exit(-1);
+	}
 
-	uint32_t imageIndex;
-	vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+	VkDescriptorPoolSize pool_size{};
+	pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	pool_size.descriptorCount = 1;
 
-	vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
-	writeCommandBuffer(commandBuffer, imageIndex);
+	VkDescriptorPoolCreateInfo pool_create_info{};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.maxSets = 1;
+	pool_create_info.poolSizeCount = 1;
+	pool_create_info.pPoolSizes = &pool_size;
 
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	if (errorHandler(vkCreateDescriptorPool(device, &pool_create_info, nullptr, &uniformDescriptorPool)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create uniform descriptor pool!");
+		std::exit(-1);
+	}
 
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
+	VkDescriptorSetAllocateInfo set_alloc_info{};
+	set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_alloc_info.descriptorPool = uniformDescriptorPool;
+	set_alloc_info.descriptorSetCount = 1;
+	set_alloc_info.pSetLayouts = &uniformSetLayout;
 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+	if (errorHandler(vkAllocateDescriptorSets(device, &set_alloc_info, &uniformSet)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to allocate uniform descriptor set!");
+		std::exit(-1);
+	}
 
-	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
+	// Written once - every frame & draw only changes the dynamic offset
+	VkDescriptorBufferInfo buffer_info{ uniformBuffer, 0, uniform_range };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = uniformSet;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	write.pBufferInfo = &buffer_info;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+	uniform_epoch = std::chrono::steady_clock::now();
+}
+
+
+MemoryRing* Renderer::createRingBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer)
+{
+	VkBufferCreateInfo buffer_create_info{};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = usage;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkQueueSubmit(graphics_queue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) 
+	if (errorHandler(vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer)) != VK_SUCCESS)
 	{
-		throw std::runtime_error("failed to submit draw command buffer!");
+		throw std::runtime_error("[!] Buffer Error - Failed to create ring buffer.");
 		std::exit(-1);
 	}
 
-	VkPresentInfoKHR presentInfo{};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+	// Coherent is required, not preferred - nothing on the hot path flushes
+	MemoryAllocationCreateInfo memory_info{};
+	memory_info.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	memory_info.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	MemoryRing* ring = allocator.createRing(requirements.size, requirements.memoryTypeBits, memory_info);
+	ring->setStartLimit(size);
+	vkBindBufferMemory(device, buffer, ring->memory(), 0);
+	return ring;
+}
 
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
 
-	VkSwapchainKHR swapChains[] = { swap_chain };
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapChains;
+// Every frame in flight can hold a full staging budget, plus the one being recorded
+void Renderer::createTextureStreamer()
+{
+	textureStagingRing = createRingBuffer(texture_staging_budget * (frames_in_flight + 1), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, textureStagingBuffer);
+	textureStreamer.init(device, &allocator, &descriptorManager, textureStagingRing, textureStagingBuffer, frames_in_flight,
+		texture_staging_budget, texture_memory_budget, texture_decode_threads, texture_compression_bc);
+}
 
-	presentInfo.pImageIndices = &imageIndex;
 
-	vkQueuePresentKHR(present_queue, &presentInfo);
+void Renderer::destroyTextureStreamer()
+{
+	textureStreamer.destroy();
+	vkDestroyBuffer(device, textureStagingBuffer, nullptr);
+	textureStagingBuffer = VK_NULL_HANDLE;
+	textureStagingRing = nullptr;
+}
+
+
+void Renderer::destroyUniformRing()
+{
+	vkDestroyDescriptorPool(device, uniformDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, uniformSetLayout, nullptr);
+	vkDestroyBuffer(device, uniformBuffer, nullptr);
+	uniformDescriptorPool = VK_NULL_HANDLE;
+	uniformSetLayout = VK_NULL_HANDLE;
+	uniformSet = VK_NULL_HANDLE;
+	uniformBuffer = VK_NULL_HANDLE;
+	uniformRing = nullptr;
 }
 
 
-std::vector<char> Renderer::readFile(const std::string &fileName)
+// The slot's fence retired the oldest closed frame - the others may still be reading theirs
+void Renderer::releaseUniformFrames()
 {
-	std::ifstream file(fileName, std::ios::ate | std::ios::binary);
+	while (uniformRing->pendingFrames() >= frames_in_flight)
+	{
+		uniformRing->releaseFrame();
+	}
+}
+
 
-	if (!file.is_open()) 
+UniformAllocation Renderer::allocateUniforms(VkDeviceSize size)
+{
+	MemoryAllocation allocation;
+	if (size > uniform_range || !uniformRing->allocate(size, uniform_alignment, allocation))
 	{
-		throw std::runtime_error("[!] File Error - failed to open and read in file. ");
+		throw std::runtime_error("[!] Uniform ring exhausted - raise UNIFORM_RING_SIZE or split the block.");
 		std::exit(-1);
 	}
 
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
+	UniformAllocation block;
+	block.data = allocation.mapped;
+	block.offset = (uint32_t)allocation.offset;
+	return block;
+}
+
+
+// Instance streams live in their own ring - batches are appended between frames, before the fence wait frees space
+void Renderer::createInstanceRing()
+{
+	instanceRing = createRingBuffer(INSTANCE_RING_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instanceBuffer);
+}
+
+
+void Renderer::destroyInstanceRing()
+{
+	vkDestroyBuffer(device, instanceBuffer, nullptr);
+	instanceBuffer = VK_NULL_HANDLE;
+	instanceRing = nullptr;
+	instanceBatches.clear();
+}
+
+
+void Renderer::releaseInstanceFrames()
+{
+	while (instanceRing->pendingFrames() >= frames_in_flight)
+	{
+		instanceRing->releaseFrame();
+	}
+}
+
+
+InstanceBatchWriter Renderer::appendInstances(const VkDrawIndexedIndirectCommand& mesh, uint32_t count)
+{
+	InstanceBatchWriter writer;
+	if (count == 0)
+	{
+		return writer;
+	}
+
+	// The instanced variant compiles in the background - batches draw with the base pipeline until it is ready
+	if (instanced_pipeline == PIPELINE_HANDLE_NONE)
+	{
+		PipelineDesc desc = basePipelineDesc();
+		desc.vertexShader = INSTANCE_VERT_FILE;
+		VkVertexInputBindingDescription stream_bindings[3] = {
+			{ 1, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_INSTANCE },
+			{ 2, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE },
+			{ 3, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE } };
+		VkVertexInputAttributeDescription stream_attributes[3] = {
+			{ 2, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0 },
+			{ 3, 2, VK_FORMAT_R8G8B8A8_UNORM, 0 },
+			{ 4, 3, VK_FORMAT_R32_UINT, 0 } };
+		desc.bindings.insert(desc.bindings.end(), stream_bindings, stream_bindings + 3);
+		desc.attributes.insert(desc.attributes.end(), stream_attributes, stream_attributes + 3);
+		instanced_pipeline = requestPipelineVariant(desc);
+	}
+
+	// One block per stream - each is tightly packed & bound at offset zero of its own binding
+	VkDeviceSize stream_sizes[3] = { (VkDeviceSize)count * 4 * sizeof(float), (VkDeviceSize)count * sizeof(uint32_t), (VkDeviceSize)count * sizeof(uint32_t) };
+	MemoryAllocation streams[3];
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		if (!instanceRing->allocate(stream_sizes[i], 16, streams[i]))
+		{
+			throw std::runtime_error("[!] Instance ring exhausted - raise INSTANCE_RING_SIZE or split the batch.");
+			std::exit(-1);
+		}
+	}
+
+	InstanceBatch batch;
+	batch.mesh = mesh;
+	batch.mesh.instanceCount = count;
+	batch.mesh.firstInstance = 0;
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		batch.streamOffsets[i] = streams[i].offset;
+	}
+	instanceBatches.push_back(batch);
+
+	writer.transforms = static_cast<float*>(streams[0].mapped);
+	writer.colors = static_cast<uint32_t*>(streams[1].mapped);
+	writer.ids = static_cast<uint32_t*>(streams[2].mapped);
+	writer.count = count;
+	return writer;
+}
+
+
+void Renderer::drawInstanced(const VkDrawIndexedIndirectCommand& mesh, const InstanceStreams& instances)
+{
+	InstanceBatchWriter writer = appendInstances(mesh, instances.size());
+	if (writer.count == 0)
+	{
+		return;
+	}
+	std::memcpy(writer.transforms, instances.transforms.data(), instances.transforms.size() * sizeof(float));
+	std::memcpy(writer.colors, instances.colors.data(), instances.colors.size() * sizeof(uint32_t));
+	std::memcpy(writer.ids, instances.ids.data(), instances.ids.size() * sizeof(uint32_t));
+}
+
+
+// One bind & one draw per batch, however many instances it holds
+void Renderer::recordInstancedDraws(VkCommandBuffer command_buffer)
+{
+	if (instanceBatches.empty())
+	{
+		return;
+	}
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLibrary.get(instanced_pipeline, graphicsPipeline));
+	bindFrameState(command_buffer);
+	setViewportState(command_buffer);
 
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-	file.close();
+	VkDeviceSize mesh_offset = 0;
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertexBuffer.buffer, &mesh_offset);
+	vkCmdBindIndexBuffer(command_buffer, indexBuffer.buffer, 0, index_type);
 
-	return buffer;;
+	VkBuffer stream_buffers[3] = { instanceBuffer, instanceBuffer, instanceBuffer };
+	for (const InstanceBatch& batch : instanceBatches)
+	{
+		vkCmdBindVertexBuffers(command_buffer, 1, 3, stream_buffers, batch.streamOffsets);
+		vkCmdDrawIndexed(command_buffer, batch.mesh.indexCount, batch.mesh.instanceCount, batch.mesh.firstIndex, batch.mesh.vertexOffset, 0);
+	}
 }
 
+
+// Once per command buffer - secondaries inherit none of this from the primary
+void Renderer::bindFrameState(VkCommandBuffer command_buffer)
+{
+	descriptorManager.bindBindless(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, FRAME_UNIFORM_SET, 1, &uniformSet, 1, &frame_uniform_offset);
+
+	static const DrawConstants identity;
+	vkCmdPushConstants(command_buffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawConstants), &identity);
+}
+
+
+// Staging Ring - one mapped host buffer split into chunks, each with its own command buffer & fence
+void Renderer::createStagingRing()
+{
+	VkCommandPoolCreateInfo pool_create_info{};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	pool_create_info.queueFamilyIndex = transfer_family_index;
+
+	if (vkCreateCommandPool(device, &pool_create_info, nullptr, &transferCommandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to Create Transfer Command pool.");
+		std::exit(-1);
+	}
+
+	// Host writes only - prefer coherent memory so chunks never need flushing
+	MemoryAllocationCreateInfo staging_memory_info{};
+	staging_memory_info.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	staging_memory_info.preferredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	staging_memory_info.dedicated = true;
+	createBuffer((VkDeviceSize)STAGING_CHUNK_SIZE * STAGING_CHUNK_COUNT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, staging_memory_info, stagingBuffer);
+
+	// Command buffer & fence per chunk - fences start signaled so every chunk is free
+	stagingChunks.resize(STAGING_CHUNK_COUNT);
+
+	std::vector<VkCommandBuffer> command_buffers(STAGING_CHUNK_COUNT);
+	VkCommandBufferAllocateInfo command_buffer_alloc_info{};
+	command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	command_buffer_alloc_info.commandPool = transferCommandPool;
+	command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	command_buffer_alloc_info.commandBufferCount = STAGING_CHUNK_COUNT;
+
+	if (errorHandler(vkAllocateCommandBuffers(device, &command_buffer_alloc_info, command_buffers.data())) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to allocate staging command buffers!");
+		std::exit(-1);
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (uint32_t i = 0; i < STAGING_CHUNK_COUNT; i++)
+	{
+		stagingChunks[i].commandBuffer = command_buffers[i];
+		if (vkCreateFence(device, &fenceInfo, nullptr, &stagingChunks[i].fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("[!] Failed to create staging fence!");
+			std::exit(-1);
+		}
+	}
+	staging_chunk_index = 0;
+}
+
+
+void Renderer::destroyStagingRing()
+{
+	for (auto& chunk : stagingChunks)
+	{
+		vkDestroyFence(device, chunk.fence, nullptr);
+	}
+	stagingChunks.clear();
+
+	destroyBuffer(stagingBuffer);
+	vkDestroyCommandPool(device, transferCommandPool, nullptr);
+}
+
+
+// Copy data into the staging ring and queue its transfer into dst - large uploads span several chunks
+void Renderer::uploadToBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+
+	while (size > 0)
+	{
+		StagingChunk& chunk = stagingChunks[staging_chunk_index];
+		VkDeviceSize space = STAGING_CHUNK_SIZE - chunk.used;
+		if (space == 0)
+		{
+			submitStagingChunk();
+			continue;
+		}
+
+		VkDeviceSize copy_size = std::min(space, size);
+		VkDeviceSize staging_offset = (VkDeviceSize)STAGING_CHUNK_SIZE * staging_chunk_index + chunk.used;
+		std::memcpy(static_cast<uint8_t*>(stagingBuffer.allocation.mapped) + staging_offset, src, (size_t)copy_size);
+
+		// Coalesce with the previous copy when it continues the same destination range
+		if (!chunk.copies.empty() && chunk.copies.back().first == dst &&
+			chunk.copies.back().second.srcOffset + chunk.copies.back().second.size == staging_offset &&
+			chunk.copies.back().second.dstOffset + chunk.copies.back().second.size == dstOffset)
+		{
+			chunk.copies.back().second.size += copy_size;
+		}
+		else
+		{
+			chunk.copies.push_back({ dst, { staging_offset, dstOffset, copy_size } });
+		}
+
+		chunk.used += copy_size;
+		src += copy_size;
+		dstOffset += copy_size;
+		size -= copy_size;
+	}
+}
+
+
+// Record & submit every copy queued in the current chunk, then wait for the next chunk to come free
+void Renderer::submitStagingChunk()
+{
+	StagingChunk& chunk = stagingChunks[staging_chunk_index];
+	if (chunk.used == 0)
+	{
+		return;
+	}
+
+	allocator.flush(stagingBuffer.allocation, (VkDeviceSize)STAGING_CHUNK_SIZE * staging_chunk_index, chunk.used);
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkResetCommandBuffer(chunk.commandBuffer, 0);
+	if (errorHandler(vkBeginCommandBuffer(chunk.commandBuffer, &begin_info)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to begin staging command buffer!");
+		std::exit(-1);
+	}
+
+	// One vkCmdCopyBuffer per run of copies into the same destination
+	std::vector<VkBufferCopy> regions;
+	for (size_t i = 0; i < chunk.copies.size(); i++)
+	{
+		regions.push_back(chunk.copies[i].second);
+		if (i + 1 == chunk.copies.size() || chunk.copies[i + 1].first != chunk.copies[i].first)
+		{
+			vkCmdCopyBuffer(chunk.commandBuffer, stagingBuffer.buffer, chunk.copies[i].first, static_cast<uint32_t>(regions.size()), regions.data());
+			regions.clear();
+		}
+	}
+
+	if (vkEndCommandBuffer(chunk.commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to record staging command buffer!");
+		std::exit(-1);
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &chunk.commandBuffer;
+
+	vkResetFences(device, 1, &chunk.fence);
+	if (vkQueueSubmit(transfer_queue, 1, &submitInfo, chunk.fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to submit staging copies!");
+		std::exit(-1);
+	}
+
+	// Move to the next chunk - it is reusable once its previous copies retire
+	staging_chunk_index = (staging_chunk_index + 1) % STAGING_CHUNK_COUNT;
+	StagingChunk& next = stagingChunks[staging_chunk_index];
+	vkWaitForFences(device, 1, &next.fence, VK_TRUE, UINT64_MAX);
+	next.used = 0;
+	next.copies.clear();
+}
+
+
+// Submit anything still queued and block until every upload has landed
+void Renderer::flushUploads()
+{
+	submitStagingChunk();
+
+	for (auto& chunk : stagingChunks)
+	{
+		vkWaitForFences(device, 1, &chunk.fence, VK_TRUE, UINT64_MAX);
+	}
+}
+
+
+// Replace the drawn geometry with new device local vertex & index buffers
+void Renderer::uploadMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	if (vertices.empty() || indices.empty())
+	{
+		throw std::runtime_error("[!] Mesh Error - Vertex and index data must not be empty.");
+		std::exit(-1);
+	}
+
+	// Old buffers may still be referenced by frames in flight - retired rather than waited on
+	retireBuffer(vertexBuffer);
+	retireBuffer(indexBuffer);
+
+	// Long lived & relocatable by defragmentMemory, hence TRANSFER_SRC
+	MemoryAllocationCreateInfo memory_info{};
+	memory_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	VkBufferUsageFlags transfer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	VkDeviceSize vertex_size = sizeof(Vertex) * vertices.size();
+	createBuffer(vertex_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | transfer_usage, memory_info, vertexBuffer);
+	uploadToBuffer(vertexBuffer.buffer, 0, vertices.data(), vertex_size);
+
+	// 16-bit indices halve index bandwidth whenever every vertex is addressable
+	index_count = static_cast<uint32_t>(indices.size());
+	if (vertices.size() <= UINT16_MAX)
+	{
+		std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+		index_type = VK_INDEX_TYPE_UINT16;
+		createBuffer(sizeof(uint16_t) * short_indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | transfer_usage, memory_info, indexBuffer);
+		uploadToBuffer(indexBuffer.buffer, 0, short_indices.data(), sizeof(uint16_t) * short_indices.size());
+	}
+	else
+	{
+		index_type = VK_INDEX_TYPE_UINT32;
+		createBuffer(sizeof(uint32_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | transfer_usage, memory_info, indexBuffer);
+		uploadToBuffer(indexBuffer.buffer, 0, indices.data(), sizeof(uint32_t) * indices.size());
+	}
+
+	flushUploads();
+
+	// Default to one draw of the whole mesh
+	drawList.assign(1, VkDrawIndexedIndirectCommand{ index_count, 1, 0, 0, 0 });
+}
+
+
+void Renderer::destroyMeshBuffers()
+{
+	destroyBuffer(indexBuffer);
+	destroyBuffer(vertexBuffer);
+	index_count = 0;
+	releaseRetiredBuffers(true);
+}
+
+
+void Renderer::retireBuffer(GpuBuffer& buffer)
+{
+	if (buffer.buffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	retiredBuffers.push_back({ buffer, submitted_frames });
+	buffer = GpuBuffer();
+}
+
+
+// Same rule as retired pipelines - every frame before submitted_frames + 1 - frames_in_flight has signaled its fence
+void Renderer::releaseRetiredBuffers(bool all)
+{
+	for (size_t i = 0; i < retiredBuffers.size(); )
+	{
+		if (!all && submitted_frames + 1 < retiredBuffers[i].frameNumber + frames_in_flight)
+		{
+			i++;
+			continue;
+		}
+		destroyBuffer(retiredBuffers[i].buffer);
+		retiredBuffers.erase(retiredBuffers.begin() + i);
+	}
+}
+
+
+ModelHandle Renderer::loadModel(const std::string& path)
+{
+	MeshContainer mesh;
+	if (!mesh.open(path))
+	{
+		throw std::runtime_error("[!] Mesh Error - Failed to load model " + path);
+		std::exit(-1);
+	}
+	return loadModel(mesh);
+}
+
+
+// No parsing - the blobs go from the mapping into the staging ring as they are
+ModelHandle Renderer::loadModel(const MeshContainer& mesh)
+{
+	const MeshContainerHeader& header = mesh.getHeader();
+
+	MemoryAllocationCreateInfo memory_info{};
+	memory_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	VkBufferUsageFlags transfer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	Model model;
+	createBuffer(header.vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | transfer_usage, memory_info, model.vertexBuffer);
+	uploadToBuffer(model.vertexBuffer.buffer, 0, mesh.vertexData(), header.vertexSize);
+	createBuffer(header.indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | transfer_usage, memory_info, model.indexBuffer);
+	uploadToBuffer(model.indexBuffer.buffer, 0, mesh.indexData(), header.indexSize);
+	flushUploads();
+
+	model.indexType = mesh.indexType();
+	model.submeshes.assign(mesh.submeshes(), mesh.submeshes() + header.submeshCount);
+	model.meshlets.assign(mesh.meshlets(), mesh.meshlets() + header.meshletCount);
+	std::memcpy(model.boundsMin, header.boundsMin, sizeof(model.boundsMin));
+	std::memcpy(model.boundsMax, header.boundsMax, sizeof(model.boundsMax));
+	std::memcpy(model.positionScale, header.positionScale, sizeof(model.positionScale));
+	std::memcpy(model.positionOffset, header.positionOffset, sizeof(model.positionOffset));
+	model.lodCount = mesh.lodCount();
+	model.lods.assign(mesh.lods(), mesh.lods() + header.submeshCount * header.lodCount);
+	model.lodErrors.assign(model.lodCount, 0.0f);
+	model.lodTriangles.assign(model.lodCount, 0);
+	for (uint32_t s = 0; s < header.submeshCount; s++)
+	{
+		for (uint32_t level = 0; level < model.lodCount; level++)
+		{
+			const MeshContainerLod& lod = model.lods[s * model.lodCount + level];
+			model.lodErrors[level] = std::max(model.lodErrors[level], lod.error);
+			model.lodTriangles[level] += lod.indexCount / 3;
+		}
+	}
+
+	// The container's attribute table is the vertex input - models sharing a layout share the pipeline
+	std::vector<uint32_t> layout_key = { header.vertexStride };
+	for (uint32_t i = 0; i < header.attributeCount; i++)
+	{
+		layout_key.push_back(mesh.attributes()[i].semantic);
+		layout_key.push_back(mesh.attributes()[i].format);
+		layout_key.push_back(mesh.attributes()[i].offset);
+	}
+
+	auto found = modelPipelines.find(layout_key);
+	if (found == modelPipelines.end())
+	{
+		PipelineDesc desc = basePipelineDesc();
+		desc.vertexShader = MESH_VERT_FILE;
+		desc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		desc.bindings.assign(1, { 0, header.vertexStride, VK_VERTEX_INPUT_RATE_VERTEX });
+		desc.attributes.clear();
+		for (uint32_t i = 0; i < header.attributeCount; i++)
+		{
+			const MeshContainerAttribute& attribute = mesh.attributes()[i];
+			desc.attributes.push_back({ attribute.semantic, 0, (VkFormat)attribute.format, attribute.offset });
+			if (attribute.semantic == MESH_ATTRIBUTE_NORMAL && attribute.format == VK_FORMAT_R16G16_SNORM)
+			{
+				desc.specialization = { 1 };	// OCTAHEDRAL_NORMALS
+			}
+		}
+		found = modelPipelines.emplace(layout_key, requestPipelineVariant(desc)).first;
+	}
+	model.pipeline = found->second;
+
+	models.push_back(std::move(model));
+	return (ModelHandle)(models.size() - 1);
+}
+
+
+VkDeviceSize Renderer::getModelVertexBytes(ModelHandle model) const
+{
+	return models[model].vertexBuffer.size;
+}
+
+
+// Level of detail from the bounding sphere's projected error - pixels per object space unit at the sphere's nearest
+// depth. Clip w & y are unit view axes scaled by the projection, so both are read straight off viewProjection.
+uint32_t Renderer::selectModelLod(ModelHandle model, const float matrix[16], uint32_t current) const
+{
+	const Model& source = models[model];
+	if (source.lodCount == 1 || lod_error_pixels <= 0.0f)
+	{
+		return 0;
+	}
+
+	float center[3];
+	float scale = 0.0f;
+	for (int row = 0; row < 3; row++)
+	{
+		center[row] = matrix[12 + row];
+		for (int column = 0; column < 3; column++)
+		{
+			center[row] += matrix[column * 4 + row] * (source.boundsMin[column] + source.boundsMax[column]) * 0.5f;
+		}
+	}
+	for (int column = 0; column < 3; column++)
+	{
+		const float* axis = &matrix[column * 4];
+		scale = std::max(scale, std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]));
+	}
+	float radius = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = (source.boundsMax[axis] - source.boundsMin[axis]) * 0.5f;
+		radius += extent * extent;
+	}
+	radius = std::sqrt(radius) * scale;
+
+	const float* vp = frame_uniforms.viewProjection;
+	float w = vp[3] * center[0] + vp[7] * center[1] + vp[11] * center[2] + vp[15];
+	float depth_scale = std::sqrt(vp[3] * vp[3] + vp[7] * vp[7] + vp[11] * vp[11]);
+	float height_scale = std::sqrt(vp[1] * vp[1] + vp[5] * vp[5] + vp[9] * vp[9]);
+	if (w + radius * depth_scale <= 0.0f)
+	{
+		return source.lodCount - 1;							// Entirely behind the camera
+	}
+	float nearest = w - radius * depth_scale;
+	if (nearest <= 1e-6f)
+	{
+		return 0;											// Camera inside the bounds
+	}
+
+	float pixels_per_unit = height_scale * scale * 0.5f * (float)swap_chain_extent.height / nearest;
+	float threshold = lod_error_pixels * lod_error_scale / std::max(pixels_per_unit, 1e-20f);
+
+	// Refine past anything over the threshold, coarsen only well under it
+	uint32_t level = current < source.lodCount ? current : 0;
+	float coarsen = current < source.lodCount ? threshold * (1.0f - MODEL_LOD_HYSTERESIS) : threshold;
+	while (level > 0 && source.lodErrors[level] > threshold)
+	{
+		level--;
+	}
+	while (level + 1 < source.lodCount && source.lodErrors[level + 1] <= coarsen)
+	{
+		level++;
+	}
+	return level;
+}
+
+
+void Renderer::drawModel(ModelHandle model, const DrawConstants& constants, uint32_t* lod)
+{
+	uint32_t level = selectModelLod(model, constants.model, lod ? *lod : UINT32_MAX);
+	if (lod)
+	{
+		*lod = level;
+	}
+
+	// Fold dequantization into the model matrix - model * translate(offset) * scale(scale), column major
+	const Model& source = models[model];
+	model_triangles += source.lodTriangles[level];
+	ModelDraw draw{ model, level, constants };
+	for (int column = 0; column < 3; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			draw.constants.model[12 + row] += constants.model[column * 4 + row] * source.positionOffset[column];
+			draw.constants.model[column * 4 + row] = constants.model[column * 4 + row] * source.positionScale[column];
+		}
+	}
+	modelDraws.push_back(draw);
+}
+
+
+// Models whose pipeline is still compiling are skipped - the base pipeline reads a different vertex layout
+void Renderer::recordModelDraws(VkCommandBuffer command_buffer)
+{
+	if (modelDraws.empty())
+	{
+		return;
+	}
+
+	bindFrameState(command_buffer);
+	setViewportState(command_buffer);
+
+	VkPipeline bound_pipeline = VK_NULL_HANDLE;
+	ModelHandle bound_model = UINT32_MAX;
+	for (const ModelDraw& draw : modelDraws)
+	{
+		const Model& model = models[draw.model];
+		VkPipeline pipeline = pipelineLibrary.get(model.pipeline, VK_NULL_HANDLE);
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		if (pipeline != bound_pipeline)
+		{
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			bound_pipeline = pipeline;
+		}
+		if (draw.model != bound_model)
+		{
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(command_buffer, 0, 1, &model.vertexBuffer.buffer, &offset);
+			vkCmdBindIndexBuffer(command_buffer, model.indexBuffer.buffer, 0, model.indexType);
+			bound_model = draw.model;
+		}
+
+		vkCmdPushConstants(command_buffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawConstants), &draw.constants);
+		for (size_t s = 0; s < model.submeshes.size(); s++)
+		{
+			const MeshContainerLod& lod = model.lods[s * model.lodCount + draw.lod];
+			vkCmdDrawIndexed(command_buffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+		}
+	}
+}
+
+
+void Renderer::destroyModels()
+{
+	for (Model& model : models)
+	{
+		destroyBuffer(model.indexBuffer);
+		destroyBuffer(model.vertexBuffer);
+	}
+	models.clear();
+	modelDraws.clear();
+	modelPipelines.clear();
+}
+
+
+// Node render states carry each draw's level of detail between frames
+void Renderer::drawScene()
+{
+	const SceneMatrix* world = scene.worldTransforms();
+	const uint32_t* handles = scene.renderHandles();
+	uint32_t* states = scene.renderStates();
+	DrawConstants constants{};
+	for (uint32_t i = 0; i < scene.size(); i++)
+	{
+		if (handles[i] >= models.size())
+		{
+			continue;
+		}
+		std::memcpy(constants.model, world[i].m, sizeof(constants.model));
+		drawModel(handles[i], constants, &states[i]);
+	}
+}
+
+
+// Surface triangle counts fall with the square of the error, so the threshold moves by the square root of the overshoot.
+// Takes effect from the next frame's selections.
+void Renderer::updateLodBudget()
+{
+	frame_stats.totalModelTriangles += model_triangles;
+	if (lod_triangle_budget > 0)
+	{
+		float load = (float)model_triangles / (float)lod_triangle_budget;
+		if (load > 1.0f)
+		{
+			lod_error_scale = std::min(lod_error_scale * std::min(std::sqrt(load), 2.0f), MODEL_LOD_MAX_ERROR_SCALE);
+		}
+		else if (load < 0.75f)
+		{
+			lod_error_scale = std::max(lod_error_scale * 0.95f, 1.0f);
+		}
+	}
+	model_triangles = 0;
+}
+
+
+// Compact long lived buffers into the fewest, fullest blocks and release the rest
+void Renderer::defragmentMemory()
+{
+	// Every long lived device local buffer - staging & readback sit in dedicated blocks, the uniform, instance & texture rings in their own memory
+	std::vector<GpuBuffer*> candidates = { &vertexBuffer, &indexBuffer, &objectBuffer };
+	for (Model& model : models)
+	{
+		candidates.push_back(&model.vertexBuffer);
+		candidates.push_back(&model.indexBuffer);
+	}
+	for (uint32_t i = 0; i < indirectBuffers.size(); i++)
+	{
+		candidates.push_back(&indirectBuffers[i]);
+		candidates.push_back(&drawCountBuffers[i]);
+	}
+
+	std::vector<GpuBuffer*> buffers;
+	for (GpuBuffer* buffer : candidates)
+	{
+		if (buffer->buffer != VK_NULL_HANDLE)
+		{
+			buffers.push_back(buffer);
+		}
+	}
+
+	std::vector<MemoryAllocation*> allocations;
+	for (GpuBuffer* buffer : buffers)
+	{
+		allocations.push_back(&buffer->allocation);
+	}
+
+	std::vector<DefragmentationMove> moves = allocator.planDefragmentation(allocations);
+	if (moves.empty())
+	{
+		allocator.releaseEmptyBlocks();
+		return;
+	}
+
+	// Frames in flight may still read the buffers being moved
+	vkDeviceWaitIdle(device);
+
+	VkCommandBufferAllocateInfo command_buffer_alloc_info{};
+	command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	command_buffer_alloc_info.commandPool = transferCommandPool;
+	command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	command_buffer_alloc_info.commandBufferCount = 1;
+
+	VkCommandBuffer command_buffer;
+	if (errorHandler(vkAllocateCommandBuffers(device, &command_buffer_alloc_info, &command_buffer)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to allocate defragmentation command buffer!");
+		std::exit(-1);
+	}
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(command_buffer, &begin_info);
+
+	// Recreate each moved buffer at its new location and copy the contents across
+	std::vector<GpuBuffer> relocated(moves.size());
+	for (size_t i = 0; i < moves.size(); i++)
+	{
+		GpuBuffer& source = *buffers[moves[i].index];
+		GpuBuffer& destination = relocated[i];
+
+		destination.buffer = createBufferHandle(source.size, source.usage);
+		destination.allocation = moves[i].destination;
+		destination.size = source.size;
+		destination.usage = source.usage;
+		destination.memoryInfo = source.memoryInfo;
+		vkBindBufferMemory(device, destination.buffer, destination.allocation.memory, destination.allocation.offset);
+
+		VkBufferCopy region{ 0, 0, source.size };
+		vkCmdCopyBuffer(command_buffer, source.buffer, destination.buffer, 1, &region);
+	}
+	vkEndCommandBuffer(command_buffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &command_buffer;
+	if (vkQueueSubmit(transfer_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to submit defragmentation copies!");
+		std::exit(-1);
+	}
+	vkQueueWaitIdle(transfer_queue);
+	vkFreeCommandBuffers(device, transferCommandPool, 1, &command_buffer);
+
+	// Swap in the relocated buffers and free the old ranges
+	bool cull_buffers_moved = false;
+	for (size_t i = 0; i < moves.size(); i++)
+	{
+		GpuBuffer& source = *buffers[moves[i].index];
+		cull_buffers_moved |= (source.usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) != 0;
+		destroyBuffer(source);
+		source = relocated[i];
+	}
+	allocator.releaseEmptyBlocks();
+
+	// The culling sets still name the old handles - everything else is bound while recording
+	if (cull_buffers_moved)
+	{
+		writeCullSets();
+	}
+}
+
+
+void Renderer::createCullingPipeline()
+{
+	// Objects, indirect commands & draw count - all storage buffers
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo set_layout_create_info{};
+	set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_create_info.bindingCount = 3;
+	set_layout_create_info.pBindings = bindings;
+
+	if (errorHandler(vkCreateDescriptorSetLayout(device, &set_layout_create_info, nullptr, &cullSetLayout)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create culling descriptor set layout!");
+		std::exit(-1);
+	}
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(CullConstants);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+	pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_create_info.setLayoutCount = 1;
+	pipeline_layout_create_info.pSetLayouts = &cullSetLayout;
+	pipeline_layout_create_info.pushConstantRangeCount = 1;
+	pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+	if (errorHandler(vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &cullPipelineLayout)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create culling pipeline layout!");
+		std::exit(-1);
+	}
+
+	cullPipeline = pipelineLibrary.compileCompute(CULL_SHADER_FILE, cullPipelineLayout);
+
+	// One set per frame in flight - each points at that frame's indirect & count buffers
+	VkDescriptorPoolSize pool_size{};
+	pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_size.descriptorCount = 3 * frames_in_flight;
+
+	VkDescriptorPoolCreateInfo pool_create_info{};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.maxSets = frames_in_flight;
+	pool_create_info.poolSizeCount = 1;
+	pool_create_info.pPoolSizes = &pool_size;
+
+	if (errorHandler(vkCreateDescriptorPool(device, &pool_create_info, nullptr, &cullDescriptorPool)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create culling descriptor pool!");
+		std::exit(-1);
+	}
+
+	std::vector<VkDescriptorSetLayout> set_layouts(frames_in_flight, cullSetLayout);
+	VkDescriptorSetAllocateInfo set_alloc_info{};
+	set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_alloc_info.descriptorPool = cullDescriptorPool;
+	set_alloc_info.descriptorSetCount = frames_in_flight;
+	set_alloc_info.pSetLayouts = set_layouts.data();
+
+	cullSets.resize(frames_in_flight);
+	if (errorHandler(vkAllocateDescriptorSets(device, &set_alloc_info, cullSets.data())) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to allocate culling descriptor sets!");
+		std::exit(-1);
+	}
+
+	indirectBuffers.resize(frames_in_flight);
+	drawCountBuffers.resize(frames_in_flight);
+}
+
+
+void Renderer::destroyCullingResources()
+{
+	for (uint32_t i = 0; i < indirectBuffers.size(); i++)
+	{
+		destroyBuffer(indirectBuffers[i]);
+		destroyBuffer(drawCountBuffers[i]);
+	}
+	indirectBuffers.clear();
+	drawCountBuffers.clear();
+	destroyBuffer(objectBuffer);
+	object_count = 0;
+	object_capacity = 0;
+
+	vkDestroyPipeline(device, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, cullDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+	cullPipeline = VK_NULL_HANDLE;
+	cullPipelineLayout = VK_NULL_HANDLE;
+	cullDescriptorPool = VK_NULL_HANDLE;
+	cullSetLayout = VK_NULL_HANDLE;
+}
+
+
+// Scene load path, not per frame - waits for idle so in-flight frames never see a half written buffer
+void Renderer::setSceneObjects(const std::vector<GpuObject>& objects)
+{
+	if (!gpu_driven)
+	{
+		throw std::runtime_error("[!] setSceneObjects requires RendererConfig::gpuDriven");
+		std::exit(-1);
+	}
+
+	vkDeviceWaitIdle(device);
+	object_count = (uint32_t)objects.size();
+	if (object_count == 0)
+	{
+		return;
+	}
+
+	// Grow geometrically so repeated loads do not reallocate every time
+	if (object_count > object_capacity)
+	{
+		object_capacity = std::max(object_count, object_capacity * 2);
+
+		MemoryAllocationCreateInfo memory_info{};
+		memory_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		// Long lived & relocatable by defragmentMemory, hence TRANSFER_SRC
+		VkBufferUsageFlags transfer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		destroyBuffer(objectBuffer);
+		createBuffer(sizeof(GpuObject) * object_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | transfer_usage, memory_info, objectBuffer);
+
+		for (uint32_t i = 0; i < frames_in_flight; i++)
+		{
+			destroyBuffer(indirectBuffers[i]);
+			destroyBuffer(drawCountBuffers[i]);
+			createBuffer(sizeof(VkDrawIndexedIndirectCommand) * object_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | transfer_usage,
+				memory_info, indirectBuffers[i]);
+			createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | transfer_usage,
+				memory_info, drawCountBuffers[i]);
+		}
+		writeCullSets();
+	}
+
+	uploadToBuffer(objectBuffer.buffer, 0, objects.data(), sizeof(GpuObject) * object_count);
+	flushUploads();
+}
+
+
+// Point each frame's culling set at the object, indirect & count buffers - after a resize or a defragmentation move
+void Renderer::writeCullSets()
+{
+	for (uint32_t i = 0; i < cullSets.size(); i++)
+	{
+		VkDescriptorBufferInfo buffer_infos[3] = {
+			{ objectBuffer.buffer, 0, VK_WHOLE_SIZE },
+			{ indirectBuffers[i].buffer, 0, VK_WHOLE_SIZE },
+			{ drawCountBuffers[i].buffer, 0, VK_WHOLE_SIZE } };
+
+		VkWriteDescriptorSet writes[3] = {};
+		for (uint32_t binding = 0; binding < 3; binding++)
+		{
+			writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[binding].dstSet = cullSets[i];
+			writes[binding].dstBinding = binding;
+			writes[binding].descriptorCount = 1;
+			writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[binding].pBufferInfo = &buffer_infos[binding];
+		}
+		vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+	}
+}
+
+
+void Renderer::recordCulling(VkCommandBuffer command_buffer)
+{
+	VkBuffer count_buffer = drawCountBuffers[currentFrame].buffer;
+	vkCmdFillBuffer(command_buffer, count_buffer, 0, sizeof(uint32_t), 0);
+
+	VkBufferMemoryBarrier clear_barrier{};
+	clear_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	clear_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clear_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	clear_barrier.buffer = count_buffer;
+	clear_barrier.offset = 0;
+	clear_barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 1, &clear_barrier, 0, nullptr);
+
+	CullConstants constants{};
+	std::memcpy(constants.frustumPlanes, frustum_planes, sizeof(frustum_planes));
+	constants.objectCount = object_count;
+	constants.compact = draw_indirect_count ? 1 : 0;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullSets[currentFrame], 0, nullptr);
+	vkCmdPushConstants(command_buffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(command_buffer, (object_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+}
+
+
+// Pipelines leave viewport & scissor dynamic - every command buffer that draws sets them
+void Renderer::setViewportState(VkCommandBuffer command_buffer)
+{
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)swap_chain_extent.width;
+	viewport.height = (float)swap_chain_extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = swap_chain_extent;
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
+
+
+// CPU cost is independent of the object count on the count path
+void Renderer::recordIndirectDraws(VkCommandBuffer command_buffer, VkPipeline pipeline)
+{
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	bindFrameState(command_buffer);
+	setViewportState(command_buffer);
+
+	VkBuffer vertex_buffers[] = { vertexBuffer.buffer };
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
+	vkCmdBindIndexBuffer(command_buffer, indexBuffer.buffer, 0, index_type);
+
+	VkBuffer indirect_buffer = indirectBuffers[currentFrame].buffer;
+	uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (draw_indirect_count)
+	{
+		cmdDrawIndexedIndirectCount(command_buffer, indirect_buffer, 0, drawCountBuffers[currentFrame].buffer, 0, object_count, stride);
+	}
+	else if (multi_draw_indirect)
+	{
+		vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer, 0, object_count, stride);
+	}
+	else
+	{
+		// Without multiDrawIndirect each draw is its own call - culled ones have instanceCount 0
+		for (uint32_t i = 0; i < object_count; i++)
+		{
+			vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer, (VkDeviceSize)i * stride, 1, stride);
+		}
+	}
+}
+
+
+// Safe to call from recording workers - reads renderer state only
+void Renderer::recordDraws(VkCommandBuffer command_buffer, VkPipeline pipeline, size_t first, size_t count)
+{
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	bindFrameState(command_buffer);
+	setViewportState(command_buffer);
+
+	VkBuffer vertex_buffers[] = { vertexBuffer.buffer };
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
+	vkCmdBindIndexBuffer(command_buffer, indexBuffer.buffer, 0, index_type);
+
+	// Per draw transforms ride in push constants - nothing is allocated or written to memory per draw
+	bool per_draw_constants = drawConstants.size() >= first + count;
+	for (size_t i = first; i < first + count; i++)
+	{
+		const VkDrawIndexedIndirectCommand& draw = drawList[i];
+		if (per_draw_constants)
+		{
+			vkCmdPushConstants(command_buffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawConstants), &drawConstants[i]);
+		}
+		vkCmdDrawIndexed(command_buffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+	}
+}
+
+
+void Renderer::writeCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+	// Begin recording to command buffer
+	VkCommandBufferBeginInfo command_buffer_begin_info{};
+	command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	command_buffer_begin_info.flags = 0; // Optional
+	command_buffer_begin_info.pInheritanceInfo = nullptr; // Optional
+
+	if (errorHandler(vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info))!= VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to begin writing to Command Buffer!");
+		std::exit(-1);
+	}
+
+	// One copy of the frame uniforms - every draw & secondary reads it through the same dynamic offset
+	frame_uniforms.extent[0] = (float)swap_chain_extent.width;
+	frame_uniforms.extent[1] = (float)swap_chain_extent.height;
+	frame_uniforms.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - uniform_epoch).count();
+	frame_uniforms.frameNumber = (uint32_t)submitted_frames;
+	frame_uniform_offset = pushUniforms(frame_uniforms);
+
+	// Split the draw list across workers once it is large enough to pay for the hand off
+	uint32_t job_count = 0;
+	if (recordWorkers && !gpu_driven)
+	{
+		job_count = (uint32_t)std::min<size_t>(record_threads, drawList.size() / PARALLEL_RECORD_MIN_DRAWS);
+	}
+
+	// Draw with the base pipeline until the active variant has finished compiling
+	VkPipeline pipeline = pipelineLibrary.get(active_pipeline, graphicsPipeline);
+
+	buildFrameGraph(image_index, [this, image_index, job_count, pipeline](VkCommandBuffer command_buffer) {
+		// Start the Render passing process
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = render_pass;
+		renderPassInfo.framebuffer = swapChainFrameBuffers[image_index];
+
+		// Bind the framebuffer for the swapchain image we want to draw
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = swap_chain_extent;
+
+		// Define the size of the render area
+		VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		// Start render passing
+		if (job_count < 2)
+		{
+			vkCmdBeginRenderPass(command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			GpuProfileScope draw_scope(gpuProfiler, command_buffer, "Draws");
+			if (gpu_driven && object_count > 0)
+			{
+				recordIndirectDraws(command_buffer, pipeline);
+			}
+			else
+			{
+				recordDraws(command_buffer, pipeline, 0, drawList.size());
+			}
+			recordInstancedDraws(command_buffer);
+			recordModelDraws(command_buffer);
+		}
+		else
+		{
+			vkCmdBeginRenderPass(command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+			// Each job owns the pool it records from, so no two threads ever touch the same pool
+			std::vector<std::future<void>> jobs;
+			size_t slice = (drawList.size() + job_count - 1) / job_count;
+			for (uint32_t job = 0; job < job_count; job++)
+			{
+				size_t first = job * slice;
+				size_t count = std::min(slice, drawList.size() - first);
+				VkCommandPool pool = recordPools[currentFrame][job];
+				VkCommandBuffer secondary = recordSecondaries[currentFrame][job];
+				VkFramebuffer framebuffer = renderPassInfo.framebuffer;
+
+				jobs.push_back(recordWorkers->submit([this, pool, secondary, framebuffer, pipeline, first, count]() {
+					vkResetCommandPool(device, pool, 0);
+
+					VkCommandBufferInheritanceInfo inheritance_info{};
+					inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+					inheritance_info.renderPass = render_pass;
+					inheritance_info.subpass = 0;
+					inheritance_info.framebuffer = framebuffer;
+
+					VkCommandBufferBeginInfo secondary_begin_info{};
+					secondary_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+					secondary_begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+					secondary_begin_info.pInheritanceInfo = &inheritance_info;
+
+					vkBeginCommandBuffer(secondary, &secondary_begin_info);
+					recordDraws(secondary, pipeline, first, count);
+					if (first + count == drawList.size())
+					{
+						recordInstancedDraws(secondary);
+						recordModelDraws(secondary);
+					}
+					vkEndCommandBuffer(secondary);
+				}));
+			}
+
+			for (auto& job : jobs)
+			{
+				job.get();
+			}
+			vkCmdExecuteCommands(command_buffer, job_count, recordSecondaries[currentFrame].data());
+		}
+		vkCmdEndRenderPass(command_buffer);
+	});
+
+	// Compute passes go out first on their own queue - graphics waits only where it consumes their output
+	if (frameGraph.hasWork(FrameGraphQueue::Compute))
+	{
+		submitAsyncCompute();
+	}
+
+	// Resolves the queries this ring slot wrote last time around, then resets them
+	gpuProfiler.beginFrame(command_buffer, currentFrame, submitted_frames);
+	uint32_t frame_scope = gpuProfiler.beginScope(command_buffer, "Frame");
+
+	// Statistics queries may not span secondaries without inheritedQueries - count inline frames only
+	bool record_statistics = job_count < 2;
+	if (record_statistics)
+	{
+		gpuProfiler.beginStatistics(command_buffer);
+	}
+
+	// Every pass left on the graphics queue, each behind the barriers the graph placed for it
+	frameGraph.execute(FrameGraphQueue::Graphics, command_buffer, &gpuProfiler);
+
+	if (record_statistics)
+	{
+		gpuProfiler.endStatistics(command_buffer);
+	}
+	gpuProfiler.endScope(command_buffer, frame_scope);
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) 
+	{
+		throw std::runtime_error("failed to record command buffer!");
+		std::exit(-1);
+	}
+}
+
+
+void Renderer::buildFrameGraph(uint32_t image_index, FrameGraphExecute renderPass)
+{
+	frameGraph.reset(submitted_frames);
+
+	// Contents are cleared - ready once the acquire semaphore's wait stage is reached
+	FrameGraphResource target = frameGraph.importImage("Target", swapChainImages[image_index], VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, headless ? FrameGraphAccess::None : FrameGraphAccess::Present);
+
+	// GPU driven - cull into this slot's indirect buffers
+	FrameGraphResource draw_commands = FRAME_GRAPH_NONE;
+	FrameGraphResource draw_count = FRAME_GRAPH_NONE;
+	if (gpu_driven && object_count > 0)
+	{
+		draw_commands = frameGraph.importBuffer("Indirect Draws", indirectBuffers[currentFrame].buffer);
+		draw_count = frameGraph.importBuffer("Draw Count", drawCountBuffers[currentFrame].buffer);
+
+		uint32_t cull = frameGraph.addPass("Cull", FrameGraphQueue::Compute, [this](VkCommandBuffer command_buffer) {
+			recordCulling(command_buffer);
+		});
+		frameGraph.use(cull, draw_commands, FrameGraphAccess::StorageWrite);
+		frameGraph.use(cull, draw_count, FrameGraphAccess::StorageWrite);
+	}
+
+	for (const ComputePass& compute_pass : computePasses)
+	{
+		ComputePassCallback record = compute_pass.record;
+		uint32_t slot = currentFrame;
+		uint32_t pass = frameGraph.addPass(compute_pass.name, FrameGraphQueue::Compute, [record, slot](VkCommandBuffer command_buffer) {
+			record(command_buffer, slot);
+		});
+		if (compute_pass.setup)
+		{
+			compute_pass.setup(frameGraph, pass);
+		}
+		else
+		{
+			frameGraph.setSideEffects(pass);
+		}
+	}
+
+	// Streamed textures - layout transitions are the streamer's, the images never enter the graph
+	uint32_t texture_uploads = frameGraph.addPass("Texture Uploads", FrameGraphQueue::Graphics, [this](VkCommandBuffer command_buffer) {
+		textureStreamer.recordUploads(command_buffer);
+	});
+	frameGraph.setSideEffects(texture_uploads);
+
+	uint32_t main_pass = frameGraph.addPass("Render Pass", FrameGraphQueue::Graphics, renderPass);
+	frameGraph.use(main_pass, target, FrameGraphAccess::ColorAttachment);
+	if (draw_commands != FRAME_GRAPH_NONE)
+	{
+		frameGraph.use(main_pass, draw_commands, FrameGraphAccess::IndirectRead);
+		frameGraph.use(main_pass, draw_count, FrameGraphAccess::IndirectRead);
+	}
+
+	// Headless - copy the finished target into its slot of the readback ring, host reads it once the fence signals
+	if (headless)
+	{
+		FrameGraphResource readback = frameGraph.importBuffer("Readback", readbackBuffer.buffer, readback_slot_size * image_index,
+			readback_slot_size, FrameGraphAccess::HostRead);
+
+		uint32_t copy_pass = frameGraph.addPass("Readback Copy", FrameGraphQueue::Graphics, [this, image_index](VkCommandBuffer command_buffer) {
+			VkBufferImageCopy region{};
+			region.bufferOffset = readback_slot_size * image_index;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { swap_chain_extent.width, swap_chain_extent.height, 1 };
+			vkCmdCopyImageToBuffer(command_buffer, swapChainImages[image_index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, 1, &region);
+		});
+		frameGraph.use(copy_pass, target, FrameGraphAccess::TransferRead);
+		frameGraph.use(copy_pass, readback, FrameGraphAccess::TransferWrite);
+	}
+
+	frameGraph.compile();
+}
+
+
+void Renderer::createAsyncCompute()
+{
+	if (!async_compute)
+	{
+		return;
+	}
+
+	VkCommandPoolCreateInfo pool_create_info{};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	pool_create_info.queueFamilyIndex = compute_family_index;
+
+	if (vkCreateCommandPool(device, &pool_create_info, nullptr, &computeCommandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to Create Compute Command pool.");
+		std::exit(-1);
+	}
+
+	computeCommandBuffers.resize(frames_in_flight);
+	VkCommandBufferAllocateInfo command_buffer_alloc_info{};
+	command_buffer_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	command_buffer_alloc_info.commandPool = computeCommandPool;
+	command_buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	command_buffer_alloc_info.commandBufferCount = frames_in_flight;
+
+	if (errorHandler(vkAllocateCommandBuffers(device, &command_buffer_alloc_info, computeCommandBuffers.data())) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to allocate compute command buffers!");
+		std::exit(-1);
+	}
+
+	// One timeline for every compute submit - each graphics submit waits on the value its frame signaled
+	VkSemaphoreTypeCreateInfo timeline_info{};
+	timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timeline_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timeline_info.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphore_info{};
+	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphore_info.pNext = &timeline_info;
+
+	if (vkCreateSemaphore(device, &semaphore_info, nullptr, &computeTimeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to create the compute timeline semaphore!");
+		std::exit(-1);
+	}
+	compute_timeline_value = 0;
+
+	// Signaled so the first wait on each ring slot returns immediately
+	VkFenceCreateInfo fence_info{};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	computeFences.resize(frames_in_flight);
+	for (uint32_t i = 0; i < frames_in_flight; i++)
+	{
+		if (vkCreateFence(device, &fence_info, nullptr, &computeFences[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("[!] Failed to create compute fences!");
+			std::exit(-1);
+		}
+	}
+
+	std::cout << "[*] Async compute on queue family " << compute_family_index << std::endl;
+}
+
+
+void Renderer::destroyAsyncCompute()
+{
+	if (computeCommandPool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(device, computeCommandPool, nullptr);
+	}
+	vkDestroySemaphore(device, computeTimeline, nullptr);
+	for (VkFence fence : computeFences)
+	{
+		vkDestroyFence(device, fence, nullptr);
+	}
+	computeFences.clear();
+	computeCommandPool = VK_NULL_HANDLE;
+	computeCommandBuffers.clear();
+	computeTimeline = VK_NULL_HANDLE;
+}
+
+
+// Overlaps the previous frame's graphics work
+void Renderer::submitAsyncCompute()
+{
+	// Graphics only waits where it consumes compute output, so its fence doesn't always cover this slot's last submit
+	vkWaitForFences(device, 1, &computeFences[currentFrame], VK_TRUE, UINT64_MAX);
+	vkResetFences(device, 1, &computeFences[currentFrame]);
+
+	VkCommandBuffer command_buffer = computeCommandBuffers[currentFrame];
+	vkResetCommandBuffer(command_buffer, 0);
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(command_buffer, &begin_info);
+
+	// The profiler's queries belong to the graphics queue - compute passes are only timed when they run on it
+	frameGraph.execute(FrameGraphQueue::Compute, command_buffer);
+
+	if (errorHandler(vkEndCommandBuffer(command_buffer)) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to record compute command buffer!");
+		std::exit(-1);
+	}
+
+	uint64_t signal_value = ++compute_timeline_value;
+	VkTimelineSemaphoreSubmitInfo timeline_submit_info{};
+	timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_submit_info.signalSemaphoreValueCount = 1;
+	timeline_submit_info.pSignalSemaphoreValues = &signal_value;
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pNext = &timeline_submit_info;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &computeTimeline;
+
+	if (vkQueueSubmit(compute_queue, 1, &submit_info, computeFences[currentFrame]) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to submit async compute command buffer!");
+		std::exit(-1);
+	}
+	compute_wait_value = signal_value;
+}
+
+
+// Signals this ring slot's fence - the semaphore signal/wait pair also makes the compute writes visible to the draws
+void Renderer::submitGraphics(VkCommandBuffer command_buffer, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore)
+{
+	VkSemaphore wait_semaphores[2];
+	VkPipelineStageFlags wait_stages[2];
+	uint64_t wait_values[2] = { 0, 0 };							// Ignored for binary semaphores
+	uint32_t wait_count = 0;
+
+	// Only the stages the frame graph found consuming compute output wait - none when nothing does
+	VkPipelineStageFlags compute_stages = frameGraph.waitStages(FrameGraphQueue::Graphics);
+	bool wait_compute = compute_wait_value != 0 && compute_stages != 0;
+
+	if (wait_semaphore != VK_NULL_HANDLE)
+	{
+		wait_semaphores[wait_count] = wait_semaphore;
+		wait_stages[wait_count] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		wait_count++;
+	}
+	if (wait_compute)
+	{
+		wait_semaphores[wait_count] = computeTimeline;
+		wait_stages[wait_count] = compute_stages;
+		wait_values[wait_count] = compute_wait_value;
+		wait_count++;
+	}
+
+	VkTimelineSemaphoreSubmitInfo timeline_submit_info{};
+	timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_submit_info.waitSemaphoreValueCount = wait_count;
+	timeline_submit_info.pWaitSemaphoreValues = wait_values;
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pNext = wait_compute ? &timeline_submit_info : nullptr;
+	submit_info.waitSemaphoreCount = wait_count;
+	submit_info.pWaitSemaphores = wait_semaphores;
+	submit_info.pWaitDstStageMask = wait_stages;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+	submit_info.signalSemaphoreCount = signal_semaphore != VK_NULL_HANDLE ? 1 : 0;
+	submit_info.pSignalSemaphores = &signal_semaphore;
+
+	if (vkQueueSubmit(graphics_queue, 1, &submit_info, inFlightFences[currentFrame]) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Failed to submit draw command buffer!");
+		std::exit(-1);
+	}
+	compute_wait_value = 0;
+}
+
+
+void Renderer::createSyncObjects()
+{
+	imageAvailableSemaphores.resize(frames_in_flight);
+	inFlightFences.resize(frames_in_flight);
+	imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
+
+	// Create info from semaphore object
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// Fences start signaled so the first wait on each ring slot returns immediately
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (uint32_t i = 0; i < frames_in_flight; i++)
+	{
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+			vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create synchronization objects for a frame!");
+			std::exit(-1);
+		}
+	}
+
+	// Headless frames never present
+	if (!headless)
+	{
+		createPresentSemaphores();
+	}
+}
+
+
+// Indexed by image rather than ring slot - with more images than frames in flight a slot comes round again
+// while the present of its previous image can still be waiting on the semaphore
+void Renderer::createPresentSemaphores()
+{
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	renderFinishedSemaphores.resize(swapChainImages.size());
+	for (VkSemaphore& semaphore : renderFinishedSemaphores)
+	{
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+		{
+			throw std::runtime_error("[!] Failed to create present semaphores!");
+			std::exit(-1);
+		}
+	}
+}
+
+
+void Renderer::drawFrame()
+{
+	if (headless)
+	{
+		drawOffscreenFrame();
+		return;
+	}
+
+	// Still minimized - skip the frame rather than build a zero sized swap chain
+	if ((swap_chain_stale || present_mode_changed) && !recreateSwapChain())
+	{
+		discardFrame();
+		return;
+	}
+
+	auto frame_start = std::chrono::steady_clock::now();
+
+	// Propagate transforms while the GPU is still busy with earlier frames - CPU work, outside the timed wait
+	scene.update();
+
+	// Wait until the GPU has retired the frame that last used this ring slot
+	auto fence_start = std::chrono::steady_clock::now();
+	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+	double fence_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fence_start).count();
+
+	swapReloadedPipelines();
+	releaseRetiredSwapChains();
+	releaseRetiredBuffers();
+	releaseUniformFrames();
+	releaseInstanceFrames();
+	collectPresentTimings();
+
+	// Out of date - nothing was acquired and the fence is still signaled, so the slot can simply be retried
+	uint32_t imageIndex;
+	auto acquire_start = std::chrono::steady_clock::now();
+	VkResult acquire_result = vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	double acquire_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - acquire_start).count();
+	if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		recreateSwapChain();
+		discardFrame();
+		return;
+	}
+	else if (acquire_result != VK_SUCCESS && acquire_result != VK_SUBOPTIMAL_KHR)
+	{
+		errorHandler(acquire_result);
+		throw std::runtime_error("[!] Failed to acquire swap chain image!");
+		std::exit(-1);
+	}
+
+	// Only now is this frame certain to be submitted
+	descriptorManager.beginFrame(currentFrame, submitted_frames);
+	textureStreamer.beginFrame(submitted_frames);
+
+	// Images can be returned out of order - wait on whichever frame is still rendering into this one
+	double image_wait_ms = 0.0;
+	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
+	{
+		auto image_wait_start = std::chrono::steady_clock::now();
+		vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		image_wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - image_wait_start).count();
+	}
+	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+
+	drawScene();
+	vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+	VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+	vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+	writeCommandBuffer(commandBuffer, imageIndex);
+
+	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[imageIndex] };
+	submitGraphics(commandBuffer, imageAvailableSemaphores[currentFrame], signalSemaphores[0]);
+	uniformRing->endFrame();
+	instanceRing->endFrame();
+	textureStreamer.endFrame();
+	instanceBatches.clear();
+	modelDraws.clear();
+	updateLodBudget();
+	uint32_t present_id = (uint32_t)++submitted_frames;
+
+	VkPresentInfoKHR presentInfo{};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = signalSemaphores;
+
+	VkSwapchainKHR swapChains[] = { swap_chain };
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = swapChains;
+
+	presentInfo.pImageIndices = &imageIndex;
+
+	// Tag the present so its on-screen time can be matched to this frame's start later
+	VkPresentTimeGOOGLE present_time{};
+	VkPresentTimesInfoGOOGLE present_times_info{};
+	if (display_timing)
+	{
+		presentStartTimes[present_id % PRESENT_TIMING_HISTORY] = std::chrono::duration_cast<std::chrono::nanoseconds>(frame_start.time_since_epoch()).count();
+		present_time.presentID = present_id;
+		present_time.desiredPresentTime = 0;
+		present_times_info.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+		present_times_info.swapchainCount = 1;
+		present_times_info.pTimes = &present_time;
+		presentInfo.pNext = &present_times_info;
+	}
+
+	// Suboptimal still presented - rebuild now so the next frame matches the window
+	VkResult present_result = vkQueuePresentKHR(present_queue, &presentInfo);
+	if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR || framebuffer_resized)
+	{
+		recreateSwapChain();
+	}
+	else if (present_result != VK_SUCCESS)
+	{
+		errorHandler(present_result);
+		throw std::runtime_error("[!] Failed to present swap chain image!");
+		std::exit(-1);
+	}
+
+	// Advance the ring
+	currentFrame = (currentFrame + 1) % frames_in_flight;
+
+	// Only the two fence waits - the releases & frame begins between them are CPU work
+	double wait_ms = fence_ms + image_wait_ms;
+	frame_stats.totalAcquireMs += acquire_ms;
+	framePacer.recordBlockedTime(wait_ms + acquire_ms);
+	recordFrameTiming(frame_start, wait_ms);
+}
+
+
+void Renderer::paceFrame()
+{
+	frame_stats.totalPacingMs += framePacer.waitForFrameStart();
+}
+
+
+// Presents finished since the last call - actualPresentTime shares steady_clock's monotonic time base
+void Renderer::collectPresentTimings()
+{
+	if (!display_timing)
+	{
+		return;
+	}
+
+	uint32_t timing_count = 0;
+	getPastPresentationTiming(device, swap_chain, &timing_count, nullptr);
+	if (timing_count == 0)
+	{
+		return;
+	}
+	std::vector<VkPastPresentationTimingGOOGLE> timings(timing_count);
+	getPastPresentationTiming(device, swap_chain, &timing_count, timings.data());
+
+	for (uint32_t i = 0; i < timing_count; i++)
+	{
+		// Older than the history ring - the start time has been overwritten
+		if (timings[i].presentID + PRESENT_TIMING_HISTORY <= submitted_frames)
+		{
+			continue;
+		}
+
+		uint64_t start_ns = presentStartTimes[timings[i].presentID % PRESENT_TIMING_HISTORY];
+		if (timings[i].actualPresentTime <= start_ns)
+		{
+			continue;
+		}
+
+		double latency_ms = (timings[i].actualPresentTime - start_ns) / 1000000.0;
+		frame_stats.presentLatencySamples++;
+		frame_stats.totalPresentLatencyMs += latency_ms;
+		frame_stats.maxPresentLatencyMs = std::max(frame_stats.maxPresentLatencyMs, latency_ms);
+	}
+}
+
+
+// The caller queues draws between frames - without this a minimized window would grow them until the instance ring overflows
+void Renderer::discardFrame()
+{
+	uniformRing->discardFrame();
+	instanceRing->discardFrame();
+	instanceBatches.clear();
+	modelDraws.clear();
+	model_triangles = 0;
+}
+
+
+// Headless frame - render into the ring slot's offscreen image and stream the previous result out
+void Renderer::drawOffscreenFrame()
+{
+	auto frame_start = std::chrono::steady_clock::now();
+
+	// Propagate transforms while the GPU is still busy with earlier frames - CPU work, outside the timed wait
+	scene.update();
+
+	// Wait until the GPU has retired the frame that last used this ring slot
+	auto fence_start = std::chrono::steady_clock::now();
+	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+	auto fence_end = std::chrono::steady_clock::now();
+	double fence_ms = std::chrono::duration<double, std::milli>(fence_end - fence_start).count();
+
+	// That frame's pixels are now in the readback ring
+	deliverReadback(currentFrame);
+	swapReloadedPipelines();
+	releaseRetiredBuffers();
+	descriptorManager.beginFrame(currentFrame, submitted_frames);
+	textureStreamer.beginFrame(submitted_frames);
+	releaseUniformFrames();
+	releaseInstanceFrames();
+
+	drawScene();
+	vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+	VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+	vkResetCommandBuffer(commandBuffer, 0);
+	writeCommandBuffer(commandBuffer, currentFrame);
+
+	// No acquire or present - nothing to wait on but the fence & any async compute
+	submitGraphics(commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+	uniformRing->endFrame();
+	instanceRing->endFrame();
+	textureStreamer.endFrame();
+	instanceBatches.clear();
+	modelDraws.clear();
+	updateLodBudget();
+	readbackPending[currentFrame] = true;
+	readbackFrameNumbers[currentFrame] = submitted_frames++;
+	framePacer.recordBlockedTime(fence_ms);
+
+	// Advance the ring
+	currentFrame = (currentFrame + 1) % frames_in_flight;
+
+	recordFrameTiming(frame_start, fence_ms);
+}
+
+
+// Hand a completed readback slot to the callback - caller guarantees the slot's fence has signaled
+void Renderer::deliverReadback(uint32_t slot)
+{
+	if (!readbackPending[slot])
+	{
+		return;
+	}
+
+	allocator.invalidate(readbackBuffer.allocation, readback_slot_size * slot, readback_slot_size);
+
+	if (frame_readback_callback)
+	{
+		frame_readback_callback(static_cast<uint8_t*>(readbackBuffer.allocation.mapped) + readback_slot_size * slot, swap_chain_extent, readbackFrameNumbers[slot]);
+	}
+	readbackPending[slot] = false;
+}
+
+
+void Renderer::recordFrameTiming(std::chrono::steady_clock::time_point frame_start, double wait_ms)
+{
+	auto frame_end = std::chrono::steady_clock::now();
+	double cpu_ms = std::chrono::duration<double, std::milli>(frame_end - frame_start).count();
+
+	if (frame_stats.frameCount > 0)
+	{
+		double interval_ms = std::chrono::duration<double, std::milli>(frame_start - last_frame_time).count();
+		frame_stats.totalFrameMs += interval_ms;
+		frame_stats.minFrameMs = (frame_stats.frameCount == 1) ? interval_ms : std::min(frame_stats.minFrameMs, interval_ms);
+		frame_stats.maxFrameMs = std::max(frame_stats.maxFrameMs, interval_ms);
+		if (keep_frame_samples)
+		{
+			frame_stats.frameTimesMs.push_back(interval_ms);
+		}
+	}
+	if (keep_frame_samples)
+	{
+		frame_stats.cpuTimesMs.push_back(cpu_ms - wait_ms);
+	}
+	frame_stats.totalCpuMs += cpu_ms;
+	gpuProfiler.recordCpuFrame(submitted_frames - 1, frame_start, cpu_ms);
+	frame_stats.totalFenceWaitMs += wait_ms;
+	frame_stats.frameCount++;
+	last_frame_time = frame_start;
+}
+
+
+// Draw a fixed number of frames - used for throughput comparisons
+void Renderer::runFrames(uint32_t frameCount)
+{
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		if (!headless)
+		{
+			if (glfwWindowShouldClose(window))
+			{
+				break;
+			}
+			paceFrame();
+			glfwPollEvents();
+		}
+		else
+		{
+			paceFrame();
+		}
+		drawFrame();
+	}
+	waitIdle();
+
+	// Drain the readback ring oldest first
+	if (headless)
+	{
+		for (uint32_t i = 0; i < frames_in_flight; i++)
+		{
+			deliverReadback((currentFrame + i) % frames_in_flight);
+		}
+	}
+}
+
+
+void Renderer::waitIdle()
+{
+	vkDeviceWaitIdle(device);
+	gpuProfiler.collectAll();
+}
+
+
+void Renderer::printMemoryStats()
+{
+	allocator.printStats();
+}
+
+
+void Renderer::resetFrameStats()
+{
+	frame_stats = FrameStats();
+	gpuProfiler.reset();
+	scene.resetStats();
+}
+
+
+void Renderer::printFrameStats()
+{
+	double frames = (double)std::max<uint64_t>(frame_stats.frameCount, 1);
+
+	std::cout << "[Frame Stats] frames in flight: " << frames_in_flight
+		<< " | frames: " << frame_stats.frameCount
+		<< std::fixed << std::setprecision(3)
+		<< " | avg: " << frame_stats.averageFrameMs() << " ms"
+		<< " | min: " << frame_stats.minFrameMs << " ms"
+		<< " | max: " << frame_stats.maxFrameMs << " ms"
+		<< " | cpu: " << frame_stats.totalCpuMs / frames << " ms"
+		<< " | fence wait: " << frame_stats.totalFenceWaitMs / frames << " ms"
+		<< " | fps: " << std::setprecision(1) << frame_stats.framesPerSecond() << std::endl;
+
+	if (!headless)
+	{
+		std::cout << "[Frame Stats] present mode: " << presentModeName(present_mode)
+			<< std::fixed << std::setprecision(3)
+			<< " | acquire: " << frame_stats.totalAcquireMs / frames << " ms"
+			<< " | pacing sleep: " << frame_stats.totalPacingMs / frames << " ms";
+		if (frame_stats.presentLatencySamples > 0)
+		{
+			std::cout << " | present latency: " << frame_stats.totalPresentLatencyMs / frame_stats.presentLatencySamples << " ms"
+				<< " (max " << frame_stats.maxPresentLatencyMs << " ms"
+				<< ", refresh " << refresh_duration_ns / 1000000.0 << " ms)";
+		}
+		std::cout << std::endl;
+	}
+
+	if (frame_stats.swapChainRecreations > 0)
+	{
+		std::cout << "[Frame Stats] swap chain recreations: " << frame_stats.swapChainRecreations
+			<< std::fixed << std::setprecision(3)
+			<< " | avg recreate: " << frame_stats.totalRecreateMs / frame_stats.swapChainRecreations << " ms" << std::endl;
+	}
+
+	const FrameGraphStats& graph_stats = frameGraph.getStats();
+	std::cout << "[Frame Stats] frame graph: " << graph_stats.passCount << " passes (" << graph_stats.culledPasses << " culled)"
+		<< " | barriers: " << graph_stats.barrierCount << std::endl;
+
+	const TextureStreamStats& texture_stats = textureStreamer.getStats();
+	if (texture_stats.resident + texture_stats.loading + texture_stats.failed > 0)
+	{
+		std::cout << "[Frame Stats] textures: " << texture_stats.resident << " resident, " << texture_stats.loading << " loading, "
+			<< texture_stats.failed << " failed | " << texture_stats.residentBytes / (1024 * 1024) << " MB resident"
+			<< " | uploaded: " << texture_stats.uploadedBytes / (1024 * 1024) << " MB"
+			<< " | promotions: " << texture_stats.promotions << " | evictions: " << texture_stats.evictions << std::endl;
+	}
+
+	if (frame_stats.totalModelTriangles > 0)
+	{
+		std::cout << "[Frame Stats] model triangles: " << frame_stats.totalModelTriangles / (uint64_t)frames << " per frame"
+			<< std::fixed << std::setprecision(2) << " | lod error scale: " << lod_error_scale << std::endl;
+	}
+
+	const SceneUpdateStats& scene_stats = scene.getStats();
+	if (scene_stats.updates > 0 && scene_stats.nodes > 0)
+	{
+		std::cout << "[Frame Stats] scene: " << scene_stats.nodes << " nodes in " << scene_stats.levels << " levels"
+			<< " | updated: " << scene_stats.totalUpdatedNodes / scene_stats.updates << " per frame"
+			<< std::fixed << std::setprecision(3) << " | update: " << scene_stats.totalUpdateMs / scene_stats.updates << " ms"
+			<< " | rebuilds: " << scene_stats.rebuilds << std::endl;
+	}
+}
+
+
 // Handle Vulkan Result Errors
 VkResult Renderer::errorHandler(VkResult error)
 {
@@ -0,0 +1,595 @@
+// Vulkan Renderer - Scene Graph
+
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENE_SIMD_SSE 1
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define SCENE_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+static const SceneMatrix identityMatrix = { { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f } };
+
+
+// 4x4 Math - out = a * b, column major. Each output column is the columns of a weighted by one column of b.
+static inline void multiplyMatrix(const SceneMatrix& a, const SceneMatrix& b, SceneMatrix& out)
+{
+#if defined(SCENE_SIMD_SSE)
+	__m128 a0 = _mm_load_ps(&a.m[0]);
+	__m128 a1 = _mm_load_ps(&a.m[4]);
+	__m128 a2 = _mm_load_ps(&a.m[8]);
+	__m128 a3 = _mm_load_ps(&a.m[12]);
+	for (int column = 0; column < 4; column++)
+	{
+		const float* weights = &b.m[column * 4];
+		__m128 result = _mm_mul_ps(a0, _mm_set1_ps(weights[0]));
+		result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(weights[1])));
+		result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(weights[2])));
+		result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(weights[3])));
+		_mm_store_ps(&out.m[column * 4], result);
+	}
+#elif defined(SCENE_SIMD_NEON)
+	float32x4_t a0 = vld1q_f32(&a.m[0]);
+	float32x4_t a1 = vld1q_f32(&a.m[4]);
+	float32x4_t a2 = vld1q_f32(&a.m[8]);
+	float32x4_t a3 = vld1q_f32(&a.m[12]);
+	for (int column = 0; column < 4; column++)
+	{
+		const float* weights = &b.m[column * 4];
+		float32x4_t result = vmulq_n_f32(a0, weights[0]);
+		result = vmlaq_n_f32(result, a1, weights[1]);
+		result = vmlaq_n_f32(result, a2, weights[2]);
+		result = vmlaq_n_f32(result, a3, weights[3]);
+		vst1q_f32(&out.m[column * 4], result);
+	}
+#else
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			out.m[column * 4 + row] = a.m[row] * b.m[column * 4] + a.m[4 + row] * b.m[column * 4 + 1]
+				+ a.m[8 + row] * b.m[column * 4 + 2] + a.m[12 + row] * b.m[column * 4 + 3];
+		}
+	}
+#endif
+}
+
+
+// Center through the matrix, radius by its largest axis scale
+static inline void transformBounds(const SceneMatrix& matrix, const SceneBounds& bounds, SceneBounds& out)
+{
+	const float* m = matrix.m;
+	float scale = 0.0f;
+	for (int column = 0; column < 3; column++)
+	{
+		const float* axis = &m[column * 4];
+		scale = std::max(scale, axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	}
+	float radius = bounds.radius * std::sqrt(scale);
+
+#if defined(SCENE_SIMD_SSE)
+	__m128 center = _mm_add_ps(_mm_mul_ps(_mm_load_ps(&m[0]), _mm_set1_ps(bounds.center[0])),
+		_mm_mul_ps(_mm_load_ps(&m[4]), _mm_set1_ps(bounds.center[1])));
+	center = _mm_add_ps(center, _mm_mul_ps(_mm_load_ps(&m[8]), _mm_set1_ps(bounds.center[2])));
+	center = _mm_add_ps(center, _mm_load_ps(&m[12]));
+	_mm_store_ps(out.center, center);								// Lane 3 lands on radius, written below
+#elif defined(SCENE_SIMD_NEON)
+	float32x4_t center = vmlaq_n_f32(vld1q_f32(&m[12]), vld1q_f32(&m[0]), bounds.center[0]);
+	center = vmlaq_n_f32(center, vld1q_f32(&m[4]), bounds.center[1]);
+	center = vmlaq_n_f32(center, vld1q_f32(&m[8]), bounds.center[2]);
+	vst1q_f32(out.center, center);
+#else
+	for (int row = 0; row < 3; row++)
+	{
+		out.center[row] = m[row] * bounds.center[0] + m[4 + row] * bounds.center[1] + m[8 + row] * bounds.center[2] + m[12 + row];
+	}
+#endif
+	out.radius = radius;
+}
+
+
+void SceneGraph::init(uint32_t threadCount)
+{
+	workers.reset(new ThreadPool(threadCount));
+}
+
+
+void SceneGraph::clear()
+{
+	for (size_t i = 0; i < dense_slots.size(); i++)
+	{
+		if (!(flags[i] & NODE_REMOVED))
+		{
+			slot_generation[dense_slots[i]]++;
+		}
+		slot_dense[dense_slots[i]] = SCENE_NODE_NONE;
+		free_slots.push_back(dense_slots[i]);
+	}
+
+	local.clear();
+	world.clear();
+	local_bounds.clear();
+	world_bounds.clear();
+	render_handles.clear();
+	render_states.clear();
+	parents.clear();
+	child_begin.clear();
+	child_end.clear();
+	dense_slots.clear();
+	flags.clear();
+	level_begin.assign(1, 0);
+	dirty.clear();
+	structure_changed = false;
+}
+
+
+void SceneGraph::resetStats()
+{
+	stats.updates = 0;
+	stats.totalUpdatedNodes = 0;
+	stats.totalUpdateMs = 0.0;
+	stats.rebuilds = 0;
+}
+
+
+// Handles
+uint32_t SceneGraph::resolve(SceneNode node) const
+{
+	uint32_t slot = node & SCENE_NODE_MAX_SLOTS;
+	if (node == SCENE_NODE_NONE || slot >= slot_dense.size() || slot_generation[slot] != (uint8_t)(node >> SCENE_NODE_INDEX_BITS))
+	{
+		return SCENE_NODE_NONE;
+	}
+	return slot_dense[slot];
+}
+
+
+bool SceneGraph::isValid(SceneNode node) const
+{
+	return resolve(node) != SCENE_NODE_NONE;
+}
+
+
+SceneNode SceneGraph::createNode(SceneNode parent)
+{
+	uint32_t parent_index = SCENE_NODE_NONE;
+	if (parent != SCENE_NODE_NONE)
+	{
+		parent_index = resolve(parent);
+		if (parent_index == SCENE_NODE_NONE)
+		{
+			return SCENE_NODE_NONE;
+		}
+	}
+
+	uint32_t slot;
+	if (!free_slots.empty())
+	{
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else
+	{
+		if (slot_dense.size() >= SCENE_NODE_MAX_SLOTS)
+		{
+			return SCENE_NODE_NONE;
+		}
+		slot = (uint32_t)slot_dense.size();
+		slot_dense.push_back(SCENE_NODE_NONE);
+		slot_generation.push_back(0);
+	}
+
+	// Appended unsorted - the next update places it in its level
+	uint32_t index = (uint32_t)parents.size();
+	local.push_back(identityMatrix);
+	world.push_back(identityMatrix);
+	local_bounds.push_back(SceneBounds{});
+	world_bounds.push_back(SceneBounds{});
+	render_handles.push_back(SCENE_RENDER_NONE);
+	render_states.push_back(UINT32_MAX);
+	parents.push_back(parent_index);
+	child_begin.push_back(0);
+	child_end.push_back(0);
+	dense_slots.push_back(slot);
+	flags.push_back(0);
+	slot_dense[slot] = index;
+	markDirty(index);
+	structure_changed = true;
+	return ((SceneNode)slot_generation[slot] << SCENE_NODE_INDEX_BITS) | slot;
+}
+
+
+void SceneGraph::destroyNode(SceneNode node)
+{
+	uint32_t index = resolve(node);
+	if (index == SCENE_NODE_NONE)
+	{
+		return;
+	}
+	flags[index] |= NODE_REMOVED;
+	slot_generation[dense_slots[index]]++;
+	structure_changed = true;
+}
+
+
+bool SceneGraph::setParent(SceneNode node, SceneNode parent)
+{
+	uint32_t index = resolve(node);
+	uint32_t parent_index = parent == SCENE_NODE_NONE ? SCENE_NODE_NONE : resolve(parent);
+	if (index == SCENE_NODE_NONE || (parent != SCENE_NODE_NONE && parent_index == SCENE_NODE_NONE))
+	{
+		return false;
+	}
+	for (uint32_t ancestor = parent_index; ancestor != SCENE_NODE_NONE; ancestor = parents[ancestor])
+	{
+		if (ancestor == index)
+		{
+			return false;
+		}
+	}
+
+	parents[index] = parent_index;
+	markDirty(index);
+	structure_changed = true;
+	return true;
+}
+
+
+SceneNode SceneGraph::getParent(SceneNode node) const
+{
+	uint32_t index = resolve(node);
+	if (index == SCENE_NODE_NONE || parents[index] == SCENE_NODE_NONE)
+	{
+		return SCENE_NODE_NONE;
+	}
+	uint32_t slot = dense_slots[parents[index]];
+	return ((SceneNode)slot_generation[slot] << SCENE_NODE_INDEX_BITS) | slot;
+}
+
+
+// Attributes
+void SceneGraph::markDirty(uint32_t index)
+{
+	if (!(flags[index] & NODE_DIRTY))
+	{
+		flags[index] |= NODE_DIRTY;
+		dirty.push_back(index);
+	}
+}
+
+
+void SceneGraph::setLocalTransform(SceneNode node, const float matrix[16])
+{
+	uint32_t index = resolve(node);
+	if (index != SCENE_NODE_NONE)
+	{
+		std::memcpy(local[index].m, matrix, sizeof(local[index].m));
+		markDirty(index);
+	}
+}
+
+
+void SceneGraph::setLocalBounds(SceneNode node, const float center[3], float radius)
+{
+	uint32_t index = resolve(node);
+	if (index != SCENE_NODE_NONE)
+	{
+		std::memcpy(local_bounds[index].center, center, sizeof(local_bounds[index].center));
+		local_bounds[index].radius = radius;
+		markDirty(index);
+	}
+}
+
+
+void SceneGraph::setRenderHandle(SceneNode node, uint32_t handle)
+{
+	uint32_t index = resolve(node);
+	if (index != SCENE_NODE_NONE)
+	{
+		render_handles[index] = handle;
+	}
+}
+
+
+const float* SceneGraph::getLocalTransform(SceneNode node) const
+{
+	uint32_t index = resolve(node);
+	return index != SCENE_NODE_NONE ? local[index].m : nullptr;
+}
+
+
+const float* SceneGraph::getWorldTransform(SceneNode node) const
+{
+	uint32_t index = resolve(node);
+	return index != SCENE_NODE_NONE ? world[index].m : nullptr;
+}
+
+
+const SceneBounds* SceneGraph::getWorldBounds(SceneNode node) const
+{
+	uint32_t index = resolve(node);
+	return index != SCENE_NODE_NONE ? &world_bounds[index] : nullptr;
+}
+
+
+uint32_t SceneGraph::getRenderHandle(SceneNode node) const
+{
+	uint32_t index = resolve(node);
+	return index != SCENE_NODE_NONE ? render_handles[index] : SCENE_RENDER_NONE;
+}
+
+
+// Breadth first re-sort after creations, removals & reparenting - removed nodes & their subtrees are never
+// reached, so their slots are freed here
+void SceneGraph::rebuild()
+{
+	uint32_t count = (uint32_t)parents.size();
+
+	std::vector <uint32_t> first_child(count + 1, 0);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (parents[i] != SCENE_NODE_NONE && !(flags[i] & NODE_REMOVED))
+		{
+			first_child[parents[i] + 1]++;
+		}
+	}
+	for (uint32_t i = 0; i < count; i++)
+	{
+		first_child[i + 1] += first_child[i];
+	}
+	std::vector <uint32_t> children(first_child[count]);
+	std::vector <uint32_t> fill(first_child.begin(), first_child.end() - 1);
+	std::vector <uint32_t> order;
+	order.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (flags[i] & NODE_REMOVED)
+		{
+			continue;
+		}
+		if (parents[i] == SCENE_NODE_NONE)
+		{
+			order.push_back(i);
+		}
+		else
+		{
+			children[fill[parents[i]]++] = i;
+		}
+	}
+
+	// One level at a time - a node's children are appended together, right after those of the node before it
+	std::vector <uint32_t> new_index(count, SCENE_NODE_NONE);
+	std::vector <uint32_t> sorted_begin(count);
+	std::vector <uint32_t> sorted_end(count);
+	level_begin.assign(1, 0);
+	size_t head = 0;
+	while (head < order.size())
+	{
+		size_t level_end = order.size();
+		for (; head < level_end; head++)
+		{
+			uint32_t old = order[head];
+			new_index[old] = (uint32_t)head;
+			sorted_begin[head] = (uint32_t)order.size();
+			order.insert(order.end(), children.begin() + first_child[old], children.begin() + first_child[old + 1]);
+			sorted_end[head] = (uint32_t)order.size();
+		}
+		level_begin.push_back((uint32_t)level_end);
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (new_index[i] == SCENE_NODE_NONE)
+		{
+			uint32_t slot = dense_slots[i];
+			if (!(flags[i] & NODE_REMOVED))
+			{
+				slot_generation[slot]++;
+			}
+			slot_dense[slot] = SCENE_NODE_NONE;
+			free_slots.push_back(slot);
+		}
+	}
+
+	auto permute = [&order](auto& pool) {
+		typename std::remove_reference<decltype(pool)>::type sorted(order.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			sorted[i] = pool[order[i]];
+		}
+		pool.swap(sorted);
+	};
+	permute(local);
+	permute(world);
+	permute(local_bounds);
+	permute(world_bounds);
+	permute(render_handles);
+	permute(render_states);
+	permute(dense_slots);
+	permute(flags);
+	permute(parents);
+
+	uint32_t sorted_count = (uint32_t)order.size();
+	sorted_begin.resize(sorted_count);
+	sorted_end.resize(sorted_count);
+	child_begin.swap(sorted_begin);
+	child_end.swap(sorted_end);
+	dirty.clear();
+	for (uint32_t i = 0; i < sorted_count; i++)
+	{
+		if (parents[i] != SCENE_NODE_NONE)
+		{
+			parents[i] = new_index[parents[i]];
+		}
+		slot_dense[dense_slots[i]] = i;
+		if (flags[i] & NODE_DIRTY)
+		{
+			dirty.push_back(i);
+		}
+	}
+	structure_changed = false;
+}
+
+
+void SceneGraph::updateRange(uint32_t begin, uint32_t end)
+{
+	for (uint32_t i = begin; i < end; i++)
+	{
+		uint32_t parent = parents[i];
+		if (parent == SCENE_NODE_NONE)
+		{
+			world[i] = local[i];
+		}
+		else
+		{
+			multiplyMatrix(world[parent], local[i], world[i]);
+		}
+		transformBounds(world[i], local_bounds[i], world_bounds[i]);
+		flags[i] &= ~NODE_DIRTY;
+	}
+}
+
+
+// Spans of one level are independent - large levels are cut into chunks that the workers & the caller pull from
+void SceneGraph::updateSpans(const std::vector<std::pair<uint32_t, uint32_t>>& ranges, uint32_t count)
+{
+	if (!workers || count < SCENE_UPDATE_CHUNK * 2)
+	{
+		for (const auto& span : ranges)
+		{
+			updateRange(span.first, span.second);
+		}
+		return;
+	}
+
+	chunks.clear();
+	for (const auto& span : ranges)
+	{
+		for (uint32_t begin = span.first; begin < span.second; begin += SCENE_UPDATE_CHUNK)
+		{
+			chunks.push_back({ begin, std::min(begin + SCENE_UPDATE_CHUNK, span.second) });
+		}
+	}
+
+	std::atomic <size_t> next{ 0 };
+	auto work = [this, &next]() {
+		for (size_t chunk = next++; chunk < chunks.size(); chunk = next++)
+		{
+			updateRange(chunks[chunk].first, chunks[chunk].second);
+		}
+	};
+	std::vector <std::future<void>> jobs;
+	size_t job_count = std::min<size_t>(workers->threadCount(), chunks.size() - 1);
+	for (size_t i = 0; i < job_count; i++)
+	{
+		jobs.push_back(workers->submit(work));
+	}
+	work();
+	for (std::future<void>& job : jobs)
+	{
+		job.get();
+	}
+}
+
+
+// Top down - a level recomputes the children of everything that changed in the level above, then its own dirty
+// nodes not already covered. Nothing outside those spans is read.
+void SceneGraph::update()
+{
+	auto update_start = std::chrono::steady_clock::now();
+	if (structure_changed)
+	{
+		rebuild();
+		stats.rebuilds++;
+	}
+
+	uint32_t level_count = (uint32_t)level_begin.size() - 1;
+	uint32_t updated = 0;
+	if (!dirty.empty())
+	{
+		level_dirty.resize(level_count);
+		for (std::vector<uint32_t>& nodes : level_dirty)
+		{
+			nodes.clear();
+		}
+		for (uint32_t index : dirty)
+		{
+			uint32_t level = (uint32_t)(std::upper_bound(level_begin.begin(), level_begin.end(), index) - level_begin.begin()) - 1;
+			level_dirty[level].push_back(index);
+		}
+		dirty.clear();
+
+		spans.clear();
+		for (uint32_t level = 0; level < level_count; level++)
+		{
+			if (spans.empty() && level_dirty[level].empty())
+			{
+				continue;
+			}
+
+			uint32_t count = 0;
+			for (const auto& span : spans)
+			{
+				count += span.second - span.first;
+			}
+			updateSpans(spans, count);
+			updated += count;
+
+			// Dirty nodes under an unchanged parent - one span each
+			size_t inherited = spans.size();
+			uint32_t own = 0;
+			for (uint32_t index : level_dirty[level])
+			{
+				if (flags[index] & NODE_DIRTY)
+				{
+					spans.push_back({ index, index + 1 });
+					own++;
+				}
+			}
+			if (own > 0)
+			{
+				own_spans.assign(spans.begin() + inherited, spans.end());
+				updateSpans(own_spans, own);
+				updated += own;
+			}
+
+			// Children of everything recomputed - contiguous per span, adjacent ones merged
+			next_spans.clear();
+			for (const auto& span : spans)
+			{
+				uint32_t begin = child_begin[span.first];
+				uint32_t end = child_end[span.second - 1];
+				if (begin >= end)
+				{
+					continue;
+				}
+				if (!next_spans.empty() && next_spans.back().second == begin)
+				{
+					next_spans.back().second = end;
+				}
+				else
+				{
+					next_spans.push_back({ begin, end });
+				}
+			}
+			spans.swap(next_spans);
+		}
+	}
+
+	stats.nodes = (uint32_t)parents.size();
+	stats.levels = level_count;
+	stats.updatedNodes = updated;
+	stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - update_start).count();
+	stats.updates++;
+	stats.totalUpdatedNodes += updated;
+	stats.totalUpdateMs += stats.updateMs;
+}
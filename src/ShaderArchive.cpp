@@ -0,0 +1,138 @@
+// Vulkan Renderer - Packed Shader Archive
+
+#include "ShaderArchive.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+bool ShaderArchive::isSpirv(const uint8_t* data, size_t size)
+{
+	uint32_t magic = 0;
+	if (size < sizeof(uint32_t) * 5 || size % sizeof(uint32_t) != 0)
+	{
+		return false;
+	}
+	std::memcpy(&magic, data, sizeof(magic));
+	return magic == SPIRV_MAGIC;
+}
+
+
+bool ShaderArchive::open(const std::string& path)
+{
+	close();
+	if (!file.open(path))
+	{
+		return false;
+	}
+
+	// Validate the header & index once - lookups afterwards trust it
+	ShaderArchiveHeader header;
+	if (file.size() < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	size_t index_end = sizeof(header) + (size_t)header.entryCount * sizeof(ShaderArchiveEntry);
+	if (header.magic != SHADER_ARCHIVE_MAGIC || header.version != SHADER_ARCHIVE_VERSION
+		|| index_end + header.nameTableSize > file.size())
+	{
+		std::cout << "[!] Shader archive " << path << " has an invalid header" << std::endl;
+		close();
+		return false;
+	}
+
+	const char* names = reinterpret_cast<const char*>(file.data() + index_end);
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		ShaderArchiveEntry entry;
+		std::memcpy(&entry, file.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+		if ((uint64_t)entry.nameOffset + entry.nameLength > header.nameTableSize
+			|| entry.offset % SHADER_ARCHIVE_ALIGNMENT != 0
+			|| entry.offset + entry.size > file.size()
+			|| !isSpirv(file.data() + entry.offset, (size_t)entry.size))
+		{
+			std::cout << "[!] Shader archive " << path << " has an invalid entry " << i << std::endl;
+			close();
+			return false;
+		}
+
+		index[std::string(names + entry.nameOffset, entry.nameLength)] = entry;
+	}
+	return true;
+}
+
+
+void ShaderArchive::close()
+{
+	index.clear();
+	file.close();
+}
+
+
+// Code points straight into the mapping - valid until the archive is closed
+bool ShaderArchive::find(const std::string& name, const uint32_t*& code, size_t& size) const
+{
+	auto found = index.find(name);
+	if (found == index.end())
+	{
+		return false;
+	}
+
+	code = reinterpret_cast<const uint32_t*>(file.data() + found->second.offset);
+	size = (size_t)found->second.size;
+	return true;
+}
+
+
+bool ShaderArchive::write(const std::string& path, const std::vector<std::string>& names, const std::vector<std::vector<uint8_t>>& modules)
+{
+	if (names.size() != modules.size())
+	{
+		return false;
+	}
+
+	ShaderArchiveHeader header{};
+	header.magic = SHADER_ARCHIVE_MAGIC;
+	header.version = SHADER_ARCHIVE_VERSION;
+	header.entryCount = (uint32_t)names.size();
+
+	std::string name_table;
+	std::vector<ShaderArchiveEntry> entries(names.size());
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		entries[i].nameOffset = (uint32_t)name_table.size();
+		entries[i].nameLength = (uint32_t)names[i].size();
+		name_table += names[i];
+	}
+	header.nameTableSize = (uint32_t)name_table.size();
+
+	// Lay the modules out after the index, each on an aligned boundary
+	auto align = [](uint64_t offset) { return (offset + SHADER_ARCHIVE_ALIGNMENT - 1) & ~(uint64_t)(SHADER_ARCHIVE_ALIGNMENT - 1); };
+	uint64_t offset = align(sizeof(header) + entries.size() * sizeof(ShaderArchiveEntry) + name_table.size());
+	for (size_t i = 0; i < modules.size(); i++)
+	{
+		entries[i].offset = offset;
+		entries[i].size = modules[i].size();
+		offset = align(offset + modules[i].size());
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ShaderArchiveEntry));
+	out.write(name_table.data(), name_table.size());
+
+	const char padding[SHADER_ARCHIVE_ALIGNMENT] = {};
+	uint64_t written = sizeof(header) + entries.size() * sizeof(ShaderArchiveEntry) + name_table.size();
+	for (size_t i = 0; i < modules.size(); i++)
+	{
+		out.write(padding, (std::streamsize)(entries[i].offset - written));
+		out.write(reinterpret_cast<const char*>(modules[i].data()), modules[i].size());
+		written = entries[i].offset + modules[i].size();
+	}
+	return (bool)out;
+}
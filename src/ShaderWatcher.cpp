@@ -0,0 +1,255 @@
+// Vulkan Renderer - Shader Hot Reload
+
+#include "ShaderWatcher.h"
+#include "ShaderArchive.h"
+
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#ifdef RENDERER_HAS_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+
+void ShaderWatcher::addSource(const std::string& sourcePath, const std::string& spvPath)
+{
+	std::lock_guard<std::mutex> lock(sources_mutex);
+
+	std::error_code error;
+	ShaderSource shader;
+	shader.source = sourcePath;
+	shader.spv = spvPath;
+	shader.lastWrite = std::filesystem::last_write_time(sourcePath, error);
+	sources.push_back(shader);
+}
+
+
+void ShaderWatcher::start(const std::string& directory, ReloadCallback callback)
+{
+	stop();
+	watch_directory = directory;
+	on_reload = callback;
+
+#ifdef __linux__
+	// Editors either rewrite in place (close after write) or rename a temp file over the source
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0 || inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		std::cout << "[!] Shader hot reload - failed to watch " << directory << ", polling instead" << std::endl;
+		if (inotify_fd >= 0)
+		{
+			close(inotify_fd);
+		}
+		inotify_fd = -1;
+	}
+#endif
+
+	running = true;
+	watcher = std::thread([this]() { watchLoop(); });
+}
+
+
+void ShaderWatcher::stop()
+{
+	if (!running)
+	{
+		return;
+	}
+
+	running = false;
+	watcher.join();
+
+#ifdef __linux__
+	if (inotify_fd >= 0)
+	{
+		close(inotify_fd);
+		inotify_fd = -1;
+	}
+#endif
+}
+
+
+void ShaderWatcher::watchLoop()
+{
+	while (running)
+	{
+#ifdef __linux__
+		if (inotify_fd >= 0)
+		{
+			pollfd poll_fd = { inotify_fd, POLLIN, 0 };
+			if (poll(&poll_fd, 1, SHADER_WATCH_POLL_MS) <= 0)
+			{
+				continue;
+			}
+
+			alignas(inotify_event) char events[4096];
+			ssize_t length;
+			while ((length = read(inotify_fd, events, sizeof(events))) > 0)
+			{
+				for (char* cursor = events; cursor < events + length; )
+				{
+					inotify_event* event = reinterpret_cast<inotify_event*>(cursor);
+					if (event->len > 0)
+					{
+						sourceChanged(event->name);
+					}
+					cursor += sizeof(inotify_event) + event->len;
+				}
+			}
+			continue;
+		}
+#endif
+
+		// No change notifications on this platform - compare timestamps instead
+		std::this_thread::sleep_for(std::chrono::milliseconds(SHADER_WATCH_POLL_MS));
+		std::vector<std::string> names;
+		{
+			std::lock_guard<std::mutex> lock(sources_mutex);
+			for (ShaderSource& shader : sources)
+			{
+				names.push_back(std::filesystem::path(shader.source).filename().string());
+			}
+		}
+		for (const std::string& name : names)
+		{
+			sourceChanged(name);
+		}
+	}
+}
+
+
+// Rebuild the matching source if its timestamp moved - one save can raise several events
+void ShaderWatcher::sourceChanged(const std::string& fileName)
+{
+	std::lock_guard<std::mutex> lock(sources_mutex);
+	for (ShaderSource& shader : sources)
+	{
+		if (std::filesystem::path(shader.source).filename() != fileName)
+		{
+			continue;
+		}
+
+		std::error_code error;
+		auto last_write = std::filesystem::last_write_time(shader.source, error);
+		if (!error && last_write != shader.lastWrite)
+		{
+			shader.lastWrite = last_write;
+			rebuild(shader);
+		}
+	}
+}
+
+
+void ShaderWatcher::rebuild(ShaderSource& shader)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<uint32_t> code;
+	std::string log;
+	if (!compile(shader.source, code, log))
+	{
+		// Keep running the last good pipelines - the fix is usually one save away
+		std::cout << "[!] Shader hot reload - " << shader.source << " failed to compile:\n" << log << std::endl;
+		return;
+	}
+
+	// Rewrite the loose .spv - a packed shaders.spva still takes precedence at the next launch until pack_shaders reruns
+	std::string temp_path = shader.spv + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(code.data()), code.size() * sizeof(uint32_t));
+	}
+	std::error_code error;
+	std::filesystem::rename(temp_path, shader.spv, error);
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "[*] Shader hot reload - " << shader.source << " recompiled in " << ms << " ms" << std::endl;
+
+	on_reload(shader.spv, std::move(code));
+}
+
+
+// GLSL to SPIR-V - in process through shaderc when available, otherwise through glslc ($GLSLC or PATH)
+bool ShaderWatcher::compile(const std::string& sourcePath, std::vector<uint32_t>& code, std::string& log)
+{
+#ifdef RENDERER_HAS_SHADERC
+	std::string extension = std::filesystem::path(sourcePath).extension().string();
+	shaderc_shader_kind kind;
+	if (extension == ".vert")
+	{
+		kind = shaderc_vertex_shader;
+	}
+	else if (extension == ".frag")
+	{
+		kind = shaderc_fragment_shader;
+	}
+	else if (extension == ".comp")
+	{
+		kind = shaderc_compute_shader;
+	}
+	else
+	{
+		log = "unknown shader stage " + extension;
+		return false;
+	}
+
+	std::ifstream file(sourcePath);
+	std::stringstream source;
+	source << file.rdbuf();
+
+	static shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source.str(), kind, sourcePath.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		log = result.GetErrorMessage();
+		return false;
+	}
+	code.assign(result.cbegin(), result.cend());
+	return true;
+#else
+	const char* glslc = std::getenv("GLSLC");
+	std::string output_path = sourcePath + ".spv.tmp";
+	std::string log_path = sourcePath + ".log";
+	std::string command = std::string("\"") + (glslc ? glslc : "glslc") + "\" -O \"" + sourcePath + "\" -o \"" + output_path + "\" 2> \"" + log_path + "\"";
+#ifdef _WIN32
+	command = "\"" + command + "\"";								// cmd /c strips the outer pair of quotes
+#endif
+
+	int status = std::system(command.c_str());
+
+	std::ifstream log_file(log_path);
+	std::stringstream log_text;
+	log_text << log_file.rdbuf();
+	log = log_text.str();
+	log_file.close();
+	std::remove(log_path.c_str());
+
+	std::ifstream spirv(output_path, std::ios::binary | std::ios::ate);
+	if (status != 0 || !spirv.is_open())
+	{
+		std::remove(output_path.c_str());
+		return false;
+	}
+
+	size_t size = (size_t)spirv.tellg();
+	code.resize(size / sizeof(uint32_t));
+	spirv.seekg(0);
+	spirv.read(reinterpret_cast<char*>(code.data()), code.size() * sizeof(uint32_t));
+	spirv.close();
+	std::remove(output_path.c_str());
+
+	return ShaderArchive::isSpirv(reinterpret_cast<const uint8_t*>(code.data()), code.size() * sizeof(uint32_t));
+#endif
+}
@@ -0,0 +1,503 @@
+// Vulkan Renderer - Block Compressed Texture Container
+
+#include "TextureContainer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+uint32_t TextureContainer::blockBytes(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+
+bool TextureContainer::isContainer(const std::string& path)
+{
+	size_t length = std::strlen(TEXTURE_CONTAINER_EXTENSION);
+	return path.size() >= length && path.compare(path.size() - length, length, TEXTURE_CONTAINER_EXTENSION) == 0;
+}
+
+
+bool TextureContainer::open(const std::string& path)
+{
+	close();
+	if (!file.open(path))
+	{
+		return false;
+	}
+
+	bytes = file.data();
+	byte_count = file.size();
+	return parse(path);
+}
+
+
+bool TextureContainer::load(std::vector<uint8_t>&& containerBytes)
+{
+	close();
+	memory = std::move(containerBytes);
+	bytes = memory.data();
+	byte_count = memory.size();
+	return parse("<memory>");
+}
+
+
+void TextureContainer::close()
+{
+	file.close();
+	memory.clear();
+	bytes = nullptr;
+	byte_count = 0;
+	header = TextureContainerHeader{};
+	mips.clear();
+}
+
+
+// Validate the header & mip table once - uploads afterwards trust it
+bool TextureContainer::parse(const std::string& name)
+{
+	if (byte_count < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	std::memcpy(&header, bytes, sizeof(header));
+
+	uint32_t block_bytes = blockBytes((VkFormat)header.format);
+	if (header.magic != TEXTURE_CONTAINER_MAGIC || header.version != TEXTURE_CONTAINER_VERSION || block_bytes == 0
+		|| header.mipCount == 0 || header.mipCount > 32 || header.width == 0 || header.height == 0
+		|| sizeof(header) + (size_t)header.mipCount * sizeof(TextureContainerMip) > byte_count)
+	{
+		std::cout << "[!] Texture container " << name << " has an invalid header" << std::endl;
+		close();
+		return false;
+	}
+
+	mips.resize(header.mipCount);
+	std::memcpy(mips.data(), bytes + sizeof(header), mips.size() * sizeof(TextureContainerMip));
+	for (uint32_t level = 0; level < header.mipCount; level++)
+	{
+		const TextureContainerMip& mip = mips[level];
+		uint64_t blocks = (uint64_t)((mip.width + 3) / 4) * ((mip.height + 3) / 4);
+		if (mip.width != std::max(1u, header.width >> level) || mip.height != std::max(1u, header.height >> level)
+			|| mip.offset % TEXTURE_CONTAINER_ALIGNMENT != 0 || mip.size != blocks * block_bytes
+			|| mip.offset + mip.size > byte_count)
+		{
+			std::cout << "[!] Texture container " << name << " has an invalid mip " << level << std::endl;
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// TGA Source - true color, uncompressed (2) or run length encoded (10)
+static bool decodeTga(const uint8_t* data, size_t size, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height)
+{
+	if (size < 18 || data[1] != 0 || (data[2] != 2 && data[2] != 10) || (data[16] != 24 && data[16] != 32))
+	{
+		return false;
+	}
+
+	width = data[12] | (data[13] << 8);
+	height = data[14] | (data[15] << 8);
+	uint32_t pixel_bytes = data[16] / 8;
+	bool top_down = (data[17] & 0x20) != 0;
+	if (width == 0 || height == 0 || width > TEXTURE_MAX_SOURCE_SIZE || height > TEXTURE_MAX_SOURCE_SIZE)
+	{
+		return false;
+	}
+
+	size_t pos = 18 + data[0];
+	size_t pixel_count = (size_t)width * height;
+	rgba.resize(pixel_count * 4);
+
+	// BGR(A) in, RGBA out - rows are flipped afterwards when stored bottom up
+	auto store = [&](size_t pixel, const uint8_t* source) {
+		rgba[pixel * 4 + 0] = source[2];
+		rgba[pixel * 4 + 1] = source[1];
+		rgba[pixel * 4 + 2] = source[0];
+		rgba[pixel * 4 + 3] = pixel_bytes == 4 ? source[3] : 255;
+	};
+
+	size_t pixel = 0;
+	while (pixel < pixel_count)
+	{
+		uint32_t run = 1;
+		bool repeat = false;
+		if (data[2] == 10)
+		{
+			if (pos >= size)
+			{
+				return false;
+			}
+			run = (data[pos] & 0x7f) + 1;
+			repeat = (data[pos] & 0x80) != 0;
+			pos++;
+		}
+
+		size_t needed = repeat ? pixel_bytes : (size_t)run * pixel_bytes;
+		if (pos + needed > size || pixel + run > pixel_count)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < run; i++)
+		{
+			store(pixel++, data + pos + (repeat ? 0 : (size_t)i * pixel_bytes));
+		}
+		pos += needed;
+	}
+
+	if (!top_down)
+	{
+		size_t row_bytes = (size_t)width * 4;
+		std::vector<uint8_t> row(row_bytes);
+		for (uint32_t y = 0; y < height / 2; y++)
+		{
+			uint8_t* top = rgba.data() + y * row_bytes;
+			uint8_t* bottom = rgba.data() + (height - 1 - y) * row_bytes;
+			std::memcpy(row.data(), top, row_bytes);
+			std::memcpy(top, bottom, row_bytes);
+			std::memcpy(bottom, row.data(), row_bytes);
+		}
+	}
+	return true;
+}
+
+
+// PPM Source - binary (P6) with 8 bit channels
+static bool decodePpm(const uint8_t* data, size_t size, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height)
+{
+	if (size < 2 || data[0] != 'P' || data[1] != '6')
+	{
+		return false;
+	}
+
+	size_t pos = 2;
+	uint32_t values[3] = {};
+	for (uint32_t& value : values)
+	{
+		// Whitespace & comments between header fields
+		while (pos < size && (std::isspace(data[pos]) || data[pos] == '#'))
+		{
+			if (data[pos] == '#')
+			{
+				while (pos < size && data[pos] != '\n')
+				{
+					pos++;
+				}
+			}
+			else
+			{
+				pos++;
+			}
+		}
+		if (pos >= size || !std::isdigit(data[pos]))
+		{
+			return false;
+		}
+		while (pos < size && std::isdigit(data[pos]) && value <= TEXTURE_MAX_SOURCE_SIZE)
+		{
+			value = value * 10 + (data[pos++] - '0');
+		}
+	}
+	pos++;															// Single whitespace before the raster
+
+	width = values[0];
+	height = values[1];
+	if (values[2] != 255 || width == 0 || height == 0 || width > TEXTURE_MAX_SOURCE_SIZE || height > TEXTURE_MAX_SOURCE_SIZE
+		|| pos + (size_t)width * height * 3 > size)
+	{
+		return false;
+	}
+
+	size_t pixel_count = (size_t)width * height;
+	rgba.resize(pixel_count * 4);
+	for (size_t i = 0; i < pixel_count; i++)
+	{
+		rgba[i * 4 + 0] = data[pos + i * 3 + 0];
+		rgba[i * 4 + 1] = data[pos + i * 3 + 1];
+		rgba[i * 4 + 2] = data[pos + i * 3 + 2];
+		rgba[i * 4 + 3] = 255;
+	}
+	return true;
+}
+
+
+bool TextureContainer::decodeImage(const std::string& path, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height)
+{
+	MappedFile source;
+	if (!source.open(path))
+	{
+		return false;
+	}
+
+	if (decodePpm(source.data(), source.size(), rgba, width, height) || decodeTga(source.data(), source.size(), rgba, width, height))
+	{
+		return true;
+	}
+	std::cout << "[!] Texture " << path << " is not a supported TGA or PPM image" << std::endl;
+	return false;
+}
+
+
+static uint16_t packColor565(const uint8_t color[3])
+{
+	return (uint16_t)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+
+static void unpackColor565(uint16_t packed, int color[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+
+// BC1 color block - endpoints from the inset bounding box, each texel takes the nearest of the four palette colors
+static void encodeColorBlock(const uint8_t texels[16][4], uint8_t* out)
+{
+	uint8_t low[3] = { 255, 255, 255 };
+	uint8_t high[3] = { 0, 0, 0 };
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			low[c] = std::min(low[c], texels[i][c]);
+			high[c] = std::max(high[c], texels[i][c]);
+		}
+	}
+
+	// Pull the endpoints in by a sixteenth - the box corners are rarely the best fit
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		uint8_t inset = (uint8_t)((high[c] - low[c]) >> 4);
+		low[c] = (uint8_t)(low[c] + inset);
+		high[c] = (uint8_t)(high[c] - inset);
+	}
+
+	// color0 > color1 selects four color mode
+	uint16_t color0 = packColor565(high);
+	uint16_t color1 = packColor565(low);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		unpackColor565(color0, palette[0]);
+		unpackColor565(color1, palette[1]);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t best = 0;
+			int best_distance = INT32_MAX;
+			for (uint32_t p = 0; p < 4; p++)
+			{
+				int distance = 0;
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					int delta = texels[i][c] - palette[p][c];
+					distance += delta * delta;
+				}
+				if (distance < best_distance)
+				{
+					best = p;
+					best_distance = distance;
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	}
+
+	out[0] = (uint8_t)(color0 & 0xff);
+	out[1] = (uint8_t)(color0 >> 8);
+	out[2] = (uint8_t)(color1 & 0xff);
+	out[3] = (uint8_t)(color1 >> 8);
+	std::memcpy(out + 4, &indices, sizeof(indices));
+}
+
+
+// BC3 alpha block - eight interpolated values between the block's min & max alpha
+static void encodeAlphaBlock(const uint8_t texels[16][4], uint8_t* out)
+{
+	uint8_t alpha0 = 0;
+	uint8_t alpha1 = 255;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		alpha0 = std::max(alpha0, texels[i][3]);
+		alpha1 = std::min(alpha1, texels[i][3]);
+	}
+
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		int palette[8] = { alpha0, alpha1 };
+		for (int i = 1; i < 7; i++)
+		{
+			palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+		}
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint64_t best = 0;
+			int best_distance = INT32_MAX;
+			for (uint32_t p = 0; p < 8; p++)
+			{
+				int distance = std::abs(texels[i][3] - palette[p]);
+				if (distance < best_distance)
+				{
+					best = p;
+					best_distance = distance;
+				}
+			}
+			indices |= best << (3 * i);
+		}
+	}
+
+	out[0] = alpha0;
+	out[1] = alpha1;
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		out[2 + i] = (uint8_t)(indices >> (8 * i));
+	}
+}
+
+
+bool TextureContainer::encode(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, std::vector<uint8_t>& container)
+{
+	if (!rgba || width == 0 || height == 0 || width > TEXTURE_MAX_SOURCE_SIZE || height > TEXTURE_MAX_SOURCE_SIZE)
+	{
+		return false;
+	}
+
+	// BC3 only when some texel is not opaque
+	bool alpha = false;
+	for (size_t i = 0; i < (size_t)width * height && !alpha; i++)
+	{
+		alpha = rgba[i * 4 + 3] != 255;
+	}
+
+	TextureContainerHeader header{};
+	header.magic = TEXTURE_CONTAINER_MAGIC;
+	header.version = TEXTURE_CONTAINER_VERSION;
+	header.format = alpha ? (srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK) : (srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+	header.width = width;
+	header.height = height;
+	header.mipCount = 1;
+	while (std::max(width, height) >> header.mipCount)
+	{
+		header.mipCount++;
+	}
+	uint32_t block_bytes = blockBytes((VkFormat)header.format);
+
+	// Lay the mips out after the table, each on an aligned boundary
+	auto align = [](uint64_t offset) { return (offset + TEXTURE_CONTAINER_ALIGNMENT - 1) & ~(uint64_t)(TEXTURE_CONTAINER_ALIGNMENT - 1); };
+	std::vector<TextureContainerMip> mips(header.mipCount);
+	uint64_t offset = align(sizeof(header) + mips.size() * sizeof(TextureContainerMip));
+	for (uint32_t level = 0; level < header.mipCount; level++)
+	{
+		mips[level].width = std::max(1u, width >> level);
+		mips[level].height = std::max(1u, height >> level);
+		mips[level].offset = offset;
+		mips[level].size = (uint64_t)((mips[level].width + 3) / 4) * ((mips[level].height + 3) / 4) * block_bytes;
+		offset = align(offset + mips[level].size);
+	}
+
+	container.assign((size_t)offset, 0);
+	std::memcpy(container.data(), &header, sizeof(header));
+	std::memcpy(container.data() + sizeof(header), mips.data(), mips.size() * sizeof(TextureContainerMip));
+
+	std::vector<uint8_t> level_pixels(rgba, rgba + (size_t)width * height * 4);
+	for (uint32_t level = 0; level < header.mipCount; level++)
+	{
+		uint32_t level_width = mips[level].width;
+		uint32_t level_height = mips[level].height;
+		uint8_t* out = container.data() + mips[level].offset;
+
+		// Edge blocks repeat the last row & column
+		for (uint32_t by = 0; by < level_height; by += 4)
+		{
+			for (uint32_t bx = 0; bx < level_width; bx += 4)
+			{
+				uint8_t texels[16][4];
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					uint32_t x = std::min(bx + (i & 3), level_width - 1);
+					uint32_t y = std::min(by + (i >> 2), level_height - 1);
+					std::memcpy(texels[i], level_pixels.data() + ((size_t)y * level_width + x) * 4, 4);
+				}
+
+				if (alpha)
+				{
+					encodeAlphaBlock(texels, out);
+					out += 8;
+				}
+				encodeColorBlock(texels, out);
+				out += 8;
+			}
+		}
+
+		// Box filter down to the next level
+		if (level + 1 < header.mipCount)
+		{
+			uint32_t next_width = mips[level + 1].width;
+			uint32_t next_height = mips[level + 1].height;
+			std::vector<uint8_t> next(next_width * (size_t)next_height * 4);
+			for (uint32_t y = 0; y < next_height; y++)
+			{
+				uint32_t y0 = std::min(y * 2, level_height - 1);
+				uint32_t y1 = std::min(y * 2 + 1, level_height - 1);
+				for (uint32_t x = 0; x < next_width; x++)
+				{
+					uint32_t x0 = std::min(x * 2, level_width - 1);
+					uint32_t x1 = std::min(x * 2 + 1, level_width - 1);
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						uint32_t sum = level_pixels[((size_t)y0 * level_width + x0) * 4 + c] + level_pixels[((size_t)y0 * level_width + x1) * 4 + c]
+							+ level_pixels[((size_t)y1 * level_width + x0) * 4 + c] + level_pixels[((size_t)y1 * level_width + x1) * 4 + c];
+						next[((size_t)y * next_width + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+					}
+				}
+			}
+			level_pixels.swap(next);
+		}
+	}
+	return true;
+}
+
+
+bool TextureContainer::write(const std::string& path, const std::vector<uint8_t>& container)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(container.data()), (std::streamsize)container.size());
+	return (bool)out;
+}
@@ -0,0 +1,577 @@
+// Vulkan Renderer - Texture Streamer
+
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+
+
+void TextureStreamer::init(VkDevice logicalDevice, MemoryAllocator* memoryAllocator, DescriptorManager* descriptors, MemoryRing* stagingRing,
+	VkBuffer stagingBuffer, uint32_t framesInFlight, VkDeviceSize stagingBudget, VkDeviceSize memoryBudget, uint32_t decodeThreads, bool blockCompression)
+{
+	device = logicalDevice;
+	allocator = memoryAllocator;
+	descriptorManager = descriptors;
+	staging_ring = stagingRing;
+	staging_buffer = stagingBuffer;
+	frames_in_flight = framesInFlight;
+	staging_budget = stagingBudget;
+	memory_budget = memoryBudget;
+	block_compression = blockCompression;
+	frame_number = 0;
+	stopping = false;
+	stats = TextureStreamStats{};
+
+	// Shared by every streamed texture - maxLod is left open, the image only holds the resident mips
+	VkSamplerCreateInfo sampler_create_info{};
+	sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_create_info.magFilter = VK_FILTER_LINEAR;
+	sampler_create_info.minFilter = VK_FILTER_LINEAR;
+	sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_create_info.minLod = 0.0f;
+	sampler_create_info.maxLod = VK_LOD_CLAMP_NONE;
+	if (vkCreateSampler(device, &sampler_create_info, nullptr, &sampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Texture streamer - failed to create sampler.");
+		std::exit(-1);
+	}
+
+	decodePool = std::make_unique<ThreadPool>(decodeThreads);
+}
+
+
+// Device idle - the pool drains whatever is queued, finished jobs see stopping & skip the decode
+void TextureStreamer::destroy()
+{
+	stopping = true;
+	decodePool.reset();
+	decoded.clear();
+
+	for (std::unique_ptr<Texture>& texture : textures)
+	{
+		destroyImage(texture->current);
+		destroyImage(texture->incoming);
+	}
+	textures.clear();
+	for (RetiredImage& entry : retired)
+	{
+		destroyImage(entry.image);
+	}
+	retired.clear();
+
+	if (sampler != VK_NULL_HANDLE)
+	{
+		vkDestroySampler(device, sampler, nullptr);
+		sampler = VK_NULL_HANDLE;
+	}
+}
+
+
+TextureHandle TextureStreamer::load(const std::string& path, bool srgb)
+{
+	TextureHandle handle = (TextureHandle)textures.size();
+	std::unique_ptr<Texture> texture = std::make_unique<Texture>();
+	texture->path = path;
+	texture->srgb = srgb;
+	textures.push_back(std::move(texture));
+	stats.loading++;
+
+	if (!block_compression)
+	{
+		std::lock_guard<std::mutex> lock(decoded_mutex);
+		std::cout << "[!] Texture streamer - BC formats unsupported, skipping " << path << std::endl;
+		decoded.push_back({ handle, nullptr });
+		return handle;
+	}
+
+	// Workers only see copies - textures grows on the render thread
+	decodePool->submit([this, handle, path, srgb]() {
+		std::unique_ptr<TextureContainer> container;
+		if (!stopping)
+		{
+			container = std::make_unique<TextureContainer>();
+			bool loaded = false;
+			if (TextureContainer::isContainer(path))
+			{
+				loaded = container->open(path);
+			}
+			else
+			{
+				std::vector <uint8_t> rgba;
+				std::vector <uint8_t> bytes;
+				uint32_t width = 0;
+				uint32_t height = 0;
+				loaded = TextureContainer::decodeImage(path, rgba, width, height)
+					&& TextureContainer::encode(rgba.data(), width, height, srgb, bytes)
+					&& container->load(std::move(bytes));
+			}
+			if (!loaded)
+			{
+				container.reset();
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(decoded_mutex);
+		decoded.push_back({ handle, std::move(container) });
+	});
+
+	return handle;
+}
+
+
+void TextureStreamer::requestMip(TextureHandle handle, uint32_t mip)
+{
+	Texture& texture = *textures[handle];
+	if (texture.requestFrame == frame_number && texture.requestedMip != UINT32_MAX)
+	{
+		texture.requestedMip = std::min(texture.requestedMip, mip);
+	}
+	else
+	{
+		texture.requestedMip = mip;
+	}
+	texture.requestFrame = frame_number;
+}
+
+
+void TextureStreamer::requestScreenSize(TextureHandle handle, float screenPixels)
+{
+	Texture& texture = *textures[handle];
+	if (texture.state != TEXTURE_READY)
+	{
+		return;
+	}
+
+	// One texel per pixel - each halving of the on screen size drops a mip
+	float size = (float)std::max(texture.container->width(), texture.container->height());
+	float mip = screenPixels > 1.0f ? std::floor(std::log2(size / screenPixels)) : (float)texture.container->mipCount();
+	requestMip(handle, (uint32_t)std::max(mip, 0.0f));
+}
+
+
+uint32_t TextureStreamer::getIndex(TextureHandle handle) const
+{
+	return textures[handle]->current.index;
+}
+
+
+uint32_t TextureStreamer::getResidentMip(TextureHandle handle) const
+{
+	return textures[handle]->current.firstMip;
+}
+
+
+bool TextureStreamer::isLoaded(TextureHandle handle) const
+{
+	const Texture& texture = *textures[handle];
+	return texture.state == TEXTURE_READY && texture.current.image != VK_NULL_HANDLE;
+}
+
+
+void TextureStreamer::beginFrame(uint64_t frameNumber)
+{
+	frame_number = frameNumber;
+
+	while (staging_ring->pendingFrames() >= frames_in_flight)
+	{
+		staging_ring->releaseFrame();
+	}
+
+	for (size_t i = 0; i < retired.size();)
+	{
+		if (frame_number >= retired[i].frameNumber + frames_in_flight)
+		{
+			destroyImage(retired[i].image);
+			retired[i] = retired.back();
+			retired.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	std::vector <DecodedTexture> finished;
+	{
+		std::lock_guard<std::mutex> lock(decoded_mutex);
+		finished.swap(decoded);
+	}
+
+	for (DecodedTexture& result : finished)
+	{
+		Texture& texture = *textures[result.handle];
+		stats.loading--;
+
+		if (!result.container)
+		{
+			texture.state = TEXTURE_FAILED;
+			stats.failed++;
+			std::cout << "[!] Texture streamer - failed to load " << texture.path << std::endl;
+			continue;
+		}
+
+		texture.container = std::move(result.container);
+		texture.state = TEXTURE_READY;
+
+		uint32_t mip_count = texture.container->mipCount();
+		texture.tailMip = mip_count - 1;
+		for (uint32_t level = 0; level < mip_count; level++)
+		{
+			const TextureContainerMip& mip = texture.container->mip(level);
+			if (std::max(mip.width, mip.height) <= TEXTURE_TAIL_SIZE)
+			{
+				texture.tailMip = level;
+				break;
+			}
+		}
+		texture.current.firstMip = mip_count;
+	}
+}
+
+
+void TextureStreamer::recordUploads(VkCommandBuffer command_buffer)
+{
+	std::vector <VkImageMemoryBarrier> finished;
+	VkDeviceSize used = 0;
+
+	// Finish what earlier frames started before anything new takes staging space
+	for (std::unique_ptr<Texture>& texture : textures)
+	{
+		if (texture->uploading && used < staging_budget)
+		{
+			used += continueUpload(*texture, command_buffer, staging_budget - used, finished);
+		}
+	}
+
+	std::vector <Texture*> candidates;
+	for (std::unique_ptr<Texture>& texture : textures)
+	{
+		if (texture->state == TEXTURE_READY && !texture->uploading && desiredMip(*texture) < texture->current.firstMip)
+		{
+			candidates.push_back(texture.get());
+		}
+	}
+
+	// First loads, then the textures furthest from what they want, then the most recently requested
+	std::sort(candidates.begin(), candidates.end(), [this](const Texture* a, const Texture* b) {
+		bool a_first = a->current.image == VK_NULL_HANDLE;
+		bool b_first = b->current.image == VK_NULL_HANDLE;
+		if (a_first != b_first)
+		{
+			return a_first;
+		}
+		uint32_t a_gap = a->current.firstMip - desiredMip(*a);
+		uint32_t b_gap = b->current.firstMip - desiredMip(*b);
+		if (a_gap != b_gap)
+		{
+			return a_gap > b_gap;
+		}
+		return a->requestFrame > b->requestFrame;
+	});
+
+	for (Texture* texture : candidates)
+	{
+		if (used >= staging_budget)
+		{
+			break;
+		}
+
+		// The tail lands in one go, finer mips are promoted one level at a time
+		bool first_load = texture->current.image == VK_NULL_HANDLE;
+		uint32_t first_mip = first_load ? texture->tailMip : texture->current.firstMip - 1;
+		if (!makeRoom(imageBytes(*texture, first_mip), texture, command_buffer) && !first_load)
+		{
+			continue;
+		}
+
+		startUpload(*texture, first_mip, command_buffer);
+		used += continueUpload(*texture, command_buffer, staging_budget - used, finished);
+	}
+
+	if (!finished.empty())
+	{
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, (uint32_t)finished.size(), finished.data());
+	}
+}
+
+
+void TextureStreamer::endFrame()
+{
+	staging_ring->endFrame();
+}
+
+
+uint32_t TextureStreamer::desiredMip(const Texture& texture) const
+{
+	if (texture.requestedMip == UINT32_MAX || frame_number > texture.requestFrame + TEXTURE_DEMAND_FRAMES)
+	{
+		return texture.tailMip;
+	}
+	return std::min(texture.requestedMip, texture.tailMip);
+}
+
+
+VkDeviceSize TextureStreamer::imageBytes(const Texture& texture, uint32_t firstMip) const
+{
+	VkDeviceSize bytes = 0;
+	for (uint32_t level = firstMip; level < texture.container->mipCount(); level++)
+	{
+		bytes += texture.container->mip(level).size;
+	}
+	return bytes;
+}
+
+
+void TextureStreamer::createMipImage(Texture& texture, uint32_t firstMip, MipImage& image)
+{
+	const TextureContainer& container = *texture.container;
+	const TextureContainerMip& mip = container.mip(firstMip);
+	uint32_t level_count = container.mipCount() - firstMip;
+
+	VkImageCreateInfo image_create_info{};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = container.format();
+	image_create_info.extent = { mip.width, mip.height, 1 };
+	image_create_info.mipLevels = level_count;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(device, &image_create_info, nullptr, &image.image) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Texture streamer - failed to create image.");
+		std::exit(-1);
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, image.image, &requirements);
+
+	MemoryAllocationCreateInfo memory_info{};
+	memory_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	memory_info.optimalImage = true;
+	image.allocation = allocator->allocate(requirements, memory_info);
+	vkBindImageMemory(device, image.image, image.allocation.memory, image.allocation.offset);
+
+	VkImageViewCreateInfo view_create_info{};
+	view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_create_info.image = image.image;
+	view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_create_info.format = container.format();
+	view_create_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count, 0, 1 };
+	if (vkCreateImageView(device, &view_create_info, nullptr, &image.view) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[!] Texture streamer - failed to create image view.");
+		std::exit(-1);
+	}
+
+	image.firstMip = firstMip;
+	image.index = BINDLESS_INDEX_NONE;
+	stats.residentBytes += image.allocation.size;
+}
+
+
+// Frames recorded up to now may still sample it - the slot & image outlive them
+void TextureStreamer::retireImage(MipImage& image)
+{
+	if (image.image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	if (image.index != BINDLESS_INDEX_NONE)
+	{
+		descriptorManager->removeTexture(image.index, frame_number);
+	}
+	stats.residentBytes -= image.allocation.size;
+	retired.push_back({ image, frame_number });
+	image = MipImage{};
+}
+
+
+void TextureStreamer::destroyImage(MipImage& image)
+{
+	if (image.view != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(device, image.view, nullptr);
+	}
+	if (image.image != VK_NULL_HANDLE)
+	{
+		vkDestroyImage(device, image.image, nullptr);
+		allocator->free(image.allocation);
+	}
+	image = MipImage{};
+}
+
+
+bool TextureStreamer::makeRoom(VkDeviceSize bytes, const Texture* keep, VkCommandBuffer command_buffer)
+{
+	// Images being replaced are freed once their upload lands - count them as gone already
+	VkDeviceSize projected = stats.residentBytes;
+	for (const std::unique_ptr<Texture>& texture : textures)
+	{
+		if (texture->uploading)
+		{
+			projected -= texture->current.allocation.size;
+		}
+	}
+	if (projected + bytes <= memory_budget)
+	{
+		return true;
+	}
+
+	std::vector <Texture*> victims;
+	for (std::unique_ptr<Texture>& texture : textures)
+	{
+		if (texture.get() != keep && texture->state == TEXTURE_READY && !texture->uploading
+			&& texture->current.image != VK_NULL_HANDLE && texture->current.firstMip < desiredMip(*texture))
+		{
+			victims.push_back(texture.get());
+		}
+	}
+	std::sort(victims.begin(), victims.end(), [](const Texture* a, const Texture* b) {
+		return a->requestFrame < b->requestFrame;
+	});
+
+	// Evicting rebuilds the smaller image from the container, so it costs staging space like any upload
+	for (Texture* victim : victims)
+	{
+		if (projected + bytes <= memory_budget)
+		{
+			break;
+		}
+		uint32_t first_mip = desiredMip(*victim);
+		VkDeviceSize freed = victim->current.allocation.size;
+		startUpload(*victim, first_mip, command_buffer);
+		projected = projected - freed + victim->incoming.allocation.size;
+	}
+
+	return projected + bytes <= memory_budget;
+}
+
+
+void TextureStreamer::startUpload(Texture& texture, uint32_t firstMip, VkCommandBuffer command_buffer)
+{
+	createMipImage(texture, firstMip, texture.incoming);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = texture.incoming.image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	texture.uploading = true;
+	texture.uploadLevel = firstMip;
+	texture.uploadRow = 0;
+}
+
+
+// Copies whole block rows - a mip bigger than the budget is split across frames
+VkDeviceSize TextureStreamer::continueUpload(Texture& texture, VkCommandBuffer command_buffer, VkDeviceSize budget,
+	std::vector<VkImageMemoryBarrier>& finished)
+{
+	const TextureContainer& container = *texture.container;
+	uint32_t block_bytes = TextureContainer::blockBytes(container.format());
+	VkDeviceSize used = 0;
+
+	while (texture.uploadLevel < container.mipCount())
+	{
+		const TextureContainerMip& mip = container.mip(texture.uploadLevel);
+		uint32_t block_rows = (mip.height + 3) / 4;
+		VkDeviceSize row_bytes = (VkDeviceSize)((mip.width + 3) / 4) * block_bytes;
+
+		// At least one row per call, or a row wider than the budget would never move
+		VkDeviceSize fit = (budget - used) / row_bytes;
+		uint32_t row_count = (uint32_t)std::min<VkDeviceSize>(block_rows - texture.uploadRow, fit);
+		if (row_count == 0 && used == 0)
+		{
+			row_count = 1;
+		}
+		if (row_count == 0)
+		{
+			break;
+		}
+
+		VkDeviceSize size = row_bytes * row_count;
+		MemoryAllocation staging;
+		if (!staging_ring->allocate(size, TEXTURE_STAGING_ALIGNMENT, staging))
+		{
+			break;
+		}
+		std::memcpy(staging.mapped, container.mipData(texture.uploadLevel) + row_bytes * texture.uploadRow, (size_t)size);
+
+		uint32_t y = texture.uploadRow * 4;
+		VkBufferImageCopy region{};
+		region.bufferOffset = staging.offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, texture.uploadLevel - texture.incoming.firstMip, 0, 1 };
+		region.imageOffset = { 0, (int32_t)y, 0 };
+		region.imageExtent = { mip.width, std::min(row_count * 4, mip.height - y), 1 };
+		vkCmdCopyBufferToImage(command_buffer, staging_buffer, texture.incoming.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		used += size;
+		stats.uploadedBytes += size;
+		texture.uploadRow += row_count;
+		if (texture.uploadRow == block_rows)
+		{
+			texture.uploadLevel++;
+			texture.uploadRow = 0;
+		}
+	}
+
+	if (texture.uploadLevel < container.mipCount())
+	{
+		return used;
+	}
+
+	// Complete - the slot is written now, the barrier recorded at the end of recordUploads covers it before any shader reads
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = texture.incoming.image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+	finished.push_back(barrier);
+
+	texture.incoming.index = descriptorManager->addTexture(texture.incoming.view, sampler);
+	if (texture.current.image == VK_NULL_HANDLE)
+	{
+		stats.resident++;
+	}
+	else if (texture.incoming.firstMip < texture.current.firstMip)
+	{
+		stats.promotions++;
+	}
+	else
+	{
+		stats.evictions++;
+	}
+
+	retireImage(texture.current);
+	texture.current = texture.incoming;
+	texture.incoming = MipImage{};
+	texture.uploading = false;
+	return used;
+}
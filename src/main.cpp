@@ -1,23 +1,447 @@
-
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 #include "Renderer.h"
 
 #define WIDTH 400
 #define HEIGHT 400
 
+#define COMPARE_FRAME_COUNT 500
+#define HEADLESS_FRAME_COUNT 500
+#define STARTUP_BENCH_RUNS 5
+#define PIPELINE_BENCH_VARIANTS 64
+#define RECORD_BENCH_DRAWS 20000
+#define RECORD_BENCH_FRAMES 200
+#define SCENE_OBJECT_EXTENT 4.0f            // Objects are scattered over four times the visible clip space per axis
 
-int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow)
+
+// Repeat the default mesh draw to build a CPU heavy draw list
+static void replicateDraws(Renderer& vulkan, uint32_t drawCount)
+{
+    if (drawCount > 0)
+    {
+        vulkan.setDrawList(std::vector<VkDrawIndexedIndirectCommand>(drawCount, vulkan.getDrawList()[0]));
+    }
+}
+
+
+// Scatter copies of the default mesh as GPU driven objects - about four in five land outside the frustum
+static void scatterSceneObjects(Renderer& vulkan, uint32_t objectCount)
+{
+    if (objectCount == 0 || !vulkan.isGpuDriven())
+    {
+        return;
+    }
+
+    const VkDrawIndexedIndirectCommand& mesh = vulkan.getDrawList()[0];
+    std::vector<GpuObject> objects(objectCount);
+    uint32_t seed = 1;
+    for (GpuObject& object : objects)
+    {
+        for (int axis = 0; axis < 2; axis++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            object.center[axis] = ((seed >> 8) / 16777216.0f * 2.0f - 1.0f) * SCENE_OBJECT_EXTENT;
+        }
+        object.center[2] = 0.0f;
+        object.radius = 0.75f;
+        object.indexCount = mesh.indexCount;
+        object.firstIndex = mesh.firstIndex;
+        object.vertexOffset = mesh.vertexOffset;
+        object.firstInstance = 0;
+    }
+    vulkan.setSceneObjects(objects);
+}
+
+
+// Draw the same workload with 1..MAX_FRAMES_IN_FLIGHT frames in flight and report throughput
+static void compareFramesInFlight(const RendererConfig& baseConfig, uint32_t frameCount, uint32_t drawCount, uint32_t objectCount)
+{
+    for (uint32_t frames = 1; frames <= MAX_FRAMES_IN_FLIGHT; frames++)
+    {
+        RendererConfig config = baseConfig;
+        config.framesInFlight = frames;
+
+        Renderer vulkan(config);
+        replicateDraws(vulkan, drawCount);
+        scatterSceneObjects(vulkan, objectCount);
+        vulkan.runFrames(frameCount / 10);         // Warm up
+        vulkan.resetFrameStats();
+        vulkan.runFrames(frameCount);
+        vulkan.printFrameStats();
+    }
+}
+
+
+// Time renderer startup with no pipeline cache (cold) and with the cache left by the previous launch (warm)
+static void benchmarkStartup(const RendererConfig& baseConfig, uint32_t runs)
+{
+    RendererConfig config = baseConfig;
+    if (config.pipelineCachePath.empty())
+    {
+        config.pipelineCachePath = PIPELINE_CACHE_FILE;
+    }
+
+    for (int warm = 0; warm < 2; warm++)
+    {
+        double totalInitMs = 0.0;
+        double totalPipelineMs = 0.0;
+        size_t cacheBytes = 0;
+
+        for (uint32_t i = 0; i < runs; i++)
+        {
+            if (!warm)
+            {
+                std::remove(config.pipelineCachePath.c_str());
+            }
+
+            Renderer vulkan(config);
+            const StartupStats& stats = vulkan.getStartupStats();
+            totalInitMs += stats.initMs;
+            totalPipelineMs += stats.pipelineMs;
+            cacheBytes = stats.pipelineCacheBytes;
+        }
+
+        std::cout << (warm ? "[*] Warm" : "[*] Cold") << " startup (" << runs << " runs): "
+            << std::fixed << std::setprecision(3)
+            << "init " << totalInitMs / runs << " ms, "
+            << "pipeline " << totalPipelineMs / runs << " ms, "
+            << "cache " << cacheBytes << " bytes" << std::endl;
+    }
+}
+
+
+// Compile the same set of pipeline variants on one worker, then on every core
+static void benchmarkPipelineCompile(const RendererConfig& baseConfig, uint32_t variantCount)
+{
+    const VkCullModeFlags cullModes[] = { VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT };
+
+    for (uint32_t threads : { 1u, 0u })
+    {
+        RendererConfig config = baseConfig;
+        config.pipelineCachePath.clear();      // Every variant must be a cache miss
+        config.pipelineThreads = threads;
+        Renderer vulkan(config);
+
+        // Distinct specialization data keeps the driver from deduplicating variants
+        auto start = std::chrono::steady_clock::now();
+        PipelineHandle last = PIPELINE_HANDLE_NONE;
+        for (uint32_t i = 0; i < variantCount; i++)
+        {
+            PipelineDesc desc = vulkan.basePipelineDesc();
+            desc.cullMode = cullModes[i % 3];
+            desc.blendEnable = (i / 3) % 2 == 1;
+            desc.specialization = { i };
+            last = vulkan.requestPipelineVariant(desc);
+        }
+        vulkan.setActivePipeline(last);
+        vulkan.waitForPipelines();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "[*] " << variantCount << " pipeline variants on " << (threads ? "1 worker" : "all workers") << ": "
+            << std::fixed << std::setprecision(3) << ms << " ms" << std::endl;
+    }
+}
+
+
+// Write a tightly packed RGBA frame as a binary PPM
+static void writePPM(const std::string& path, const std::vector<uint8_t>& rgba, VkExtent2D extent)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+    for (size_t i = 0; i + 3 < rgba.size(); i += 4)
+    {
+        file.write(reinterpret_cast<const char*>(&rgba[i]), 3);
+    }
+}
+
+
+// Record a large draw list inline, then on 1..N recording workers - the cpu p50 is recording & submit cost, waits excluded
+static void compareRecordThreads(const RendererConfig& baseConfig, uint32_t drawCount)
+{
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t threads = 0; threads <= maxThreads; threads = threads ? threads * 2 : 1)
+    {
+        RendererConfig config = baseConfig;
+        config.recordThreads = threads;
+
+        Renderer vulkan(config);
+        replicateDraws(vulkan, drawCount);
+        vulkan.runFrames(RECORD_BENCH_FRAMES / 10);
+        vulkan.resetFrameStats();
+        vulkan.keepFrameSamples(true);
+        vulkan.runFrames(RECORD_BENCH_FRAMES);
+
+        // The stats' average cpu includes the fence & acquire waits, which shift with the worker count
+        std::vector<double> cpuTimes = vulkan.getFrameStats().cpuTimesMs;
+        double cpuP50 = 0.0;
+        if (!cpuTimes.empty())
+        {
+            std::nth_element(cpuTimes.begin(), cpuTimes.begin() + cpuTimes.size() / 2, cpuTimes.end());
+            cpuP50 = cpuTimes[cpuTimes.size() / 2];
+        }
+        std::cout << "[*] " << drawCount << " draws, " << threads << " recording workers: cpu p50 "
+            << std::fixed << std::setprecision(3) << cpuP50 << " ms" << std::endl;
+        vulkan.printFrameStats();
+    }
+}
+
+
+// Print the profiler summary & write its Chrome trace - open in chrome://tracing or ui.perfetto.dev
+static void reportProfile(Renderer& vulkan, const std::string& tracePath)
+{
+    if (!vulkan.getGpuProfiler().isEnabled())
+    {
+        return;
+    }
+    vulkan.getGpuProfiler().printSummary();
+    if (!tracePath.empty())
+    {
+        vulkan.getGpuProfiler().exportChromeTrace(tracePath);
+    }
+}
+
+
+// Render a fixed number of frames offscreen and optionally dump the last one
+static void runHeadless(const RendererConfig& config, uint32_t frameCount, uint32_t drawCount, uint32_t objectCount, const std::string& dumpPath, const std::string& tracePath)
+{
+    Renderer vulkan(config);
+    replicateDraws(vulkan, drawCount);
+    scatterSceneObjects(vulkan, objectCount);
+
+    std::vector<uint8_t> lastFrame;
+    VkExtent2D lastExtent{};
+    if (!dumpPath.empty())
+    {
+        vulkan.setFrameReadbackCallback([&](const void* pixels, VkExtent2D extent, uint64_t frameNumber) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(pixels);
+            lastFrame.assign(bytes, bytes + (size_t)extent.width * extent.height * 4);
+            lastExtent = extent;
+        });
+    }
+
+    vulkan.runFrames(frameCount);
+    vulkan.printFrameStats();
+    reportProfile(vulkan, tracePath);
+    vulkan.defragmentMemory();
+    vulkan.printMemoryStats();
+
+    if (!dumpPath.empty() && !lastFrame.empty())
+    {
+        writePPM(dumpPath, lastFrame, lastExtent);
+    }
+}
+
+
+static bool parsePresentMode(const char* name, VkPresentModeKHR& mode)
 {
-    Renderer vulkan;
+    static const struct { const char* name; VkPresentModeKHR mode; } modes[] = {
+        { "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR },
+        { "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+        { "fifo", VK_PRESENT_MODE_FIFO_KHR },
+        { "fifo-relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+    };
+    for (const auto& entry : modes) {
+        if (strcmp(name, entry.name) == 0) {
+            mode = entry.mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static int run(int argc, char** argv)
+{
+    RendererConfig config;
+    uint32_t frameCount = HEADLESS_FRAME_COUNT;
+    uint32_t compareFrameCount = 0;
+    uint32_t startupRuns = 0;
+    uint32_t pipelineVariants = 0;
+    uint32_t drawCount = 0;
+    uint32_t recordBenchDraws = 0;
+    uint32_t objectCount = 0;
+    std::string dumpPath;
+    std::string tracePath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+        {
+            config.framesInFlight = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            config.headless = true;
+        }
+        else if (strcmp(argv[i], "--no-validation") == 0)
+        {
+            config.enableValidation = false;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frameCount = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--dump-frame") == 0 && i + 1 < argc)
+        {
+            dumpPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc)
+        {
+            config.pipelineCachePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-pipeline-cache") == 0)
+        {
+            config.pipelineCachePath.clear();
+        }
+        else if (strcmp(argv[i], "--startup-bench") == 0)
+        {
+            startupRuns = STARTUP_BENCH_RUNS;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                startupRuns = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+            }
+        }
+        else if (strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc)
+        {
+            config.recordThreads = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+        {
+            drawCount = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--compare-record-threads") == 0)
+        {
+            recordBenchDraws = RECORD_BENCH_DRAWS;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                recordBenchDraws = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+            }
+        }
+        else if (strcmp(argv[i], "--gpu-driven") == 0)
+        {
+            config.gpuDriven = true;
+        }
+        else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+        {
+            objectCount = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--hot-reload") == 0)
+        {
+            config.hotReload = true;
+        }
+        else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc)
+        {
+            if (!parsePresentMode(argv[++i], config.presentMode))
+            {
+                std::cerr << "[!] Unknown present mode " << argv[i] << " - expected immediate, mailbox, fifo or fifo-relaxed" << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc)
+        {
+            config.targetFps = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--low-latency") == 0)
+        {
+            config.lowLatency = true;
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            config.profileGpu = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                tracePath = argv[++i];
+            }
+        }
+        else if (strcmp(argv[i], "--pipeline-threads") == 0 && i + 1 < argc)
+        {
+            config.pipelineThreads = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--pipeline-bench") == 0)
+        {
+            pipelineVariants = PIPELINE_BENCH_VARIANTS;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                pipelineVariants = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+            }
+        }
+        else if (strcmp(argv[i], "--compare-frames-in-flight") == 0)
+        {
+            compareFrameCount = COMPARE_FRAME_COUNT;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                compareFrameCount = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+            }
+        }
+    }
+
+    if (startupRuns > 0)
+    {
+        benchmarkStartup(config, startupRuns);
+        return 0;
+    }
+
+    if (pipelineVariants > 0)
+    {
+        benchmarkPipelineCompile(config, pipelineVariants);
+        return 0;
+    }
+
+    if (recordBenchDraws > 0)
+    {
+        compareRecordThreads(config, recordBenchDraws);
+        return 0;
+    }
+
+    if (compareFrameCount > 0)
+    {
+        compareFramesInFlight(config, compareFrameCount, drawCount, objectCount);
+        return 0;
+    }
+
+    if (config.headless)
+    {
+        runHeadless(config, frameCount, drawCount, objectCount, dumpPath, tracePath);
+        return 0;
+    }
+
+    Renderer vulkan(config);
+    replicateDraws(vulkan, drawCount);
+    scatterSceneObjects(vulkan, objectCount);
     vulkan.eventHandler();
+    vulkan.printFrameStats();
+    reportProfile(vulkan, tracePath);
 
     return 0;
 }
 
-// mingw32-make -f Makefile
-//  /home/user/VulkanSDK/x.x.x.x/x86_64/bin/glslc shader.vert -o vert.spv
-//  /home/user/VulkanSDK/x.x.x.x/x86_64/bin/glslc shader.frag -o frag.spv
 
+#ifdef _WIN32
+int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow)
+{
+    return run(__argc, __argv);
+}
+#else
+int main(int argc, char** argv)
+{
+    return run(argc, argv);
+}
+#endif
+
+// cmake -S . -B build && cmake --build build -j   (rebuilds the shaders too when glslc is installed)
+//  ./VulkanTest --compare-frames-in-flight 1000 --headless   (e.g. VK_ICD_FILENAMES=lvp_icd.x86_64.json for lavapipe)
+//  ./VulkanTest --headless --no-validation --frames 1000 --dump-frame out.ppm
+//  MESA_SHADER_CACHE_DISABLE=true ./VulkanTest --headless --no-validation --startup-bench 10
+//  MESA_SHADER_CACHE_DISABLE=true ./VulkanTest --headless --no-validation --pipeline-bench 128
+//  ./VulkanTest --headless --no-validation --compare-record-threads 50000
+//  ./VulkanTest --headless --no-validation --gpu-driven --objects 100000 --compare-frames-in-flight
+//  ./VulkanTest --present-mode fifo --low-latency           (prints acquire, pacing & measured present latency on exit)
+//  ./VulkanTest --present-mode immediate --target-fps 144
+//  ./VulkanTest --headless --no-validation --frames 500 --profile trace.json   (GPU timings per pass, Chrome trace format)
+//  ./VulkanTest --hot-reload   (recompiles edited shaders through glslc - $GLSLC or PATH - unless built with RENDERER_USE_SHADERC)
 
@@ -0,0 +1,17 @@
+// Bindless table - matches DescriptorManager, bound once per command buffer at set 0
+//
+//   #extension GL_EXT_nonuniform_qualifier : require
+//   #include "bindless.glsl"
+//
+// Indices come from DescriptorManager::addTexture / addStorageBuffer. Wrap an index in
+// nonuniformEXT() whenever it can differ between invocations of one draw.
+
+layout(set = 0, binding = 0) uniform sampler2D bindlessTextures[];
+
+layout(std430, set = 0, binding = 1) readonly buffer BindlessBuffer {
+    uint words[];
+} bindlessBuffers[];
+
+vec4 sampleBindless(uint index, vec2 uv) {
+    return texture(bindlessTextures[nonuniformEXT(index)], uv);
+}
@@ -1,2 +1,7 @@
 H:/Source_Libraries/Vulkan/Bin/glslc.exe shader_base.vert -o vert.spv
-H:/Source_Libraries/Vulkan/Bin/glslc.exe shader_base.frag -o frag.spv
\ No newline at end of file
+H:/Source_Libraries/Vulkan/Bin/glslc.exe shader_base.frag -o frag.spv
+H:/Source_Libraries/Vulkan/Bin/glslc.exe cull.comp -o cull.spv
+H:/Source_Libraries/Vulkan/Bin/glslc.exe instanced.vert -o instanced.spv
+H:/Source_Libraries/Vulkan/Bin/glslc.exe mesh.vert -o mesh.spv
+cd ..\..
+pack_shaders.exe src/shaders/shaders.spva src/shaders/vert.spv src/shaders/frag.spv src/shaders/cull.spv src/shaders/instanced.spv src/shaders/mesh.spv
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 450
+
+// Instanced variant of shader_base.vert - per instance streams arrive through bindings 1-3
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec4 instanceTransform;     // xy offset, scale, rotation in radians
+layout(location = 3) in vec4 instanceColor;         // RGBA8 unorm
+layout(location = 4) in uint instanceId;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) flat out uint fragInstanceId;
+
+layout(std140, set = 1, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+    vec2 extent;
+    float time;
+    uint frameNumber;
+} frame;
+
+void main() {
+    float s = sin(instanceTransform.w);
+    float c = cos(instanceTransform.w);
+    vec2 position = mat2(c, s, -s, c) * inPosition * instanceTransform.z + instanceTransform.xy;
+
+    gl_Position = frame.viewProjection * vec4(position, 0.0, 1.0);
+    fragColor = inColor * instanceColor.rgb;
+    fragInstanceId = instanceId;
+}
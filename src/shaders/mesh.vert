@@ -0,0 +1,40 @@
+#version 450
+
+// Model variant of shader_base.vert - vertex layout comes from the mesh container's attribute table,
+// locations follow MeshAttributeSemantic. Quantized positions are dequantized by the model matrix,
+// quantized normals arrive octahedral encoded in xy.
+
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(std140, set = 1, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+    vec2 extent;
+    float time;
+    uint frameNumber;
+} frame;
+
+layout(push_constant) uniform DrawConstants {
+    mat4 model;
+} draw;
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return n;
+}
+
+void main() {
+    gl_Position = frame.viewProjection * draw.model * vec4(inPosition, 1.0);
+
+    // Until materials exist - a fixed light over the object space normal
+    vec3 normal = normalize(OCTAHEDRAL_NORMALS ? decodeOctahedral(inNormal.xy) : inNormal);
+    float light = 0.25 + 0.75 * max(dot(normal, normalize(vec3(0.4, 0.8, 0.45))), 0.0);
+    fragColor = vec3(light) * mix(vec3(1.0), vec3(inUV, 1.0), 0.15);
+}
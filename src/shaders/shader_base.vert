@@ -1,20 +1,24 @@
 #version 450
 
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
 layout(location = 0) out vec3 fragColor;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// Written once per frame into the uniform ring - FrameUniforms in Renderer.h
+layout(std140, set = 1, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+    vec2 extent;
+    float time;
+    uint frameNumber;
+} frame;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+// Per draw - DrawConstants in Renderer.h
+layout(push_constant) uniform DrawConstants {
+    mat4 model;
+} draw;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    gl_Position = frame.viewProjection * draw.model * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+}
@@ -0,0 +1,190 @@
+// Vulkan Renderer - Memory Allocator Tests
+
+#include <vector>
+#include <algorithm>
+
+#include "TestHarness.h"
+#include "MemoryAllocator.h"
+
+
+#define TEST_HEAP_SIZE (1024 * 1024)
+#define TEST_RING_SIZE 1024
+
+
+// ----- TLSF Heap -----
+
+TEST_CASE(MemoryAllocator, TlsfAlignedAllocationsDoNotOverlap)
+{
+	TlsfHeap heap;
+	heap.init(TEST_HEAP_SIZE);
+
+	const VkDeviceSize sizes[] = { 100, 4096, 1, 70000, 256, 3 };
+	const VkDeviceSize alignments[] = { 1, 256, 64, 4096, 16, 1024 };
+	std::vector <std::pair<VkDeviceSize, VkDeviceSize>> ranges;
+	for (int i = 0; i < 6; i++)
+	{
+		VkDeviceSize offset;
+		uint32_t node;
+		REQUIRE(heap.allocate(sizes[i], alignments[i], offset, node));
+		CHECK(offset % alignments[i] == 0);
+		CHECK(offset + sizes[i] <= heap.capacity());
+		CHECK(heap.nodeSize(node) >= sizes[i]);
+		ranges.push_back({ offset, offset + sizes[i] });
+	}
+	CHECK(heap.allocationCount() == 6);
+
+	std::sort(ranges.begin(), ranges.end());
+	for (size_t i = 1; i < ranges.size(); i++)
+	{
+		CHECK(ranges[i - 1].second <= ranges[i].first);
+	}
+}
+
+
+TEST_CASE(MemoryAllocator, TlsfFreeCoalescesNeighbours)
+{
+	TlsfHeap heap;
+	heap.init(TEST_HEAP_SIZE);
+
+	// Free out of order so every merge direction is taken
+	std::vector <uint32_t> nodes(16);
+	for (uint32_t& node : nodes)
+	{
+		VkDeviceSize offset;
+		REQUIRE(heap.allocate(TEST_HEAP_SIZE / 16, 1, offset, node));
+	}
+	CHECK(heap.usedBytes() == TEST_HEAP_SIZE);
+	CHECK(heap.largestFreeRange() == 0);
+
+	VkDeviceSize offset;
+	uint32_t node;
+	CHECK(!heap.allocate(1, 1, offset, node));
+
+	for (uint32_t i = 0; i < 16; i += 2)
+	{
+		heap.free(nodes[i]);
+	}
+	CHECK(heap.largestFreeRange() == TEST_HEAP_SIZE / 16);
+	for (uint32_t i = 1; i < 16; i += 2)
+	{
+		heap.free(nodes[i]);
+	}
+	CHECK(heap.empty());
+	CHECK(heap.usedBytes() == 0);
+	CHECK(heap.largestFreeRange() == TEST_HEAP_SIZE);
+
+	// One range again - the whole heap fits in a single allocation
+	REQUIRE(heap.allocate(TEST_HEAP_SIZE, 1, offset, node));
+	CHECK(offset == 0);
+	heap.free(node);
+}
+
+
+TEST_CASE(MemoryAllocator, TlsfRejectsOversizedRequests)
+{
+	TlsfHeap heap;
+	heap.init(TEST_HEAP_SIZE);
+
+	VkDeviceSize offset;
+	uint32_t node;
+	CHECK(!heap.allocate(TEST_HEAP_SIZE + 1, 1, offset, node));
+	CHECK(heap.empty());
+
+	REQUIRE(heap.allocate(TEST_HEAP_SIZE / 2, 1, offset, node));
+	CHECK(!heap.allocate(TEST_HEAP_SIZE / 2 + 1, 1, offset, node));
+	CHECK(heap.allocationCount() == 1);
+}
+
+
+// ----- Memory Ring -----
+
+TEST_CASE(MemoryAllocator, RingWrapsOnceFramesRetire)
+{
+	std::vector <uint8_t> storage(TEST_RING_SIZE);
+	MemoryRing ring(VK_NULL_HANDLE, storage.data(), TEST_RING_SIZE, 0);
+
+	MemoryAllocation allocation;
+	REQUIRE(ring.allocate(256, 16, allocation));
+	CHECK(allocation.offset == 0);
+	CHECK(allocation.mapped == storage.data());
+	REQUIRE(ring.allocate(200, 64, allocation));
+	CHECK(allocation.offset == 256);
+	ring.endFrame();
+
+	REQUIRE(ring.allocate(300, 16, allocation));
+	CHECK(allocation.offset == 464);
+	ring.endFrame();
+	CHECK(ring.pendingFrames() == 2);
+	CHECK(ring.usedBytes() == 764);									// Alignment padding is charged to its frame
+
+	// [764, 1024) is too short - wrapping needs the first frame's range back
+	CHECK(!ring.allocate(400, 16, allocation));
+	ring.releaseFrame();
+	CHECK(ring.usedBytes() == 308);
+
+	REQUIRE(ring.allocate(400, 16, allocation));
+	CHECK(allocation.offset == 0);
+	CHECK(allocation.mapped == storage.data());
+	CHECK(ring.usedBytes() == 308 + (TEST_RING_SIZE - 764) + 400);
+	ring.endFrame();
+
+	ring.releaseFrame();
+	ring.releaseFrame();
+	CHECK(ring.pendingFrames() == 0);
+	CHECK(ring.usedBytes() == 0);
+}
+
+
+TEST_CASE(MemoryAllocator, RingDiscardFrameDropsOnlyTheOpenFrame)
+{
+	std::vector <uint8_t> storage(TEST_RING_SIZE);
+	MemoryRing ring(VK_NULL_HANDLE, storage.data(), TEST_RING_SIZE, 0);
+
+	MemoryAllocation allocation;
+	REQUIRE(ring.allocate(128, 16, allocation));
+	ring.endFrame();
+	REQUIRE(ring.allocate(300, 16, allocation));
+	REQUIRE(ring.allocate(300, 16, allocation));
+	ring.discardFrame();
+	CHECK(ring.usedBytes() == 128);
+	CHECK(ring.pendingFrames() == 1);
+
+	REQUIRE(ring.allocate(64, 16, allocation));
+	CHECK(allocation.offset == 128);
+	ring.discardFrame();
+
+	// With every closed frame released the open one restarts at the tail
+	ring.releaseFrame();
+	REQUIRE(ring.allocate(64, 16, allocation));
+	ring.discardFrame();
+	CHECK(ring.usedBytes() == 0);
+	REQUIRE(ring.allocate(TEST_RING_SIZE, 1, allocation));
+	CHECK(allocation.offset == 0);
+}
+
+
+TEST_CASE(MemoryAllocator, RingStartLimitAndReset)
+{
+	std::vector <uint8_t> storage(TEST_RING_SIZE);
+	MemoryRing ring(VK_NULL_HANDLE, storage.data(), TEST_RING_SIZE, 0);
+	ring.setStartLimit(TEST_RING_SIZE - 256);
+
+	MemoryAllocation allocation;
+	REQUIRE(ring.allocate(64, 1, allocation));
+	ring.endFrame();
+	REQUIRE(ring.allocate(TEST_RING_SIZE - 256 - 64, 1, allocation));
+	ring.endFrame();
+	ring.releaseFrame();
+
+	// Starting at the limit is allowed, past it wraps
+	REQUIRE(ring.allocate(16, 1, allocation));
+	CHECK(allocation.offset == TEST_RING_SIZE - 256);
+	REQUIRE(ring.allocate(16, 1, allocation));
+	CHECK(allocation.offset == 0);
+
+	ring.reset();
+	CHECK(ring.usedBytes() == 0);
+	CHECK(ring.pendingFrames() == 0);
+	REQUIRE(ring.allocate(32, 1, allocation));
+	CHECK(allocation.offset == 0);
+}
@@ -0,0 +1,383 @@
+// Vulkan Renderer - Mesh Container Tests
+
+#include <vector>
+#include <set>
+#include <array>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+#include "TestHarness.h"
+#include "MeshContainer.h"
+
+
+#define TEST_SPHERE_SEGMENTS 48										// 2 * 48 * 48 triangles, enough for several levels
+#define TEST_MESH_PATH "renderer_tests.rmesh"
+
+
+// UV sphere of unit radius - normals are the positions, seams & poles keep their duplicated vertices
+static MeshData buildSphere(uint32_t segments)
+{
+	const float pi = 3.14159265358979f;
+	MeshData mesh;
+	for (uint32_t y = 0; y <= segments; y++)
+	{
+		float theta = pi * y / segments;
+		for (uint32_t x = 0; x <= segments; x++)
+		{
+			float phi = 2.0f * pi * x / segments;
+			float position[3] = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+			mesh.positions.insert(mesh.positions.end(), position, position + 3);
+			mesh.normals.insert(mesh.normals.end(), position, position + 3);
+			mesh.uvs.push_back((float)x / segments);
+			mesh.uvs.push_back((float)y / segments);
+		}
+	}
+	for (uint32_t y = 0; y < segments; y++)
+	{
+		for (uint32_t x = 0; x < segments; x++)
+		{
+			uint32_t a = y * (segments + 1) + x;
+			uint32_t b = a + segments + 1;
+			mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+	return mesh;
+}
+
+
+static uint32_t readIndex(const MeshContainer& container, uint32_t i)
+{
+	if (container.indexType() == VK_INDEX_TYPE_UINT16)
+	{
+		uint16_t value;
+		std::memcpy(&value, container.indexData() + i * 2, sizeof(value));
+		return value;
+	}
+	uint32_t value;
+	std::memcpy(&value, container.indexData() + i * 4, sizeof(value));
+	return value;
+}
+
+
+// Inverses of the build time packing, as mesh.vert decodes them
+static float unpackSnorm16(int16_t value)
+{
+	return std::max(value / 32767.0f, -1.0f);
+}
+
+static float unpackHalf(uint16_t value)
+{
+	int exponent = (value >> 10) & 0x1F;
+	float magnitude = exponent == 0 ? std::ldexp((float)(value & 0x3FF), -24) : std::ldexp((float)((value & 0x3FF) | 0x400), exponent - 25);
+	return (value & 0x8000) ? -magnitude : magnitude;
+}
+
+static void decodeOctahedral(float x, float y, float normal[3])
+{
+	normal[0] = x;
+	normal[1] = y;
+	normal[2] = 1.0f - std::fabs(x) - std::fabs(y);
+	if (normal[2] < 0.0f)
+	{
+		normal[0] = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		normal[1] = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+	}
+	float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		normal[axis] /= length;
+	}
+}
+
+
+// Triangles as rotated index triples, sorted - equal when two lists draw the same triangles in any order
+static std::vector<std::array<uint32_t, 3>> triangleSet(const std::vector<uint32_t>& indices)
+{
+	std::vector <std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		std::array<uint32_t, 3> triangle = { indices[i], indices[i + 1], indices[i + 2] };
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+
+TEST_CASE(MeshContainer, FileRoundTrip)
+{
+	MeshData mesh = buildSphere(TEST_SPHERE_SEGMENTS);
+	std::vector <uint8_t> bytes;
+	REQUIRE(MeshContainer::build(mesh, bytes));
+	REQUIRE(MeshContainer::write(TEST_MESH_PATH, bytes));
+	CHECK(MeshContainer::isContainer(TEST_MESH_PATH));
+
+	MeshContainer mapped;
+	REQUIRE(mapped.open(TEST_MESH_PATH));
+	MeshContainer loaded;
+	REQUIRE(loaded.load(std::vector<uint8_t>(bytes)));
+	CHECK(std::memcmp(&mapped.getHeader(), &loaded.getHeader(), sizeof(MeshContainerHeader)) == 0);
+	CHECK(std::memcmp(mapped.vertexData(), loaded.vertexData(), mapped.getHeader().vertexSize) == 0);
+	CHECK(std::memcmp(mapped.indexData(), loaded.indexData(), mapped.getHeader().indexSize) == 0);
+	mapped.close();
+	std::remove(TEST_MESH_PATH);
+
+	// Truncated or foreign bytes are refused
+	MeshContainer broken;
+	CHECK(!broken.load(std::vector<uint8_t>(bytes.begin(), bytes.end() - 4)));
+	std::vector <uint8_t> foreign(bytes);
+	foreign[0] ^= 0xFF;
+	CHECK(!broken.load(std::move(foreign)));
+	CHECK(!broken.isOpen());
+}
+
+
+TEST_CASE(MeshContainer, MeshletsTileSubmeshes)
+{
+	MeshData mesh = buildSphere(TEST_SPHERE_SEGMENTS);
+	std::vector <uint8_t> bytes;
+	REQUIRE(MeshContainer::build(mesh, bytes));
+	MeshContainer container;
+	REQUIRE(container.load(std::move(bytes)));
+	REQUIRE(container.getHeader().submeshCount == 1);
+	CHECK(container.getHeader().meshletCount > 1);
+
+	// Back to back in index order, each within the limits & referencing as many vertices as it claims
+	const MeshContainerSubmesh& submesh = container.submeshes()[0];
+	uint32_t meshlet_indices = 0;
+	for (uint32_t m = submesh.firstMeshlet; m < submesh.firstMeshlet + submesh.meshletCount; m++)
+	{
+		const MeshContainerMeshlet& meshlet = container.meshlets()[m];
+		CHECK(meshlet.firstIndex == submesh.firstIndex + meshlet_indices);
+		CHECK(meshlet.vertexCount <= MESHLET_MAX_VERTICES);
+		CHECK(meshlet.indexCount <= MESHLET_MAX_TRIANGLES * 3);
+		CHECK(meshlet.radius > 0.0f);
+
+		std::set <uint32_t> vertices;
+		for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+		{
+			vertices.insert(readIndex(container, i));
+		}
+		CHECK(vertices.size() == meshlet.vertexCount);
+		CHECK(*vertices.rbegin() < container.vertexCount());
+		meshlet_indices += meshlet.indexCount;
+	}
+	CHECK(meshlet_indices == submesh.indexCount);
+}
+
+
+TEST_CASE(MeshContainer, RawBuildReproducesSource)
+{
+	MeshData mesh = buildSphere(TEST_SPHERE_SEGMENTS);
+	MeshBuildOptions options;
+	options.optimizeIndices = false;
+	options.quantize = false;
+	options.generateLods = false;
+
+	std::vector <uint8_t> bytes;
+	REQUIRE(MeshContainer::build(mesh, bytes, options));
+	MeshContainer container;
+	REQUIRE(container.load(std::move(bytes)));
+
+	CHECK(container.getHeader().vertexStride == 32);
+	CHECK(container.lodCount() == 1);
+	CHECK(container.indexCount() == mesh.indices.size());
+	CHECK(container.indexType() == VK_INDEX_TYPE_UINT16);
+	CHECK(container.attributes()[0].format == VK_FORMAT_R32G32B32_SFLOAT);
+	REQUIRE(container.getHeader().submeshCount == 1);
+	CHECK(container.submeshes()[0].indexCount == mesh.indices.size());
+
+	// Source order - every index points at a vertex holding the source attributes, normals renormalized
+	for (uint32_t i = 0; i < container.indexCount(); i++)
+	{
+		uint32_t index = readIndex(container, i);
+		REQUIRE(index < container.vertexCount());
+		float vertex[8];
+		std::memcpy(vertex, container.vertexData() + index * 32, sizeof(vertex));
+		uint32_t source = mesh.indices[i];
+		CHECK(std::memcmp(vertex, &mesh.positions[source * 3], 12) == 0);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			CHECK(std::fabs(vertex[3 + axis] - mesh.normals[source * 3 + axis]) < 1e-6f);
+		}
+		CHECK(std::memcmp(vertex + 6, &mesh.uvs[source * 2], 8) == 0);
+	}
+}
+
+
+TEST_CASE(MeshContainer, QuantizedVerticesWithinError)
+{
+	MeshData mesh = buildSphere(TEST_SPHERE_SEGMENTS);
+	MeshBuildOptions options;
+	options.optimizeIndices = false;
+	options.generateLods = false;
+
+	// Same layout but for the packing, so vertex i of one is vertex i of the other
+	std::vector <uint8_t> raw_bytes;
+	std::vector <uint8_t> quantized_bytes;
+	options.quantize = false;
+	REQUIRE(MeshContainer::build(mesh, raw_bytes, options));
+	options.quantize = true;
+	REQUIRE(MeshContainer::build(mesh, quantized_bytes, options));
+	MeshContainer raw;
+	MeshContainer quantized;
+	REQUIRE(raw.load(std::move(raw_bytes)));
+	REQUIRE(quantized.load(std::move(quantized_bytes)));
+
+	const MeshContainerHeader& header = quantized.getHeader();
+	CHECK(header.vertexStride == 16);
+	CHECK(quantized.attributes()[0].format == VK_FORMAT_R16G16B16A16_SNORM);
+	REQUIRE(header.vertexCount == raw.vertexCount());
+	REQUIRE(header.indexCount == raw.indexCount());
+	CHECK(std::memcmp(quantized.indexData(), raw.indexData(), header.indexSize) == 0);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		CHECK(std::fabs(header.boundsMin[axis] + 1.0f) < 1e-5f);
+		CHECK(std::fabs(header.boundsMax[axis] - 1.0f) < 1e-5f);
+	}
+
+	float worst_position = 0.0f;
+	float worst_normal = 1.0f;
+	float worst_uv = 0.0f;
+	for (uint32_t v = 0; v < header.vertexCount; v++)
+	{
+		float source[8];
+		int16_t packed[8];
+		std::memcpy(source, raw.vertexData() + v * 32, sizeof(source));
+		std::memcpy(packed, quantized.vertexData() + v * 16, sizeof(packed));
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float position = unpackSnorm16(packed[axis]) * header.positionScale[axis] + header.positionOffset[axis];
+			worst_position = std::max(worst_position, std::fabs(position - source[axis]) / header.positionScale[axis]);
+		}
+
+		float normal[3];
+		decodeOctahedral(unpackSnorm16(packed[4]), unpackSnorm16(packed[5]), normal);
+		float length = std::sqrt(source[3] * source[3] + source[4] * source[4] + source[5] * source[5]);
+		worst_normal = std::min(worst_normal, (normal[0] * source[3] + normal[1] * source[4] + normal[2] * source[5]) / length);
+
+		uint16_t halves[2];
+		std::memcpy(halves, &packed[6], sizeof(halves));
+		worst_uv = std::max(worst_uv, std::fabs(unpackHalf(halves[0]) - source[6]));
+		worst_uv = std::max(worst_uv, std::fabs(unpackHalf(halves[1]) - source[7]));
+	}
+
+	// Half a snorm step over the bounds, ~0.01 degree normals, half a half float step at 1.0
+	CHECK(worst_position <= 0.5f / 32767.0f + 1e-6f);
+	CHECK(worst_normal >= 0.99999f);
+	CHECK(worst_uv <= 1.0f / 2048.0f);
+}
+
+
+TEST_CASE(MeshContainer, OptimizedBuildKeepsTriangles)
+{
+	MeshData mesh = buildSphere(TEST_SPHERE_SEGMENTS);
+	MeshBuildOptions options;
+	options.quantize = false;
+	options.generateLods = false;
+
+	std::vector <uint8_t> bytes;
+	REQUIRE(MeshContainer::build(mesh, bytes, options));
+	MeshContainer container;
+	REQUIRE(container.load(std::move(bytes)));
+	REQUIRE(container.indexCount() == mesh.indices.size());
+
+	// Name vertices by position on both sides so the vertex reorder drops out of the comparison
+	std::map <std::array<float, 3>, uint32_t> names;
+	auto name = [&names](const float* position)
+	{
+		std::array<float, 3> key = { position[0], position[1], position[2] };
+		return names.insert({ key, (uint32_t)names.size() }).first->second;
+	};
+	std::vector <uint32_t> canonical_source(mesh.indices.size());
+	std::vector <uint32_t> canonical_built(container.indexCount());
+	for (uint32_t i = 0; i < container.indexCount(); i++)
+	{
+		uint32_t index = readIndex(container, i);
+		REQUIRE(index < container.vertexCount());
+		float position[3];
+		std::memcpy(position, container.vertexData() + index * 32, sizeof(position));
+		canonical_built[i] = name(position);
+		canonical_source[i] = name(&mesh.positions[mesh.indices[i] * 3]);
+	}
+	CHECK(triangleSet(canonical_source) == triangleSet(canonical_built));
+
+	std::vector <uint32_t> indices(container.indexCount());
+	for (uint32_t i = 0; i < container.indexCount(); i++)
+	{
+		indices[i] = readIndex(container, i);
+	}
+	CHECK(MeshContainer::cacheMissRatio(indices.data(), indices.size()) <= MeshContainer::cacheMissRatio(mesh.indices.data(), mesh.indices.size()));
+}
+
+
+TEST_CASE(MeshContainer, VertexCacheOrderKeepsTriangles)
+{
+	// Triangles shuffled so the source order thrashes the cache
+	MeshData mesh = buildSphere(TEST_SPHERE_SEGMENTS);
+	std::vector <uint32_t> indices;
+	uint32_t triangles = (uint32_t)mesh.indices.size() / 3;
+	for (uint32_t t = 0; t < triangles; t++)
+	{
+		uint32_t shuffled = (uint32_t)(((uint64_t)t * 7919) % triangles);
+		indices.insert(indices.end(), mesh.indices.begin() + shuffled * 3, mesh.indices.begin() + shuffled * 3 + 3);
+	}
+
+	std::vector <uint32_t> optimized(indices);
+	MeshContainer::optimizeVertexCache(optimized, mesh.positions.size() / 3);
+	CHECK(triangleSet(optimized) == triangleSet(indices));
+
+	float before = MeshContainer::cacheMissRatio(indices.data(), indices.size());
+	float after = MeshContainer::cacheMissRatio(optimized.data(), optimized.size());
+	CHECK(after < before);
+	CHECK(after < 1.0f);
+}
+
+
+TEST_CASE(MeshContainer, LodsShrinkPerSubmesh)
+{
+	MeshData mesh = buildSphere(TEST_SPHERE_SEGMENTS);
+	uint32_t half = (uint32_t)mesh.indices.size() / 6 * 3;
+	mesh.submeshes = { { 0, half }, { half, (uint32_t)mesh.indices.size() - half } };
+
+	std::vector <uint8_t> bytes;
+	REQUIRE(MeshContainer::build(mesh, bytes));
+	MeshContainer container;
+	REQUIRE(container.load(std::move(bytes)));
+	REQUIRE(container.getHeader().submeshCount == 2);
+	CHECK(container.lodCount() > 1);
+	CHECK(container.lodCount() <= MESH_MAX_LODS);
+
+	for (uint32_t s = 0; s < 2; s++)
+	{
+		const MeshContainerSubmesh& submesh = container.submeshes()[s];
+		CHECK(submesh.indexCount == mesh.submeshes[s].second);
+		CHECK(submesh.radius > 0.0f);
+
+		const MeshContainerLod* levels = container.lods() + s * container.lodCount();
+		CHECK(levels[0].firstIndex == submesh.firstIndex);
+		CHECK(levels[0].indexCount == submesh.indexCount);
+		CHECK(levels[0].error == 0.0f);
+		for (uint32_t l = 1; l < container.lodCount(); l++)
+		{
+			CHECK(levels[l].indexCount <= levels[l - 1].indexCount);
+			CHECK(levels[l].indexCount % 3 == 0);
+			CHECK(levels[l].error >= levels[l - 1].error);
+			CHECK(levels[l].firstIndex + levels[l].indexCount <= container.indexCount());
+		}
+		CHECK(levels[container.lodCount() - 1].indexCount < levels[0].indexCount);
+
+		for (uint32_t l = 0; l < container.lodCount(); l++)
+		{
+			for (uint32_t i = levels[l].firstIndex; i < levels[l].firstIndex + levels[l].indexCount; i++)
+			{
+				CHECK(readIndex(container, i) < container.vertexCount());
+			}
+		}
+	}
+}
@@ -0,0 +1,180 @@
+// Vulkan Renderer - Scene Graph Tests
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+#include "TestHarness.h"
+#include "SceneGraph.h"
+
+
+#define TEST_SCENE_WIDE_LEVEL (SCENE_UPDATE_CHUNK * 3)					// Wide enough that a threaded update splits it
+
+
+static void translation(float matrix[16], float x, float y, float z)
+{
+	std::memset(matrix, 0, sizeof(float) * 16);
+	matrix[0] = matrix[5] = matrix[10] = matrix[15] = 1.0f;
+	matrix[12] = x;
+	matrix[13] = y;
+	matrix[14] = z;
+}
+
+static bool hasTranslation(const float* matrix, float x, float y, float z)
+{
+	return matrix && std::fabs(matrix[12] - x) < 1e-5f && std::fabs(matrix[13] - y) < 1e-5f && std::fabs(matrix[14] - z) < 1e-5f;
+}
+
+
+TEST_CASE(SceneGraph, HandlesGoStaleOnDestroy)
+{
+	SceneGraph scene;
+	SceneNode root = scene.createNode();
+	SceneNode child = scene.createNode(root);
+	SceneNode grandchild = scene.createNode(child);
+	REQUIRE(scene.isValid(root) && scene.isValid(child) && scene.isValid(grandchild));
+	CHECK(scene.getParent(child) == root);
+	CHECK(scene.getParent(root) == SCENE_NODE_NONE);
+	CHECK(scene.createNode(SCENE_NODE_NONE - 1) == SCENE_NODE_NONE);
+
+	// The node goes at once, its subtree at the next update
+	scene.destroyNode(child);
+	CHECK(!scene.isValid(child));
+	CHECK(scene.getWorldTransform(child) == nullptr);
+	scene.update();
+	CHECK(!scene.isValid(grandchild));
+	CHECK(scene.isValid(root));
+	CHECK(scene.size() == 1);
+
+	// Recycled slots come back with a new generation - the old handles stay dead
+	SceneNode reused = scene.createNode(root);
+	SceneNode reused_child = scene.createNode(reused);
+	CHECK(reused != child && reused != grandchild);
+	CHECK(reused_child != child && reused_child != grandchild);
+	CHECK(!scene.isValid(child));
+	CHECK(!scene.isValid(grandchild));
+	CHECK(scene.createNode(child) == SCENE_NODE_NONE);
+
+	scene.clear();
+	CHECK(!scene.isValid(root));
+	CHECK(!scene.isValid(reused));
+	CHECK(scene.size() == 0);
+}
+
+
+TEST_CASE(SceneGraph, UpdateComposesTransforms)
+{
+	SceneGraph scene;
+	float matrix[16];
+	SceneNode root = scene.createNode();
+	SceneNode child = scene.createNode(root);
+	SceneNode grandchild = scene.createNode(child);
+	translation(matrix, 1.0f, 0.0f, 0.0f);
+	scene.setLocalTransform(root, matrix);
+	translation(matrix, 0.0f, 2.0f, 0.0f);
+	scene.setLocalTransform(child, matrix);
+	translation(matrix, 0.0f, 0.0f, 3.0f);
+	scene.setLocalTransform(grandchild, matrix);
+
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	scene.setLocalBounds(grandchild, center, 0.5f);
+	scene.update();
+	CHECK(hasTranslation(scene.getWorldTransform(root), 1.0f, 0.0f, 0.0f));
+	CHECK(hasTranslation(scene.getWorldTransform(child), 1.0f, 2.0f, 0.0f));
+	CHECK(hasTranslation(scene.getWorldTransform(grandchild), 1.0f, 2.0f, 3.0f));
+	const SceneBounds* bounds = scene.getWorldBounds(grandchild);
+	REQUIRE(bounds != nullptr);
+	CHECK(std::fabs(bounds->center[2] - 3.0f) < 1e-5f);
+	CHECK(std::fabs(bounds->radius - 0.5f) < 1e-5f);
+
+	// Only the moved subtree is recomputed
+	translation(matrix, 0.0f, 5.0f, 0.0f);
+	scene.setLocalTransform(child, matrix);
+	scene.update();
+	CHECK(scene.getStats().updatedNodes == 2);
+	CHECK(hasTranslation(scene.getWorldTransform(grandchild), 1.0f, 5.0f, 3.0f));
+
+	scene.update();
+	CHECK(scene.getStats().updatedNodes == 0);
+}
+
+
+TEST_CASE(SceneGraph, ReparentMovesSubtree)
+{
+	SceneGraph scene;
+	float matrix[16];
+	SceneNode left = scene.createNode();
+	SceneNode right = scene.createNode();
+	SceneNode child = scene.createNode(left);
+	SceneNode grandchild = scene.createNode(child);
+	translation(matrix, -10.0f, 0.0f, 0.0f);
+	scene.setLocalTransform(left, matrix);
+	translation(matrix, 10.0f, 0.0f, 0.0f);
+	scene.setLocalTransform(right, matrix);
+	translation(matrix, 0.0f, 1.0f, 0.0f);
+	scene.setLocalTransform(grandchild, matrix);
+	scene.update();
+	CHECK(hasTranslation(scene.getWorldTransform(grandchild), -10.0f, 1.0f, 0.0f));
+
+	// Cycles & stale handles are refused without touching the hierarchy
+	CHECK(!scene.setParent(left, grandchild));
+	CHECK(!scene.setParent(child, child));
+	SceneNode stale = scene.createNode();
+	scene.destroyNode(stale);
+	CHECK(!scene.setParent(child, stale));
+	CHECK(scene.getParent(child) == left);
+
+	REQUIRE(scene.setParent(child, right));
+	CHECK(scene.getParent(child) == right);
+	scene.update();
+	CHECK(hasTranslation(scene.getWorldTransform(child), 10.0f, 0.0f, 0.0f));
+	CHECK(hasTranslation(scene.getWorldTransform(grandchild), 10.0f, 1.0f, 0.0f));
+	CHECK(scene.getStats().levels == 3);
+
+	// Detaching makes a root
+	REQUIRE(scene.setParent(child, SCENE_NODE_NONE));
+	scene.update();
+	CHECK(scene.getParent(child) == SCENE_NODE_NONE);
+	CHECK(hasTranslation(scene.getWorldTransform(grandchild), 0.0f, 1.0f, 0.0f));
+}
+
+
+// Workers split the wide level - results must match the caller only update exactly
+TEST_CASE(SceneGraph, ThreadedUpdateMatchesSerial)
+{
+	SceneGraph serial;
+	SceneGraph threaded;
+	threaded.init(2);
+
+	std::vector <SceneNode> serial_nodes;
+	std::vector <SceneNode> threaded_nodes;
+	float matrix[16];
+	for (SceneGraph* scene : { &serial, &threaded })
+	{
+		std::vector <SceneNode>& nodes = scene == &serial ? serial_nodes : threaded_nodes;
+		SceneNode root = scene->createNode();
+		translation(matrix, 1.0f, 2.0f, 3.0f);
+		scene->setLocalTransform(root, matrix);
+		for (uint32_t i = 0; i < TEST_SCENE_WIDE_LEVEL; i++)
+		{
+			SceneNode node = scene->createNode(root);
+			translation(matrix, (float)(i % 97), (float)(i / 97), 0.5f);
+			scene->setLocalTransform(node, matrix);
+			nodes.push_back(node);
+		}
+		scene->update();
+
+		translation(matrix, -4.0f, 0.0f, 0.0f);
+		scene->setLocalTransform(root, matrix);
+		scene->update();
+	}
+
+	CHECK(threaded.getStats().updatedNodes == TEST_SCENE_WIDE_LEVEL + 1);
+	bool matches = true;
+	for (uint32_t i = 0; i < TEST_SCENE_WIDE_LEVEL; i++)
+	{
+		matches = matches && std::memcmp(serial.getWorldTransform(serial_nodes[i]), threaded.getWorldTransform(threaded_nodes[i]), sizeof(SceneMatrix)) == 0;
+	}
+	CHECK(matches);
+	CHECK(hasTranslation(threaded.getWorldTransform(threaded_nodes[TEST_SCENE_WIDE_LEVEL - 1]), -4.0f + (TEST_SCENE_WIDE_LEVEL - 1) % 97, (float)((TEST_SCENE_WIDE_LEVEL - 1) / 97), 0.5f));
+}
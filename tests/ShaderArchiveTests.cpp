@@ -0,0 +1,87 @@
+// Vulkan Renderer - Shader Archive Tests
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+#include "TestHarness.h"
+#include "ShaderArchive.h"
+
+
+#define TEST_ARCHIVE_PATH "renderer_tests.spva"
+
+
+// Header only module of the given size - enough for isSpirv & the archive's checks
+static std::vector<uint8_t> fakeModule(uint32_t words, uint32_t fill)
+{
+	std::vector <uint32_t> code(words, fill);
+	code[0] = SPIRV_MAGIC;
+	std::vector <uint8_t> bytes(words * sizeof(uint32_t));
+	std::memcpy(bytes.data(), code.data(), bytes.size());
+	return bytes;
+}
+
+
+TEST_CASE(ShaderArchive, IsSpirv)
+{
+	std::vector <uint8_t> module = fakeModule(5, 0);
+	CHECK(ShaderArchive::isSpirv(module.data(), module.size()));
+	CHECK(!ShaderArchive::isSpirv(module.data(), module.size() - 4));		// Shorter than a header
+	CHECK(!ShaderArchive::isSpirv(module.data(), module.size() - 1));		// Not whole words
+	module[0] ^= 0xFF;
+	CHECK(!ShaderArchive::isSpirv(module.data(), module.size()));
+}
+
+
+TEST_CASE(ShaderArchive, WriteOpenFind)
+{
+	std::vector <std::string> names = { "vert.spv", "frag.spv", "cull.spv" };
+	std::vector <std::vector<uint8_t>> modules = { fakeModule(5, 1), fakeModule(37, 2), fakeModule(1024, 3) };
+	REQUIRE(ShaderArchive::write(TEST_ARCHIVE_PATH, names, modules));
+
+	ShaderArchive archive;
+	REQUIRE(archive.open(TEST_ARCHIVE_PATH));
+	CHECK(archive.moduleCount() == 3);
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		const uint32_t* code = nullptr;
+		size_t size = 0;
+		REQUIRE(archive.find(names[i], code, size));
+		CHECK(size == modules[i].size());
+		CHECK(reinterpret_cast<uintptr_t>(code) % SHADER_ARCHIVE_ALIGNMENT == 0);		// Mappings start page aligned
+		CHECK(std::memcmp(code, modules[i].data(), size) == 0);
+	}
+
+	const uint32_t* code = nullptr;
+	size_t size = 0;
+	CHECK(!archive.find("missing.spv", code, size));
+	CHECK(!archive.find("vert", code, size));
+	archive.close();
+	CHECK(!archive.isOpen());
+	std::remove(TEST_ARCHIVE_PATH);
+}
+
+
+TEST_CASE(ShaderArchive, RejectsInvalidInput)
+{
+	CHECK(!ShaderArchive::write(TEST_ARCHIVE_PATH, { "a.spv", "b.spv" }, { fakeModule(5, 0) }));
+
+	// A module that is not SPIR-V makes the whole archive invalid
+	std::vector <std::vector<uint8_t>> modules = { fakeModule(5, 0), fakeModule(8, 0) };
+	modules[1][0] = 0;
+	REQUIRE(ShaderArchive::write(TEST_ARCHIVE_PATH, { "good.spv", "bad.spv" }, modules));
+	ShaderArchive archive;
+	CHECK(!archive.open(TEST_ARCHIVE_PATH));
+	CHECK(archive.moduleCount() == 0);
+
+	{
+		std::ofstream out(TEST_ARCHIVE_PATH, std::ios::binary | std::ios::trunc);
+		out << "not an archive";
+	}
+	CHECK(!archive.open(TEST_ARCHIVE_PATH));
+	CHECK(!archive.open("missing.spva"));
+	std::remove(TEST_ARCHIVE_PATH);
+}
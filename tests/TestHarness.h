@@ -0,0 +1,57 @@
+// Vulkan Renderer - Test Harness
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// Cases register themselves at static init - renderer_tests runs them grouped by suite
+struct TestCase
+{
+	const char* suite;
+	const char* name;
+	void (*run)();
+};
+
+
+inline std::vector<TestCase>& testCases()
+{
+	static std::vector <TestCase> cases;
+	return cases;
+}
+
+inline int& testFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline void testFail(const char* file, int line, const char* expression)
+{
+	std::cout << "[!] " << file << ":" << line << ": CHECK(" << expression << ") failed" << std::endl;
+	testFailures()++;
+}
+
+
+struct TestRegistrar
+{
+	TestRegistrar(const char* suite, const char* name, void (*run)())
+	{
+		testCases().push_back({ suite, name, run });
+	}
+};
+
+
+#define TEST_CASE(suite, name) \
+	static void suite##_##name(); \
+	static TestRegistrar suite##_##name##_registrar(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) testFail(__FILE__, __LINE__, #condition); } while (0)
+
+// Stops the case - for preconditions the rest of it would dereference
+#define REQUIRE(condition) \
+	do { if (!(condition)) { testFail(__FILE__, __LINE__, #condition); return; } } while (0)
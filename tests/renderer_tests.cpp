@@ -0,0 +1,41 @@
+// Vulkan Renderer - Unit Tests
+//
+// renderer_tests [suite]...
+//
+// Runs every suite, or only the ones named. Nothing here needs a device - CTest runs one suite per test
+// from the build directory, where the file round trips write their scratch files. Exits 1 on any failure.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "TestHarness.h"
+
+
+int main(int argc, char** argv)
+{
+	std::vector <std::string> suites(argv + 1, argv + argc);
+
+	int ran = 0;
+	for (const TestCase& test : testCases())
+	{
+		if (!suites.empty() && std::find(suites.begin(), suites.end(), test.suite) == suites.end())
+		{
+			continue;
+		}
+
+		int failures = testFailures();
+		test.run();
+		std::cout << (testFailures() == failures ? "[*] " : "[!] ") << test.suite << "." << test.name << std::endl;
+		ran++;
+	}
+
+	if (ran == 0)
+	{
+		std::cout << "[!] No tests matched" << std::endl;
+		return 1;
+	}
+	std::cout << ran << " tests, " << testFailures() << " failed checks" << std::endl;
+	return testFailures() == 0 ? 0 : 1;
+}
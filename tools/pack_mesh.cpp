@@ -0,0 +1,104 @@
+// Vulkan Renderer - Mesh Container Packer
+//
+// pack_mesh [--no-reorder] [--no-quantize] [--no-lods] <model.obj> <out.rmesh>
+// Dedupes vertices, reorders triangles for the post transform cache, splits each group or material into
+// meshlets, generates simplified levels of detail, quantizes the vertex attributes and writes the vertex &
+// index blobs in the order the GPU reads them. Renderer::loadModel maps the result with no parsing.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "MeshContainer.h"
+
+
+int main(int argc, char** argv)
+{
+	MeshBuildOptions options;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--no-reorder")
+		{
+			options.optimizeIndices = false;
+		}
+		else if (arg == "--no-quantize")
+		{
+			options.quantize = false;
+		}
+		else if (arg == "--no-lods")
+		{
+			options.generateLods = false;
+		}
+		else
+		{
+			paths.push_back(arg);
+		}
+	}
+	if (paths.size() != 2)
+	{
+		std::cerr << "usage: " << argv[0] << " [--no-reorder] [--no-quantize] [--no-lods] <model.obj> <out.rmesh>" << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	MeshData mesh;
+	if (!MeshContainer::importObj(paths[0], mesh))
+	{
+		std::cerr << "[!] Failed to import " << paths[0] << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> container;
+	if (!MeshContainer::build(mesh, container, options) || !MeshContainer::write(paths[1], container))
+	{
+		std::cerr << "[!] Failed to write " << paths[1] << std::endl;
+		return 1;
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	MeshContainer packed;
+	if (!packed.open(paths[1]))
+	{
+		std::cerr << "[!] Failed to read back " << paths[1] << std::endl;
+		return 1;
+	}
+
+	// Full detail indices come first - levels of detail follow them
+	const MeshContainerHeader& header = packed.getHeader();
+	uint32_t full_detail = 0;
+	for (uint32_t s = 0; s < header.submeshCount; s++)
+	{
+		full_detail = std::max(full_detail, packed.submeshes()[s].firstIndex + packed.submeshes()[s].indexCount);
+	}
+	std::vector<uint32_t> indices(full_detail);
+	for (uint32_t i = 0; i < full_detail; i++)
+	{
+		indices[i] = packed.indexType() == VK_INDEX_TYPE_UINT16
+			? reinterpret_cast<const uint16_t*>(packed.indexData())[i]
+			: reinterpret_cast<const uint32_t*>(packed.indexData())[i];
+	}
+
+	std::cout << "[*] Packed " << paths[0] << " into " << paths[1] << " - " << header.vertexCount << " vertices, "
+		<< full_detail / 3 << " triangles, " << header.submeshCount << " submeshes, " << header.meshletCount << " meshlets ("
+		<< container.size() / 1024 << " KB, " << ms << " ms)" << std::endl;
+	std::cout << "[*] Vertex data " << header.vertexSize / 1024 << " KB at " << header.vertexStride << " bytes per vertex, ACMR "
+		<< MeshContainer::cacheMissRatio(mesh.indices.data(), mesh.indices.size()) << " source -> "
+		<< MeshContainer::cacheMissRatio(indices.data(), indices.size()) << " packed" << std::endl;
+	for (uint32_t level = 1; level < header.lodCount; level++)
+	{
+		uint32_t triangles = 0;
+		float error = 0.0f;
+		for (uint32_t s = 0; s < header.submeshCount; s++)
+		{
+			const MeshContainerLod& lod = packed.lods()[s * header.lodCount + level];
+			triangles += lod.indexCount / 3;
+			error = std::max(error, lod.error);
+		}
+		std::cout << "[*] Level " << level << ": " << triangles << " triangles, error " << error << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,44 @@
+// Vulkan Renderer - Shader Archive Packer
+//
+// pack_shaders <out.spva> <module.spv>...
+// Each module is stored under the path it was given on the command line,
+// which is the same path the renderer asks for, e.g. src/shaders/vert.spv
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ShaderArchive.h"
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: " << argv[0] << " <out.spva> <module.spv>..." << std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> names;
+	std::vector<std::vector<uint8_t>> modules;
+	for (int i = 2; i < argc; i++)
+	{
+		MappedFile file;
+		if (!file.open(argv[i]) || !ShaderArchive::isSpirv(file.data(), file.size()))
+		{
+			std::cerr << "[!] " << argv[i] << " is missing or not SPIR-V" << std::endl;
+			return 1;
+		}
+		names.push_back(argv[i]);
+		modules.emplace_back(file.data(), file.data() + file.size());
+	}
+
+	if (!ShaderArchive::write(argv[1], names, modules))
+	{
+		std::cerr << "[!] Failed to write " << argv[1] << std::endl;
+		return 1;
+	}
+
+	std::cout << "[*] Packed " << modules.size() << " modules into " << argv[1] << std::endl;
+	return 0;
+}
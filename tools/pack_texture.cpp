@@ -0,0 +1,48 @@
+// Vulkan Renderer - Texture Container Packer
+//
+// pack_texture [--linear] <image.tga|image.ppm> <out.rtex>
+// Builds the full mip chain and block compresses it (BC1, or BC3 when the image has alpha).
+// Color textures are tagged sRGB - pass --linear for normal maps & other data textures.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TextureContainer.h"
+
+
+int main(int argc, char** argv)
+{
+	bool srgb = true;
+	int first = 1;
+	if (argc > 1 && std::string(argv[1]) == "--linear")
+	{
+		srgb = false;
+		first = 2;
+	}
+	if (argc - first != 2)
+	{
+		std::cerr << "usage: " << argv[0] << " [--linear] <image.tga|image.ppm> <out.rtex>" << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> rgba;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	if (!TextureContainer::decodeImage(argv[first], rgba, width, height))
+	{
+		std::cerr << "[!] Failed to decode " << argv[first] << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> container;
+	if (!TextureContainer::encode(rgba.data(), width, height, srgb, container) || !TextureContainer::write(argv[first + 1], container))
+	{
+		std::cerr << "[!] Failed to write " << argv[first + 1] << std::endl;
+		return 1;
+	}
+
+	std::cout << "[*] Packed " << width << "x" << height << " " << argv[first] << " into " << argv[first + 1]
+		<< " (" << container.size() / 1024 << " KB)" << std::endl;
+	return 0;
+}